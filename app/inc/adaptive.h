@@ -0,0 +1,50 @@
+#ifndef ADAPTIVE_H
+#define ADAPTIVE_H
+
+#include "sample.h"
+#include <stdint.h>
+
+/*
+ * Adaptive sampling period for one sensor.
+ *
+ * Every fresh reading updates an EWMA mean and variance per channel. A
+ * reading is "hot" when it is at least one step away from the mean, or
+ * the spread (sqrt of the variance) is at least one step: the period then
+ * drops straight to min_ms, so a transient is followed at full rate. A
+ * "calm" reading (under half a step on both) stretches the period by 1.5x,
+ * up to max_ms. Anything in between keeps the period.
+ *
+ * Steps: temp 0.2 C, hum 1 %RH, lux max(5 lx, 10 % of the mean).
+ */
+
+struct adaptive_config {
+    uint32_t min_ms;
+    uint32_t max_ms;
+};
+
+struct adaptive {
+    struct adaptive_config cfg;
+    uint32_t channels;          // bit c: channel c thuoc sensor nay
+    uint32_t period_ms;
+    int64_t next_ms;            // lan doc tiep theo (CLOCK_MONOTONIC)
+    int64_t mean[SAMPLE_CHANNELS];
+    int64_t var[SAMPLE_CHANNELS];
+    uint32_t primed;            // bit c: da co mean cho channel c
+    uint64_t reads;             // so lan doc
+    uint64_t boosts;            // so lan nhay ve min_ms
+};
+
+// "MIN,MAX" (giay); 0 neu hop le
+int adaptive_parse(const char *spec, struct adaptive_config *cfg);
+
+void adaptive_init(struct adaptive *a, const struct adaptive_config *cfg, uint32_t channels,
+                   int64_t now_ms);
+
+// 1 neu den luc doc sensor
+int adaptive_due(const struct adaptive *a, int64_t now_ms);
+
+// Sau mot lan doc: fresh = cac channel doc duoc (bit hop le); hen lan doc tiep
+void adaptive_update(struct adaptive *a, const struct sensor_sample *sample, uint32_t fresh,
+                     int64_t now_ms);
+
+#endif // ADAPTIVE_H
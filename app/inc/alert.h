@@ -0,0 +1,60 @@
+#ifndef ALERT_H
+#define ALERT_H
+
+#include "sample.h"
+#include <stdint.h>
+
+/*
+ * Threshold / rate / duration rules evaluated on every sample, O(rules).
+ *
+ * Rule file, one rule per line ('#' starts a comment):
+ *
+ *   <name> <channel>[/s] <op> <value> [for <sec>] [hyst <value>]
+ *
+ *   hot    temp > 30 for 60 hyst 0.5    above 30 C for 60 s, clears at 29.5 C
+ *   dry    hum < 25 hyst 2              below 25 %RH, clears above 27 %RH
+ *   dark   lux/s < -200                 lux falling faster than 200 lx/s
+ *
+ * channel is temp | hum | lux, op is > or <. "/s" compares the rate of change
+ * per second between consecutive valid samples instead of the value. A rule
+ * raises once and stays active until the value is back past the threshold by
+ * more than hyst, so a noisy value near the threshold does not flap.
+ *
+ * Events go to an in-process queue and, as text lines, to every client
+ * connected to the Unix socket from alert_listen(). alert_eventfd() is
+ * readable while the queue holds events: poll it, then call alert_next()
+ * until it returns 0, which also resets the eventfd. The socket is served
+ * from alert_eval(): new clients are accepted there, before its events are
+ * sent, one line each:
+ *
+ *   <unix_ms> RAISE|CLEAR <name> <value>\n
+ */
+
+struct alert_event {
+    int64_t t_ms;
+    int32_t value;          // milli-units (per second for rate rules)
+    uint16_t rule;          // index in the rule file, see alert_rule_name()
+    uint8_t raised;         // 1 = raised, 0 = cleared
+};
+
+// Load and compile rules; 0 on success
+int alert_load(const char *path);
+
+// Publish events on a SOCK_STREAM Unix socket at path
+int alert_listen(const char *path);
+
+// eventfd, readable while events are queued (-1 before alert_load)
+int alert_eventfd(void);
+
+// Evaluate all rules against one sample; returns the number of new events
+int alert_eval(const struct sensor_sample *sample);
+
+// Pop the oldest queued event; 1 if one was returned, 0 (eventfd reset) if empty
+int alert_next(struct alert_event *ev);
+
+unsigned int alert_rule_count(void);
+const char *alert_rule_name(unsigned int rule);
+
+void alert_close(void);
+
+#endif // ALERT_H
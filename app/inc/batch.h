@@ -0,0 +1,65 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "sample.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Sample batch codec and wire frame shared by the uplink and the collector.
+ *
+ * Frame, big endian:
+ *
+ *   "EMU1" | uint64 seq | uint32 len | payload[len]
+ *
+ * seq 0 is a hello frame whose payload is the node name; it is sent once
+ * after connecting (TCP) or in front of every batch (UDP) and never acked.
+ * Batches use seq >= 1 and are acked with their seq.
+ *
+ * Payload (delta + zigzag varint, a few bytes per sample vs ~53 as text):
+ *
+ *   varint count, varint t0_ms, then per sample: varint dt_ms, byte valid,
+ *   and for each valid channel the zigzag varint delta from that channel's
+ *   previous value in the batch (milli-units)
+ */
+
+#define BATCH_MAGIC         "EMU1"
+#define BATCH_HEAD_LEN      16
+#define BATCH_SEQ_HELLO     0
+#define BATCH_NODE_MAX      64          // ten node, ke ca '\0'
+#define BATCH_MAX_SAMPLES   4096
+
+// Kich thuoc payload toi da cho n mau
+#define BATCH_ENCODED_MAX(n) (20 + (size_t)(n) * (11 + 10 * SAMPLE_CHANNELS))
+
+// Encode s[0..n) vao out (it nhat BATCH_ENCODED_MAX(n) byte); tra ve so byte
+size_t batch_encode(const struct sensor_sample *s, unsigned int n, uint8_t *out);
+
+// Decode payload vao out[0..max); tra ve so mau, -1 neu payload hong
+int batch_decode(const uint8_t *payload, size_t len, struct sensor_sample *out,
+                 unsigned int max);
+
+// So nguyen big endian `bytes` byte (frame, ack, header MQTT)
+static inline void batch_put_be(uint8_t *p, uint64_t v, int bytes)
+{
+    for (int i = bytes - 1; i >= 0; i--) {
+        p[i] = (uint8_t)v;
+        v >>= 8;
+    }
+}
+
+static inline uint64_t batch_get_be(const uint8_t *p, int bytes)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; i++) {
+        v = v << 8 | p[i];
+    }
+    return v;
+}
+
+void batch_put_head(uint8_t *head, uint64_t seq, uint32_t len);
+
+// 0 neu head bat dau bang BATCH_MAGIC
+int batch_get_head(const uint8_t *head, uint64_t *seq, uint32_t *len);
+
+#endif // BATCH_H
@@ -0,0 +1,59 @@
+#ifndef BULK_H
+#define BULK_H
+
+#include "sample.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Bulk loader for archived sensor_data_*.log files (plain, framed or flash
+ * layout), for offline analysis of many nodes / months at once.
+ *
+ * Files are mmap'ed and cut into chunks at line boundaries; a pool of
+ * threads counts the lines of every chunk, then parses each chunk straight
+ * into its slot of one set of columns, so the output keeps file order
+ * without merging. Timestamps are checked and decoded 8 bytes at a time
+ * (SWAR, same code on x86 and ARM), local time goes through mktime() once
+ * per hour per thread.
+ *
+ * The columns have the history ring layout (struct of arrays, milli-units,
+ * valid bit c = channel c read fine).
+ */
+
+struct bulk_config {
+    unsigned int threads;       // 0 = so CPU online
+    size_t chunk_bytes;         // kich thuoc chunk (default 4 MiB)
+    int verify;                 // framed record: kiem tra crc (record_parse)
+    uint64_t skip_bytes;        // bo qua N byte dau cua file dau tien (phan da doc roi)
+};
+
+struct bulk_columns {
+    size_t count;
+    int64_t *t_ms;
+    int32_t *value[SAMPLE_CHANNELS];
+    uint8_t *valid;
+};
+
+struct bulk_stats {
+    uint64_t files;
+    uint64_t bytes;
+    uint64_t lines;
+    uint64_t skipped;           // dong hong / sai format / sai crc
+    uint64_t chunks;
+    unsigned int threads;
+    uint64_t wall_ns;
+};
+
+void bulk_default_config(struct bulk_config *cfg);
+
+/*
+ * Load paths[0..count) (files, or directories of sensor_data_*.log in date
+ * order) into out; free it with bulk_free(). Returns 0, or -1 if an input
+ * could not be opened or memory ran out.
+ */
+int bulk_load(const struct bulk_config *cfg, char *const paths[], int count,
+              struct bulk_columns *out, struct bulk_stats *stats);
+
+void bulk_free(struct bulk_columns *cols);
+
+#endif // BULK_H
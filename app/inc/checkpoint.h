@@ -0,0 +1,51 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "adaptive.h"
+#include "display_data.h"
+#include "logger.h"
+#include <stdint.h>
+
+/*
+ * Warm-restart checkpoint: the in-memory state that is slow to rebuild
+ * (history ring, sensor breakers with their last good readings, adaptive
+ * sampling state) plus the logger cursor (current file, offset and seq of
+ * the last record, day of the last retention run), in one binary file.
+ *
+ *   header  "ENVCKPT1", version, crc32c, size, save time (wall + monotonic),
+ *           logger cursor, breakers, adaptive state, sample count n
+ *   int64_t t_ms[n], int32_t value[SAMPLE_CHANNELS][n], uint8_t valid[n]
+ *
+ * Native byte order and struct layout: a file written by another build is
+ * rejected by the version / size check and the daemon starts cold.
+ *
+ * On startup checkpoint_open() maps and checks the file; its cursor lets
+ * logger_init_with() skip the retention scan and log recovery.
+ * checkpoint_restore() then copies the state back and parses only the log
+ * written after the cursor (bulk_load() from that offset), so startup cost
+ * depends on the time since the last checkpoint, not on the history on
+ * disk. checkpoint_save() writes a temporary file and renames it over the
+ * old one, so a crash leaves either checkpoint whole.
+ */
+
+struct checkpoint_stats {
+    uint64_t samples;           // mau lay tu checkpoint
+    uint64_t tail_samples;      // mau doc lai tu log sau cursor
+    uint64_t tail_bytes;
+    int64_t age_ms;             // tuoi cua checkpoint luc nap
+    uint64_t load_ns;           // open + restore
+};
+
+// Map va kiem tra checkpoint, tra cursor cua logger; -1 neu khong co / hong
+int checkpoint_open(const char *path, struct logger_cursor *cursor);
+
+// Nap lai history, breaker, adaptive (NULL = bo qua) va log tail; unmap checkpoint
+int checkpoint_restore(const char *log_dir, struct adaptive sched[DISPLAY_SENSORS],
+                       struct checkpoint_stats *stats);
+
+// Ghi trang thai hien tai (tmp + fsync + rename); 0 neu OK. health: ban sao breaker
+// cua thread doc sensor (--rt), NULL = doc thang tu display
+int checkpoint_save(const char *path, const struct adaptive sched[DISPLAY_SENSORS],
+                    const struct health health[DISPLAY_SENSORS]);
+
+#endif // CHECKPOINT_H
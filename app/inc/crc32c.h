@@ -0,0 +1,11 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC-32C (Castagnoli). Uses the SSE4.2 / ARMv8 CRC instructions when the
+// CPU has them, a table otherwise. crc32c(0, buf, len) starts a new CRC.
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len);
+
+#endif // CRC32C_H
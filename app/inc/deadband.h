@@ -0,0 +1,41 @@
+#ifndef DEADBAND_H
+#define DEADBAND_H
+
+#include "sample.h"
+#include <stdint.h>
+
+/*
+ * Change-only logging. A sample is written when any channel moved past its
+ * band since the last written sample, a channel became valid / invalid,
+ * or heartbeat_ms has passed; otherwise it is dropped. Band of a channel:
+ * max(abs, |last written value| * rel / 10000), abs = 0 and rel = 0 means
+ * any change.
+ *
+ * The written samples describe a step function: each value holds until
+ * the next record, and stays within the band of what the sensor read. A
+ * gap longer than the heartbeat (plus one sample period) is missing data,
+ * not a held value.
+ */
+
+struct deadband_config {
+    int32_t abs;                // milli-unit
+    uint32_t rel;               // phan van (0.01 %)
+};
+
+struct deadband {
+    struct deadband_config cfg[SAMPLE_CHANNELS];
+    int64_t heartbeat_ms;
+    struct sensor_sample last;  // mau ghi gan nhat
+    int have_last;
+};
+
+// "[CH:]abs=X,rel=P" (X theo don vi channel, P theo %); 0 neu hop le
+int deadband_parse(const char *spec, struct deadband_config cfg[SAMPLE_CHANNELS]);
+
+void deadband_init(struct deadband *d, const struct deadband_config cfg[SAMPLE_CHANNELS],
+                   unsigned int heartbeat_sec);
+
+// 1 neu mau can ghi (va nho no lam moc moi), 0 neu nam trong band
+int deadband_check(struct deadband *d, const struct sensor_sample *sample);
+
+#endif // DEADBAND_H
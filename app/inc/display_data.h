@@ -1,8 +1,48 @@
 #ifndef DISPLAY_DATA_H
 #define DISPLAY_DATA_H
 
+#include "filter.h"
+#include "health.h"
+
+enum display_sensor {
+    DISPLAY_SHT30,
+    DISPLAY_BH1750,
+    DISPLAY_SENSORS
+};
+
+#define DISPLAY_ALL ((1u << DISPLAY_SENSORS) - 1)
+
 void display_data(void);
 
+// Read only the sensors in the mask (1 << DISPLAY_*), others keep their last
+// reading; returns the channels (1 << SAMPLE_*) read fresh
+uint32_t display_data_for(unsigned int sensors);
+
+// Read sensors directly from an i2c-dev bus (e.g. "/dev/i2c-1")
+int display_use_i2cdev(const char *bus_path);
+
 const char* get_ssd1306_buffer(void);
 
+// Typed sample (wall clock t_ms) of the last display_data(), NULL if unparseable
+const struct sensor_sample *display_sample(void);
+
+// Filter every reading before it is displayed and logged (one config per channel)
+void display_set_filters(const struct filter_config cfg[SAMPLE_CHANNELS]);
+
+// Circuit breaker settings for both sensors (health_default_config() if not called)
+void display_set_breaker(const struct health_config *cfg);
+
+// Breaker state and last good reading; age in ms (-1 if never read)
+const struct health *display_sensor_health(enum display_sensor sensor);
+int64_t display_sensor_age_ms(enum display_sensor sensor);
+
+// Warm restart: lay lai trang thai breaker da luu (giu name / cfg hien tai)
+void display_restore_health(enum display_sensor sensor, const struct health *saved);
+
+// Format "<sht30>-<bh1750>" into the OLED buffer and return it
+const char *display_compose(const char *sht30, const char *bh1750);
+
+// Send a string to /dev/oled_ssd1306
+int write_oled(const char *str_display);
+
 #endif // DISPLAY_DATA_H
\ No newline at end of file
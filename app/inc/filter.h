@@ -0,0 +1,58 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include "sample.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Signal conditioning per channel, integer math on milli-unit values:
+ *
+ *   rate   reject a sample that moved faster than max_rate from the last
+ *          accepted one (the last value is held instead); after
+ *          FILTER_REJECT_MAX rejects in a row the new level is accepted
+ *   median median of the last N accepted values (spike filter)
+ *   ema    y += (x - y) / 2^ema_shift
+ *
+ * filter_batch() gives exactly the same output as calling filter_step() on
+ * every element, with the median done 4 samples at a time (SSE2/NEON).
+ */
+
+#define FILTER_MEDIAN_MAX 7
+#define FILTER_REJECT_MAX 3
+
+struct filter_config {
+    uint8_t median;         // cua so median: 1 (tat), 3, 5, 7
+    uint8_t ema_shift;      // 0 = tat
+    int32_t max_rate;       // milli-unit / giay, 0 = tat
+};
+
+struct filter {
+    struct filter_config cfg;
+    int32_t window[FILTER_MEDIAN_MAX];
+    uint8_t filled;         // so gia tri trong window (< median khi moi bat dau)
+    uint8_t pos;            // vi tri ghi tiep theo
+    uint8_t rejects;        // so mau lien tiep bi loai
+    uint8_t primed;
+    int32_t last;           // gia tri da chap nhan gan nhat
+    int64_t last_ms;
+    int64_t ema;            // << FILTER_EMA_FRAC
+    uint64_t rejected;      // tong so mau bi loai
+};
+
+void filter_init(struct filter *f, const struct filter_config *cfg);
+
+// Loc mot mau, tra ve gia tri sau loc
+int32_t filter_step(struct filter *f, int32_t x, int64_t t_ms);
+
+// out[i] = filter_step(f, in[i], t_ms[i]) cho i = 0..n-1; out co the trung in
+void filter_batch(struct filter *f, const int32_t *in, const int64_t *t_ms,
+                  int32_t *out, size_t n);
+
+/*
+ * Parse "[channel:]median=N,ema=K,rate=R" (R theo don vi/giay) vao cfg[]:
+ * chi channel do, hoac moi channel neu khong co prefix. 0 neu hop le.
+ */
+int filter_parse(const char *spec, struct filter_config cfg[SAMPLE_CHANNELS]);
+
+#endif // FILTER_H
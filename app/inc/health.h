@@ -0,0 +1,71 @@
+#ifndef HEALTH_H
+#define HEALTH_H
+
+#include <stdint.h>
+
+/*
+ * Circuit breaker for one sensor.
+ *
+ *   HEALTHY   last read succeeded
+ *   DEGRADED  1 .. fail_max - 1 failures in a row, still read every cycle
+ *   OPEN      fail_max failures in a row: the sensor is not touched until
+ *             retry_ms, then one half-open probe. A failed probe doubles the
+ *             backoff (up to backoff_max_ms), a good one closes the circuit.
+ *
+ * Probe times are jittered over [backoff / 2, backoff] so several nodes (or
+ * sensors) that failed together do not retry in lockstep. The last good
+ * reading is kept so consumers can show it, with its age, while the sensor
+ * is down. Only state changes are printed; failed probes leave the circuit
+ * open and are only counted.
+ */
+
+enum health_state {
+    HEALTH_HEALTHY,
+    HEALTH_DEGRADED,
+    HEALTH_OPEN,
+};
+
+struct health_config {
+    unsigned int fail_max;      // loi lien tiep truoc khi ngat
+    uint32_t backoff_min_ms;    // cho truoc lan probe dau tien
+    uint32_t backoff_max_ms;
+};
+
+struct health {
+    const char *name;
+    struct health_config cfg;
+    enum health_state state;
+    unsigned int fails;         // loi lien tiep
+    uint32_t backoff_ms;
+    int64_t retry_ms;           // OPEN: thoi diem probe tiep theo
+    int64_t down_ms;            // thoi diem loi dau tien cua dot nay
+    uint32_t rng;
+    char last_good[64];         // "" = chua doc duoc lan nao
+    int64_t last_good_ms;
+    uint64_t trips;             // so lan chuyen sang OPEN
+    uint64_t probes;            // so lan probe half-open
+    uint64_t probe_fails;       // probe loi (circuit van OPEN)
+    uint64_t skipped;           // so chu ky bo qua vi OPEN
+};
+
+void health_default_config(struct health_config *cfg);
+
+// "FAILS,MIN_SEC,MAX_SEC"; 0 neu hop le
+int health_parse(const char *spec, struct health_config *cfg);
+
+void health_init(struct health *h, const char *name, const struct health_config *cfg);
+
+// 1 neu chu ky nay duoc doc sensor (OPEN: chi khi den luc probe)
+int health_allow(struct health *h, int64_t now_ms);
+
+// Doc thanh cong; text la gia tri (da loc) de giu lam last good
+void health_success(struct health *h, int64_t now_ms, const char *text);
+
+void health_failure(struct health *h, int64_t now_ms, const char *why);
+
+// Tuoi cua last good (ms), -1 neu chua co
+int64_t health_age_ms(const struct health *h, int64_t now_ms);
+
+const char *health_state_name(enum health_state state);
+
+#endif // HEALTH_H
@@ -0,0 +1,58 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "sample.h"
+#include <stdint.h>
+
+/*
+ * In-memory history of the last N typed samples, struct-of-arrays: one
+ * contiguous, cache-line aligned array per field (t_ms, each channel's
+ * value, valid bits). A scan over one channel only touches that channel's
+ * int32 array and the valid bytes, and needs no text parsing.
+ *
+ * Samples are numbered by a running index: history_head() is the index the
+ * next push gets, history_tail() the oldest one still kept. One thread
+ * pushes; readers may run in other threads. history_get()/history_stats()
+ * lock internally; history_view() hands out pointers into the ring, so
+ * call it between history_read_lock() and history_read_unlock().
+ */
+
+// Mot doan lien tuc cua ring (doan thu 2 khi vong qua cuoi ring)
+struct history_view {
+    unsigned int n[2];
+    const int64_t *t_ms[2];
+    const int32_t *value[SAMPLE_CHANNELS][2];
+    const uint8_t *valid[2];        // bit c: value[c] hop le
+    uint64_t first;                 // chi so cua mau dau tien
+};
+
+struct history_stats {
+    uint32_t count;                 // so mau hop le
+    int32_t min, max;
+    int64_t sum;                    // mean = sum / count
+};
+
+// Cap phat ring cho capacity mau (lam tron len luy thua 2); 0 neu OK
+int history_init(unsigned int capacity);
+
+void history_close(void);
+
+// Them mau moi (ghi de mau cu nhat khi day); bo qua neu chua init
+void history_push(const struct sensor_sample *sample);
+
+uint64_t history_head(void);
+uint64_t history_tail(void);
+
+// Mau thu index; -1 neu chua co hoac da bi ghi de
+int history_get(uint64_t index, struct sensor_sample *out);
+
+void history_read_lock(void);
+void history_read_unlock(void);
+
+// Cac mau co t_ms >= since_ms; tra ve so mau. Phai giu read lock
+unsigned int history_view(int64_t since_ms, struct history_view *view);
+
+// min / max / sum cua mot channel tu since_ms; -1 neu khong co mau hop le
+int history_stats(enum sample_channel channel, int64_t since_ms, struct history_stats *out);
+
+#endif // HISTORY_H
@@ -0,0 +1,42 @@
+#ifndef I2CDEV_BACKEND_H
+#define I2CDEV_BACKEND_H
+
+#include <stddef.h>
+
+// Bits returned by i2cdev_read_sensors() for sensors that failed
+#define I2CDEV_SHT30_FAILED   0x1
+#define I2CDEV_BH1750_FAILED  0x2
+
+// Conversion policy, changeable without rebuilding the kernel modules
+enum i2cdev_sht30_repeatability {
+    I2CDEV_SHT30_LOW,
+    I2CDEV_SHT30_MEDIUM,
+    I2CDEV_SHT30_HIGH,
+};
+
+enum i2cdev_bh1750_resolution {
+    I2CDEV_BH1750_LOW,      // 4 lx, 16 ms
+    I2CDEV_BH1750_HIGH,     // 1 lx, 120 ms
+    I2CDEV_BH1750_HIGH2,    // 0.5 lx, 120 ms
+};
+
+// Open the i2c-dev bus (e.g. "/dev/i2c-1") the sensors are attached to
+int i2cdev_open(const char *bus_path);
+
+void i2cdev_close(void);
+
+void i2cdev_set_policy(enum i2cdev_sht30_repeatability sht30,
+                       enum i2cdev_bh1750_resolution bh1750);
+
+/*
+ * Sample both sensors: one combined write for both commands, one wait for
+ * the slower conversion, one combined read. Fills the buffers with the
+ * same text the kernel drivers return ("25.3-60.1" and "123.4").
+ * Sensors in the skip mask (I2CDEV_*_FAILED bits) are not addressed at all
+ * and come back as failed.
+ * Returns 0, a mask of I2CDEV_*_FAILED bits, or -1 if the bus is not open.
+ */
+int i2cdev_read_sensors(int skip, char *sht30_buf, size_t sht30_size,
+                        char *bh1750_buf, size_t bh1750_size);
+
+#endif // I2CDEV_BACKEND_H
@@ -0,0 +1,71 @@
+#ifndef IORING_H
+#define IORING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Optional io_uring path for the per-cycle I/O: sensor reads, OLED write
+ * and log append. Each slot pairs one registered fd with one registered
+ * buffer owned by the ring, so a cycle needs no open()/close() and the
+ * kernel does not look up fds or pin pages per I/O. The reads of a cycle
+ * go out as one batch (the kernel runs them in parallel), the OLED frame
+ * and log record as a second one, and write completions are reaped on the
+ * next submit without waiting.
+ *
+ * Raw syscalls on the kernel uapi header, no liburing. ioring_start()
+ * fails (and callers keep the blocking path) when the kernel has no
+ * io_uring or it is disabled.
+ */
+
+enum ioring_slot {
+    IORING_SLOT_SHT30,
+    IORING_SLOT_BH1750,
+    IORING_SLOT_OLED,
+    IORING_SLOT_LOG,
+    IORING_SLOTS
+};
+
+#define IORING_MASK(slot) (1u << (slot))
+#define IORING_BUF_SIZE   512       // >= RECORD_MAX_LEN
+
+struct ioring_stats {
+    uint64_t enters;            // so lan goi io_uring_enter
+    uint64_t sqes;
+    uint64_t cqes;
+    uint64_t errors;            // completion < 0 hoac ghi thieu
+};
+
+// Buffer IORING_BUF_SIZE byte cua slot (NULL truoc ioring_start); chi sua khi slot ranh
+void *ioring_buffer(enum ioring_slot slot);
+
+// fd cua slot, -1 = trong; sau ioring_start thi cap nhat bang files update
+int ioring_set_fd(enum ioring_slot slot, int fd);
+
+// Tao ring va dang ky fd + buffer; -1 neu kernel khong ho tro
+int ioring_start(void);
+
+// Doi het I/O dang bay, huy ring
+void ioring_stop(void);
+
+int ioring_active(void);
+
+// Queue read / write len byte cua buffer slot tai offset off (chua submit)
+int ioring_read(enum ioring_slot slot, size_t len, int64_t off);
+int ioring_write(enum ioring_slot slot, size_t len, int64_t off);
+
+// Submit moi SQE da queue (mot syscall) va doi den khi cac slot trong mask xong
+int ioring_submit(unsigned int wait_mask);
+
+// Doi cac slot trong mask (khong submit them); 0 neu khong co gi dang bay
+int ioring_wait(unsigned int wait_mask);
+
+// 1 neu slot co I/O chua xong
+int ioring_busy(enum ioring_slot slot);
+
+// Ket qua cua I/O cuoi cung cua slot (so byte, hoac -errno)
+int ioring_result(enum ioring_slot slot);
+
+void ioring_get_stats(struct ioring_stats *out);
+
+#endif // IORING_H
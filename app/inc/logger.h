@@ -2,14 +2,90 @@
 #define LOGGER_H
 
 #include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "deadband.h"
+
+struct dirent;
+
+// Che do ghi log
+enum logger_mode {
+    LOGGER_MODE_APPEND,     // open/append/close moi mau (mac dinh)
+    LOGGER_MODE_FLASH,      // fallocate + chi ghi nguyen page (giam ghi lai tren SD/eMMC)
+};
+
+// Header page 0 cua file LOGGER_MODE_FLASH: data tu offset page den end
+#define LOG_HEADER_MAGIC  "#sensor_log v1"
+#define LOG_HEADER_FMT    LOG_HEADER_MAGIC " page=%08zu end=%020llu\n"
+
+// Vi tri cua logger, luu trong checkpoint de khoi dong lai nhanh (checkpoint.h)
+struct logger_cursor {
+    char path[256];             // file log hien tai, "" = chua co
+    uint64_t offset;            // ngay sau record cuoi da ghi (logical end voi file flash)
+    uint32_t seq;               // seq cua record do
+    int64_t retention_day;      // 00:00 (unix) cua ngay chay retention gan nhat, 0 = chua
+};
+
+struct logger_config {
+    const char *log_dir;        // thu muc chua sensor_data_YYYY-MM-DD.log
+    enum logger_mode mode;
+    size_t page_size;           // don vi flush (LOGGER_MODE_FLASH)
+    unsigned int flush_sec;     // flush page chua day sau toi da N giay
+    size_t prealloc_bytes;      // fallocate moi lan file can them cho
+    int framed;                 // them seq,len,crc32c vao moi record (mac dinh)
+    const struct deadband_config *deadband;     // SAMPLE_CHANNELS, NULL = ghi moi mau
+    unsigned int heartbeat_sec; // deadband: ghi it nhat moi N giay
+    const struct logger_cursor *resume;     // tu checkpoint: bo qua retention / scan log neu
+                                            // van dung, NULL = quet nhu binh thuong
+    int sketches;               // gom quantile sketch theo gio canh log (sketch.h), mac dinh 1
+};
+
+// Thong ke de do write amplification
+struct logger_stats {
+    uint64_t record_bytes;      // so byte log thuc su
+    uint64_t device_bytes;      // so byte da ghi xuong file (data + header)
+    uint64_t flushes;
+    uint64_t retention_runs;    // so lan chay cleanup_old_logs
+    uint64_t retention_ns;      // tong thoi gian cleanup_old_logs
+    uint64_t samples;           // so mau dua vao log_sensor_sample
+    uint64_t deadband_skipped;  // so mau khong ghi vi nam trong deadband
+};
+
+// Cau hinh mac dinh (append, LOG_DIR)
+void logger_default_config(struct logger_config *cfg);
 
 // Khởi tạo logger (tạo thư mục, xóa log cũ)
 int logger_init(void);
 
+// Khoi tao logger voi cau hinh tuy chon
+int logger_init_with(const struct logger_config *cfg);
+
 // Ghi log dữ liệu sensor - Nhận raw string từ display buffer
 int log_sensor_data(const char *sensor_data);
 
+// Ghi log voi thoi diem cho truoc (replay du lieu cu)
+int log_sensor_data_at(const char *sensor_data, time_t when);
+
+// Ghi log mot mau da parse (text "t.t-h.h-l.l", thoi diem sample->t_ms).
+// Co deadband: chi ghi khi can (xem deadband.h), mau cuoi duoc ghi khi close
+int log_sensor_sample(const struct sensor_sample *sample);
+
+// Flush du lieu con trong buffer va dong file hien tai
+void logger_close(void);
+
+void logger_get_stats(struct logger_stats *stats);
+
+// Vi tri hien tai (doi record dang bay qua io_uring xong truoc)
+void logger_get_cursor(struct logger_cursor *out);
+
 // Xóa log cũ hơn N ngày
 int cleanup_old_logs(int days);
 
-#endif // LOGGER_H
\ No newline at end of file
+// Loc cho scandir(): chi file log ngay sensor_data_*
+int logger_is_log_file(const struct dirent *entry);
+
+// Phan du lieu cua file log trong bo nho (mmap): file LOGGER_MODE_FLASH chi co
+// [page, end) theo header, file khac la ca file
+void logger_data_range(const char *data, size_t size, const char **start, const char **end);
+
+#endif // LOGGER_H
@@ -0,0 +1,89 @@
+#ifndef PROBE_H
+#define PROBE_H
+
+/*
+ * USDT (SystemTap SDT) static probes, provider "env_monitor". A probe is
+ * one nop in the code plus an ELF note (.note.stapsdt) with its name,
+ * address and argument locations; perf / bpftrace / gdb read the note and
+ * patch the nop only while they are attached, so an idle probe costs a
+ * nop:
+ *
+ *   bpftrace -e 'usdt:./env_monitor_app:env_monitor:write_start { ... }'
+ *   perf buildid-cache --add ./env_monitor_app; perf record -e sdt_env_monitor:*
+ *
+ * <sys/sdt.h> (systemtap-sdt-dev) is used when the sysroot has it; without
+ * it the same note is emitted here for x86 and ARM. -DNO_PROBES compiles
+ * every probe out. Arguments are passed as long.
+ */
+
+#define PROBE_PROVIDER env_monitor
+
+#if defined(NO_PROBES)
+
+#define PROBE(name)             do { } while (0)
+#define PROBE1(name, a)         do { (void)(a); } while (0)
+
+#elif defined(__has_include) && __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+
+#define PROBE(name)             DTRACE_PROBE(env_monitor, name)
+#define PROBE1(name, a)         DTRACE_PROBE1(env_monitor, name, (long)(a))
+
+#elif defined(__x86_64__) || defined(__i386__) || defined(__aarch64__) || defined(__arm__)
+
+#define PROBE_STR_(x)           #x
+#define PROBE_STR(x)            PROBE_STR_(x)
+
+#if __SIZEOF_POINTER__ == 8
+#define PROBE_ADDR              ".8byte"
+#else
+#define PROBE_ADDR              ".4byte"
+#endif
+
+// Rang buoc toan hang giong sys/sdt.h: thanh ghi, hang so hoac o nho
+#if defined(__arm__)
+#define PROBE_ARG(x)            "g"((long)(x))
+#else
+#define PROBE_ARG(x)            "nor"((long)(x))
+#endif
+
+// "-8@%rdi": so co dau, sizeof(long) byte, vi tri do compiler chon
+#define PROBE_ARGSPEC(n)        "-" PROBE_STR(__SIZEOF_LONG__) "@%" #n
+
+// Note .note.stapsdt (type 3) cho nop o nhan 990; _.stapsdt.base de tool bu prelink
+#define PROBE_NOTE(name, args)                                              \
+    "990: nop\n"                                                            \
+    ".pushsection .note.stapsdt,\"\",\"note\"\n"                            \
+    ".balign 4\n"                                                           \
+    ".4byte 992f-991f, 994f-993f, 3\n"                                      \
+    "991: .asciz \"stapsdt\"\n"                                             \
+    "992: .balign 4\n"                                                      \
+    "993: " PROBE_ADDR " 990b\n"                                            \
+    PROBE_ADDR " _.stapsdt.base\n"                                          \
+    PROBE_ADDR " 0\n"                                                       \
+    ".asciz \"" PROBE_STR(PROBE_PROVIDER) "\"\n"                            \
+    ".asciz \"" #name "\"\n"                                                \
+    ".asciz \"" args "\"\n"                                                 \
+    "994: .balign 4\n"                                                      \
+    ".popsection\n"                                                         \
+    ".ifndef _.stapsdt.base\n"                                              \
+    ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+    ".weak _.stapsdt.base\n"                                                \
+    ".hidden _.stapsdt.base\n"                                              \
+    "_.stapsdt.base: .space 1\n"                                            \
+    ".size _.stapsdt.base, 1\n"                                             \
+    ".popsection\n"                                                         \
+    ".endif\n"
+
+#define PROBE(name)             __asm__ __volatile__(PROBE_NOTE(name, ""))
+#define PROBE1(name, a)         __asm__ __volatile__(PROBE_NOTE(name, PROBE_ARGSPEC(0)) \
+                                                     :: PROBE_ARG(a))
+
+#else
+
+#define PROBE(name)             do { } while (0)
+#define PROBE1(name, a)         do { (void)(a); } while (0)
+
+#endif
+
+#endif // PROBE_H
@@ -0,0 +1,73 @@
+#ifndef PROF_H
+#define PROF_H
+
+#include "probe.h"
+#include <stdio.h>
+
+/*
+ * Per-stage cost of the pipeline. Every stage is bracketed by
+ * PROF_BEGIN / PROF_END, which fire the USDT probes <probe>_start and
+ * <probe>_end (probe.h) and, with --profile, add the stage's wall time
+ * (CLOCK_MONOTONIC) and CPU time (CLOCK_THREAD_CPUTIME_ID) to its node in
+ * a call tree: the same stage under different parents ("cycle;log;timestamp"
+ * vs "log;timestamp" in replay) is counted separately. Main thread only.
+ *
+ * Without --profile a stage costs the probe nop and one load + branch.
+ */
+
+enum prof_stage {
+    PROF_CYCLE,         // mot vong lap (tru sleep)
+    PROF_DISPLAY,       // display_data_for()
+    PROF_READ,          // doc sensor
+    PROF_FORMAT,        // compose / parse / loc / health
+    PROF_OLED,
+    PROF_LOG,
+    PROF_FILENAME,      // localtime + ten file ngay
+    PROF_TIMESTAMP,     // localtime + strftime
+    PROF_WRITE,         // ghi record (append / flash / io_uring)
+    PROF_SUBMIT,        // ioring_submit() cuoi chu ky
+    PROF_CAPTURE,
+    PROF_HISTORY,
+    PROF_ALERT,
+    PROF_UPLINK,
+    PROF_CONSOLE,       // printf debug
+    PROF_CHECKPOINT,
+    PROF_SLEEP,
+    PROF_STAGES
+};
+
+enum prof_output {
+    PROF_OUT_SUMMARY,   // bang theo cay stage
+    PROF_OUT_FOLDED,    // "cycle;log;write <us>" theo wall time (flamegraph.pl)
+    PROF_OUT_FOLDED_CPU // nhu tren, theo CPU time
+};
+
+extern int prof_enabled;
+
+#define PROF_BEGIN(stage, probe)                    \
+    do {                                            \
+        PROBE(probe##_start);                       \
+        if (prof_enabled) {                         \
+            prof_begin(stage);                      \
+        }                                           \
+    } while (0)
+
+#define PROF_END(stage, probe)                      \
+    do {                                            \
+        if (prof_enabled) {                         \
+            prof_end(stage);                        \
+        }                                           \
+        PROBE(probe##_end);                         \
+    } while (0)
+
+void prof_enable(void);
+
+void prof_begin(enum prof_stage stage);
+void prof_end(enum prof_stage stage);
+
+// "summary" | "folded" | "folded-cpu"; -1 neu khong hop le
+int prof_parse_output(const char *name, enum prof_output *out);
+
+void prof_report(FILE *out, enum prof_output format);
+
+#endif // PROF_H
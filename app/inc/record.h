@@ -0,0 +1,43 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * Framed log record, still one CSV line:
+ *
+ *   <timestamp>,<data>,<seq>,<len>,<crc>\n
+ *
+ * seq  - per-file sequence number, starts at 1 (a gap means lost records)
+ * len  - byte length of "<timestamp>,<data>,<seq>," so a reader that finds
+ *        the end of a record can jump straight to its start
+ * crc  - CRC-32C (8 hex digits) of everything before it, "<len>," included
+ */
+
+#define RECORD_MAX_LEN 512
+
+struct record_view {
+    const char *timestamp;
+    size_t timestamp_len;
+    const char *data;
+    size_t data_len;
+    uint32_t seq;
+};
+
+// Format one record into out; returns its length, or -1 if it does not fit
+int record_format(char *out, size_t size, const char *timestamp,
+                  const char *data, uint32_t seq);
+
+// Check one line [line, line + len) ending in '\n'; 0 if it is a valid record
+int record_parse(const char *line, size_t len, struct record_view *view);
+
+/*
+ * Find the last valid record in buf[0, len). Only complete lines are
+ * considered, so buf may start in the middle of one. Returns the offset
+ * just past that record's '\n' (and its seq), or -1 if there is none.
+ */
+ssize_t record_scan_back(const char *buf, size_t len, uint32_t *seq);
+
+#endif // RECORD_H
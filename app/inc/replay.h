@@ -0,0 +1,43 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "filter.h"
+#include <signal.h>
+#include <stdint.h>
+
+/*
+ * Replay recorded samples through the normal pipeline (filters, display
+ * formatting, alert rules, uplink, logging, retention) without sensors, at
+ * real time x speed or as fast as possible, and report throughput and the
+ * cost of each stage.
+ *
+ * Inputs are sensor_data_*.log files (plain, framed or flash layout),
+ * directories holding them, or binary captures written with --capture:
+ *
+ *   "ENVCAP1\n", then per sample: uint64_t unix_ms, uint16_t len, data[len]
+ *   (little endian, data is the OLED text "t.t-h.h-l.l")
+ */
+#define REPLAY_CAPTURE_MAGIC "ENVCAP1\n"
+
+struct replay_config {
+    double speed;           // x real time, 0 = as fast as possible
+    int oled;               // also write every frame to /dev/oled_ssd1306
+    const char *log_dir;    // output log dir, must not be one of the inputs
+    const struct filter_config *filters;    // SAMPLE_CHANNELS config, NULL = no filtering
+    unsigned int fill_sec;      // repeat held values every N s between records (deadband logs)
+    unsigned int fill_max_sec;  // longer gaps are missing data and are not filled
+};
+
+// Refuse inputs inside cfg->log_dir (call before logger init: it prunes old logs)
+int replay_check_inputs(const struct replay_config *cfg, char *const inputs[], int count);
+
+// Replay inputs[0..count) in order; returns 0, or -1 if nothing could be read
+int replay_run(const struct replay_config *cfg, char *const inputs[], int count,
+               volatile sig_atomic_t *running);
+
+// Append live samples to a binary capture file
+int capture_open(const char *path);
+int capture_write(int64_t unix_ms, const char *data);
+void capture_close(void);
+
+#endif // REPLAY_H
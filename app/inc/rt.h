@@ -0,0 +1,74 @@
+#ifndef RT_H
+#define RT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdatomic.h>
+
+/*
+ * Real-time acquisition (--rt). rt_enter() turns the calling thread into
+ * the acquisition thread: SCHED_FIFO at cfg->priority, pinned to cfg->cpu,
+ * with every current and future page of the process locked (mlockall), the
+ * heap kept from shrinking or mmap'ing and RT_STACK_PREFAULT bytes of stack
+ * touched, so the loop takes no page faults. Threads created before it keep
+ * SCHED_OTHER and all CPUs.
+ *
+ * struct rt_queue hands fixed-size items from the acquisition thread to a
+ * normal-priority worker (logging, capture, alert socket, uplink, console,
+ * checkpoint): single producer, single consumer, slots allocated up front,
+ * an eventfd to wake the worker. rt_queue_push() never blocks; when the
+ * worker falls RT_QUEUE_SLOTS items behind, the item is dropped and counted.
+ *
+ * rt_latency_test() is a small cyclictest: a thread wakes every period on
+ * an absolute CLOCK_MONOTONIC deadline and records how late it woke, first
+ * as SCHED_OTHER, then after rt_enter(), each time with one CPU hog per
+ * online CPU (memory + syscall churn) running at normal priority.
+ */
+
+#define RT_PRIORITY_DEFAULT     80
+#define RT_STACK_PREFAULT       (256 * 1024)
+#define RT_QUEUE_SLOTS          64
+#define RT_LATENCY_PERIOD_US    1000
+
+struct rt_config {
+    int priority;               // SCHED_FIFO 1..99
+    int cpu;                    // CPU cua thread doc sensor, -1 = khong pin
+};
+
+struct rt_queue {
+    size_t item_size;
+    char *slots;                // RT_QUEUE_SLOTS * item_size
+    _Atomic uint64_t head;      // producer ghi
+    _Atomic uint64_t tail;      // consumer ghi
+    _Atomic int closed;
+    int efd;
+    uint64_t dropped;
+};
+
+// Mac dinh: RT_PRIORITY_DEFAULT tren CPU online cuoi cung
+void rt_default_config(struct rt_config *cfg);
+
+// "PRIO[,CPU]"; 0 neu hop le
+int rt_parse(const char *arg, struct rt_config *cfg);
+
+// SCHED_FIFO + affinity + mlockall + prefault cho thread goi; -1 neu khong du quyen
+int rt_enter(const struct rt_config *cfg);
+
+int rt_queue_init(struct rt_queue *q, size_t item_size);
+
+// Producer: 0, hoac -1 neu queue day (item bi bo)
+int rt_queue_push(struct rt_queue *q, const void *item);
+
+// Consumer: cho den khi co item (1) hoac queue da dong va het item (0)
+int rt_queue_pop(struct rt_queue *q, void *item);
+
+// Producer: khong push nua, consumer lay not phan con lai roi thoat
+void rt_queue_close(struct rt_queue *q);
+
+void rt_queue_free(struct rt_queue *q);
+
+// Do do tre thuc day trong `seconds` giay moi pha (thuong / RT), in ket qua ra out
+int rt_latency_test(const struct rt_config *cfg, unsigned int seconds, FILE *out);
+
+#endif // RT_H
@@ -0,0 +1,30 @@
+#ifndef SAMPLE_H
+#define SAMPLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum sample_channel {
+    SAMPLE_TEMP,
+    SAMPLE_HUM,
+    SAMPLE_LUX,
+    SAMPLE_CHANNELS
+};
+
+// Mot mau da parse, gia tri theo milli-unit (m°C, m%RH, mlx)
+struct sensor_sample {
+    int64_t t_ms;
+    int32_t value[SAMPLE_CHANNELS];
+    uint32_t valid;             // bit i: value[i] hop le (sensor khong bao "ERROR")
+};
+
+extern const char *const sample_channel_names[SAMPLE_CHANNELS];
+
+// Parse text OLED "t.t-h.h-l.l" (phan SHT30 / BH1750 co the la "ERROR"); -1 neu sai format
+int sample_parse(const char *text, int64_t t_ms, struct sensor_sample *out);
+
+// Nguoc lai: "t.t-h.h" / "l.l" (1 chu so thap phan nhu driver) hoac "ERROR"
+void sample_format(const struct sensor_sample *s, char *sht30, size_t sht30_size,
+                   char *bh1750, size_t bh1750_size);
+
+#endif // SAMPLE_H
@@ -0,0 +1,105 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * 4 x int32 vector helpers: SSE2, NEON or a scalar fallback (1 lane), so
+ * the same loop builds for the x86 dev host and the ARM target. Masks are
+ * all-ones / all-zeros lanes.
+ *
+ * The target build takes the NEON branch: the Makefile adds -mfpu=neon
+ * -mfloat-abi=hard (ARM_FLAGS) for an ARM CC, as the Yocto SDK CC does.
+ * With ARM_FLAGS= or a soft-float CC it falls back to scalar. Every
+ * branch must give the same result (history.c, filter.c), so callers
+ * size their int32 accumulators for VEC_LANES = 1.
+ */
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+
+typedef __m128i vec_t;
+#define VEC_LANES 4
+
+static inline vec_t vec_load(const int32_t *p)
+{
+    return _mm_loadu_si128((const __m128i *)p);
+}
+
+static inline void vec_store(int32_t *p, vec_t v)
+{
+    _mm_storeu_si128((__m128i *)p, v);
+}
+
+// SSE2 chua co pminsd/pmaxsd (SSE4.1): chon theo mask so sanh
+static inline vec_t vec_min(vec_t a, vec_t b)
+{
+    __m128i gt = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(gt, b), _mm_andnot_si128(gt, a));
+}
+
+static inline vec_t vec_max(vec_t a, vec_t b)
+{
+    __m128i gt = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(gt, a), _mm_andnot_si128(gt, b));
+}
+
+// 4 byte -> 4 lane (zero extend)
+static inline vec_t vec_load_u8(const uint8_t *p)
+{
+    uint32_t w;
+    memcpy(&w, p, sizeof(w));
+    __m128i v = _mm_cvtsi32_si128((int)w);
+    v = _mm_unpacklo_epi8(v, _mm_setzero_si128());
+    return _mm_unpacklo_epi16(v, _mm_setzero_si128());
+}
+
+#define vec_set1(x)         _mm_set1_epi32(x)
+#define vec_add(a, b)       _mm_add_epi32(a, b)
+#define vec_sub(a, b)       _mm_sub_epi32(a, b)
+#define vec_and(a, b)       _mm_and_si128(a, b)
+#define vec_cmpeq(a, b)     _mm_cmpeq_epi32(a, b)
+// mask ? a : b
+#define vec_select(m, a, b) _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b))
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+
+typedef int32x4_t vec_t;
+#define VEC_LANES 4
+#define vec_load(p)     vld1q_s32(p)
+#define vec_store(p, v) vst1q_s32(p, v)
+#define vec_min(a, b)   vminq_s32(a, b)
+#define vec_max(a, b)   vmaxq_s32(a, b)
+
+static inline vec_t vec_load_u8(const uint8_t *p)
+{
+    uint32_t w;
+    memcpy(&w, p, sizeof(w));
+    uint16x8_t h = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(w)));
+    return vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(h)));
+}
+
+#define vec_set1(x)         vdupq_n_s32(x)
+#define vec_add(a, b)       vaddq_s32(a, b)
+#define vec_sub(a, b)       vsubq_s32(a, b)
+#define vec_and(a, b)       vandq_s32(a, b)
+#define vec_cmpeq(a, b)     vreinterpretq_s32_u32(vceqq_s32(a, b))
+#define vec_select(m, a, b) vbslq_s32(vreinterpretq_u32_s32(m), a, b)
+#else
+typedef int32_t vec_t;
+#define VEC_LANES 1
+#define vec_load(p)         (*(p))
+#define vec_store(p, v)     (*(p) = (v))
+#define vec_min(a, b)       ((a) < (b) ? (a) : (b))
+#define vec_max(a, b)       ((a) > (b) ? (a) : (b))
+#define vec_load_u8(p)      ((int32_t)*(p))
+#define vec_set1(x)         ((int32_t)(x))
+#define vec_add(a, b)       ((a) + (b))
+#define vec_sub(a, b)       ((a) - (b))
+#define vec_and(a, b)       ((a) & (b))
+#define vec_cmpeq(a, b)     (-(int32_t)((a) == (b)))
+#define vec_select(m, a, b) ((m) ? (a) : (b))
+#endif
+
+#endif // SIMD_H
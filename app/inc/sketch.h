@@ -0,0 +1,97 @@
+#ifndef SKETCH_H
+#define SKETCH_H
+
+#include "sample.h"
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * DDSketch quantile sketch per channel. Values (milli-units, as in struct
+ * sensor_sample) are counted in logarithmic bins: bin i holds
+ * (gamma^(i-1), gamma^i], gamma = (1 + a) / (1 - a), so any quantile comes
+ * back within relative error a = SKETCH_ALPHA of a real sample. Negative
+ * values go to a mirrored store, |v| < 1 counts as zero. Two sketches
+ * merge exactly by adding bin counts, so hours add up to days, months or
+ * years without touching the logs.
+ *
+ * Stored next to the logs, one record per (bucket, channel):
+ *
+ *   sketch_YYYY-MM.skt  hour sketches: deltas appended while the hour runs
+ *                       (every SKETCH_FLUSH_SEC), merged once a day
+ *   sketch_YYYY.skt     day sketches, appended when a day is over
+ *
+ *   record = struct sketch_record + uint32_t bins[pos_n + neg_n], crc32c
+ *   over both (native byte order). Readers merge every record of a bucket,
+ *   and stop at the first bad one (torn tail).
+ *
+ * Buckets are local hours / days like the daily logs. Log retention only
+ * removes sensor_data_* files, so the sketches outlive the raw logs.
+ */
+
+#define SKETCH_ALPHA        0.005       // sai so tuong doi 0.5 %
+#define SKETCH_BINS         2176        // > log(2^31) / log(gamma)
+#define SKETCH_FLUSH_SEC    300
+
+enum sketch_kind {
+    SKETCH_HOUR,
+    SKETCH_DAY,
+};
+
+struct sketch {
+    uint64_t count;
+    uint64_t zero;              // |v| < 1
+    int32_t min, max;
+    int lo[2], hi[2];           // doan bin da dung cua store [0] duong, [1] am
+    uint32_t bins[2][SKETCH_BINS];
+};
+
+struct sketch_record {
+    char magic[4];              // "SKT1"
+    uint8_t kind;               // enum sketch_kind
+    uint8_t channel;            // enum sample_channel
+    uint16_t pos_n;
+    int64_t start;              // unix time dau gio / dau ngay (gio dia phuong)
+    uint64_t count;
+    uint64_t zero;
+    int32_t min, max;
+    int16_t pos_lo, neg_lo;
+    uint16_t neg_n;
+    uint16_t pad;
+    uint32_t crc;               // tinh voi crc = 0
+    uint32_t reserved;
+};
+
+// Gom mau theo gio cho logger (hoac tool dung lai tu log cu)
+struct sketch_writer {
+    char dir[256];
+    int64_t hour_start, hour_end;   // gio dang gom [start, end)
+    int64_t day_start, day_end;
+    int64_t flushed;                // thoi diem mau luc flush delta gan nhat
+    struct sketch cur[SAMPLE_CHANNELS];
+};
+
+// Xoa toan bo sketch (bo nho chua khoi tao cung duoc)
+void sketch_init(struct sketch *s);
+
+// Dung lai sketch da sketch_init: chi xoa doan bin da dung
+void sketch_reset(struct sketch *s);
+
+void sketch_add(struct sketch *s, int32_t value);
+void sketch_merge(struct sketch *dst, const struct sketch *src);
+
+// Gia tri tai quantile q (0..1), trong sai so SKETCH_ALPHA; count phai > 0
+int32_t sketch_quantile(const struct sketch *s, double q);
+
+// Gop moi sketch cua [from, to) trong dir; bucket gio tinh neu gio bat dau trong khoang
+int sketch_query(const char *dir, time_t from, time_t to, struct sketch out[SAMPLE_CHANNELS]);
+
+void sketch_writer_init(struct sketch_writer *w, const char *dir);
+
+// Them mau (theo t_ms cua mau): sang gio moi / du SKETCH_FLUSH_SEC thi ghi delta,
+// sang ngay moi thi gop file thang va ghi sketch ngay
+int sketch_writer_add(struct sketch_writer *w, const struct sensor_sample *sample);
+
+// Ghi delta con lai (khi tat)
+int sketch_writer_flush(struct sketch_writer *w);
+
+#endif // SKETCH_H
@@ -0,0 +1,68 @@
+#ifndef UPLINK_H
+#define UPLINK_H
+
+#include "batch.h"
+#include <stdint.h>
+
+/*
+ * Store-and-forward uplink to a collector.
+ *
+ * Samples are grouped into batches (batch_count samples or batch_sec seconds
+ * of sample time, whichever comes first), encoded, written to queue_dir as
+ * <seq>.batch and sent by a background thread. A batch file is only deleted
+ * once the collector has acknowledged it, so batches queued while the link
+ * is down go out in order when it comes back (at least once: the collector
+ * drops samples it already has). The queue is capped at queue_max bytes by dropping
+ * the oldest unsent batches.
+ *
+ * Batches go out as BATCH_MAGIC frames (see batch.h):
+ *
+ *   tcp://host:port        hello frame with the node name, then batches;
+ *                          the collector answers every batch with its seq
+ *   mqtt://host:port/topic MQTT 3.1.1 PUBLISH QoS 1, acked by PUBACK
+ */
+
+enum uplink_proto {
+    UPLINK_TCP,
+    UPLINK_MQTT,
+};
+
+struct uplink_config {
+    enum uplink_proto proto;
+    char host[128];
+    char port[8];
+    char topic[128];            // UPLINK_MQTT
+    char node[BATCH_NODE_MAX];  // ten node gui cho collector (mac dinh hostname)
+    const char *queue_dir;
+    unsigned int batch_count;   // toi da so mau / batch
+    unsigned int batch_sec;     // toi da thoi gian (theo mau) / batch
+    uint64_t queue_max;         // byte tren disk
+};
+
+struct uplink_stats {
+    uint64_t samples;
+    uint64_t batches;
+    uint64_t payload_bytes;     // tong payload da encode
+    uint64_t sent;              // frame da gui (ke ca gui lai)
+    uint64_t acked;
+    uint64_t dropped;           // batch bi bo vi queue day
+    uint64_t connects;
+};
+
+void uplink_default_config(struct uplink_config *cfg);
+
+// "tcp://host:port" hoac "mqtt://host:port/topic"; 0 neu hop le
+int uplink_parse_url(const char *url, struct uplink_config *cfg);
+
+// Nap lai queue tren disk va chay thread gui
+int uplink_start(const struct uplink_config *cfg);
+
+// Them mot mau vao batch hien tai
+int uplink_push(const struct sensor_sample *sample);
+
+// Ghi batch dang do xuong queue, dung thread (batch chua gui nam lai tren disk)
+void uplink_stop(void);
+
+void uplink_get_stats(struct uplink_stats *stats);
+
+#endif // UPLINK_H
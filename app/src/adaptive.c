@@ -0,0 +1,117 @@
+#include "adaptive.h"
+#include <stdio.h>
+
+#define EWMA_SHIFT      2       // alpha = 1/4 moi mau
+#define LUX_STEP_MIN    5000    // 5 lx
+#define LUX_STEP_REL    10      // %
+
+static const int32_t channel_step[SAMPLE_CHANNELS] = {
+    [SAMPLE_TEMP] = 200,        // 0.2 C
+    [SAMPLE_HUM]  = 1000,       // 1 %RH
+    [SAMPLE_LUX]  = LUX_STEP_MIN,
+};
+
+/*********************************
+ * HELPERS
+ *********************************/
+
+static int64_t step_of(int c, int64_t mean)
+{
+    if (c == SAMPLE_LUX) {
+        int64_t rel = (mean < 0 ? -mean : mean) * LUX_STEP_REL / 100;
+        return rel > LUX_STEP_MIN ? rel : LUX_STEP_MIN;
+    }
+    return channel_step[c];
+}
+
+/*
+ * Cap nhat mean / var cua channel c va cho diem: 2 = hot, 0 = calm, 1 = giu.
+ * var la EWMA cua (x - mean)^2, cung don vi milli^2.
+ */
+static int channel_score(struct adaptive *a, int c, int32_t x)
+{
+    if (!(a->primed & (1u << c))) {
+        a->mean[c] = x;
+        a->var[c] = 0;
+        a->primed |= 1u << c;
+        return 1;
+    }
+
+    int64_t d = x - a->mean[c];
+    int64_t step = step_of(c, a->mean[c]);
+    int64_t dev = d < 0 ? -d : d;
+
+    a->mean[c] += d >> EWMA_SHIFT;
+    a->var[c] += (d * d - a->var[c]) >> EWMA_SHIFT;
+
+    if (dev >= step || a->var[c] >= step * step) {
+        return 2;
+    }
+    if (2 * dev < step && 4 * a->var[c] < step * step) {
+        return 0;
+    }
+    return 1;
+}
+
+/*********************************
+ * PUBLIC API
+ *********************************/
+
+int adaptive_parse(const char *spec, struct adaptive_config *cfg)
+{
+    double min_sec, max_sec;
+    char tail;
+
+    if (sscanf(spec, "%lf,%lf%c", &min_sec, &max_sec, &tail) != 2 ||
+        min_sec < 0.05 || max_sec < min_sec || max_sec > 3600) {
+        return -1;
+    }
+
+    cfg->min_ms = (uint32_t)(min_sec * 1000);
+    cfg->max_ms = (uint32_t)(max_sec * 1000);
+    return 0;
+}
+
+void adaptive_init(struct adaptive *a, const struct adaptive_config *cfg, uint32_t channels,
+                   int64_t now_ms)
+{
+    *a = (struct adaptive){ .cfg = *cfg, .channels = channels };
+    a->period_ms = cfg->min_ms;
+    a->next_ms = now_ms;
+}
+
+int adaptive_due(const struct adaptive *a, int64_t now_ms)
+{
+    return now_ms >= a->next_ms;
+}
+
+void adaptive_update(struct adaptive *a, const struct sensor_sample *sample, uint32_t fresh,
+                     int64_t now_ms)
+{
+    int score = -1;
+
+    a->reads++;
+    for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+        if (sample && (a->channels & fresh & (1u << c))) {
+            int s = channel_score(a, c, sample->value[c]);
+            score = s > score ? s : score;
+        }
+    }
+
+    // score -1: khong doc duoc gi, giu period (breaker lo phan sensor loi)
+    if (score == 2) {
+        if (a->period_ms > a->cfg.min_ms) {
+            a->boosts++;
+        }
+        a->period_ms = a->cfg.min_ms;
+    } else if (score == 0) {
+        uint32_t next = a->period_ms + a->period_ms / 2;
+        a->period_ms = next < a->cfg.max_ms ? next : a->cfg.max_ms;
+    }
+
+    // Hen theo lich, khong troi theo thoi gian doc (tru khi da tre qua mot chu ky)
+    a->next_ms += a->period_ms;
+    if (a->next_ms <= now_ms) {
+        a->next_ms = now_ms + a->period_ms;
+    }
+}
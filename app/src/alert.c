@@ -0,0 +1,449 @@
+#define _GNU_SOURCE     // accept4()
+#include "alert.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define ALERT_CHANNELS    (2 * SAMPLE_CHANNELS)   // gia tri, roi toc do thay doi
+#define ALERT_NAME_LEN    32
+#define ALERT_QUEUE_LEN   256                     // luy thua cua 2
+#define ALERT_MAX_CLIENTS 8
+
+enum rule_state { RULE_CLEAR, RULE_PENDING, RULE_ACTIVE };
+
+/*
+ * Rule da compile. Rule '<' duoc doi dau (sign = -1) de moi rule chi con
+ * mot phep so sanh "x > on"; off = on - hyst la nguong de clear.
+ */
+struct alert_rule {
+    int64_t on;
+    int64_t off;
+    int64_t since;          // RULE_PENDING: luc dieu kien bat dau dung
+    int32_t hold_ms;        // "for <sec>"
+    uint16_t id;
+    int8_t sign;
+    uint8_t state;
+};
+
+static struct {
+    struct alert_rule *rules;               // sap xep theo channel
+    unsigned int count;
+    unsigned int first[ALERT_CHANNELS + 1]; // rules cua channel c: [first[c], first[c + 1])
+    char (*names)[ALERT_NAME_LEN];          // theo id (thu tu trong file)
+    uint32_t rate_mask;                     // channel co rule "/s"
+
+    int32_t prev[SAMPLE_CHANNELS];          // gia tri hop le gan nhat, de tinh toc do
+    int64_t prev_ms[SAMPLE_CHANNELS];
+    uint32_t prev_valid;
+
+    struct alert_event queue[ALERT_QUEUE_LEN];
+    unsigned int head, tail;
+    int efd;
+
+    int listen_fd;
+    int clients[ALERT_MAX_CLIENTS];
+    unsigned int nclients;
+} engine = { .efd = -1, .listen_fd = -1 };
+
+/*********************************
+ * RULE FILE
+ *********************************/
+
+static int parse_channel(const char *name, unsigned int *channel)
+{
+    size_t len = strcspn(name, "/");
+    int rate = strcmp(name + len, "/s") == 0;
+
+    if (name[len] != '\0' && !rate) {
+        return -1;
+    }
+    for (unsigned int i = 0; i < SAMPLE_CHANNELS; i++) {
+        if (strlen(sample_channel_names[i]) == len &&
+            strncmp(name, sample_channel_names[i], len) == 0) {
+            *channel = rate ? SAMPLE_CHANNELS + i : i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int parse_milli(const char *text, int64_t *out)
+{
+    char *end;
+    double value = strtod(text, &end);
+
+    if (end == text || *end != '\0') {
+        return -1;
+    }
+    *out = (int64_t)(value * 1000 + (value < 0 ? -0.5 : 0.5));
+    return 0;
+}
+
+// "<name> <channel>[/s] <op> <value> [for <sec>] [hyst <value>]"
+static int parse_rule(char *line, struct alert_rule *rule, unsigned int *channel, char *name)
+{
+    char *tok[8];
+    int ntok = 0;
+    int64_t threshold, hyst = 0, hold = 0;
+
+    for (char *t = strtok(line, " \t\r\n"); t; t = strtok(NULL, " \t\r\n")) {
+        if (ntok == 8) {
+            return -1;
+        }
+        tok[ntok++] = t;
+    }
+    if (ntok < 4 || ntok % 2 != 0 || strlen(tok[0]) >= ALERT_NAME_LEN ||
+        parse_channel(tok[1], channel) != 0 || parse_milli(tok[3], &threshold) != 0) {
+        return -1;
+    }
+
+    if (strcmp(tok[2], ">") == 0) {
+        rule->sign = 1;
+    } else if (strcmp(tok[2], "<") == 0) {
+        rule->sign = -1;
+    } else {
+        return -1;
+    }
+
+    for (int i = 4; i < ntok; i += 2) {
+        int64_t value;
+        if (parse_milli(tok[i + 1], &value) != 0 || value < 0) {
+            return -1;
+        }
+        if (strcmp(tok[i], "for") == 0) {
+            hold = value;       // giay * 1000 = ms
+        } else if (strcmp(tok[i], "hyst") == 0) {
+            hyst = value;
+        } else {
+            return -1;
+        }
+    }
+
+    strcpy(name, tok[0]);
+    rule->on = rule->sign * threshold;
+    rule->off = rule->on - hyst;
+    rule->hold_ms = (int32_t)hold;
+    rule->state = RULE_CLEAR;
+    return 0;
+}
+
+int alert_load(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        perror("open alert rules");
+        return -1;
+    }
+
+    struct alert_rule *parsed = NULL;
+    unsigned int *channels = NULL;
+    unsigned int count = 0, cap = 0, lineno = 0;
+    char line[256];
+    int ret = 0;
+
+    while (fgets(line, sizeof(line), fp)) {
+        lineno++;
+        line[strcspn(line, "#")] = '\0';
+        if (line[strspn(line, " \t\r\n")] == '\0') {
+            continue;
+        }
+
+        if (count == cap) {
+            cap = cap ? 2 * cap : 16;
+            void *p1 = realloc(parsed, cap * sizeof(*parsed));
+            parsed = p1 ? p1 : parsed;
+            void *p2 = realloc(channels, cap * sizeof(*channels));
+            channels = p2 ? p2 : channels;
+            void *p3 = realloc(engine.names, cap * sizeof(*engine.names));
+            engine.names = p3 ? p3 : engine.names;
+            if (!p1 || !p2 || !p3) {
+                fprintf(stderr, "Out of memory loading alert rules\n");
+                ret = -1;
+                break;
+            }
+        }
+
+        if (count > UINT16_MAX ||
+            parse_rule(line, &parsed[count], &channels[count], engine.names[count]) != 0) {
+            fprintf(stderr, "%s:%u: invalid alert rule\n", path, lineno);
+            ret = -1;
+            break;
+        }
+        parsed[count].id = (uint16_t)count;
+        count++;
+    }
+    fclose(fp);
+
+    if (ret == 0) {
+        // Sap xep on dinh theo channel (counting sort) de moi mau chi duyet rule lien quan
+        memset(engine.first, 0, sizeof(engine.first));
+        for (unsigned int i = 0; i < count; i++) {
+            engine.first[channels[i] + 1]++;
+        }
+        for (unsigned int c = 0; c < ALERT_CHANNELS; c++) {
+            engine.first[c + 1] += engine.first[c];
+        }
+
+        unsigned int next[ALERT_CHANNELS];
+        memcpy(next, engine.first, sizeof(next));
+        free(engine.rules);
+        engine.rules = malloc((count ? count : 1) * sizeof(*engine.rules));
+        if (!engine.rules) {
+            ret = -1;
+        } else {
+            engine.rate_mask = 0;
+            for (unsigned int i = 0; i < count; i++) {
+                engine.rules[next[channels[i]]++] = parsed[i];
+                if (channels[i] >= SAMPLE_CHANNELS) {
+                    engine.rate_mask |= 1u << (channels[i] - SAMPLE_CHANNELS);
+                }
+            }
+            engine.count = count;
+        }
+    }
+    free(parsed);
+    free(channels);
+
+    if (ret == 0 && engine.efd < 0) {
+        engine.efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (engine.efd < 0) {
+            perror("eventfd");
+            ret = -1;
+        }
+    }
+    if (ret == 0) {
+        printf("Loaded %u alert rule(s) from %s\n", count, path);
+    }
+    return ret;
+}
+
+/*********************************
+ * PUBLISHING
+ *********************************/
+
+int alert_listen(const char *path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Alert socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, ALERT_MAX_CLIENTS) != 0) {
+        fprintf(stderr, "listen %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    engine.listen_fd = fd;
+    return 0;
+}
+
+// Nhan client moi dang cho (non-blocking)
+static void accept_clients(void)
+{
+    int fd;
+
+    while (engine.nclients < ALERT_MAX_CLIENTS &&
+           (fd = accept4(engine.listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        engine.clients[engine.nclients++] = fd;
+    }
+}
+
+static void publish(const struct alert_event *ev)
+{
+    // Queue day: bo event cu nhat
+    if (engine.tail - engine.head == ALERT_QUEUE_LEN) {
+        engine.head++;
+    }
+    engine.queue[engine.tail++ % ALERT_QUEUE_LEN] = *ev;
+
+    if (engine.nclients == 0) {
+        return;
+    }
+
+    char line[96];
+    long long mag = llabs((long long)ev->value);
+    int len = snprintf(line, sizeof(line), "%lld %s %s %s%lld.%03lld\n", (long long)ev->t_ms,
+                       ev->raised ? "RAISE" : "CLEAR", engine.names[ev->rule],
+                       ev->value < 0 ? "-" : "", mag / 1000, mag % 1000);
+
+    // Client cham hoac da dong: ngat ket noi thay vi chan vong lap chinh
+    for (unsigned int i = 0; i < engine.nclients; ) {
+        if (send(engine.clients[i], line, len, MSG_NOSIGNAL | MSG_DONTWAIT) != len) {
+            close(engine.clients[i]);
+            engine.clients[i] = engine.clients[--engine.nclients];
+        } else {
+            i++;
+        }
+    }
+}
+
+/*********************************
+ * EVALUATION
+ *********************************/
+
+static int eval_rule(struct alert_rule *rule, int64_t x, int64_t t_ms)
+{
+    int64_t v = rule->sign * x;
+    struct alert_event ev;
+
+    switch (rule->state) {
+    case RULE_CLEAR:
+        if (v <= rule->on) {
+            return 0;
+        }
+        rule->since = t_ms;
+        rule->state = RULE_PENDING;
+        /* fall through */
+    case RULE_PENDING:
+        if (v <= rule->on) {
+            rule->state = RULE_CLEAR;
+            return 0;
+        }
+        if (t_ms - rule->since < rule->hold_ms) {
+            return 0;
+        }
+        rule->state = RULE_ACTIVE;
+        ev.raised = 1;
+        break;
+    default:
+        if (v > rule->off) {
+            return 0;
+        }
+        rule->state = RULE_CLEAR;
+        ev.raised = 0;
+        break;
+    }
+
+    ev.t_ms = t_ms;
+    ev.value = x > INT32_MAX ? INT32_MAX : x < INT32_MIN ? INT32_MIN : (int32_t)x;
+    ev.rule = rule->id;
+    publish(&ev);
+    return 1;
+}
+
+int alert_eval(const struct sensor_sample *sample)
+{
+    int64_t x[ALERT_CHANNELS];
+    uint32_t valid = sample->valid & ((1u << SAMPLE_CHANNELS) - 1);
+    int events = 0;
+
+    if (engine.count == 0) {
+        return 0;
+    }
+    // Event chi sinh ra o day: client moi duoc nhan truoc lan publish tiep theo
+    if (engine.listen_fd >= 0) {
+        accept_clients();
+    }
+
+    for (unsigned int c = 0; c < SAMPLE_CHANNELS; c++) {
+        if (!(valid & (1u << c))) {
+            continue;
+        }
+        x[c] = sample->value[c];
+
+        // Toc do thay doi / giay so voi mau hop le truoc
+        if (engine.rate_mask & engine.prev_valid & (1u << c)) {
+            int64_t dt = sample->t_ms - engine.prev_ms[c];
+            if (dt > 0) {
+                x[SAMPLE_CHANNELS + c] = (x[c] - engine.prev[c]) * 1000 / dt;
+                valid |= 1u << (SAMPLE_CHANNELS + c);
+            }
+        }
+        engine.prev[c] = sample->value[c];
+        engine.prev_ms[c] = sample->t_ms;
+        engine.prev_valid |= 1u << c;
+    }
+
+    for (unsigned int c = 0; c < ALERT_CHANNELS; c++) {
+        if (!(valid & (1u << c))) {
+            continue;
+        }
+        for (unsigned int i = engine.first[c]; i < engine.first[c + 1]; i++) {
+            events += eval_rule(&engine.rules[i], x[c], sample->t_ms);
+        }
+    }
+
+    if (events > 0) {
+        eventfd_write(engine.efd, events);
+    }
+    return events;
+}
+
+/*********************************
+ * QUERIES
+ *********************************/
+
+int alert_eventfd(void)
+{
+    return engine.efd;
+}
+
+int alert_next(struct alert_event *ev)
+{
+    if (engine.head == engine.tail) {
+        eventfd_t ignored;
+
+        // Queue rong: xoa counter de poll() khong bao readable mai
+        if (engine.efd >= 0) {
+            eventfd_read(engine.efd, &ignored);
+        }
+        return 0;
+    }
+    *ev = engine.queue[engine.head++ % ALERT_QUEUE_LEN];
+    return 1;
+}
+
+unsigned int alert_rule_count(void)
+{
+    return engine.count;
+}
+
+const char *alert_rule_name(unsigned int rule)
+{
+    return rule < engine.count ? engine.names[rule] : "?";
+}
+
+void alert_close(void)
+{
+    for (unsigned int i = 0; i < engine.nclients; i++) {
+        close(engine.clients[i]);
+    }
+    engine.nclients = 0;
+
+    if (engine.listen_fd >= 0) {
+        struct sockaddr_un addr;
+        socklen_t len = sizeof(addr);
+        if (getsockname(engine.listen_fd, (struct sockaddr *)&addr, &len) == 0) {
+            unlink(addr.sun_path);
+        }
+        close(engine.listen_fd);
+        engine.listen_fd = -1;
+    }
+    if (engine.efd >= 0) {
+        close(engine.efd);
+        engine.efd = -1;
+    }
+
+    free(engine.rules);
+    free(engine.names);
+    engine.rules = NULL;
+    engine.names = NULL;
+    engine.count = 0;
+}
@@ -0,0 +1,112 @@
+#include "batch.h"
+#include <string.h>
+
+static uint8_t *put_varint(uint8_t *p, uint64_t v)
+{
+    while (v >= 0x80) {
+        *p++ = (uint8_t)v | 0x80;
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+// NULL neu varint vuot qua end hoac dai hon 10 byte
+static const uint8_t *get_varint(const uint8_t *p, const uint8_t *end, uint64_t *v)
+{
+    *v = 0;
+    for (int shift = 0; shift < 70 && p < end; shift += 7) {
+        uint8_t b = *p++;
+        *v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static uint64_t zigzag(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+size_t batch_encode(const struct sensor_sample *s, unsigned int n, uint8_t *out)
+{
+    int64_t prev[SAMPLE_CHANNELS] = { 0 };
+    int64_t prev_ms = n ? s[0].t_ms : 0;
+    uint8_t *p = out;
+
+    p = put_varint(p, n);
+    p = put_varint(p, (uint64_t)prev_ms);
+
+    for (unsigned int i = 0; i < n; i++) {
+        p = put_varint(p, zigzag(s[i].t_ms - prev_ms));
+        prev_ms = s[i].t_ms;
+
+        *p++ = (uint8_t)s[i].valid;
+        for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+            if (s[i].valid & (1u << c)) {
+                p = put_varint(p, zigzag(s[i].value[c] - prev[c]));
+                prev[c] = s[i].value[c];
+            }
+        }
+    }
+    return p - out;
+}
+
+int batch_decode(const uint8_t *payload, size_t len, struct sensor_sample *out,
+                 unsigned int max)
+{
+    const uint8_t *p = payload, *end = payload + len;
+    int64_t prev[SAMPLE_CHANNELS] = { 0 };
+    uint64_t count, t0, v;
+
+    if (!(p = get_varint(p, end, &count)) || !(p = get_varint(p, end, &t0)) || count > max) {
+        return -1;
+    }
+
+    int64_t t_ms = (int64_t)t0;
+    for (unsigned int i = 0; i < count; i++) {
+        if (!(p = get_varint(p, end, &v)) || p >= end) {
+            return -1;
+        }
+        t_ms += unzigzag(v);
+        out[i].t_ms = t_ms;
+        out[i].valid = *p++ & ((1u << SAMPLE_CHANNELS) - 1);
+
+        for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+            if (out[i].valid & (1u << c)) {
+                if (!(p = get_varint(p, end, &v))) {
+                    return -1;
+                }
+                prev[c] += unzigzag(v);
+                out[i].value[c] = (int32_t)prev[c];
+            } else {
+                out[i].value[c] = 0;
+            }
+        }
+    }
+    return p == end ? (int)count : -1;
+}
+
+void batch_put_head(uint8_t *head, uint64_t seq, uint32_t len)
+{
+    memcpy(head, BATCH_MAGIC, 4);
+    batch_put_be(head + 4, seq, 8);
+    batch_put_be(head + 12, len, 4);
+}
+
+int batch_get_head(const uint8_t *head, uint64_t *seq, uint32_t *len)
+{
+    if (memcmp(head, BATCH_MAGIC, 4) != 0) {
+        return -1;
+    }
+    *seq = batch_get_be(head + 4, 8);
+    *len = (uint32_t)batch_get_be(head + 12, 4);
+    return 0;
+}
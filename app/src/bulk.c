@@ -0,0 +1,573 @@
+#include "bulk.h"
+#include "logger.h"
+#include "record.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define BULK_CHUNK_BYTES    (4u << 20)
+#define BULK_ALIGN          64
+#define BULK_MAX_THREADS    256
+#define TS_LEN              19          // "YYYY-MM-DD HH:MM:SS"
+
+// Hang so SWAR: byte i o bit 8*i (little endian)
+#define ONES        0x0101010101010101ULL
+#define HIGHS       0x8080808080808080ULL
+
+struct bulk_file {
+    const char *map;
+    size_t size;
+};
+
+struct bulk_chunk {
+    const char *start;
+    const char *end;
+    size_t first;               // vi tri trong cot (sau pass dem dong)
+    size_t lines;               // so '\n'
+    size_t count;               // so mau parse duoc
+    uint64_t skipped;
+};
+
+struct bulk_job {
+    const struct bulk_config *cfg;
+    struct bulk_chunk *chunks;
+    size_t nchunks;
+    atomic_size_t next;
+    int pass;                   // 0 = dem dong, 1 = parse
+    struct bulk_columns *cols;
+};
+
+/*********************************
+ * HELPERS
+ *********************************/
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t load_le64(const char *p)
+{
+    uint64_t w;
+    memcpy(&w, p, sizeof(w));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    w = __builtin_bswap64(w);
+#endif
+    return w;
+}
+
+// So byte '\n' trong [p, end), 8 byte mot lan
+static size_t count_lines(const char *p, const char *end)
+{
+    size_t n = 0;
+
+    for (; end - p >= 8; p += 8) {
+        uint64_t x = load_le64(p) ^ ('\n' * ONES);
+        // 0x80 dung tai byte bang 0 (khong bi carry giua cac byte)
+        uint64_t t = (x & ~HIGHS) + ~HIGHS;
+        n += __builtin_popcountll(~(t | x | ~HIGHS));
+    }
+    for (; p < end; p++) {
+        n += *p == '\n';
+    }
+    return n;
+}
+
+// Cac byte trong mask la '0'..'9'
+static inline int digits_ok(uint64_t w, uint64_t mask)
+{
+    uint64_t hi = 0xF0F0F0F0F0F0F0F0ULL & mask;
+    uint64_t zero = 0x3030303030303030ULL & mask;
+
+    return (w & hi) == zero && ((w + (0x0606060606060606ULL & mask)) & hi) == zero;
+}
+
+// Byte i cua d*10 + byte i+1: so 2 chu so bat dau tai byte i
+static inline uint64_t pairs(uint64_t w, uint64_t mask)
+{
+    uint64_t d = (w - (0x3030303030303030ULL & mask)) & mask;
+    return d * 10 + (d >> 8);
+}
+
+#define BYTE(w, i)  ((int)((w) >> (8 * (i)) & 0xFF))
+
+/*
+ * "YYYY-MM-DD HH:MM:SS," o dau dong (it nhat 24 byte) -> unix ms. Kiem tra
+ * va tach so 8 byte mot lan, khong re nhanh theo tung ky tu; mktime() chi
+ * khi sang gio moi.
+ */
+static int parse_timestamp(const char *s, int *hour_key, time_t *hour_base, int64_t *out)
+{
+    // "YYYY-MM-" | "DD HH:MM" | ":SS,...."
+    static const uint64_t dmask0 = 0x00FFFF00FFFFFFFFULL, smask0 = 0xFF0000FF00000000ULL;
+    static const uint64_t dmask1 = 0xFFFF00FFFF00FFFFULL, smask1 = 0x0000FF0000FF0000ULL;
+    static const uint64_t dmask2 = 0x0000000000FFFF00ULL, smask2 = 0x00000000FF0000FFULL;
+    static const uint64_t sep0 = (uint64_t)'-' << 32 | (uint64_t)'-' << 56;
+    static const uint64_t sep1 = (uint64_t)' ' << 16 | (uint64_t)':' << 40;
+    static const uint64_t sep2 = (uint64_t)':' | (uint64_t)',' << 24;
+    uint64_t w0 = load_le64(s), w1 = load_le64(s + 8), w2 = load_le64(s + 16);
+
+    if (!(digits_ok(w0, dmask0) & digits_ok(w1, dmask1) & digits_ok(w2, dmask2)) ||
+        ((w0 & smask0) ^ sep0) | ((w1 & smask1) ^ sep1) | ((w2 & smask2) ^ sep2)) {
+        return -1;
+    }
+
+    uint64_t p0 = pairs(w0, dmask0), p1 = pairs(w1, dmask1), p2 = pairs(w2, dmask2);
+    int year = BYTE(p0, 0) * 100 + BYTE(p0, 2);
+    int mon = BYTE(p0, 5), day = BYTE(p1, 0), hour = BYTE(p1, 3);
+    int min = BYTE(p1, 6), sec = BYTE(p2, 1);
+
+    if (mon < 1 || mon > 12 || day < 1 || day > 31 || hour > 23 || min > 59 || sec > 60) {
+        return -1;
+    }
+
+    int key = ((year * 16 + mon) * 32 + day) * 32 + hour;
+    if (key != *hour_key) {
+        struct tm tm = {0};
+        tm.tm_year = year - 1900;
+        tm.tm_mon = mon - 1;
+        tm.tm_mday = day;
+        tm.tm_hour = hour;
+        tm.tm_isdst = -1;
+        *hour_base = mktime(&tm);
+        *hour_key = key;
+    }
+
+    *out = ((int64_t)*hour_base + min * 60 + sec) * 1000;
+    return 0;
+}
+
+// "-12.3" -> -12300 trong [p, end); NULL neu khong phai so
+static const char *parse_fixed(const char *p, const char *end, int32_t *out)
+{
+    int negative = p < end && *p == '-';
+    const char *digits;
+    uint32_t value = 0, scale = 100;
+
+    p += negative;
+    digits = p;
+    while (p < end && (unsigned int)(*p - '0') < 10 && p - digits < 6) {
+        value = value * 10 + (uint32_t)(*p++ - '0');
+    }
+    if (p == digits) {
+        return NULL;
+    }
+    value *= 1000;
+    if (p < end && *p == '.') {
+        for (p++; p < end && (unsigned int)(*p - '0') < 10; p++) {
+            value += (uint32_t)(*p - '0') * scale;
+            scale /= 10;
+        }
+    }
+
+    *out = negative ? -(int32_t)value : (int32_t)value;
+    return p;
+}
+
+// Mot field: so hoac "ERROR" (valid bit khong bat)
+static const char *parse_field(const char *p, const char *end, int32_t *out, int *valid)
+{
+    if (end - p >= 5 && memcmp(p, "ERROR", 5) == 0) {
+        *out = 0;
+        *valid = 0;
+        return p + 5;
+    }
+    *valid = 1;
+    return parse_fixed(p, end, out);
+}
+
+// "t.t-h.h-l.l" (SHT30 / BH1750 co the la "ERROR"), giong sample_parse()
+static int parse_data(const char *p, const char *end, int32_t value[SAMPLE_CHANNELS],
+                      uint8_t *valid)
+{
+    int sht30, bh1750;
+
+    if (end - p >= 5 && memcmp(p, "ERROR", 5) == 0) {
+        p += 5;
+        value[SAMPLE_TEMP] = value[SAMPLE_HUM] = 0;
+        sht30 = 0;
+    } else {
+        p = parse_fixed(p, end, &value[SAMPLE_TEMP]);
+        if (!p || p == end || *p++ != '-' || !(p = parse_fixed(p, end, &value[SAMPLE_HUM]))) {
+            return -1;
+        }
+        sht30 = 1;
+    }
+    if (p == end || *p++ != '-' || !(p = parse_field(p, end, &value[SAMPLE_LUX], &bh1750))) {
+        return -1;
+    }
+
+    *valid = (uint8_t)((sht30 ? 1u << SAMPLE_TEMP | 1u << SAMPLE_HUM : 0) |
+                       (bh1750 ? 1u << SAMPLE_LUX : 0));
+    return p == end ? 0 : -1;
+}
+
+// Dong [line, nl] -> cot i; 0 neu hop le
+static int parse_line(const struct bulk_config *cfg, const char *line, const char *nl,
+                      int *hour_key, time_t *hour_base, struct bulk_columns *cols, size_t i)
+{
+    const char *data = line + TS_LEN + 1;
+    const char *end = nl;
+    int32_t value[SAMPLE_CHANNELS];
+
+    if (nl - line < 24 || parse_timestamp(line, hour_key, hour_base, &cols->t_ms[i]) != 0) {
+        return -1;
+    }
+    if (end[-1] == '\r') {
+        end--;
+    }
+
+    // Record co seq,len,crc: data dung truoc dau ',' tiep theo
+    const char *comma = memchr(data, ',', end - data);
+    if (comma) {
+        if (cfg->verify && record_parse(line, nl - line + 1, NULL) != 0) {
+            return -1;
+        }
+        end = comma;
+    }
+
+    if (parse_data(data, end, value, &cols->valid[i]) != 0) {
+        return -1;
+    }
+    for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+        cols->value[c][i] = value[c];
+    }
+    return 0;
+}
+
+static void parse_chunk(const struct bulk_config *cfg, struct bulk_chunk *ch,
+                        struct bulk_columns *cols)
+{
+    int hour_key = -1;
+    time_t hour_base = 0;
+    size_t i = ch->first;
+
+    for (const char *p = ch->start; p < ch->end; ) {
+        const char *nl = memchr(p, '\n', ch->end - p);
+        if (!nl) {
+            ch->skipped++;      // dong cuoi bi ghi do
+            break;
+        }
+        size_t len = nl - p;
+        if (len > 0 && !(len == 1 && *p == '\r')) {      // dong trong: bo qua
+            if (parse_line(cfg, p, nl, &hour_key, &hour_base, cols, i) == 0) {
+                i++;
+            } else {
+                ch->skipped++;
+            }
+        }
+        p = nl + 1;
+    }
+    ch->count = i - ch->first;
+}
+
+static void *bulk_worker(void *arg)
+{
+    struct bulk_job *job = arg;
+    size_t k;
+
+    while ((k = atomic_fetch_add(&job->next, 1)) < job->nchunks) {
+        struct bulk_chunk *ch = &job->chunks[k];
+        if (job->pass == 0) {
+            ch->lines = count_lines(ch->start, ch->end);
+        } else {
+            parse_chunk(job->cfg, ch, job->cols);
+        }
+    }
+    return NULL;
+}
+
+static void run_pass(struct bulk_job *job, int pass, unsigned int threads)
+{
+    pthread_t tid[BULK_MAX_THREADS];
+    unsigned int started = 0;
+
+    job->pass = pass;
+    atomic_store(&job->next, 0);
+    for (unsigned int t = 1; t < threads; t++) {
+        if (pthread_create(&tid[started], NULL, bulk_worker, job) == 0) {
+            started++;
+        }
+    }
+    bulk_worker(job);           // thread goi cung lam viec
+    for (unsigned int t = 0; t < started; t++) {
+        pthread_join(tid[t], NULL);
+    }
+}
+
+static int add_file(const char *path, struct bulk_file **files, size_t *count, size_t *cap)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        fprintf(stderr, "stat %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    const char *map = NULL;
+    size_t size = st.st_size;
+    if (size > 0) {
+        map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            fprintf(stderr, "mmap %s: %s\n", path, strerror(errno));
+            close(fd);
+            return -1;
+        }
+        madvise((void *)map, size, MADV_SEQUENTIAL);
+    }
+    close(fd);
+
+    if (*count == *cap) {
+        size_t grow = *cap ? *cap * 2 : 64;
+        struct bulk_file *p = realloc(*files, grow * sizeof(*p));
+        if (!p) {
+            if (map) {
+                munmap((void *)map, size);
+            }
+            return -1;
+        }
+        *files = p;
+        *cap = grow;
+    }
+    (*files)[(*count)++] = (struct bulk_file){ .map = map, .size = size };
+    return 0;
+}
+
+// File, hoac thu muc chua sensor_data_*.log (theo thu tu ngay)
+static int add_path(const char *path, struct bulk_file **files, size_t *count, size_t *cap)
+{
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        fprintf(stderr, "stat %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        return add_file(path, files, count, cap);
+    }
+
+    struct dirent **list;
+    int n = scandir(path, &list, logger_is_log_file, alphasort);
+    if (n < 0) {
+        fprintf(stderr, "scandir %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    int ret = 0;
+    for (int i = 0; i < n; i++) {
+        char file[PATH_MAX];
+        snprintf(file, sizeof(file), "%s/%s", path, list[i]->d_name);
+        if (ret == 0 && add_file(file, files, count, cap) != 0) {
+            ret = -1;
+        }
+        free(list[i]);
+    }
+    free(list);
+    return ret;
+}
+
+// Phan du lieu cua file: file LOGGER_MODE_FLASH chi co [page, end)
+static void file_range(const struct bulk_file *f, const char **start, const char **end)
+{
+    logger_data_range(f->map, f->size, start, end);
+}
+
+// Cat [start, end) thanh cac chunk ~chunk_bytes, ranh gioi ngay sau '\n'
+static int add_chunks(const char *start, const char *end, size_t chunk_bytes,
+                      struct bulk_chunk **chunks, size_t *count, size_t *cap)
+{
+    while (start < end) {
+        const char *cut = end;
+        if ((size_t)(end - start) > chunk_bytes) {
+            const char *nl = memchr(start + chunk_bytes, '\n', end - start - chunk_bytes);
+            cut = nl ? nl + 1 : end;
+        }
+
+        if (*count == *cap) {
+            size_t grow = *cap ? *cap * 2 : 256;
+            struct bulk_chunk *p = realloc(*chunks, grow * sizeof(*p));
+            if (!p) {
+                return -1;
+            }
+            *chunks = p;
+            *cap = grow;
+        }
+        (*chunks)[(*count)++] = (struct bulk_chunk){ .start = start, .end = cut };
+        start = cut;
+    }
+    return 0;
+}
+
+static void *alloc_column(size_t size)
+{
+    void *p = NULL;
+    if (posix_memalign(&p, BULK_ALIGN, size ? size : 1) != 0) {
+        return NULL;
+    }
+    return p;
+}
+
+static int alloc_columns(struct bulk_columns *cols, size_t n)
+{
+    memset(cols, 0, sizeof(*cols));
+    cols->t_ms = alloc_column(n * sizeof(*cols->t_ms));
+    cols->valid = alloc_column(n);
+    for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+        cols->value[c] = alloc_column(n * sizeof(*cols->value[c]));
+    }
+
+    int ok = cols->t_ms && cols->valid;
+    for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+        ok = ok && cols->value[c];
+    }
+    if (!ok) {
+        bulk_free(cols);
+        return -1;
+    }
+    return 0;
+}
+
+// Don cac slot cua dong hong: chunk k bat dau ngay sau mau cuoi cua chunk k-1
+static size_t compact(struct bulk_columns *cols, const struct bulk_chunk *chunks, size_t n)
+{
+    size_t dst = 0;
+
+    for (size_t k = 0; k < n; k++) {
+        const struct bulk_chunk *ch = &chunks[k];
+        if (ch->first != dst && ch->count > 0) {
+            memmove(cols->t_ms + dst, cols->t_ms + ch->first, ch->count * sizeof(*cols->t_ms));
+            memmove(cols->valid + dst, cols->valid + ch->first, ch->count);
+            for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+                memmove(cols->value[c] + dst, cols->value[c] + ch->first,
+                        ch->count * sizeof(*cols->value[c]));
+            }
+        }
+        dst += ch->count;
+    }
+    return dst;
+}
+
+/*********************************
+ * PUBLIC API
+ *********************************/
+
+void bulk_default_config(struct bulk_config *cfg)
+{
+    cfg->threads = 0;
+    cfg->chunk_bytes = BULK_CHUNK_BYTES;
+    cfg->verify = 1;
+    cfg->skip_bytes = 0;
+}
+
+int bulk_load(const struct bulk_config *cfg, char *const paths[], int count,
+              struct bulk_columns *out, struct bulk_stats *stats)
+{
+    struct bulk_file *files = NULL;
+    struct bulk_chunk *chunks = NULL;
+    size_t nfiles = 0, files_cap = 0, nchunks = 0, chunks_cap = 0;
+    uint64_t t0 = now_ns();
+    int ret = -1;
+
+    memset(out, 0, sizeof(*out));
+    memset(stats, 0, sizeof(*stats));
+
+    for (int i = 0; i < count; i++) {
+        if (add_path(paths[i], &files, &nfiles, &files_cap) != 0) {
+            goto done;
+        }
+    }
+
+    size_t chunk_bytes = cfg->chunk_bytes ? cfg->chunk_bytes : BULK_CHUNK_BYTES;
+    for (size_t f = 0; f < nfiles; f++) {
+        const char *start, *end;
+        if (files[f].size == 0) {
+            continue;
+        }
+        file_range(&files[f], &start, &end);
+        // skip_bytes la offset ngay sau mot record nen roi dung dau dong
+        if (f == 0 && cfg->skip_bytes > (uint64_t)(start - files[f].map)) {
+            start = cfg->skip_bytes < (uint64_t)(end - files[f].map) ? files[f].map + cfg->skip_bytes
+                                                                     : end;
+        }
+        stats->bytes += end - start;
+        if (add_chunks(start, end, chunk_bytes, &chunks, &nchunks, &chunks_cap) != 0) {
+            fprintf(stderr, "bulk_load: out of memory\n");
+            goto done;
+        }
+    }
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned int threads = cfg->threads ? cfg->threads : (cpus > 0 ? (unsigned int)cpus : 1);
+    if (threads > BULK_MAX_THREADS) {
+        threads = BULK_MAX_THREADS;
+    }
+    if (threads > nchunks) {
+        threads = nchunks ? (unsigned int)nchunks : 1;
+    }
+
+    struct bulk_job job = { .cfg = cfg, .chunks = chunks, .nchunks = nchunks, .cols = out };
+
+    // Pass 1: dem dong -> vi tri cua moi chunk trong cot
+    run_pass(&job, 0, threads);
+    size_t slots = 0;
+    for (size_t k = 0; k < nchunks; k++) {
+        chunks[k].first = slots;
+        slots += chunks[k].lines;
+    }
+
+    if (alloc_columns(out, slots) != 0) {
+        fprintf(stderr, "bulk_load: cannot allocate %zu samples\n", slots);
+        goto done;
+    }
+
+    // Pass 2: parse thang vao slot cua chunk
+    run_pass(&job, 1, threads);
+    out->count = compact(out, chunks, nchunks);
+
+    stats->files = nfiles;
+    stats->chunks = nchunks;
+    stats->threads = threads;
+    stats->lines = slots;
+    for (size_t k = 0; k < nchunks; k++) {
+        stats->skipped += chunks[k].skipped;
+    }
+    ret = 0;
+
+done:
+    for (size_t f = 0; f < nfiles; f++) {
+        if (files[f].map) {
+            munmap((void *)files[f].map, files[f].size);
+        }
+    }
+    free(files);
+    free(chunks);
+    stats->wall_ns = now_ns() - t0;
+    return ret;
+}
+
+void bulk_free(struct bulk_columns *cols)
+{
+    free(cols->t_ms);
+    free(cols->valid);
+    for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+        free(cols->value[c]);
+    }
+    memset(cols, 0, sizeof(*cols));
+}
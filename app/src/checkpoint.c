@@ -0,0 +1,394 @@
+#include "checkpoint.h"
+#include "bulk.h"
+#include "crc32c.h"
+#include "history.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define CKPT_MAGIC      "ENVCKPT1"
+#define CKPT_VERSION    1
+
+// Breaker khong co name / cfg (lay tu cau hinh hien tai) va bo dem thong ke (tinh theo lan chay)
+struct ckpt_health {
+    uint32_t state;
+    uint32_t fails;
+    uint32_t backoff_ms;
+    uint32_t rng;
+    int64_t retry_ms;           // CLOCK_MONOTONIC luc ghi
+    int64_t down_ms;
+    int64_t last_good_ms;
+    char last_good[64];
+};
+
+struct ckpt_adaptive {
+    uint32_t channels;
+    uint32_t period_ms;
+    uint32_t primed;
+    uint32_t pad;
+    int64_t mean[SAMPLE_CHANNELS];
+    int64_t var[SAMPLE_CHANNELS];
+};
+
+struct ckpt_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t crc;               // crc32c tu 'size' den het file
+    uint64_t size;
+    uint32_t header_size;
+    uint32_t samples;           // so mau history sau header
+    int64_t saved_ms;           // CLOCK_REALTIME
+    int64_t saved_mono_ms;      // CLOCK_MONOTONIC
+    struct logger_cursor log;
+    struct ckpt_health health[DISPLAY_SENSORS];
+    struct ckpt_adaptive adaptive[DISPLAY_SENSORS];
+    uint32_t has_adaptive;
+    uint32_t pad;
+};
+
+#define SAMPLE_BYTES (sizeof(int64_t) + SAMPLE_CHANNELS * sizeof(int32_t) + 1)
+
+// Checkpoint da map boi checkpoint_open()
+static struct {
+    const struct ckpt_header *hdr;
+    size_t len;
+    uint64_t t0_ns;
+} map;
+
+/*********************************
+ * HELPERS
+ *********************************/
+
+static int64_t clock_ms(clockid_t clk)
+{
+    struct timespec ts;
+    clock_gettime(clk, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t header_crc(const struct ckpt_header *hdr, size_t len)
+{
+    size_t off = offsetof(struct ckpt_header, size);
+    return crc32c(0, (const char *)hdr + off, len - off);
+}
+
+static void unmap(void)
+{
+    if (map.hdr) {
+        munmap((void *)map.hdr, map.len);
+        map.hdr = NULL;
+    }
+}
+
+// Doi thoi diem CLOCK_MONOTONIC luc ghi sang lan chay nay (khac boot thi theo gio thuc)
+static int64_t remap_mono(int64_t t_ms, int64_t shift_ms)
+{
+    return t_ms ? t_ms + shift_ms : 0;
+}
+
+static void save_health(struct ckpt_health *out, const struct health *h)
+{
+    out->state = h->state;
+    out->fails = h->fails;
+    out->backoff_ms = h->backoff_ms;
+    out->rng = h->rng;
+    out->retry_ms = h->retry_ms;
+    out->down_ms = h->down_ms;
+    out->last_good_ms = h->last_good_ms;
+    memcpy(out->last_good, h->last_good, sizeof(out->last_good));
+}
+
+static void restore_health(enum display_sensor sensor, const struct ckpt_health *in,
+                           int64_t shift_ms)
+{
+    struct health h = *display_sensor_health(sensor);
+
+    h.state = in->state <= HEALTH_OPEN ? (enum health_state)in->state : HEALTH_HEALTHY;
+    h.fails = in->fails;
+    h.backoff_ms = in->backoff_ms;
+    h.rng = in->rng;
+    h.retry_ms = remap_mono(in->retry_ms, shift_ms);
+    h.down_ms = remap_mono(in->down_ms, shift_ms);
+    h.last_good_ms = remap_mono(in->last_good_ms, shift_ms);
+    memcpy(h.last_good, in->last_good, sizeof(h.last_good));
+    h.last_good[sizeof(h.last_good) - 1] = '\0';
+    display_restore_health(sensor, &h);
+}
+
+static void restore_adaptive(struct adaptive *a, const struct ckpt_adaptive *in)
+{
+    if (in->channels != a->channels) {
+        return;
+    }
+
+    // Chu ky giu trong [min, max] cua cau hinh moi; lan doc dau van la ngay
+    a->period_ms = in->period_ms < a->cfg.min_ms ? a->cfg.min_ms :
+                   in->period_ms > a->cfg.max_ms ? a->cfg.max_ms : in->period_ms;
+    a->primed = in->primed;
+    memcpy(a->mean, in->mean, sizeof(a->mean));
+    memcpy(a->var, in->var, sizeof(a->var));
+}
+
+/*
+ * Cac mau ghi log sau cursor: phan con lai cua file cursor roi cac file
+ * ngay sau no. Chi day vao history cac mau moi hon after_ms.
+ */
+static int load_tail(const char *log_dir, const struct logger_cursor *cur, int64_t after_ms,
+                     struct checkpoint_stats *stats)
+{
+    const char *base = strrchr(cur->path, '/');
+    base = base ? base + 1 : cur->path;
+    if (cur->path[0] == '\0') {
+        return 0;
+    }
+
+    struct dirent **list;
+    int n = scandir(log_dir, &list, logger_is_log_file, alphasort);
+    if (n < 0) {
+        fprintf(stderr, "scandir %s: %s\n", log_dir, strerror(errno));
+        return -1;
+    }
+
+    char **paths = calloc(n > 0 ? n : 1, sizeof(*paths));
+    int count = 0, ret = paths ? 0 : -1;
+    struct bulk_config cfg;
+
+    bulk_default_config(&cfg);
+    cfg.threads = 1;            // tail nho: khong dang tao thread
+    for (int i = 0; i < n; i++) {
+        int cmp = strcmp(list[i]->d_name, base);
+
+        if (paths && cmp >= 0) {
+            char path[PATH_MAX];
+            snprintf(path, sizeof(path), "%s/%s", log_dir, list[i]->d_name);
+            if (count == 0 && cmp == 0) {
+                cfg.skip_bytes = cur->offset;
+            }
+            paths[count] = strdup(path);
+            if (!paths[count]) {
+                ret = -1;
+            } else {
+                count++;
+            }
+        }
+        free(list[i]);
+    }
+    free(list);
+
+    if (ret == 0 && count > 0) {
+        struct bulk_columns cols;
+        struct bulk_stats st;
+
+        ret = bulk_load(&cfg, paths, count, &cols, &st);
+        if (ret == 0) {
+            for (size_t i = 0; i < cols.count; i++) {
+                struct sensor_sample s = { .t_ms = cols.t_ms[i], .valid = cols.valid[i] };
+
+                if (s.t_ms <= after_ms) {
+                    continue;
+                }
+                for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+                    s.value[c] = cols.value[c][i];
+                }
+                history_push(&s);
+                stats->tail_samples++;
+            }
+            stats->tail_bytes = st.bytes;
+            bulk_free(&cols);
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        free(paths[i]);
+    }
+    free(paths);
+    return ret;
+}
+
+/*********************************
+ * PUBLIC API
+ *********************************/
+
+int checkpoint_open(const char *path, struct logger_cursor *cursor)
+{
+    struct stat st;
+
+    unmap();
+    map.t0_ns = now_ns();
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        if (errno != ENOENT) {
+            fprintf(stderr, "open %s: %s\n", path, strerror(errno));
+        }
+        return -1;
+    }
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct ckpt_header)) {
+        fprintf(stderr, "%s: not a checkpoint, starting cold\n", path);
+        close(fd);
+        return -1;
+    }
+
+    const struct ckpt_header *hdr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (hdr == MAP_FAILED) {
+        fprintf(stderr, "mmap %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    map.hdr = hdr;
+    map.len = st.st_size;
+
+    if (memcmp(hdr->magic, CKPT_MAGIC, sizeof(hdr->magic)) != 0 ||
+        hdr->version != CKPT_VERSION || hdr->header_size != sizeof(*hdr) ||
+        hdr->size != map.len || map.len != sizeof(*hdr) + (size_t)hdr->samples * SAMPLE_BYTES ||
+        hdr->crc != header_crc(hdr, map.len)) {
+        fprintf(stderr, "%s: corrupt or foreign checkpoint, starting cold\n", path);
+        unmap();
+        return -1;
+    }
+
+    *cursor = hdr->log;
+    cursor->path[sizeof(cursor->path) - 1] = '\0';
+    return 0;
+}
+
+int checkpoint_restore(const char *log_dir, struct adaptive sched[DISPLAY_SENSORS],
+                       struct checkpoint_stats *stats)
+{
+    const struct ckpt_header *hdr = map.hdr;
+
+    memset(stats, 0, sizeof(*stats));
+    if (!hdr) {
+        return -1;
+    }
+
+    int64_t now_ms = clock_ms(CLOCK_REALTIME);
+    int64_t shift_ms = clock_ms(CLOCK_MONOTONIC) - now_ms - (hdr->saved_mono_ms - hdr->saved_ms);
+    stats->age_ms = now_ms - hdr->saved_ms;
+
+    // Cac cot nam ngay sau header, theo thu tu thoi gian
+    uint32_t n = hdr->samples;
+    const int64_t *t_ms = (const int64_t *)(hdr + 1);
+    const int32_t *value = (const int32_t *)(t_ms + n);
+    const uint8_t *valid = (const uint8_t *)(value + (size_t)SAMPLE_CHANNELS * n);
+    int64_t last_ms = INT64_MIN;
+
+    madvise((void *)hdr, map.len, MADV_SEQUENTIAL);
+    for (uint32_t i = 0; i < n; i++) {
+        struct sensor_sample s = { .t_ms = t_ms[i], .valid = valid[i] };
+
+        for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+            s.value[c] = value[(size_t)c * n + i];
+        }
+        history_push(&s);
+        last_ms = s.t_ms;
+    }
+    stats->samples = n;
+
+    for (int i = 0; i < DISPLAY_SENSORS; i++) {
+        restore_health(i, &hdr->health[i], shift_ms);
+        if (sched && hdr->has_adaptive) {
+            restore_adaptive(&sched[i], &hdr->adaptive[i]);
+        }
+    }
+
+    struct logger_cursor cur = hdr->log;
+    cur.path[sizeof(cur.path) - 1] = '\0';
+    unmap();
+
+    int ret = load_tail(log_dir, &cur, last_ms, stats);
+    stats->load_ns = now_ns() - map.t0_ns;
+    return ret;
+}
+
+int checkpoint_save(const char *path, const struct adaptive sched[DISPLAY_SENSORS],
+                    const struct health health[DISPLAY_SENSORS])
+{
+    struct history_view view;
+    char tmp[PATH_MAX];
+
+    history_read_lock();
+    uint32_t n = history_view(INT64_MIN, &view);
+    size_t len = sizeof(struct ckpt_header) + (size_t)n * SAMPLE_BYTES;
+    struct ckpt_header *hdr = calloc(1, len);
+
+    if (!hdr) {
+        history_read_unlock();
+        fprintf(stderr, "checkpoint: cannot allocate %zu bytes\n", len);
+        return -1;
+    }
+
+    // Cot cua history (2 doan neu ring vong qua cuoi) -> cot lien tuc
+    int64_t *t_ms = (int64_t *)(hdr + 1);
+    int32_t *value = (int32_t *)(t_ms + n);
+    uint8_t *valid = (uint8_t *)(value + (size_t)SAMPLE_CHANNELS * n);
+    for (int s = 0, at = 0; s < 2; at += view.n[s], s++) {
+        memcpy(t_ms + at, view.t_ms[s], view.n[s] * sizeof(*t_ms));
+        memcpy(valid + at, view.valid[s], view.n[s]);
+        for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+            memcpy(value + (size_t)c * n + at, view.value[c][s], view.n[s] * sizeof(*value));
+        }
+    }
+    history_read_unlock();
+
+    memcpy(hdr->magic, CKPT_MAGIC, sizeof(hdr->magic));
+    hdr->version = CKPT_VERSION;
+    hdr->size = len;
+    hdr->header_size = sizeof(*hdr);
+    hdr->samples = n;
+    hdr->saved_ms = clock_ms(CLOCK_REALTIME);
+    hdr->saved_mono_ms = clock_ms(CLOCK_MONOTONIC);
+    logger_get_cursor(&hdr->log);
+    for (int i = 0; i < DISPLAY_SENSORS; i++) {
+        save_health(&hdr->health[i], health ? &health[i] : display_sensor_health(i));
+        if (sched) {
+            const struct adaptive *a = &sched[i];
+
+            hdr->adaptive[i] = (struct ckpt_adaptive){
+                .channels = a->channels, .period_ms = a->period_ms, .primed = a->primed,
+            };
+            memcpy(hdr->adaptive[i].mean, a->mean, sizeof(a->mean));
+            memcpy(hdr->adaptive[i].var, a->var, sizeof(a->var));
+        }
+    }
+    hdr->has_adaptive = sched != NULL;
+    hdr->crc = header_crc(hdr, len);
+
+    // tmp + fsync + rename: mat dien giua chung van con checkpoint cu nguyen ven
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    int ret = -1;
+    if (fd < 0) {
+        fprintf(stderr, "open %s: %s\n", tmp, strerror(errno));
+    } else {
+        if (write(fd, hdr, len) != (ssize_t)len || fsync(fd) != 0) {
+            perror(tmp);
+        } else if (rename(tmp, path) != 0) {
+            fprintf(stderr, "rename %s: %s\n", path, strerror(errno));
+        } else {
+            ret = 0;
+        }
+        close(fd);
+        if (ret != 0) {
+            unlink(tmp);
+        }
+    }
+    free(hdr);
+    return ret;
+}
@@ -0,0 +1,104 @@
+#include "crc32c.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define CRC32C_HAVE_X86 1
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define CRC32C_HAVE_ARM 1
+#endif
+
+#define CRC32C_POLY 0x82F63B78u     // reflected Castagnoli polynomial
+
+/*********************************
+ * PORTABLE TABLE PATH
+ *********************************/
+
+static uint32_t crc_table[256];
+
+static void crc32c_init_table(void)
+{
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? (c >> 1) ^ CRC32C_POLY : c >> 1;
+        }
+        crc_table[i] = c;
+    }
+}
+
+static uint32_t crc32c_sw(uint32_t crc, const uint8_t *p, size_t len)
+{
+    if (crc_table[1] == 0) {
+        crc32c_init_table();
+    }
+
+    while (len--) {
+        crc = crc_table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+/*********************************
+ * HARDWARE PATHS
+ *********************************/
+
+#ifdef CRC32C_HAVE_X86
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc, const uint8_t *p, size_t len)
+{
+#ifdef __x86_64__
+    uint64_t c = crc;
+    for (; len >= 8; p += 8, len -= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        c = _mm_crc32_u64(c, v);
+    }
+    crc = (uint32_t)c;
+#endif
+    for (; len >= 4; p += 4, len -= 4) {
+        uint32_t v;
+        memcpy(&v, p, 4);
+        crc = _mm_crc32_u32(crc, v);
+    }
+    while (len--) {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+    return crc;
+}
+#endif
+
+#ifdef CRC32C_HAVE_ARM
+static uint32_t crc32c_hw(uint32_t crc, const uint8_t *p, size_t len)
+{
+    for (; len >= 4; p += 4, len -= 4) {
+        uint32_t v;
+        memcpy(&v, p, 4);
+        crc = __crc32cw(crc, v);
+    }
+    while (len--) {
+        crc = __crc32cb(crc, *p++);
+    }
+    return crc;
+}
+#endif
+
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len)
+{
+    crc = ~crc;
+
+#if defined(CRC32C_HAVE_X86)
+    static int have_sse42 = -1;
+    if (have_sse42 < 0) {
+        have_sse42 = __builtin_cpu_supports("sse4.2") ? 1 : 0;
+    }
+    if (have_sse42) {
+        return ~crc32c_hw(crc, buf, len);
+    }
+#elif defined(CRC32C_HAVE_ARM)
+    return ~crc32c_hw(crc, buf, len);
+#endif
+
+    return ~crc32c_sw(crc, buf, len);
+}
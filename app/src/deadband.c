@@ -0,0 +1,106 @@
+#include "deadband.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*********************************
+ * HELPERS
+ *********************************/
+
+static int outside_band(const struct deadband_config *cfg, int32_t last, int32_t x)
+{
+    int64_t diff = (int64_t)x - last;
+    int64_t band = cfg->abs;
+    int64_t rel = (int64_t)(last < 0 ? -(int64_t)last : last) * cfg->rel / 10000;
+
+    if (rel > band) {
+        band = rel;
+    }
+    return diff > band || diff < -band;
+}
+
+/*********************************
+ * PUBLIC API
+ *********************************/
+
+int deadband_parse(const char *spec, struct deadband_config cfg[SAMPLE_CHANNELS])
+{
+    struct deadband_config parsed = { 0 };
+    int channel = -1;
+    const char *colon = strchr(spec, ':');
+    char buf[128];
+
+    if (colon) {
+        for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+            if (strlen(sample_channel_names[c]) == (size_t)(colon - spec) &&
+                strncmp(spec, sample_channel_names[c], colon - spec) == 0) {
+                channel = c;
+            }
+        }
+        if (channel < 0) {
+            return -1;
+        }
+        spec = colon + 1;
+    }
+
+    snprintf(buf, sizeof(buf), "%s", spec);
+    for (char *opt = strtok(buf, ","); opt; opt = strtok(NULL, ",")) {
+        char *value = strchr(opt, '=');
+        char *end;
+        double v;
+
+        if (!value) {
+            return -1;
+        }
+        *value++ = '\0';
+        v = strtod(value, &end);
+        if (*end == '%') {
+            end++;
+        }
+        if (*end || v < 0) {
+            return -1;
+        }
+
+        if (strcmp(opt, "abs") == 0 && v <= INT32_MAX / 1000) {
+            parsed.abs = (int32_t)(v * 1000 + 0.5);
+        } else if (strcmp(opt, "rel") == 0 && v <= 100) {
+            parsed.rel = (uint32_t)(v * 100 + 0.5);
+        } else {
+            return -1;
+        }
+    }
+
+    for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+        if (channel < 0 || channel == c) {
+            cfg[c] = parsed;
+        }
+    }
+    return 0;
+}
+
+void deadband_init(struct deadband *d, const struct deadband_config cfg[SAMPLE_CHANNELS],
+                   unsigned int heartbeat_sec)
+{
+    memset(d, 0, sizeof(*d));
+    memcpy(d->cfg, cfg, sizeof(d->cfg));
+    d->heartbeat_ms = (int64_t)heartbeat_sec * 1000;
+}
+
+int deadband_check(struct deadband *d, const struct sensor_sample *sample)
+{
+    int64_t dt = sample->t_ms - d->last.t_ms;
+    int write = !d->have_last || sample->valid != d->last.valid ||
+                dt >= d->heartbeat_ms || dt < 0;      // dt < 0: dong ho bi chinh lui
+
+    for (int c = 0; c < SAMPLE_CHANNELS && !write; c++) {
+        if (sample->valid & (1u << c)) {
+            write = outside_band(&d->cfg[c], d->last.value[c], sample->value[c]);
+        }
+    }
+
+    if (write) {
+        d->last = *sample;
+        d->have_last = 1;
+    }
+    return write;
+}
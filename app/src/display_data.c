@@ -1,8 +1,14 @@
 #include "display_data.h"
+#include "i2cdev_backend.h"
+#include "filter.h"
+#include "ioring.h"
+#include "prof.h"
 #include <stdio.h>
+#include <errno.h>
 #include <fcntl.h>     // open(), close()
 #include <unistd.h>    // read(), write()
 #include <string.h>    // strlen()
+#include <time.h>      // clock_gettime()
 
 #define OLED_FILE_PATH   "/dev/oled_ssd1306"
 #define BH1750_FILE_PATH "/dev/bh1750_sensor"
@@ -12,17 +18,47 @@
 static char buf_bh1750[64];
 static char buf_sht30[64];
 static char buf_ssd1306[128];
+static char buf_oled[160];      // buf_ssd1306 voi last good thay cho "ERROR"
+
+// Typed sample of the current cycle, parsed once right after acquisition
+static struct sensor_sample sample;
+static int sample_ok;
+
+// Read sensors through i2c-dev instead of the /dev/*_sensor drivers
+static int use_i2cdev;
+
+// Signal conditioning between acquisition and display/log
+static struct filter filters[SAMPLE_CHANNELS];
+static int use_filters;
+
+// Circuit breaker and last good reading per sensor
+static struct health health[DISPLAY_SENSORS];
+static int health_ready;
+static int sensor_down[DISPLAY_SENSORS];   // lan doc gan nhat bi loi / bi breaker chan
+
+// Duong io_uring: fd giu mo (-1 = mo lai o lan sau), frame OLED dang ghi
+static int ring_fds[IORING_SLOTS] = { -1, -1, -1, -1 };
+static int oled_pending;
+
+static const struct {
+    enum ioring_slot slot;
+    const char *path;
+    char *buf;
+    size_t size;
+} ring_sensors[DISPLAY_SENSORS] = {
+    [DISPLAY_SHT30]  = { IORING_SLOT_SHT30,  SHT30_FILE_PATH,  buf_sht30,  sizeof(buf_sht30) },
+    [DISPLAY_BH1750] = { IORING_SLOT_BH1750, BH1750_FILE_PATH, buf_bh1750, sizeof(buf_bh1750) },
+};
 
 /*********************************
  * LOW-LEVEL HARDWARE ACCESS
  *********************************/
 
-/* Read data from BH1750 sensor via its device file */
+/* Read data from BH1750 sensor via its device file (errno set on failure) */
 static int read_bh1750(void)
 {
     int fd = open(BH1750_FILE_PATH, O_RDONLY);
     if (fd < 0) {
-        perror("open /dev/bh1750_sensor");
         return -1;
     }
 
@@ -30,12 +66,11 @@ static int read_bh1750(void)
     close(fd);  
     
     if (ret < 0) {
-        perror("read /dev/bh1750_sensor");
         return -1;
     }
     
     if (ret == 0) {
-        fprintf(stderr, "read /dev/bh1750_sensor: no data available\n");
+        errno = ENODATA;
         return -1;
     }
 
@@ -43,12 +78,11 @@ static int read_bh1750(void)
     return 0;
 }
 
-/* Read data from SHT30 sensor via its device file */
+/* Read data from SHT30 sensor via its device file (errno set on failure) */
 static int read_sht30(void)
 {
     int fd = open(SHT30_FILE_PATH, O_RDONLY);
     if (fd < 0) {
-        perror("open /dev/sht30_sensor");
         return -1;
     }
 
@@ -56,12 +90,11 @@ static int read_sht30(void)
     close(fd); 
     
     if (ret < 0) {
-        perror("read /dev/sht30_sensor");
         return -1;
     }
     
     if (ret == 0) {
-        fprintf(stderr, "read /dev/sht30_sensor: no data available\n");
+        errno = ENODATA;
         return -1;
     }
 
@@ -69,9 +102,119 @@ static int read_sht30(void)
     return 0;
 }
 
+/* Open a device once for the io_uring path and register its fd */
+static int ring_open(enum ioring_slot slot, const char *path, int flags)
+{
+    if (ring_fds[slot] >= 0) {
+        return 0;
+    }
+
+    int fd = open(path, flags);
+    if (fd < 0) {
+        return -1;
+    }
+    if (ioring_set_fd(slot, fd) != 0) {
+        close(fd);
+        return -1;
+    }
+    ring_fds[slot] = fd;
+    return 0;
+}
+
+// Loi I/O (vd module bi go): dong fd, chu ky sau mo lai nhu duong blocking
+static void ring_drop(enum ioring_slot slot)
+{
+    if (ring_fds[slot] >= 0) {
+        ioring_set_fd(slot, -1);
+        close(ring_fds[slot]);
+        ring_fds[slot] = -1;
+    }
+}
+
+/*
+ * Read the sensors in the mask (1 << DISPLAY_*) with one submission; the
+ * kernel runs the reads in parallel. Returns the mask of sensors that
+ * failed, with their errno in err[].
+ */
+static unsigned int ring_read_sensors(unsigned int sensors, int err[DISPLAY_SENSORS])
+{
+    unsigned int wait = 0, failed = 0;
+
+    for (int i = 0; i < DISPLAY_SENSORS; i++) {
+        if (!(sensors & (1u << i))) {
+            continue;
+        }
+        if (ring_open(ring_sensors[i].slot, ring_sensors[i].path, O_RDONLY) != 0 ||
+            ioring_read(ring_sensors[i].slot, ring_sensors[i].size - 1, 0) != 0) {
+            failed |= 1u << i;
+            err[i] = errno;
+            continue;
+        }
+        wait |= IORING_MASK(ring_sensors[i].slot);
+    }
+
+    int submit_err = wait && ioring_submit(wait) != 0 ? EIO : 0;
+
+    for (int i = 0; i < DISPLAY_SENSORS; i++) {
+        enum ioring_slot slot = ring_sensors[i].slot;
+        int res = ioring_result(slot);
+
+        if (!(wait & IORING_MASK(slot))) {
+            continue;
+        }
+        if (submit_err || res <= 0) {
+            failed |= 1u << i;
+            err[i] = submit_err ? submit_err : res < 0 ? -res : ENODATA;
+            if (res < 0) {
+                ring_drop(slot);
+            }
+            continue;
+        }
+        memcpy(ring_sensors[i].buf, ioring_buffer(slot), res);
+        ring_sensors[i].buf[res] = '\0';
+    }
+    return failed;
+}
+
+/* Queue the OLED frame; it goes out with the log record in ioring_submit() */
+static int ring_write_oled(const char *str_display)
+{
+    size_t len = strlen(str_display);
+
+    // Loi cua frame truoc (ghi async) bao o day
+    if (oled_pending) {
+        oled_pending = 0;
+        ioring_wait(IORING_MASK(IORING_SLOT_OLED));
+        if (ioring_result(IORING_SLOT_OLED) < 0) {
+            errno = -ioring_result(IORING_SLOT_OLED);
+            perror("write /dev/oled_ssd1306");
+            ring_drop(IORING_SLOT_OLED);
+        }
+    }
+
+    if (ring_open(IORING_SLOT_OLED, OLED_FILE_PATH, O_WRONLY) != 0) {
+        perror("open /dev/oled_ssd1306");
+        return -1;
+    }
+    if (len > IORING_BUF_SIZE) {
+        len = IORING_BUF_SIZE;
+    }
+    memcpy(ioring_buffer(IORING_SLOT_OLED), str_display, len);
+    if (ioring_write(IORING_SLOT_OLED, len, 0) != 0) {
+        perror("write /dev/oled_ssd1306");
+        return -1;
+    }
+    oled_pending = 1;
+    return 0;
+}
+
 /* Write a string to the SSD1306 OLED display via its device file */
-static int write_oled(const char *str_display)
+int write_oled(const char *str_display)
 {
+    if (ioring_active()) {
+        return ring_write_oled(str_display);
+    }
+
     int fd = open(OLED_FILE_PATH, O_WRONLY);
     if (fd < 0) {
         perror("open /dev/oled_ssd1306");
@@ -93,23 +236,292 @@ static int write_oled(const char *str_display)
  * HIGH-LEVEL FUNCTION: READ DATA AND DISPLAY
  ********************************************/
 
-/* Read all sensor data, format it, and send to OLED display */
-void display_data(void) 
+/* Switch sensor acquisition to the userspace i2c-dev backend */
+int display_use_i2cdev(const char *bus_path)
+{
+    if (i2cdev_open(bus_path) != 0) {
+        return -1;
+    }
+
+    use_i2cdev = 1;
+    return 0;
+}
+
+/* Enable median / EMA / rate-limit filtering of every reading */
+void display_set_filters(const struct filter_config cfg[SAMPLE_CHANNELS])
+{
+    for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+        filter_init(&filters[c], &cfg[c]);
+    }
+    use_filters = 1;
+}
+
+/* Run the filters over the typed sample, rewriting the text in the same format */
+static void condition_readings(int64_t mono_ms, uint32_t fresh)
+{
+    // Gia tri giu lai tu chu ky truoc da duoc loc roi
+    for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+        if (sample.valid & fresh & (1u << c)) {
+            sample.value[c] = filter_step(&filters[c], sample.value[c], mono_ms);
+        }
+    }
+    sample_format(&sample, buf_sht30, sizeof(buf_sht30), buf_bh1750, sizeof(buf_bh1750));
+}
+
+/* Format the OLED text from the two sensor strings ("ERROR" on failure) */
+const char *display_compose(const char *sht30, const char *bh1750)
+{
+    snprintf(buf_ssd1306, sizeof(buf_ssd1306), "%s-%s", sht30, bh1750);
+    return buf_ssd1306;
+}
+
+static int64_t monotonic_ms(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/* Configure the per-sensor circuit breakers (defaults if never called) */
+void display_set_breaker(const struct health_config *cfg)
+{
+    health_init(&health[DISPLAY_SHT30], "sht30", cfg);
+    health_init(&health[DISPLAY_BH1750], "bh1750", cfg);
+    health_ready = 1;
+}
+
+/* Last good reading with '~' before every value: "~25.3-~60.1" */
+static void format_stale(char *out, size_t size, const char *text)
+{
+    size_t len = 0;
+    char prev = '\0';
+
+    out[len++] = '~';
+    for (const char *p = text; *p && len + 2 < size; prev = *p++) {
+        out[len++] = *p;
+        // '-' sau mot chu so la dau phan cach, khong phai dau am
+        if (*p == '-' && prev >= '0' && prev <= '9') {
+            out[len++] = '~';
+        }
+    }
+    out[len] = '\0';
+}
+
+/* Compact age for the OLED: "~45s", "~5m", "~7h", "~3d" */
+static void format_age(char *out, size_t size, int64_t age_ms)
+{
+    int64_t sec = age_ms / 1000;
+
+    if (sec < 60) {
+        snprintf(out, size, "~%llds", (long long)sec);
+    } else if (sec < 3600) {
+        snprintf(out, size, "~%lldm", (long long)(sec / 60));
+    } else if (sec < 48 * 3600) {
+        snprintf(out, size, "~%lldh", (long long)(sec / 3600));
+    } else {
+        snprintf(out, size, "~%lldd", (long long)(sec / 86400));
+    }
+}
+
+/* OLED text: a sensor whose last read failed shows its last good reading,
+ * and a 4th field carries the age of the oldest one shown */
+static const char *compose_oled(int sht30_failed, int bh1750_failed, int64_t now_ms)
+{
+    char sht30[64], bh1750[64], age[24];
+    const struct health *hs = &health[DISPLAY_SHT30];
+    const struct health *hb = &health[DISPLAY_BH1750];
+    int64_t oldest = 0;
+
+    if ((!sht30_failed || !hs->last_good[0]) && (!bh1750_failed || !hb->last_good[0])) {
+        return buf_ssd1306;
+    }
+
+    if (sht30_failed && hs->last_good[0]) {
+        format_stale(sht30, sizeof(sht30), hs->last_good);
+        oldest = health_age_ms(hs, now_ms);
+    } else {
+        snprintf(sht30, sizeof(sht30), "%s", buf_sht30);
+    }
+    if (bh1750_failed && hb->last_good[0]) {
+        format_stale(bh1750, sizeof(bh1750), hb->last_good);
+        int64_t a = health_age_ms(hb, now_ms);
+        oldest = a > oldest ? a : oldest;
+    } else {
+        snprintf(bh1750, sizeof(bh1750), "%s", buf_bh1750);
+    }
+
+    format_age(age, sizeof(age), oldest);
+    snprintf(buf_oled, sizeof(buf_oled), "%s-%s-%s", sht30, bh1750, age);
+    return buf_oled;
+}
+
+/* Feed the outcome of one read attempt into the sensor's breaker */
+static void update_health(struct health *h, int64_t now_ms, int failed, int err,
+                          const char *value)
 {
-    if (read_sht30() != 0) {
+    if (!failed) {
+        health_success(h, now_ms, value);
+    } else {
+        health_failure(h, now_ms, err ? strerror(err) : "I2C transfer failed");
+    }
+}
+
+/*
+ * Read the sensors in the mask (1 << DISPLAY_*), format the data and send
+ * it to the OLED display. Sensors not in the mask keep their last reading.
+ * A sensor whose circuit is open is not touched (no open(), no I2C
+ * traffic) until its next probe, so it costs the healthy one nothing.
+ * Logged data still says "ERROR" for it; only the OLED shows the last
+ * good value. Returns the channels (1 << SAMPLE_*) read fresh this call.
+ */
+uint32_t display_data_for(unsigned int sensors)
+{
+    int sht30_failed = 0, bh1750_failed = 0;
+    int sht30_err = 0, bh1750_err = 0;
+    int64_t now_ms = monotonic_ms();
+    int due_sht30 = (sensors >> DISPLAY_SHT30) & 1;
+    int due_bh1750 = (sensors >> DISPLAY_BH1750) & 1;
+
+    PROF_BEGIN(PROF_DISPLAY, display);
+    if (!health_ready) {
+        struct health_config cfg;
+        health_default_config(&cfg);
+        display_set_breaker(&cfg);
+    }
+
+    int try_sht30 = due_sht30 && health_allow(&health[DISPLAY_SHT30], now_ms);
+    int try_bh1750 = due_bh1750 && health_allow(&health[DISPLAY_BH1750], now_ms);
+
+    PROF_BEGIN(PROF_READ, read);
+    if (use_i2cdev) {
+        int skip = (try_sht30 ? 0 : I2CDEV_SHT30_FAILED) |
+                   (try_bh1750 ? 0 : I2CDEV_BH1750_FAILED);
+        int failed = i2cdev_read_sensors(skip, buf_sht30, sizeof(buf_sht30),
+                                         buf_bh1750, sizeof(buf_bh1750));
+        sht30_failed = due_sht30 && (failed < 0 || (failed & I2CDEV_SHT30_FAILED));
+        bh1750_failed = due_bh1750 && (failed < 0 || (failed & I2CDEV_BH1750_FAILED));
+    } else if (ioring_active()) {
+        int err[DISPLAY_SENSORS] = { 0 };
+        unsigned int failed = ring_read_sensors((unsigned int)try_sht30 << DISPLAY_SHT30 |
+                                                (unsigned int)try_bh1750 << DISPLAY_BH1750, err);
+        sht30_failed = due_sht30 && (!try_sht30 || (failed & (1u << DISPLAY_SHT30)));
+        bh1750_failed = due_bh1750 && (!try_bh1750 || (failed & (1u << DISPLAY_BH1750)));
+        sht30_err = err[DISPLAY_SHT30];
+        bh1750_err = err[DISPLAY_BH1750];
+    } else {
+        if (due_sht30) {
+            sht30_failed = !try_sht30 || read_sht30() != 0;
+            if (try_sht30 && sht30_failed) {
+                sht30_err = errno;
+            }
+        }
+        if (due_bh1750) {
+            bh1750_failed = !try_bh1750 || read_bh1750() != 0;
+            if (try_bh1750 && bh1750_failed) {
+                bh1750_err = errno;
+            }
+        }
+    }
+
+    if (sht30_failed) {
         snprintf(buf_sht30, sizeof(buf_sht30), "ERROR");
     }
 
-    if (read_bh1750() != 0) {
+    if (bh1750_failed) {
         snprintf(buf_bh1750, sizeof(buf_bh1750), "ERROR");
     }
+    PROF_END(PROF_READ, read);
+
+    PROF_BEGIN(PROF_FORMAT, format);
+    uint32_t fresh = (try_sht30 && !sht30_failed ? 1u << SAMPLE_TEMP | 1u << SAMPLE_HUM : 0) |
+                     (try_bh1750 && !bh1750_failed ? 1u << SAMPLE_LUX : 0);
+
+    // Parse mot lan duy nhat; moi thu phia sau dung mau da parse
+    struct timespec wall;
+    clock_gettime(CLOCK_REALTIME, &wall);
+    display_compose(buf_sht30, buf_bh1750);
+    sample_ok = sample_parse(buf_ssd1306, (int64_t)wall.tv_sec * 1000 + wall.tv_nsec / 1000000,
+                             &sample) == 0;
+    if (!sample_ok) {
+        sample.valid = 0;
+    }
+
+    if (use_filters && sample_ok) {
+        condition_readings(now_ms, fresh);
+    }
+
+    // Last good la gia tri da loc, giong gia tri da hien thi/ghi log
+    if (try_sht30) {
+        update_health(&health[DISPLAY_SHT30], now_ms, sht30_failed, sht30_err, buf_sht30);
+    }
+    if (try_bh1750) {
+        update_health(&health[DISPLAY_BH1750], now_ms, bh1750_failed, bh1750_err, buf_bh1750);
+    }
+    if (due_sht30) {
+        sensor_down[DISPLAY_SHT30] = sht30_failed;
+    }
+    if (due_bh1750) {
+        sensor_down[DISPLAY_BH1750] = bh1750_failed;
+    }
 
     // Format data to display on OLED
-    snprintf(buf_ssd1306, sizeof(buf_ssd1306), "%s-%s", buf_sht30, buf_bh1750);
-    
-    if (write_oled(buf_ssd1306) != 0) {
+    display_compose(buf_sht30, buf_bh1750);
+    const char *oled = compose_oled(sensor_down[DISPLAY_SHT30], sensor_down[DISPLAY_BH1750], now_ms);
+    PROF_END(PROF_FORMAT, format);
+
+    PROF_BEGIN(PROF_OLED, oled);
+    if (write_oled(oled) != 0) {
         fprintf(stderr, "write_oled failed\n");
     }
+    PROF_END(PROF_OLED, oled);
+
+    PROF_END(PROF_DISPLAY, display);
+    return fresh & sample.valid;
+}
+
+/* Read all sensor data, format it, and send to OLED display */
+void display_data(void)
+{
+    display_data_for(DISPLAY_ALL);
+}
+
+/* Typed sample of the last display_data() call, NULL if the text was malformed */
+const struct sensor_sample *display_sample(void)
+{
+    return sample_ok ? &sample : NULL;
+}
+
+/* Breaker state and last good reading of a sensor */
+const struct health *display_sensor_health(enum display_sensor sensor)
+{
+    return &health[sensor];
+}
+
+/* Restore a saved breaker (state, backoff, last good) over the configured one */
+void display_restore_health(enum display_sensor sensor, const struct health *saved)
+{
+    struct health *h = &health[sensor];
+    const char *name = h->name;
+    struct health_config cfg = h->cfg;
+
+    if (!health_ready) {
+        health_default_config(&cfg);
+        display_set_breaker(&cfg);
+        name = h->name;
+    }
+    *h = *saved;
+    h->name = name;
+    h->cfg = cfg;
+    if (h->backoff_ms > cfg.backoff_max_ms) {
+        h->backoff_ms = cfg.backoff_max_ms;
+    }
+}
+
+/* Age of the sensor's last good reading in ms, -1 if there is none */
+int64_t display_sensor_age_ms(enum display_sensor sensor)
+{
+    return health_age_ms(&health[sensor], monotonic_ms());
 }
 
 /* Return the current OLED display buffer */
@@ -1,8 +1,30 @@
 #include "display_data.h"
 #include "logger.h"
+#include "i2cdev_backend.h"
+#include "replay.h"
+#include "alert.h"
+#include "uplink.h"
+#include "history.h"
+#include "adaptive.h"
+#include "ioring.h"
+#include "prof.h"
+#include "checkpoint.h"
+#include "rt.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <signal.h>
 #include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+
+#define SAMPLE_PERIOD_SEC   5
+#define HISTORY_HOURS       24
+#define CHECKPOINT_SEC      600
+#define CYCLE_TEXT          128
+#define WORKER_STACK        (512 * 1024)
 
 volatile sig_atomic_t keep_running = 1;
 
@@ -11,35 +33,887 @@ void sigint_handler(int sig) {
     keep_running = 0;
 }
 
-int main(void)
+static void print_usage(const char *prog)
+{
+    printf("Usage: %s [options]\n"
+           "       %s --replay -d DIR [options] LOG|CAPTURE|DIR...\n"
+           "  -b, --i2c-bus PATH          read sensors via i2c-dev (e.g. /dev/i2c-1)\n"
+           "                              instead of the sensor kernel modules\n"
+           "      --sht30-repeatability   low | medium | high (i2c-dev only, default high)\n"
+           "      --bh1750-resolution     low | high | high2 (i2c-dev only, default high)\n"
+           "      --adaptive [SENSOR:]MIN,MAX  read a sensor every MIN..MAX s, faster while its\n"
+           "                              readings move (SENSOR = sht30 | bh1750, default both;\n"
+           "                              e.g. sht30:1,30 bh1750:0.5,30; default fixed 5 s)\n"
+           "      --sensor-breaker F,MIN,MAX  open a sensor's circuit after F failures in a row,\n"
+           "                              probe after MIN..MAX s with backoff (default 3,10,300)\n"
+           "      --io-uring              batch sensor reads, OLED write and log append\n"
+           "                              through io_uring (falls back to blocking I/O)\n"
+           "  -d, --log-dir DIR           log directory (default /var/log/sensor_monitor)\n"
+           "      --flash-log             preallocated, page-aligned log writes\n"
+           "      --log-page BYTES        flash log page size (default 4096)\n"
+           "      --log-flush SEC         flash log flush interval (default 60)\n"
+           "      --log-prealloc BYTES    flash log preallocation step (default 4 MiB)\n"
+           "      --plain-log             log bare CSV lines without seq/len/crc32c\n"
+           "      --no-sketch             do not keep hourly quantile sketches next to the\n"
+           "                              log (sketch_*.skt, queried by env_quantile)\n"
+           "      --deadband [CH:]SPEC    log only changes, SPEC = abs=X,rel=P%% (CH = temp |\n"
+           "                              hum | lux, default all; repeatable)\n"
+           "      --heartbeat SEC         with --deadband, log at least every SEC (default 900)\n"
+           "      --filter [CH:]SPEC      condition readings, SPEC = median=N,ema=K,rate=R\n"
+           "                              (CH = temp | hum | lux, default all; repeatable)\n"
+           "      --alert-rules FILE      evaluate threshold/rate rules on every sample\n"
+           "      --alert-socket PATH     publish alert events on a Unix socket\n"
+           "      --uplink URL            send batches to tcp://host:port or mqtt://host:port/topic\n"
+           "      --uplink-node NAME      node name sent to the collector (default hostname)\n"
+           "      --uplink-batch N        samples per batch (default 60)\n"
+           "      --uplink-interval SEC   max sample time per batch (default 300)\n"
+           "      --uplink-queue DIR      on-disk queue (default /var/lib/sensor_monitor/uplink)\n"
+           "      --uplink-queue-max BYTES  queue size cap (default 16 MiB)\n"
+           "      --history HOURS         keep the last HOURS of samples in memory (default 24)\n"
+           "      --checkpoint FILE       save history / breaker / log cursor state to FILE and\n"
+           "                              restore it at startup (warm restart)\n"
+           "      --checkpoint-interval SEC  seconds between checkpoints (default 600)\n"
+           "  -c, --capture FILE          also append samples to a binary capture\n"
+           "      --replay                feed recorded logs/captures through the pipeline\n"
+           "                              instead of reading sensors (needs --log-dir)\n"
+           "      --replay-speed X        x real time, 0 = as fast as possible (default)\n"
+           "      --replay-oled           also draw replayed frames on the OLED\n"
+           "      --replay-fill SEC       repeat held values every SEC between deadband records\n"
+           "      --profile[=MODE[:FILE]] time every pipeline stage (wall + CPU) and print\n"
+           "                              it on exit, MODE = summary | folded | folded-cpu\n"
+           "                              (flamegraph.pl input; default summary to stdout)\n"
+           "      --rt[=PRIO[,CPU]]       read sensors in a SCHED_FIFO thread pinned to CPU\n"
+           "                              with locked memory; logging, alerts, uplink and\n"
+           "                              console run in a normal thread (default 80, last CPU)\n"
+           "      --rt-latency SEC        measure wakeup jitter under CPU load, normal vs\n"
+           "                              --rt settings, SEC per run, and exit\n"
+           "  -h, --help                  show this help\n", prog, prog);
+}
+
+static void print_log_stats(void)
+{
+    struct logger_stats st;
+
+    logger_get_stats(&st);
+    if (st.deadband_skipped > 0) {
+        printf("\nDeadband: %llu of %llu samples logged\n",
+               (unsigned long long)(st.samples - st.deadband_skipped),
+               (unsigned long long)st.samples);
+    }
+    if (st.record_bytes > 0) {
+        printf("\nLogged %llu bytes, wrote %llu bytes in %llu flushes (write amplification %.2f)\n",
+               (unsigned long long)st.record_bytes, (unsigned long long)st.device_bytes,
+               (unsigned long long)st.flushes, (double)st.device_bytes / st.record_bytes);
+    }
+}
+
+static void print_uplink_stats(void)
+{
+    struct uplink_stats st;
+
+    uplink_get_stats(&st);
+    if (st.samples > 0) {
+        printf("Uplink: %llu samples in %llu batches (%.2f bytes/sample), %llu sent, %llu acked, %llu dropped, %llu connect(s)\n",
+               (unsigned long long)st.samples, (unsigned long long)st.batches,
+               (double)st.payload_bytes / st.samples, (unsigned long long)st.sent,
+               (unsigned long long)st.acked, (unsigned long long)st.dropped,
+               (unsigned long long)st.connects);
+    }
+}
+
+// min / mean / max cua tung channel trong history
+static void print_history_stats(void)
+{
+    uint64_t count = history_head() - history_tail();
+
+    if (count == 0) {
+        return;
+    }
+    printf("History: %llu samples in memory\n", (unsigned long long)count);
+    for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+        struct history_stats st;
+
+        if (history_stats(c, INT64_MIN, &st) == 0) {
+            printf("  %-4s min %.1f mean %.1f max %.1f (%u valid)\n", sample_channel_names[c],
+                   st.min / 1000.0, (double)st.sum / st.count / 1000.0, st.max / 1000.0, st.count);
+        }
+    }
+}
+
+static int64_t mono_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Sensor dang loi: trang thai breaker va tuoi cua gia tri cuoi
+static void print_sensor_health(const struct health health[DISPLAY_SENSORS])
 {
+    for (int i = 0; i < DISPLAY_SENSORS; i++) {
+        const struct health *h = &health[i];
+        int64_t age = health_age_ms(h, mono_ms());
+
+        if (h->state == HEALTH_HEALTHY) {
+            continue;
+        }
+        if (age >= 0) {
+            printf("  %s %s, showing %s from %.0f s ago\n", h->name,
+                   health_state_name(h->state), h->last_good, age / 1000.0);
+        } else {
+            printf("  %s %s, no reading yet\n", h->name, health_state_name(h->state));
+        }
+    }
+}
+
+static void print_breaker_stats(void)
+{
+    for (int i = 0; i < DISPLAY_SENSORS; i++) {
+        const struct health *h = display_sensor_health(i);
+
+        if (h->trips > 0) {
+            printf("Sensor %s: circuit opened %llu time(s), %llu probe(s) (%llu failed), "
+                   "%llu read(s) skipped\n", h->name, (unsigned long long)h->trips,
+                   (unsigned long long)h->probes, (unsigned long long)h->probe_fails,
+                   (unsigned long long)h->skipped);
+        }
+    }
+}
+
+// Ngu den moc t_ms (CLOCK_MONOTONIC), khong troi theo thoi gian doc sensor
+static int sleep_until_ms(int64_t t_ms)
+{
+    struct timespec ts = { .tv_sec = t_ms / 1000, .tv_nsec = (t_ms % 1000) * 1000000 };
+    int err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+
+    errno = err;
+    return err ? -1 : 0;
+}
+
+// "[sht30:|bh1750:]MIN,MAX" -> cfg[DISPLAY_SENSORS]
+static int parse_adaptive(const char *arg, struct adaptive_config cfg[DISPLAY_SENSORS])
+{
+    static const char *const names[DISPLAY_SENSORS] = {
+        [DISPLAY_SHT30] = "sht30", [DISPLAY_BH1750] = "bh1750",
+    };
+    struct adaptive_config parsed;
+    const char *colon = strchr(arg, ':');
+    int sensor = -1;
+
+    if (colon) {
+        for (int i = 0; i < DISPLAY_SENSORS; i++) {
+            if (strlen(names[i]) == (size_t)(colon - arg) &&
+                strncmp(arg, names[i], colon - arg) == 0) {
+                sensor = i;
+            }
+        }
+        if (sensor < 0) {
+            return -1;
+        }
+        arg = colon + 1;
+    }
+
+    if (adaptive_parse(arg, &parsed) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < DISPLAY_SENSORS; i++) {
+        if (sensor < 0 || sensor == i) {
+            cfg[i] = parsed;
+        }
+    }
+    return 0;
+}
+
+// So lan doc that su so voi chu ky co dinh SAMPLE_PERIOD_SEC
+static void print_adaptive_stats(const struct adaptive sched[DISPLAY_SENSORS], int64_t elapsed_ms)
+{
+    uint64_t fixed = elapsed_ms / (SAMPLE_PERIOD_SEC * 1000) + 1;
+
+    for (int i = 0; i < DISPLAY_SENSORS; i++) {
+        const struct adaptive *a = &sched[i];
+
+        printf("Adaptive %s: %llu read(s), avg period %.2f s, %llu boost(s) "
+               "(fixed %d s: %llu)\n", display_sensor_health(i)->name,
+               (unsigned long long)a->reads,
+               a->reads ? elapsed_ms / 1000.0 / a->reads : 0.0,
+               (unsigned long long)a->boosts, SAMPLE_PERIOD_SEC, (unsigned long long)fixed);
+    }
+}
+
+static void print_ioring_stats(uint64_t cycles)
+{
+    struct ioring_stats st;
+
+    ioring_get_stats(&st);
+    printf("io_uring: %llu submit(s) for %llu cycle(s) (%.2f per cycle), %llu I/O(s), "
+           "%llu error(s)\n", (unsigned long long)st.enters, (unsigned long long)cycles,
+           cycles ? (double)st.enters / cycles : 0.0, (unsigned long long)st.sqes,
+           (unsigned long long)st.errors);
+}
+
+// In cac alert moi ra console
+static void print_alerts(void)
+{
+    struct alert_event ev;
+
+    while (alert_next(&ev)) {
+        printf("ALERT %s %s (%.3f)\n", ev.raised ? "RAISE" : "CLEAR",
+               alert_rule_name(ev.rule), ev.value / 1000.0);
+    }
+}
+
+/*
+ * Ket qua mot chu ky doc sensor, du cho phan con lai cua pipeline (log,
+ * capture, history, alert, uplink, console, checkpoint). Binh thuong chay
+ * ngay trong vong lap; voi --rt di qua rt_queue sang worker thread thuong.
+ */
+struct cycle {
+    int has_sample;
+    int checkpoint;                         // luu checkpoint voi sched ben duoi
+    struct sensor_sample sample;
+    char data[CYCLE_TEXT];                  // text OLED
+    struct health health[DISPLAY_SENSORS];  // breaker luc doc
+    struct adaptive sched[DISPLAY_SENSORS];
+};
+
+static struct {
+    const char *capture_path;
+    const char *checkpoint_path;
+    int use_uplink;
+    struct rt_queue queue;                  // --rt: vong lap -> worker
+} pipeline;
+
+static void finish_cycle(const struct cycle *c)
+{
+    const struct sensor_sample *sample = c->has_sample ? &c->sample : NULL;
+
+    PROF_BEGIN(PROF_LOG, log);
+    if ((sample ? log_sensor_sample(sample) : log_sensor_data(c->data)) != 0) {
+        fprintf(stderr, "Failed to log sensor data\n");
+    }
+    PROF_END(PROF_LOG, log);
+
+    // Frame OLED + record log: mot lan submit, khong doi ket qua
+    if (ioring_active()) {
+        PROF_BEGIN(PROF_SUBMIT, submit);
+        ioring_submit(0);
+        PROF_END(PROF_SUBMIT, submit);
+    }
+
+    if (pipeline.capture_path) {
+        struct timespec now;
+        PROF_BEGIN(PROF_CAPTURE, capture);
+        clock_gettime(CLOCK_REALTIME, &now);
+        capture_write(sample ? sample->t_ms : (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000,
+                      c->data);
+        PROF_END(PROF_CAPTURE, capture);
+    }
+
+    if (sample) {
+        // Mau da parse san: history, alert, uplink khong parse lai text
+        PROF_BEGIN(PROF_HISTORY, history);
+        history_push(sample);
+        PROF_END(PROF_HISTORY, history);
+        PROF_BEGIN(PROF_ALERT, alert);
+        if (alert_eval(sample) > 0) {
+            print_alerts();
+        }
+        PROF_END(PROF_ALERT, alert);
+        if (pipeline.use_uplink) {
+            PROF_BEGIN(PROF_UPLINK, uplink);
+            uplink_push(sample);
+            PROF_END(PROF_UPLINK, uplink);
+        }
+    }
+
+    // In ra console để debug
+    PROF_BEGIN(PROF_CONSOLE, console);
+    printf("Data: %s\n", c->data);
+    print_sensor_health(c->health);
+    PROF_END(PROF_CONSOLE, console);
+
+    if (c->checkpoint) {
+        PROF_BEGIN(PROF_CHECKPOINT, checkpoint);
+        checkpoint_save(pipeline.checkpoint_path, c->sched, c->health);
+        PROF_END(PROF_CHECKPOINT, checkpoint);
+    }
+}
+
+// --rt: phan khong gap cua pipeline, o muc uu tien thuong
+static void *cycle_worker(void *arg)
+{
+    struct cycle c;
+
+    (void)arg;
+    while (rt_queue_pop(&pipeline.queue, &c)) {
+        finish_cycle(&c);
+    }
+    return NULL;
+}
+
+// Worker khong nhan SIGINT / SIGTERM: signal phai danh thuc vong lap doc sensor
+static int start_cycle_worker(pthread_t *tid)
+{
+    sigset_t block, old;
+
+    if (rt_queue_init(&pipeline.queue, sizeof(struct cycle)) != 0) {
+        return -1;
+    }
+    sigemptyset(&block);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGTERM);
+    // mlockall() khoa ca stack cua thread: khong can 8 MiB mac dinh
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, WORKER_STACK);
+    pthread_sigmask(SIG_BLOCK, &block, &old);
+    int err = pthread_create(tid, &attr, cycle_worker, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    pthread_attr_destroy(&attr);
+    if (err != 0) {
+        fprintf(stderr, "pthread_create: %s\n", strerror(err));
+        rt_queue_free(&pipeline.queue);
+        return -1;
+    }
+    return 0;
+}
+
+static void stop_cycle_worker(pthread_t tid)
+{
+    rt_queue_close(&pipeline.queue);
+    pthread_join(tid, NULL);
+    if (pipeline.queue.dropped > 0) {
+        printf("Real-time: %llu cycle(s) dropped, worker fell behind\n",
+               (unsigned long long)pipeline.queue.dropped);
+    }
+    rt_queue_free(&pipeline.queue);
+}
+
+// "MODE[:FILE]" cua --profile; khong co FILE = stdout
+static int parse_profile(const char *arg, enum prof_output *out, const char **path)
+{
+    char mode[16];
+    const char *colon = arg ? strchr(arg, ':') : NULL;
+
+    *out = PROF_OUT_SUMMARY;
+    *path = NULL;
+    if (!arg) {
+        return 0;
+    }
+    snprintf(mode, sizeof(mode), "%.*s", colon ? (int)(colon - arg) : (int)strlen(arg), arg);
+    if (prof_parse_output(mode, out) != 0 || (colon && colon[1] == '\0')) {
+        return -1;
+    }
+    *path = colon ? colon + 1 : NULL;
+    return 0;
+}
+
+// Ghi ket qua --profile ra stdout hoac file
+static void write_profile(enum prof_output format, const char *path)
+{
+    FILE *f = path ? fopen(path, "w") : stdout;
+
+    if (!f) {
+        perror(path);
+        return;
+    }
+    prof_report(f, format);
+    if (f != stdout && fclose(f) != 0) {
+        perror(path);
+    }
+}
+
+// Map a policy name to its index in names[], or -1
+static int parse_choice(const char *arg, const char *const names[], int count)
+{
+    for (int i = 0; i < count; i++) {
+        if (strcmp(arg, names[i]) == 0) {
+            return i;
+        }
+    }
+    fprintf(stderr, "Invalid value: %s\n", arg);
+    return -1;
+}
+
+int main(int argc, char *argv[])
+{
+    static const char *const sht30_names[] = { "low", "medium", "high" };
+    static const char *const bh1750_names[] = { "low", "high", "high2" };
+    static const struct option long_opts[] = {
+        { "i2c-bus",             required_argument, NULL, 'b' },
+        { "sht30-repeatability", required_argument, NULL, 'r' },
+        { "bh1750-resolution",   required_argument, NULL, 'l' },
+        { "adaptive",            required_argument, NULL, 'V' },
+        { "sensor-breaker",      required_argument, NULL, 'B' },
+        { "io-uring",            no_argument,       NULL, 'U' },
+        { "log-dir",             required_argument, NULL, 'd' },
+        { "flash-log",           no_argument,       NULL, 'F' },
+        { "log-page",            required_argument, NULL, 'P' },
+        { "log-flush",           required_argument, NULL, 'T' },
+        { "log-prealloc",        required_argument, NULL, 'A' },
+        { "plain-log",           no_argument,       NULL, 'C' },
+        { "no-sketch",           no_argument,       NULL, 'X' },
+        { "deadband",            required_argument, NULL, 'D' },
+        { "heartbeat",           required_argument, NULL, 'E' },
+        { "filter",              required_argument, NULL, 'f' },
+        { "alert-rules",         required_argument, NULL, 'a' },
+        { "alert-socket",        required_argument, NULL, 'k' },
+        { "uplink",              required_argument, NULL, 'u' },
+        { "uplink-node",         required_argument, NULL, 'n' },
+        { "uplink-batch",        required_argument, NULL, 'N' },
+        { "uplink-interval",     required_argument, NULL, 'I' },
+        { "uplink-queue",        required_argument, NULL, 'Q' },
+        { "uplink-queue-max",    required_argument, NULL, 'M' },
+        { "history",             required_argument, NULL, 'H' },
+        { "checkpoint",          required_argument, NULL, 'K' },
+        { "checkpoint-interval", required_argument, NULL, 'W' },
+        { "capture",             required_argument, NULL, 'c' },
+        { "replay",              no_argument,       NULL, 'R' },
+        { "replay-speed",        required_argument, NULL, 'S' },
+        { "replay-oled",         no_argument,       NULL, 'O' },
+        { "replay-fill",         required_argument, NULL, 'G' },
+        { "profile",             optional_argument, NULL, 'p' },
+        { "rt",                  optional_argument, NULL, 'Y' },
+        { "rt-latency",          required_argument, NULL, 'Z' },
+        { "help",                no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    const char *i2c_bus = NULL;
+    int sht30_policy = I2CDEV_SHT30_HIGH;
+    int bh1750_policy = I2CDEV_BH1750_HIGH;
+    struct logger_config log_cfg;
+    struct replay_config replay_cfg = { 0 };
+    struct filter_config filters[SAMPLE_CHANNELS];
+    struct deadband_config deadband[SAMPLE_CHANNELS] = { { 0 } };
+    struct uplink_config uplink_cfg;
+    struct health_config breaker_cfg;
+    struct adaptive_config adaptive_cfg[DISPLAY_SENSORS];
+    struct adaptive sched[DISPLAY_SENSORS];
+    int use_adaptive = 0;
+    int use_ioring = 0;
+    uint64_t cycles = 0;
+    int use_uplink = 0;
+    int use_filters = 0;
+    double history_hours = HISTORY_HOURS;
+    const char *capture_path = NULL;
+    const char *checkpoint_path = NULL;
+    unsigned int checkpoint_sec = CHECKPOINT_SEC;
+    struct logger_cursor resume;
+    const char *alert_rules = NULL;
+    const char *alert_socket = NULL;
+    int replay = 0;
+    int use_profile = 0;
+    enum prof_output profile_format = PROF_OUT_SUMMARY;
+    const char *profile_path = NULL;
+    struct rt_config rt_cfg;
+    int use_rt = 0;
+    unsigned int rt_latency_sec = 0;
+    pthread_t worker;
+    int opt;
+
+    logger_default_config(&log_cfg);
+    uplink_default_config(&uplink_cfg);
+    health_default_config(&breaker_cfg);
+    rt_default_config(&rt_cfg);
+    for (int i = 0; i < DISPLAY_SENSORS; i++) {
+        adaptive_cfg[i] = (struct adaptive_config){ .min_ms = SAMPLE_PERIOD_SEC * 1000,
+                                                    .max_ms = SAMPLE_PERIOD_SEC * 1000 };
+    }
+    for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+        filters[c] = (struct filter_config){ .median = 1 };
+    }
+
+    while ((opt = getopt_long(argc, argv, "b:c:d:h", long_opts, NULL)) != -1) {
+        switch (opt) {
+        case 'b':
+            i2c_bus = optarg;
+            break;
+        case 'r':
+            sht30_policy = parse_choice(optarg, sht30_names, 3);
+            if (sht30_policy < 0) return 1;
+            break;
+        case 'l':
+            bh1750_policy = parse_choice(optarg, bh1750_names, 3);
+            if (bh1750_policy < 0) return 1;
+            break;
+        case 'V':
+            if (parse_adaptive(optarg, adaptive_cfg) != 0) {
+                fprintf(stderr, "Invalid adaptive rate: %s\n", optarg);
+                return 1;
+            }
+            use_adaptive = 1;
+            break;
+        case 'B':
+            if (health_parse(optarg, &breaker_cfg) != 0) {
+                fprintf(stderr, "Invalid sensor breaker: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'U':
+            use_ioring = 1;
+            break;
+        case 'd':
+            log_cfg.log_dir = optarg;
+            replay_cfg.log_dir = optarg;
+            break;
+        case 'F':
+            log_cfg.mode = LOGGER_MODE_FLASH;
+            break;
+        case 'P':
+            log_cfg.page_size = strtoul(optarg, NULL, 0);
+            break;
+        case 'T':
+            log_cfg.flush_sec = strtoul(optarg, NULL, 0);
+            break;
+        case 'A':
+            log_cfg.prealloc_bytes = strtoul(optarg, NULL, 0);
+            break;
+        case 'C':
+            log_cfg.framed = 0;
+            break;
+        case 'X':
+            log_cfg.sketches = 0;
+            break;
+        case 'D':
+            if (deadband_parse(optarg, deadband) != 0) {
+                fprintf(stderr, "Invalid deadband: %s\n", optarg);
+                return 1;
+            }
+            log_cfg.deadband = deadband;
+            break;
+        case 'E':
+            log_cfg.heartbeat_sec = strtoul(optarg, NULL, 0);
+            break;
+        case 'f':
+            if (filter_parse(optarg, filters) != 0) {
+                fprintf(stderr, "Invalid filter: %s\n", optarg);
+                return 1;
+            }
+            use_filters = 1;
+            break;
+        case 'a':
+            alert_rules = optarg;
+            break;
+        case 'k':
+            alert_socket = optarg;
+            break;
+        case 'u':
+            if (uplink_parse_url(optarg, &uplink_cfg) != 0) {
+                fprintf(stderr, "Invalid uplink URL: %s\n", optarg);
+                return 1;
+            }
+            use_uplink = 1;
+            break;
+        case 'n':
+            snprintf(uplink_cfg.node, sizeof(uplink_cfg.node), "%s", optarg);
+            break;
+        case 'N':
+            uplink_cfg.batch_count = strtoul(optarg, NULL, 0);
+            break;
+        case 'I':
+            uplink_cfg.batch_sec = strtoul(optarg, NULL, 0);
+            break;
+        case 'Q':
+            uplink_cfg.queue_dir = optarg;
+            break;
+        case 'M':
+            uplink_cfg.queue_max = strtoull(optarg, NULL, 0);
+            break;
+        case 'H':
+            history_hours = strtod(optarg, NULL);
+            break;
+        case 'c':
+            capture_path = optarg;
+            break;
+        case 'K':
+            checkpoint_path = optarg;
+            break;
+        case 'W':
+            checkpoint_sec = strtoul(optarg, NULL, 0);
+            if (checkpoint_sec == 0) {
+                fprintf(stderr, "Invalid checkpoint interval: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'R':
+            replay = 1;
+            break;
+        case 'S':
+            replay_cfg.speed = strtod(optarg, NULL);
+            break;
+        case 'O':
+            replay_cfg.oled = 1;
+            break;
+        case 'G':
+            replay_cfg.fill_sec = strtoul(optarg, NULL, 0);
+            break;
+        case 'p':
+            if (parse_profile(optarg, &profile_format, &profile_path) != 0) {
+                fprintf(stderr, "Invalid profile output: %s\n", optarg);
+                return 1;
+            }
+            use_profile = 1;
+            break;
+        case 'Y':
+            if (optarg && rt_parse(optarg, &rt_cfg) != 0) {
+                fprintf(stderr, "Invalid real-time setting: %s\n", optarg);
+                return 1;
+            }
+            use_rt = 1;
+            break;
+        case 'Z':
+            rt_latency_sec = strtoul(optarg, NULL, 0);
+            if (rt_latency_sec == 0) {
+                fprintf(stderr, "Invalid latency test length: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'h':
+            print_usage(argv[0]);
+            return 0;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // Khoang trong dai hon heartbeat (+ sai so) la mat du lieu
+    replay_cfg.fill_max_sec = log_cfg.heartbeat_sec + 2 * replay_cfg.fill_sec;
+
+    if (replay && (!replay_cfg.log_dir || optind >= argc)) {
+        // Khong ghi du lieu replay lan vao log that
+        fprintf(stderr, "--replay needs --log-dir and at least one input\n");
+        return 1;
+    }
+    if (replay && replay_check_inputs(&replay_cfg, argv + optind, argc - optind) != 0) {
+        return 1;
+    }
+    // --rt tach pipeline ra hai thread: io_uring ring va cay --profile chi cho mot thread
+    if (use_rt && (replay || use_ioring || use_profile)) {
+        fprintf(stderr, "--rt cannot be combined with --replay, --io-uring or --profile\n");
+        return 1;
+    }
+    if (rt_latency_sec > 0) {
+        return rt_latency_test(&rt_cfg, rt_latency_sec, stdout) == 0 ? 0 : 1;
+    }
+
+    if (alert_rules && alert_load(alert_rules) != 0) {
+        return 1;
+    }
+    if (alert_socket && alert_listen(alert_socket) != 0) {
+        return 1;
+    }
+
     signal(SIGINT, sigint_handler);
     signal(SIGTERM, sigint_handler);
+
+    // Warm restart: cursor trong checkpoint cho logger bo qua retention / quet log
+    int warm = 0;
+    if (checkpoint_path && !replay && checkpoint_open(checkpoint_path, &resume) == 0) {
+        log_cfg.resume = &resume;
+        warm = 1;
+    }
     
     // *** THÊM: Khởi tạo logger ***
-    if (logger_init() != 0) {
+    if (logger_init_with(&log_cfg) != 0) {
         fprintf(stderr, "Failed to initialize logger\n");
         return 1;
     }
+
+    if (use_uplink && uplink_start(&uplink_cfg) != 0) {
+        fprintf(stderr, "Failed to start uplink\n");
+        return 1;
+    }
+
+    // Chu ky ngan nhat quyet dinh so mau trong HOURS
+    uint32_t min_period_ms = SAMPLE_PERIOD_SEC * 1000;
+    for (int i = 0; i < DISPLAY_SENSORS && !replay; i++) {
+        if (adaptive_cfg[i].min_ms < min_period_ms) {
+            min_period_ms = adaptive_cfg[i].min_ms;
+        }
+    }
+    if (history_hours > 0 &&
+        history_init((unsigned int)(history_hours * 3600 * 1000 / min_period_ms)) != 0) {
+        return 1;
+    }
+
+    if (use_filters) {
+        display_set_filters(filters);
+        replay_cfg.filters = filters;
+    }
+
+    if (use_profile) {
+        prof_enable();
+    }
+
+    if (replay) {
+        int ret = replay_run(&replay_cfg, argv + optind, argc - optind, &keep_running);
+        uplink_stop();
+        alert_close();
+        logger_close();
+        print_log_stats();
+        print_uplink_stats();
+        print_history_stats();
+        history_close();
+        if (use_profile) {
+            write_profile(profile_format, profile_path);
+        }
+        return ret == 0 ? 0 : 1;
+    }
+
+    if (capture_path && capture_open(capture_path) != 0) {
+        return 1;
+    }
+
+    if (i2c_bus) {
+        i2cdev_set_policy(sht30_policy, bh1750_policy);
+        if (display_use_i2cdev(i2c_bus) != 0) {
+            fprintf(stderr, "Failed to open I2C bus %s\n", i2c_bus);
+            return 1;
+        }
+    }
     
+    display_set_breaker(&breaker_cfg);
+
+    if (use_ioring) {
+        if (ioring_start() == 0) {
+            printf("I/O: io_uring\n");
+        } else {
+            fprintf(stderr, "io_uring not available, using blocking I/O\n");
+        }
+    }
+
+    // SHT30 cho temp + hum, BH1750 cho lux; moi sensor co lich doc rieng
+    static const uint32_t sensor_channels[DISPLAY_SENSORS] = {
+        [DISPLAY_SHT30] = 1u << SAMPLE_TEMP | 1u << SAMPLE_HUM,
+        [DISPLAY_BH1750] = 1u << SAMPLE_LUX,
+    };
+    int64_t start_ms = mono_ms();
+    for (int i = 0; i < DISPLAY_SENSORS; i++) {
+        adaptive_init(&sched[i], &adaptive_cfg[i], sensor_channels[i], start_ms);
+    }
+
+    if (warm) {
+        struct checkpoint_stats ck;
+
+        checkpoint_restore(log_cfg.log_dir, sched, &ck);
+        printf("Warm restart: %llu sample(s) from checkpoint (%.1f s old) + %llu from "
+               "%llu byte(s) of log tail in %.2f ms\n", (unsigned long long)ck.samples,
+               ck.age_ms / 1000.0, (unsigned long long)ck.tail_samples,
+               (unsigned long long)ck.tail_bytes, ck.load_ns / 1e6);
+    }
+    int64_t checkpoint_ms = start_ms + (int64_t)checkpoint_sec * 1000;
+
+    pipeline.capture_path = capture_path;
+    pipeline.checkpoint_path = checkpoint_path;
+    pipeline.use_uplink = use_uplink;
+
+    // Worker tao truoc rt_enter(): giu SCHED_OTHER va moi CPU
+    if (use_rt) {
+        if (start_cycle_worker(&worker) != 0) {
+            return 1;
+        }
+        if (rt_enter(&rt_cfg) != 0) {
+            fprintf(stderr, "Failed to enter real-time mode\n");
+            stop_cycle_worker(worker);
+            return 1;
+        }
+        printf("Real-time: SCHED_FIFO %d on CPU %d, memory locked\n", rt_cfg.priority,
+               rt_cfg.cpu);
+    }
+
     printf("Starting sensor monitoring...\n");
     
     while (keep_running) {
-        // Đọc và hiển thị dữ liệu
-        display_data();
+        int64_t next_ms = sched[0].next_ms;
+        unsigned int due = 0;
+
+        for (int i = 1; i < DISPLAY_SENSORS; i++) {
+            if (sched[i].next_ms < next_ms) {
+                next_ms = sched[i].next_ms;
+            }
+        }
+        PROF_BEGIN(PROF_SLEEP, sleep);
+        int slept = sleep_until_ms(next_ms);
+        PROF_END(PROF_SLEEP, sleep);
+        if (slept != 0) {
+            if (errno != EINTR) {
+                perror("clock_nanosleep");
+                break;
+            }
+            continue;       // signal: kiem tra keep_running
+        }
+
+        PROF_BEGIN(PROF_CYCLE, cycle);
+        int64_t now_ms = mono_ms();
+        for (int i = 0; i < DISPLAY_SENSORS; i++) {
+            if (adaptive_due(&sched[i], now_ms)) {
+                due |= 1u << i;
+            }
+        }
+        PROBE1(due, due);      // sensor (1 << DISPLAY_*) doc trong chu ky nay
+
+        // Đọc và hiển thị dữ liệu (chi cac sensor den han)
+        uint32_t fresh = display_data_for(due);
         
         // *** THÊM: Ghi log ***
-        const char *data = get_ssd1306_buffer();
-        if (log_sensor_data(data) != 0) {
-            fprintf(stderr, "Failed to log sensor data\n");
+        const struct sensor_sample *sample = display_sample();
+        for (int i = 0; i < DISPLAY_SENSORS; i++) {
+            if (due & (1u << i)) {
+                adaptive_update(&sched[i], sample, fresh, now_ms);
+            }
         }
-        
-        // In ra console để debug
-        printf("Data: %s\n", data);
-        
-        sleep(5);
+        cycles++;
+
+        struct cycle c = { .has_sample = sample != NULL };
+        if (sample) {
+            c.sample = *sample;
+        }
+        snprintf(c.data, sizeof(c.data), "%s", get_ssd1306_buffer());
+        for (int i = 0; i < DISPLAY_SENSORS; i++) {
+            c.health[i] = *display_sensor_health(i);
+        }
+        if (checkpoint_path && now_ms >= checkpoint_ms) {
+            c.checkpoint = 1;
+            memcpy(c.sched, sched, sizeof(c.sched));
+            checkpoint_ms = now_ms + (int64_t)checkpoint_sec * 1000;
+        }
+
+        if (use_rt) {
+            rt_queue_push(&pipeline.queue, &c);
+        } else {
+            finish_cycle(&c);
+        }
+        PROF_END(PROF_CYCLE, cycle);
+    }
+
+    if (use_rt) {
+        stop_cycle_worker(worker);
     }
     
+    i2cdev_close();
+    capture_close();
+    uplink_stop();
+    alert_close();
+    logger_close();
+    if (checkpoint_path) {
+        checkpoint_save(checkpoint_path, sched, NULL);
+    }
+    if (ioring_active()) {
+        ioring_stop();
+        print_ioring_stats(cycles);
+    }
+    print_log_stats();
+    print_uplink_stats();
+    print_breaker_stats();
+    if (use_adaptive) {
+        print_adaptive_stats(sched, mono_ms() - start_ms);
+    }
+    print_history_stats();
+    history_close();
+    if (use_profile) {
+        write_profile(profile_format, profile_path);
+    }
     printf("\nExiting...\n");
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,261 @@
+#include "filter.h"
+#include "simd.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FILTER_EMA_FRAC 8       // bit phan so cua trang thai EMA
+
+/*********************************
+ * VECTOR HELPERS
+ *********************************/
+
+/*
+ * Median cua n vector bang odd-even transposition sort (chi min/max, khong
+ * re nhanh). n la hang so tai cho goi nen vong lap duoc unroll het.
+ */
+static inline __attribute__((always_inline)) vec_t vec_median(vec_t *v, int n)
+{
+    for (int round = 0; round < n; round++) {
+        for (int j = round & 1; j + 1 < n; j += 2) {
+            vec_t lo = vec_min(v[j], v[j + 1]);
+            v[j + 1] = vec_max(v[j], v[j + 1]);
+            v[j] = lo;
+        }
+    }
+    return v[n / 2];
+}
+
+/*
+ * a[i] = median(a[i - n + 1 .. i]) cho i = n - 1 .. len - 1, tai cho. Di tu
+ * cuoi ve dau: moi block chi doc cac phan tu <= vi tri no ghi, nen block sau
+ * (thap hon) van doc duoc gia tri goc.
+ */
+static inline __attribute__((always_inline)) void median_run(int32_t *a, size_t len, int n)
+{
+    vec_t v[FILTER_MEDIAN_MAX];
+    size_t i = len;
+
+    while (i >= (size_t)(n - 1) + VEC_LANES) {
+        i -= VEC_LANES;
+        for (int k = 0; k < n; k++) {
+            v[k] = vec_load(&a[i - (n - 1) + k]);
+        }
+        vec_store(&a[i], vec_median(v, n));
+    }
+
+    // Phan con lai (it hon VEC_LANES vi tri), tung mau mot
+    while (i > (size_t)(n - 1)) {
+        int32_t s[FILTER_MEDIAN_MAX];
+        i--;
+        for (int k = 0; k < n; k++) {
+            s[k] = a[i - (n - 1) + k];
+        }
+        for (int round = 0; round < n; round++) {
+            for (int j = round & 1; j + 1 < n; j += 2) {
+                if (s[j] > s[j + 1]) {
+                    int32_t t = s[j];
+                    s[j] = s[j + 1];
+                    s[j + 1] = t;
+                }
+            }
+        }
+        a[i] = s[n / 2];
+    }
+}
+
+/*********************************
+ * SCALAR STAGES
+ *********************************/
+
+// Median cua count gia tri (count le: phan tu giua, chan: phan tu giua duoi)
+static int32_t median_of(const int32_t *values, int count)
+{
+    int32_t s[FILTER_MEDIAN_MAX];
+
+    for (int i = 0; i < count; i++) {
+        int32_t x = values[i];
+        int j = i;
+        while (j > 0 && s[j - 1] > x) {
+            s[j] = s[j - 1];
+            j--;
+        }
+        s[j] = x;
+    }
+    return s[(count - 1) / 2];
+}
+
+// Rate-limit: tra ve gia tri duoc dua tiep vao median
+static int32_t accept(struct filter *f, int32_t x, int64_t t_ms)
+{
+    if (f->primed && f->cfg.max_rate > 0 && f->rejects < FILTER_REJECT_MAX) {
+        int64_t dt = t_ms - f->last_ms;
+        int64_t limit = (int64_t)f->cfg.max_rate * (dt > 0 ? dt : 1) / 1000;
+        int64_t step = (int64_t)x - f->last;
+
+        if (step > limit || step < -limit) {
+            f->rejects++;
+            f->rejected++;
+            return f->last;
+        }
+    }
+
+    f->primed = 1;
+    f->rejects = 0;
+    f->last = x;
+    f->last_ms = t_ms;
+    return x;
+}
+
+static void window_push(struct filter *f, int32_t a)
+{
+    f->window[f->pos] = a;
+    f->pos = f->pos + 1 == f->cfg.median ? 0 : f->pos + 1;
+    if (f->filled < f->cfg.median) {
+        f->filled++;
+    }
+}
+
+static int32_t ema_step(struct filter *f, int32_t m)
+{
+    int64_t x = (int64_t)m << FILTER_EMA_FRAC;
+
+    if (f->cfg.ema_shift == 0) {
+        return m;
+    }
+    if (f->ema == INT64_MIN) {
+        f->ema = x;
+    } else {
+        f->ema += (x - f->ema) >> f->cfg.ema_shift;
+    }
+    return (int32_t)((f->ema + (1 << (FILTER_EMA_FRAC - 1))) >> FILTER_EMA_FRAC);
+}
+
+/*********************************
+ * PUBLIC API
+ *********************************/
+
+void filter_init(struct filter *f, const struct filter_config *cfg)
+{
+    memset(f, 0, sizeof(*f));
+    f->cfg = *cfg;
+    if (f->cfg.median < 1 || f->cfg.median > FILTER_MEDIAN_MAX) {
+        f->cfg.median = 1;
+    }
+    f->ema = INT64_MIN;
+}
+
+int32_t filter_step(struct filter *f, int32_t x, int64_t t_ms)
+{
+    int32_t a = accept(f, x, t_ms);
+
+    if (f->cfg.median > 1) {
+        window_push(f, a);
+        a = median_of(f->window, f->filled);
+    }
+    return ema_step(f, a);
+}
+
+void filter_batch(struct filter *f, const int32_t *in, const int64_t *t_ms,
+                  int32_t *out, size_t n)
+{
+    int median = f->cfg.median;
+    int32_t hist[2 * FILTER_MEDIAN_MAX];
+    int old = f->filled;
+
+    // Window cu theo thu tu cu -> moi, cho cac vi tri dau batch
+    for (int k = 0; k < old; k++) {
+        hist[k] = f->window[(f->pos + median - old + k) % median];
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        out[i] = accept(f, in[i], t_ms[i]);
+        if (median > 1) {
+            window_push(f, out[i]);
+        }
+    }
+
+    if (median > 1) {
+        size_t head = n < (size_t)(median - 1) ? n : (size_t)(median - 1);
+        memcpy(hist + old, out, head * sizeof(*out));
+
+        switch (median) {
+        case 3: median_run(out, n, 3); break;
+        case 5: median_run(out, n, 5); break;
+        case 7: median_run(out, n, 7); break;
+        default: median_run(out, n, median); break;
+        }
+
+        // n - 1 vi tri dau: window con gom ca gia tri tu batch truoc
+        for (size_t i = 0; i < head; i++) {
+            int count = old + (int)i + 1 < median ? old + (int)i + 1 : median;
+            out[i] = median_of(hist + old + i + 1 - count, count);
+        }
+    }
+
+    if (f->cfg.ema_shift > 0) {
+        for (size_t i = 0; i < n; i++) {
+            out[i] = ema_step(f, out[i]);
+        }
+    }
+}
+
+int filter_parse(const char *spec, struct filter_config cfg[SAMPLE_CHANNELS])
+{
+    struct filter_config parsed = { .median = 1 };
+    int channel = -1;
+    const char *colon = strchr(spec, ':');
+    char buf[128];
+
+    if (colon) {
+        for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+            if (strlen(sample_channel_names[c]) == (size_t)(colon - spec) &&
+                strncmp(spec, sample_channel_names[c], colon - spec) == 0) {
+                channel = c;
+            }
+        }
+        if (channel < 0) {
+            return -1;
+        }
+        spec = colon + 1;
+    }
+
+    snprintf(buf, sizeof(buf), "%s", spec);
+    for (char *opt = strtok(buf, ","); opt; opt = strtok(NULL, ",")) {
+        char *value = strchr(opt, '=');
+        char *end;
+        if (!value) {
+            return -1;
+        }
+        *value++ = '\0';
+
+        if (strcmp(opt, "median") == 0) {
+            long v = strtol(value, &end, 10);
+            if (*end || v < 1 || v > FILTER_MEDIAN_MAX || v % 2 == 0) {
+                return -1;
+            }
+            parsed.median = (uint8_t)v;
+        } else if (strcmp(opt, "ema") == 0) {
+            long v = strtol(value, &end, 10);
+            if (*end || v < 0 || v > 16) {
+                return -1;
+            }
+            parsed.ema_shift = (uint8_t)v;
+        } else if (strcmp(opt, "rate") == 0) {
+            double v = strtod(value, &end);
+            if (*end || v < 0 || v > INT32_MAX / 1000) {
+                return -1;
+            }
+            parsed.max_rate = (int32_t)(v * 1000);
+        } else {
+            return -1;
+        }
+    }
+
+    for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+        if (channel < 0 || channel == c) {
+            cfg[c] = parsed;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,145 @@
+#include "health.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define HEALTH_FAIL_MAX     3
+#define HEALTH_BACKOFF_MIN  10000   // ms
+#define HEALTH_BACKOFF_MAX  300000  // ms
+
+static const char *const state_names[] = { "healthy", "degraded", "open" };
+
+/*********************************
+ * HELPERS
+ *********************************/
+
+static uint32_t next_rand(struct health *h)
+{
+    // xorshift32, du cho jitter
+    h->rng ^= h->rng << 13;
+    h->rng ^= h->rng >> 17;
+    h->rng ^= h->rng << 5;
+    return h->rng;
+}
+
+// Hen lan probe tiep theo trong [backoff / 2, backoff]
+static void schedule_probe(struct health *h, int64_t now_ms)
+{
+    uint32_t half = h->backoff_ms / 2;
+
+    h->retry_ms = now_ms + half + next_rand(h) % (h->backoff_ms - half + 1);
+}
+
+/*********************************
+ * PUBLIC API
+ *********************************/
+
+void health_default_config(struct health_config *cfg)
+{
+    cfg->fail_max = HEALTH_FAIL_MAX;
+    cfg->backoff_min_ms = HEALTH_BACKOFF_MIN;
+    cfg->backoff_max_ms = HEALTH_BACKOFF_MAX;
+}
+
+int health_parse(const char *spec, struct health_config *cfg)
+{
+    unsigned int fails;
+    double min_sec, max_sec;
+    char tail;
+
+    if (sscanf(spec, "%u,%lf,%lf%c", &fails, &min_sec, &max_sec, &tail) != 3 ||
+        fails < 1 || min_sec <= 0 || max_sec < min_sec || max_sec > 86400) {
+        return -1;
+    }
+
+    cfg->fail_max = fails;
+    cfg->backoff_min_ms = (uint32_t)(min_sec * 1000);
+    cfg->backoff_max_ms = (uint32_t)(max_sec * 1000);
+    return 0;
+}
+
+void health_init(struct health *h, const char *name, const struct health_config *cfg)
+{
+    memset(h, 0, sizeof(*h));
+    h->name = name;
+    h->cfg = *cfg;
+    h->state = HEALTH_HEALTHY;
+    h->backoff_ms = cfg->backoff_min_ms;
+    h->rng = (uint32_t)getpid() * 2654435761u ^ (uint32_t)(uintptr_t)h;
+    if (h->rng == 0) {
+        h->rng = 1;
+    }
+}
+
+int health_allow(struct health *h, int64_t now_ms)
+{
+    if (h->state != HEALTH_OPEN) {
+        return 1;
+    }
+    if (now_ms < h->retry_ms) {
+        h->skipped++;
+        return 0;
+    }
+
+    h->probes++;
+    return 1;
+}
+
+void health_success(struct health *h, int64_t now_ms, const char *text)
+{
+    if (h->state != HEALTH_HEALTHY) {
+        fprintf(stderr, "%s: recovered after %.1f s\n", h->name,
+                (now_ms - h->down_ms) / 1000.0);
+    }
+
+    h->state = HEALTH_HEALTHY;
+    h->fails = 0;
+    h->backoff_ms = h->cfg.backoff_min_ms;
+    snprintf(h->last_good, sizeof(h->last_good), "%s", text);
+    h->last_good_ms = now_ms;
+}
+
+void health_failure(struct health *h, int64_t now_ms, const char *why)
+{
+    if (h->fails++ == 0) {
+        h->down_ms = now_ms;
+    }
+
+    switch (h->state) {
+    case HEALTH_HEALTHY:
+    case HEALTH_DEGRADED:
+        if (h->fails < h->cfg.fail_max) {
+            if (h->state == HEALTH_HEALTHY) {
+                fprintf(stderr, "%s: read failed (%s), degraded\n", h->name, why);
+            }
+            h->state = HEALTH_DEGRADED;
+            return;
+        }
+        h->state = HEALTH_OPEN;
+        h->trips++;
+        schedule_probe(h, now_ms);
+        fprintf(stderr, "%s: %u failure(s) in a row (%s), circuit open, next probe in %.1f s\n",
+                h->name, h->fails, why, (h->retry_ms - now_ms) / 1000.0);
+        break;
+
+    case HEALTH_OPEN:
+        // Probe half-open loi: lui gap doi
+        h->backoff_ms = h->backoff_ms > h->cfg.backoff_max_ms / 2 ?
+                        h->cfg.backoff_max_ms : h->backoff_ms * 2;
+        // Van OPEN: khong in, chi dem
+        h->probe_fails++;
+        schedule_probe(h, now_ms);
+        break;
+    }
+}
+
+int64_t health_age_ms(const struct health *h, int64_t now_ms)
+{
+    return h->last_good[0] ? now_ms - h->last_good_ms : -1;
+}
+
+const char *health_state_name(enum health_state state)
+{
+    return state_names[state];
+}
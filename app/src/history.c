@@ -0,0 +1,273 @@
+#include "history.h"
+#include "simd.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HISTORY_ALIGN   64      // cache line
+#define HISTORY_MIN_CAP 64
+#define SUM_BLOCK       (8 * VEC_LANES)     // moi lane cong don 8 mau trong int32
+
+static struct {
+    pthread_rwlock_t lock;
+    unsigned int cap;           // luy thua 2, 0 = chua init
+    uint64_t head;              // so mau da push
+    int64_t *t_ms;
+    int32_t *value[SAMPLE_CHANNELS];
+    uint8_t *valid;
+} ring = {
+    .lock = PTHREAD_RWLOCK_INITIALIZER,
+};
+
+/*********************************
+ * HELPERS
+ *********************************/
+
+static void *alloc_array(size_t size)
+{
+    void *p;
+
+    if (posix_memalign(&p, HISTORY_ALIGN, size) != 0) {
+        return NULL;
+    }
+    memset(p, 0, size);
+    return p;
+}
+
+static uint64_t tail_of(void)
+{
+    return ring.head > ring.cap ? ring.head - ring.cap : 0;
+}
+
+// Chi so mau dau tien co t_ms >= since_ms (t_ms tang dan)
+static uint64_t find_index(int64_t since_ms)
+{
+    uint64_t lo = tail_of(), hi = ring.head;
+    unsigned int mask = ring.cap - 1;
+
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (ring.t_ms[mid & mask] < since_ms) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/*
+ * min / max / sum / count cua cac mau co bit hop le, khong re nhanh: lane
+ * khong hop le duoc thay bang gia tri trung tinh. Tong cong don trong int32
+ * theo block SUM_BLOCK mau: moi lane giu 8 gia tri, ca khi VEC_LANES = 1.
+ * 8 x 121 556 000 milli-lux (BH1750 MTreg 31, toi da) < INT32_MAX; 32 gia
+ * tri thi tran. Sau moi block moi cong vao int64.
+ */
+static void scan_channel(const int32_t *v, const uint8_t *valid, unsigned int n,
+                         uint8_t bit, struct history_stats *st)
+{
+    vec_t vbit = vec_set1(bit);
+    vec_t vmin = vec_set1(INT32_MAX), vmax = vec_set1(INT32_MIN);
+    vec_t vcnt = vec_set1(0);
+    int32_t lanes[VEC_LANES];
+    unsigned int i = 0;
+
+    for (; i + SUM_BLOCK <= n; i += SUM_BLOCK) {
+        vec_t vsum = vec_set1(0);
+
+        for (unsigned int k = i; k < i + SUM_BLOCK; k += VEC_LANES) {
+            vec_t x = vec_load(v + k);
+            vec_t m = vec_cmpeq(vec_and(vec_load_u8(valid + k), vbit), vbit);
+
+            vsum = vec_add(vsum, vec_and(m, x));
+            vcnt = vec_sub(vcnt, m);
+            vmin = vec_min(vmin, vec_select(m, x, vec_set1(INT32_MAX)));
+            vmax = vec_max(vmax, vec_select(m, x, vec_set1(INT32_MIN)));
+        }
+        vec_store(lanes, vsum);
+        for (int l = 0; l < VEC_LANES; l++) {
+            st->sum += lanes[l];
+        }
+    }
+
+    vec_store(lanes, vcnt);
+    for (int l = 0; l < VEC_LANES; l++) {
+        st->count += (uint32_t)lanes[l];
+    }
+    vec_store(lanes, vmin);
+    for (int l = 0; l < VEC_LANES; l++) {
+        st->min = lanes[l] < st->min ? lanes[l] : st->min;
+    }
+    vec_store(lanes, vmax);
+    for (int l = 0; l < VEC_LANES; l++) {
+        st->max = lanes[l] > st->max ? lanes[l] : st->max;
+    }
+
+    // Phan con lai (it hon SUM_BLOCK mau)
+    for (; i < n; i++) {
+        if (valid[i] & bit) {
+            st->count++;
+            st->sum += v[i];
+            st->min = v[i] < st->min ? v[i] : st->min;
+            st->max = v[i] > st->max ? v[i] : st->max;
+        }
+    }
+}
+
+/*********************************
+ * PUBLIC API
+ *********************************/
+
+int history_init(unsigned int capacity)
+{
+    unsigned int cap = HISTORY_MIN_CAP;
+
+    while (cap < capacity && cap < (1u << 30)) {
+        cap <<= 1;
+    }
+
+    history_close();
+    pthread_rwlock_wrlock(&ring.lock);
+    ring.t_ms = alloc_array(cap * sizeof(*ring.t_ms));
+    ring.valid = alloc_array(cap);
+    int ok = ring.t_ms && ring.valid;
+    for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+        ring.value[c] = alloc_array(cap * sizeof(int32_t));
+        ok = ok && ring.value[c];
+    }
+    ring.cap = ok ? cap : 0;
+    ring.head = 0;
+    pthread_rwlock_unlock(&ring.lock);
+
+    if (!ok) {
+        fprintf(stderr, "history: cannot allocate %u samples\n", cap);
+        history_close();
+        return -1;
+    }
+    return 0;
+}
+
+void history_close(void)
+{
+    pthread_rwlock_wrlock(&ring.lock);
+    free(ring.t_ms);
+    free(ring.valid);
+    ring.t_ms = NULL;
+    ring.valid = NULL;
+    for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+        free(ring.value[c]);
+        ring.value[c] = NULL;
+    }
+    ring.cap = 0;
+    ring.head = 0;
+    pthread_rwlock_unlock(&ring.lock);
+}
+
+void history_push(const struct sensor_sample *sample)
+{
+    pthread_rwlock_wrlock(&ring.lock);
+    if (ring.cap > 0) {
+        unsigned int i = ring.head & (ring.cap - 1);
+
+        ring.t_ms[i] = sample->t_ms;
+        for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+            ring.value[c][i] = sample->value[c];
+        }
+        ring.valid[i] = (uint8_t)sample->valid;
+        ring.head++;
+    }
+    pthread_rwlock_unlock(&ring.lock);
+}
+
+uint64_t history_head(void)
+{
+    pthread_rwlock_rdlock(&ring.lock);
+    uint64_t head = ring.head;
+    pthread_rwlock_unlock(&ring.lock);
+    return head;
+}
+
+uint64_t history_tail(void)
+{
+    pthread_rwlock_rdlock(&ring.lock);
+    uint64_t tail = tail_of();
+    pthread_rwlock_unlock(&ring.lock);
+    return tail;
+}
+
+int history_get(uint64_t index, struct sensor_sample *out)
+{
+    int ret = -1;
+
+    pthread_rwlock_rdlock(&ring.lock);
+    if (ring.cap > 0 && index >= tail_of() && index < ring.head) {
+        unsigned int i = index & (ring.cap - 1);
+
+        out->t_ms = ring.t_ms[i];
+        for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+            out->value[c] = ring.value[c][i];
+        }
+        out->valid = ring.valid[i];
+        ret = 0;
+    }
+    pthread_rwlock_unlock(&ring.lock);
+    return ret;
+}
+
+void history_read_lock(void)
+{
+    pthread_rwlock_rdlock(&ring.lock);
+}
+
+void history_read_unlock(void)
+{
+    pthread_rwlock_unlock(&ring.lock);
+}
+
+unsigned int history_view(int64_t since_ms, struct history_view *view)
+{
+    memset(view, 0, sizeof(*view));
+    if (ring.cap == 0) {
+        return 0;
+    }
+
+    uint64_t first = find_index(since_ms);
+    unsigned int n = (unsigned int)(ring.head - first);
+    unsigned int pos = first & (ring.cap - 1);
+
+    view->first = first;
+    view->n[0] = n < ring.cap - pos ? n : ring.cap - pos;
+    view->n[1] = n - view->n[0];
+
+    for (int s = 0; s < 2; s++) {
+        unsigned int at = s == 0 ? pos : 0;
+
+        view->t_ms[s] = ring.t_ms + at;
+        view->valid[s] = ring.valid + at;
+        for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+            view->value[c][s] = ring.value[c] + at;
+        }
+    }
+    return n;
+}
+
+int history_stats(enum sample_channel channel, int64_t since_ms, struct history_stats *out)
+{
+    struct history_view view;
+
+    out->count = 0;
+    out->sum = 0;
+    out->min = INT32_MAX;
+    out->max = INT32_MIN;
+
+    history_read_lock();
+    history_view(since_ms, &view);
+    for (int s = 0; s < 2; s++) {
+        scan_channel(view.value[channel][s], view.valid[s], view.n[s],
+                     (uint8_t)(1u << channel), out);
+    }
+    history_read_unlock();
+
+    return out->count > 0 ? 0 : -1;
+}
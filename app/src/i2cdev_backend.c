@@ -0,0 +1,274 @@
+#include "i2cdev_backend.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#define SHT30_ADDR   0x44
+#define BH1750_ADDR  0x23
+
+/*
+ * Userspace alternative to the sensor kernel modules. The I2C traffic for
+ * a full sample is two I2C_RDWR ioctls: both measurement commands in the
+ * first, both results in the second, with a single sleep in between.
+ *
+ * Adapters without plain I2C support (e.g. the i2c-stub test module) fall
+ * back to SMBus transfers per sensor: the command is sent as a byte write
+ * and the result is read as an I2C block from register 0, so a stub chip
+ * can be preloaded with i2cset.
+ */
+
+struct sht30_policy {
+    uint8_t cmd_lsb;        // single shot, no clock stretching (MSB 0x24)
+    unsigned int max_us;
+};
+
+struct bh1750_policy {
+    uint8_t cmd;            // one-time measurement
+    unsigned int conv_us;
+    int div;                // H2 counts twice per lux
+};
+
+static const struct sht30_policy sht30_policies[] = {
+    [I2CDEV_SHT30_LOW]    = { 0x16, 4000 },
+    [I2CDEV_SHT30_MEDIUM] = { 0x0B, 6000 },
+    [I2CDEV_SHT30_HIGH]   = { 0x00, 15000 },
+};
+
+static const struct bh1750_policy bh1750_policies[] = {
+    [I2CDEV_BH1750_LOW]   = { 0x23, 16000, 1 },
+    [I2CDEV_BH1750_HIGH]  = { 0x20, 120000, 1 },
+    [I2CDEV_BH1750_HIGH2] = { 0x21, 120000, 2 },
+};
+
+static int bus_fd = -1;
+static int bus_plain_i2c;
+static const struct sht30_policy *sht30_pol = &sht30_policies[I2CDEV_SHT30_HIGH];
+static const struct bh1750_policy *bh1750_pol = &bh1750_policies[I2CDEV_BH1750_HIGH];
+
+/*********************************
+ * HELPERS
+ *********************************/
+
+/* SHT30 CRC-8: polynomial 0x31, init 0xFF */
+static uint8_t sht30_crc8(const uint8_t *data, size_t len)
+{
+    uint8_t crc = 0xFF;
+
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int j = 0; j < 8; j++)
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+    }
+    return crc;
+}
+
+static void sleep_us(unsigned int us)
+{
+    struct timespec ts = { us / 1000000, (long)(us % 1000000) * 1000 };
+
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+        ;
+}
+
+static int rdwr(struct i2c_msg *msgs, unsigned int n)
+{
+    struct i2c_rdwr_ioctl_data data = { msgs, n };
+
+    return ioctl(bus_fd, I2C_RDWR, &data) < 0 ? -1 : 0;
+}
+
+static int smbus(uint16_t addr, uint8_t rw, uint8_t cmd, uint32_t size,
+                 union i2c_smbus_data *data)
+{
+    struct i2c_smbus_ioctl_data args = { rw, cmd, size, data };
+
+    if (ioctl(bus_fd, I2C_SLAVE, addr) < 0)
+        return -1;
+    return ioctl(bus_fd, I2C_SMBUS, &args) < 0 ? -1 : 0;
+}
+
+/* SMBus fallback: send a 1- or 2-byte command */
+static int smbus_command(uint16_t addr, const uint8_t *cmd, int len)
+{
+    union i2c_smbus_data data;
+
+    if (len == 1)
+        return smbus(addr, I2C_SMBUS_WRITE, cmd[0], I2C_SMBUS_BYTE, NULL);
+
+    data.byte = cmd[1];
+    return smbus(addr, I2C_SMBUS_WRITE, cmd[0], I2C_SMBUS_BYTE_DATA, &data);
+}
+
+/* SMBus fallback: read len bytes as an I2C block from register 0 */
+static int smbus_result(uint16_t addr, uint8_t *buf, int len)
+{
+    union i2c_smbus_data data;
+
+    data.block[0] = (uint8_t)len;
+    if (smbus(addr, I2C_SMBUS_READ, 0, I2C_SMBUS_I2C_BLOCK_DATA, &data) < 0)
+        return -1;
+    memcpy(buf, &data.block[1], len);
+    return 0;
+}
+
+static int format_sht30(const uint8_t *raw, char *out, size_t size)
+{
+    if (raw[2] != sht30_crc8(raw, 2) || raw[5] != sht30_crc8(raw + 3, 2)) {
+        fprintf(stderr, "i2cdev: SHT30 CRC error\n");
+        return -1;
+    }
+
+    int raw_temp = (raw[0] << 8) | raw[1];
+    int raw_hum  = (raw[3] << 8) | raw[4];
+
+    // Same fixed-point conversion and text format as sht30_i2c_driver
+    int temp_milli = -45000 + (raw_temp * 2672) / 1000;
+    int hum_milli  = (raw_hum * 1526) / 1000;
+
+    snprintf(out, size, "%d.%d-%d.%d",
+             temp_milli / 1000, abs(temp_milli % 1000) / 100,
+             hum_milli / 1000, (hum_milli % 1000) / 100);
+    return 0;
+}
+
+static void format_bh1750(const uint8_t *raw, char *out, size_t size)
+{
+    int count = (raw[0] << 8) | raw[1];
+    int lux10 = count * 100 / (12 * bh1750_pol->div);
+
+    snprintf(out, size, "%d.%d", lux10 / 10, lux10 % 10);
+}
+
+/*********************************
+ * PUBLIC API
+ *********************************/
+
+int i2cdev_open(const char *bus_path)
+{
+    unsigned long funcs = 0;
+
+    bus_fd = open(bus_path, O_RDWR);
+    if (bus_fd < 0) {
+        perror("open i2c bus");
+        return -1;
+    }
+
+    if (ioctl(bus_fd, I2C_FUNCS, &funcs) < 0) {
+        perror("ioctl I2C_FUNCS");
+        i2cdev_close();
+        return -1;
+    }
+
+    bus_plain_i2c = (funcs & I2C_FUNC_I2C) != 0;
+    if (!bus_plain_i2c && !(funcs & I2C_FUNC_SMBUS_I2C_BLOCK)) {
+        fprintf(stderr, "%s: adapter supports neither I2C_RDWR nor I2C block reads\n",
+                bus_path);
+        i2cdev_close();
+        return -1;
+    }
+
+    printf("Reading sensors through %s (%s)\n", bus_path,
+           bus_plain_i2c ? "I2C_RDWR" : "SMBus fallback");
+    return 0;
+}
+
+void i2cdev_close(void)
+{
+    if (bus_fd >= 0) {
+        close(bus_fd);
+        bus_fd = -1;
+    }
+}
+
+void i2cdev_set_policy(enum i2cdev_sht30_repeatability sht30,
+                       enum i2cdev_bh1750_resolution bh1750)
+{
+    sht30_pol = &sht30_policies[sht30];
+    bh1750_pol = &bh1750_policies[bh1750];
+}
+
+int i2cdev_read_sensors(int skip, char *sht30_buf, size_t sht30_size,
+                        char *bh1750_buf, size_t bh1750_size)
+{
+    uint8_t sht30_cmd[2] = { 0x24, sht30_pol->cmd_lsb };
+    uint8_t bh1750_cmd[1] = { bh1750_pol->cmd };
+    uint8_t sht30_raw[6], bh1750_raw[2];
+    struct i2c_msg start[2], fetch[2];
+    int bits[2];
+    unsigned int n = 0, wait_us = 0;
+    int failed = skip;
+
+    if (bus_fd < 0)
+        return -1;
+
+    // Only the sensors not skipped are addressed (and waited for)
+    if (!(skip & I2CDEV_SHT30_FAILED)) {
+        start[n] = (struct i2c_msg){ SHT30_ADDR, 0, sizeof(sht30_cmd), sht30_cmd };
+        fetch[n] = (struct i2c_msg){ SHT30_ADDR, I2C_M_RD, sizeof(sht30_raw), sht30_raw };
+        bits[n++] = I2CDEV_SHT30_FAILED;
+        wait_us = sht30_pol->max_us;
+    }
+    if (!(skip & I2CDEV_BH1750_FAILED)) {
+        start[n] = (struct i2c_msg){ BH1750_ADDR, 0, sizeof(bh1750_cmd), bh1750_cmd };
+        fetch[n] = (struct i2c_msg){ BH1750_ADDR, I2C_M_RD, sizeof(bh1750_raw), bh1750_raw };
+        bits[n++] = I2CDEV_BH1750_FAILED;
+        if (bh1750_pol->conv_us > wait_us)
+            wait_us = bh1750_pol->conv_us;
+    }
+    if (n == 0)
+        return failed;
+
+    // 1) All commands. If the batch is NACKed, find out which sensor failed.
+    if (!bus_plain_i2c || rdwr(start, n) != 0) {
+        int nacked = 0;
+
+        for (unsigned int i = 0; i < n; i++) {
+            int ret = bus_plain_i2c ? rdwr(&start[i], 1)
+                                    : smbus_command(start[i].addr, start[i].buf, start[i].len);
+            if (ret != 0) {
+                failed |= bits[i];
+                nacked++;
+            }
+        }
+        if (nacked == (int)n) {
+            perror("i2cdev: measurement command");
+            return failed;
+        }
+    }
+
+    // 2) One wait, for the slower conversion
+    sleep_us(wait_us);
+
+    // 3) All results, again with a per-sensor retry if the batch fails
+    if (failed || !bus_plain_i2c || rdwr(fetch, n) != 0) {
+        for (unsigned int i = 0; i < n; i++) {
+            int ret;
+
+            if (failed & bits[i])
+                continue;
+            ret = bus_plain_i2c ? rdwr(&fetch[i], 1)
+                                : smbus_result(fetch[i].addr, fetch[i].buf, fetch[i].len);
+            if (ret != 0) {
+                perror(bits[i] == I2CDEV_SHT30_FAILED ? "i2cdev: read SHT30" : "i2cdev: read BH1750");
+                failed |= bits[i];
+            }
+        }
+    }
+
+    if (!(failed & I2CDEV_SHT30_FAILED) &&
+        format_sht30(sht30_raw, sht30_buf, sht30_size) != 0)
+        failed |= I2CDEV_SHT30_FAILED;
+
+    if (!(failed & I2CDEV_BH1750_FAILED))
+        format_bh1750(bh1750_raw, bh1750_buf, bh1750_size);
+
+    return failed;
+}
@@ -0,0 +1,339 @@
+#include "ioring.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+#define IORING_ENTRIES  8       // moi slot toi da 1 I/O dang bay
+
+static struct {
+    int fd;                     // ring fd, -1 = tat
+    unsigned int *sq_head, *sq_tail, *sq_mask, *sq_entries, *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned int *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+    void *sq_map, *cq_map;
+    size_t sq_map_len, cq_map_len, sqes_len;
+    char *bufs_map;             // IORING_SLOTS x IORING_BUF_SIZE, anonymous
+    unsigned int queued;        // SQE da ghi, chua submit
+    int fds[IORING_SLOTS];
+    struct iovec bufs[IORING_SLOTS];
+    int busy[IORING_SLOTS];
+    int result[IORING_SLOTS];
+    size_t want[IORING_SLOTS];  // ghi: so byte phai ghi du
+    int writing[IORING_SLOTS];
+} ring = { .fd = -1, .fds = { -1, -1, -1, -1 } };
+
+static struct ioring_stats stats;
+
+/*********************************
+ * HELPERS
+ *********************************/
+
+static int sys_setup(unsigned int entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_enter(unsigned int to_submit, unsigned int min_complete, unsigned int flags)
+{
+    return (int)syscall(__NR_io_uring_enter, ring.fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_register(unsigned int opcode, const void *arg, unsigned int nr)
+{
+    return (int)syscall(__NR_io_uring_register, ring.fd, opcode, arg, nr);
+}
+
+// Lay ket qua cac I/O da xong (khong syscall)
+static void reap(void)
+{
+    unsigned int head = *ring.cq_head;
+    unsigned int tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+
+    for (; head != tail; head++) {
+        const struct io_uring_cqe *cqe = &ring.cqes[head & *ring.cq_mask];
+        unsigned int slot = (unsigned int)cqe->user_data;
+
+        stats.cqes++;
+        if (slot >= IORING_SLOTS) {
+            continue;
+        }
+        ring.result[slot] = cqe->res;
+        ring.busy[slot]--;
+        if (cqe->res < 0 || (ring.writing[slot] && (size_t)cqe->res != ring.want[slot])) {
+            stats.errors++;
+        }
+    }
+    __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+}
+
+// Submit het SQE da queue, doi it nhat min_complete completion
+static int enter(unsigned int min_complete)
+{
+    int ret = sys_enter(ring.queued, min_complete, min_complete ? IORING_ENTER_GETEVENTS : 0);
+
+    stats.enters++;
+    if (ret < 0) {
+        if (errno == EINTR) {
+            return 0;           // bi signal khi dang doi: caller goi lai
+        }
+        perror("io_uring_enter");
+        return -1;
+    }
+    ring.queued -= (unsigned int)ret;
+    return 0;
+}
+
+static unsigned int pending(unsigned int mask)
+{
+    unsigned int n = 0;
+
+    for (int s = 0; s < IORING_SLOTS; s++) {
+        if ((mask & IORING_MASK(s)) && ring.busy[s] > 0) {
+            n += (unsigned int)ring.busy[s];
+        }
+    }
+    return n;
+}
+
+static int queue(int opcode, enum ioring_slot slot, size_t len, int64_t off)
+{
+    if (ring.fd < 0 || slot >= IORING_SLOTS || len > ring.bufs[slot].iov_len ||
+        ring.fds[slot] < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Buffer cua slot con dang duoc kernel dung
+    if (ring.busy[slot] > 0 && ioring_wait(IORING_MASK(slot)) != 0) {
+        return -1;
+    }
+
+    unsigned int tail = *ring.sq_tail;
+    if (tail - __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE) >= *ring.sq_entries) {
+        if (enter(0) != 0) {
+            return -1;
+        }
+    }
+
+    unsigned int idx = tail & *ring.sq_mask;
+    struct io_uring_sqe *sqe = &ring.sqes[idx];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = (uint8_t)opcode;
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->fd = slot;
+    sqe->off = (uint64_t)off;
+    sqe->addr = (uint64_t)(uintptr_t)ring.bufs[slot].iov_base;
+    sqe->len = (uint32_t)len;
+    sqe->buf_index = slot;
+    sqe->user_data = slot;
+    ring.sq_array[idx] = idx;
+    __atomic_store_n(ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    ring.queued++;
+    ring.busy[slot]++;
+    ring.want[slot] = len;
+    ring.writing[slot] = opcode == IORING_OP_WRITE_FIXED;
+    stats.sqes++;
+    return 0;
+}
+
+/*********************************
+ * PUBLIC API
+ *********************************/
+
+void *ioring_buffer(enum ioring_slot slot)
+{
+    return ring.bufs[slot].iov_base;
+}
+
+int ioring_set_fd(enum ioring_slot slot, int fd)
+{
+    if (ring.fd >= 0) {
+        struct io_uring_files_update up = {
+            .offset = slot,
+            .fds = (uint64_t)(uintptr_t)&fd,
+        };
+
+        if (ring.busy[slot] > 0) {
+            ioring_wait(IORING_MASK(slot));
+        }
+        if (sys_register(IORING_REGISTER_FILES_UPDATE, &up, 1) < 0) {
+            perror("io_uring files update");
+            return -1;
+        }
+    }
+    ring.fds[slot] = fd;
+    return 0;
+}
+
+int ioring_start(void)
+{
+    struct io_uring_params p;
+
+    memset(&p, 0, sizeof(p));
+    ring.fd = sys_setup(IORING_ENTRIES, &p);
+    if (ring.fd < 0) {
+        return -1;
+    }
+
+    ring.sq_map_len = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+    ring.cq_map_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring.cq_map_len > ring.sq_map_len) {
+            ring.sq_map_len = ring.cq_map_len;
+        }
+        ring.cq_map_len = ring.sq_map_len;
+    }
+
+    ring.sq_map = mmap(NULL, ring.sq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       ring.fd, IORING_OFF_SQ_RING);
+    if (ring.sq_map == MAP_FAILED) {
+        goto fail;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ring.cq_map = ring.sq_map;
+    } else {
+        ring.cq_map = mmap(NULL, ring.cq_map_len, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_CQ_RING);
+        if (ring.cq_map == MAP_FAILED) {
+            goto fail;
+        }
+    }
+    ring.sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring.sqes = mmap(NULL, ring.sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     ring.fd, IORING_OFF_SQES);
+    if (ring.sqes == MAP_FAILED) {
+        goto fail;
+    }
+
+    char *sq = ring.sq_map, *cq = ring.cq_map;
+    ring.sq_head = (unsigned int *)(sq + p.sq_off.head);
+    ring.sq_tail = (unsigned int *)(sq + p.sq_off.tail);
+    ring.sq_mask = (unsigned int *)(sq + p.sq_off.ring_mask);
+    ring.sq_entries = (unsigned int *)(sq + p.sq_off.ring_entries);
+    ring.sq_array = (unsigned int *)(sq + p.sq_off.array);
+    ring.cq_head = (unsigned int *)(cq + p.cq_off.head);
+    ring.cq_tail = (unsigned int *)(cq + p.cq_off.tail);
+    ring.cq_mask = (unsigned int *)(cq + p.cq_off.ring_mask);
+    ring.cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    // Buffer dang ky phai la bo nho anonymous (khong phai .data/.bss cua file)
+    ring.bufs_map = mmap(NULL, IORING_SLOTS * IORING_BUF_SIZE, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring.bufs_map == MAP_FAILED) {
+        ring.bufs_map = NULL;
+        goto fail;
+    }
+    for (int s = 0; s < IORING_SLOTS; s++) {
+        ring.bufs[s].iov_base = ring.bufs_map + s * IORING_BUF_SIZE;
+        ring.bufs[s].iov_len = IORING_BUF_SIZE;
+    }
+
+    // fd + buffer co dinh: kernel khong phai tra fd / pin trang moi lan I/O
+    if (sys_register(IORING_REGISTER_BUFFERS, ring.bufs, IORING_SLOTS) < 0 ||
+        sys_register(IORING_REGISTER_FILES, ring.fds, IORING_SLOTS) < 0) {
+        goto fail;
+    }
+    return 0;
+
+fail:
+    perror("io_uring setup");
+    ioring_stop();
+    return -1;
+}
+
+void ioring_stop(void)
+{
+    if (ring.fd < 0) {
+        return;
+    }
+    if (ring.sqes && ring.sqes != MAP_FAILED) {
+        if (ring.queued > 0) {
+            enter(0);
+        }
+        ioring_wait(~0u);
+        munmap(ring.sqes, ring.sqes_len);
+    }
+    if (ring.cq_map && ring.cq_map != MAP_FAILED && ring.cq_map != ring.sq_map) {
+        munmap(ring.cq_map, ring.cq_map_len);
+    }
+    if (ring.sq_map && ring.sq_map != MAP_FAILED) {
+        munmap(ring.sq_map, ring.sq_map_len);
+    }
+    if (ring.bufs_map) {
+        munmap(ring.bufs_map, IORING_SLOTS * IORING_BUF_SIZE);
+        ring.bufs_map = NULL;
+        memset(ring.bufs, 0, sizeof(ring.bufs));
+    }
+    close(ring.fd);
+    ring.fd = -1;
+    ring.sq_map = ring.cq_map = NULL;
+    ring.sqes = NULL;
+    ring.queued = 0;
+}
+
+int ioring_active(void)
+{
+    return ring.fd >= 0;
+}
+
+int ioring_read(enum ioring_slot slot, size_t len, int64_t off)
+{
+    return queue(IORING_OP_READ_FIXED, slot, len, off);
+}
+
+int ioring_write(enum ioring_slot slot, size_t len, int64_t off)
+{
+    return queue(IORING_OP_WRITE_FIXED, slot, len, off);
+}
+
+int ioring_submit(unsigned int wait_mask)
+{
+    if (ring.fd < 0) {
+        return -1;
+    }
+
+    reap();
+    if (ring.queued > 0 && enter(pending(wait_mask)) != 0) {
+        return -1;
+    }
+    return ioring_wait(wait_mask);
+}
+
+int ioring_wait(unsigned int wait_mask)
+{
+    if (ring.fd < 0) {
+        return -1;
+    }
+
+    reap();
+    while (pending(wait_mask) > 0) {
+        if (enter(1) != 0) {
+            return -1;
+        }
+        reap();
+    }
+    return 0;
+}
+
+int ioring_busy(enum ioring_slot slot)
+{
+    return ring.busy[slot] > 0;
+}
+
+int ioring_result(enum ioring_slot slot)
+{
+    return ring.result[slot];
+}
+
+void ioring_get_stats(struct ioring_stats *out)
+{
+    *out = stats;
+}
@@ -1,4 +1,10 @@
+#define _GNU_SOURCE     // fallocate()
 #include "logger.h"
+#include "record.h"
+#include "sample.h"
+#include "ioring.h"
+#include "prof.h"
+#include "sketch.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -7,30 +13,109 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <time.h>
+#include <errno.h>
 
 #define LOG_DIR "/var/log/sensor_monitor"
 #define MAX_LOG_AGE_DAYS 7
 
-// Lay timestamp hien tai dang string
-static void get_timestamp(char *buffer, size_t size)
+#define DEFAULT_PAGE_SIZE     4096
+#define DEFAULT_FLUSH_SEC     60
+#define DEFAULT_PREALLOC      (4 * 1024 * 1024)
+#define RECOVER_CHUNK         8192
+#define RECOVER_TAIL          (64 * 1024)
+#define DEFAULT_HEARTBEAT     900
+
+/*
+ * LOGGER_MODE_FLASH file layout:
+ *
+ *   page 0      header line "#sensor_log v1 page=... end=...\n", rest NUL
+ *   page 1..    CSV records, same text as append mode
+ *   end..       preallocated tail (reads back as NUL)
+ *
+ * Records are staged in a page-sized buffer and written with pwrite() at
+ * page-aligned offsets: a full page when it fills up, or the partial page
+ * (NUL padded) once flush_sec has passed. Each flush then rewrites the
+ * fixed-width header with the logical end of data, so readers stop there
+ * instead of at the preallocated file size (LOG_HEADER_FMT in logger.h).
+ */
+
+static struct logger_config config;
+
+// Trang thai file dang mo o che do flash
+static struct {
+    int fd;
+    char path[256];
+    char *stage;            // buffer 1 page, can theo page
+    size_t stage_len;       // so byte hop le trong stage
+    off_t stage_off;        // offset cua page dang stage trong file
+    off_t alloc_end;        // da fallocate den day
+    time_t last_flush;
+    int dirty;
+} flash = { .fd = -1 };
+
+static struct logger_stats stats;
+
+// Seq cua record cuoi trong file log hien tai
+static uint32_t log_seq;
+static char seq_path[256];
+
+// Thoi diem cua mau dang ghi (thoi gian thuc, hoac thoi gian ghi lai khi replay)
+static time_t log_clock;
+
+// 00:00 cua ngay chay retention gan nhat
+static time_t retention_day;
+
+// Deadband: mau cuoi cung bi bo qua, ghi khi close de chuoi ket thuc dung luc
+static struct deadband deadband;
+static struct sensor_sample held;
+static int held_pending;
+
+// Quantile sketch theo gio, ghi canh log
+static struct sketch_writer sketch;
+
+// Append qua io_uring: file ngay hien tai giu mo, record cuoi co the dang bay
+static struct {
+    int fd;
+    char path[256];
+    size_t len;
+    int pending;
+} ring = { .fd = -1 };
+
+// Lay timestamp dang string
+static void get_timestamp(char *buffer, size_t size, time_t when)
 {
-    time_t now = time(NULL);
-    struct tm *t = localtime(&now);
+    PROF_BEGIN(PROF_TIMESTAMP, timestamp);
+    struct tm *t = localtime(&when);
     strftime(buffer, size, "%Y-%m-%d %H:%M:%S", t);
+    PROF_END(PROF_TIMESTAMP, timestamp);
 }
 
-// Lay ten file log theo ngay hien tai
-static void get_daily_log_filename(char *buffer, size_t size)
+// Lay ten file log theo ngay cua mau
+static void get_daily_log_filename(char *buffer, size_t size, time_t when)
 {
-    time_t now = time(NULL);
-    struct tm *t = localtime(&now);
+    PROF_BEGIN(PROF_FILENAME, filename);
+    struct tm *t = localtime(&when);
     
     // Format: sensor_data_2025-11-23.log
     snprintf(buffer, size, "%s/sensor_data_%04d-%02d-%02d.log",
-             LOG_DIR, 
+             config.log_dir, 
              t->tm_year + 1900,
              t->tm_mon + 1,
              t->tm_mday);
+    PROF_END(PROF_FILENAME, filename);
+}
+
+// 00:00 gio dia phuong cua ngay chua when
+static time_t day_start(time_t when)
+{
+    struct tm tm;
+
+    localtime_r(&when, &tm);
+    tm.tm_hour = 0;
+    tm.tm_min = 0;
+    tm.tm_sec = 0;
+    tm.tm_isdst = -1;
+    return mktime(&tm);
 }
 
 // Tao thu muc log neu chua ton tai
@@ -38,12 +123,12 @@ static int create_log_directory(void)
 {
     struct stat st = {0};
     
-    if (stat(LOG_DIR, &st) == -1) {
-        if (mkdir(LOG_DIR, 0755) != 0) {
-            perror("mkdir " LOG_DIR);
+    if (stat(config.log_dir, &st) == -1) {
+        if (mkdir(config.log_dir, 0755) != 0) {
+            fprintf(stderr, "mkdir %s: %s\n", config.log_dir, strerror(errno));
             return -1;
         }
-        printf("Created log directory: %s\n", LOG_DIR);
+        printf("Created log directory: %s\n", config.log_dir);
     }
     
     return 0;
@@ -70,16 +155,18 @@ static time_t parse_date_from_filename(const char *filename)
     return 0;
 }
 
-// Xoa log cu hon N ngay (dua vao ten file)
-int cleanup_old_logs(int days) 
+// Xoa log cu hon N ngay tinh tu now (dua vao ten file)
+static int cleanup_logs_before(time_t now, int days)
 {
-    DIR *dir = opendir(LOG_DIR);
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    DIR *dir = opendir(config.log_dir);
     if (!dir) {
-        perror("opendir " LOG_DIR);
+        fprintf(stderr, "opendir %s: %s\n", config.log_dir, strerror(errno));
         return -1;
     }
 
-    time_t now = time(NULL);
     time_t cutoff_time = now - (days * 24 * 60 * 60);
     int deleted_count = 0;
 
@@ -91,7 +178,7 @@ int cleanup_old_logs(int days)
         }
 
         // Chi xu ly file co format sensor_data_YYYY-MM-DD.log
-        if (strncmp(entry->d_name, "sensor_data_", 12) != 0) {
+        if (!logger_is_log_file(entry)) {
             continue;
         }
 
@@ -105,7 +192,7 @@ int cleanup_old_logs(int days)
         // So sanh voi cutoff time
         if (file_date < cutoff_time) {
             char filepath[512];
-            snprintf(filepath, sizeof(filepath), "%s/%s", LOG_DIR, entry->d_name);
+            snprintf(filepath, sizeof(filepath), "%s/%s", config.log_dir, entry->d_name);
             
             if (unlink(filepath) == 0) {
                 printf("Deleted old log: %s\n", entry->d_name);
@@ -121,27 +208,590 @@ int cleanup_old_logs(int days)
     if (deleted_count > 0) {
         printf("Cleaned up %d old log file(s)\n", deleted_count);
     }
-    
+
+    retention_day = day_start(now);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    stats.retention_runs++;
+    stats.retention_ns += (t1.tv_sec - t0.tv_sec) * 1000000000ULL + t1.tv_nsec - t0.tv_nsec;
+    return 0;
+}
+
+// Xoa log cu hon N ngay (dua vao ten file)
+int cleanup_old_logs(int days) 
+{
+    return cleanup_logs_before(time(NULL), days);
+}
+
+/*********************************
+ * FLASH-FRIENDLY WRITER
+ *********************************/
+
+// Ghi header voi logical end cho truoc
+static int write_header(int fd, size_t page_size, unsigned long long end)
+{
+    char header[128];
+    int len = snprintf(header, sizeof(header), LOG_HEADER_FMT, page_size, end);
+
+    if (pwrite(fd, header, len, 0) != len) {
+        perror("pwrite log header");
+        return -1;
+    }
+    stats.device_bytes += len;
+    return 0;
+}
+
+// Ghi lai header voi logical end hien tai
+static int flash_write_header(void)
+{
+    return write_header(flash.fd, config.page_size,
+                        (unsigned long long)flash.stage_off + flash.stage_len);
+}
+
+// Parse header tu len byte dau file; 0 neu la file flash
+static int parse_header(const char *data, size_t len, size_t *page_size, unsigned long long *end)
+{
+    char header[128];
+    size_t n = len < sizeof(header) - 1 ? len : sizeof(header) - 1;
+
+    memcpy(header, data, n);
+    header[n] = '\0';
+    return sscanf(header, LOG_HEADER_MAGIC " page=%zu end=%llu", page_size, end) == 2 ? 0 : -1;
+}
+
+// Doc header, tra ve logical end (-1 neu khong phai file flash)
+static long long flash_read_header(int fd, size_t *page_size)
+{
+    char header[128];
+    unsigned long long end;
+    ssize_t n = pread(fd, header, sizeof(header), 0);
+
+    if (n <= 0 || parse_header(header, (size_t)n, page_size, &end) != 0) {
+        return -1;
+    }
+    return (long long)end;
+}
+
+// Dam bao file da duoc cap phat truoc toi it nhat 'need' byte
+static void flash_reserve(off_t need)
+{
+    if (need <= flash.alloc_end || config.prealloc_bytes == 0) {
+        return;
+    }
+
+    off_t len = (off_t)config.prealloc_bytes;
+    while (flash.alloc_end + len < need) {
+        len += (off_t)config.prealloc_bytes;
+    }
+
+    // FS khong ho tro (vd. FAT) thi file van lon dan binh thuong
+    if (fallocate(flash.fd, 0, flash.alloc_end, len) == 0) {
+        flash.alloc_end += len;
+    } else if (errno == EOPNOTSUPP) {
+        config.prealloc_bytes = 0;
+    } else {
+        perror("fallocate log file");
+    }
+}
+
+// Ghi page dang stage (pad NUL) tai offset can page, cap nhat header
+static int flash_flush(void)
+{
+    if (!flash.dirty) {
+        return 0;
+    }
+
+    memset(flash.stage + flash.stage_len, 0, config.page_size - flash.stage_len);
+    flash_reserve(flash.stage_off + (off_t)config.page_size);
+
+    ssize_t n = pwrite(flash.fd, flash.stage, config.page_size, flash.stage_off);
+    if (n != (ssize_t)config.page_size) {
+        perror("pwrite log page");
+        return -1;
+    }
+    stats.device_bytes += n;
+    stats.flushes++;
+
+    if (flash.stage_len == config.page_size) {
+        flash.stage_off += config.page_size;
+        flash.stage_len = 0;
+    }
+
+    if (flash_write_header() != 0 || fdatasync(flash.fd) != 0) {
+        return -1;
+    }
+
+    flash.dirty = 0;
+    flash.last_flush = log_clock;
+    return 0;
+}
+
+static void flash_close(void)
+{
+    if (flash.fd < 0) {
+        return;
+    }
+
+    flash_flush();
+    close(flash.fd);
+    flash.fd = -1;
+}
+
+// Mo (hoac tiep tuc) file log ngay o che do flash
+static int flash_open(const char *path)
+{
+    struct stat st;
+    size_t page_size;
+    long long end;
+
+    // Nho ten file ke ca khi khong dung duoc che do flash, de khong thu lai moi mau
+    snprintf(flash.path, sizeof(flash.path), "%s", path);
+
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        perror("open log file");
+        flash.path[0] = '\0';
+        return -1;
+    }
+
+    if (fstat(fd, &st) != 0) {
+        perror("fstat log file");
+        close(fd);
+        flash.path[0] = '\0';
+        return -1;
+    }
+
+    flash.fd = fd;
+    flash.alloc_end = st.st_size;
+    flash.dirty = 0;
+    flash.last_flush = log_clock;
+
+    if (st.st_size == 0) {
+        // File moi: page 0 danh cho header
+        flash.stage_off = (off_t)config.page_size;
+        flash.stage_len = 0;
+        flash_reserve((off_t)config.page_size * 2);
+        memset(flash.stage, 0, config.page_size);
+        if (pwrite(fd, flash.stage, config.page_size, 0) != (ssize_t)config.page_size ||
+            flash_write_header() != 0) {
+            perror("init log header");
+            flash_close();
+            flash.path[0] = '\0';
+            return -1;
+        }
+        stats.device_bytes += config.page_size;
+        return 0;
+    }
+
+    end = flash_read_header(fd, &page_size);
+    if (end < 0 || page_size != config.page_size || end < (long long)page_size) {
+        fprintf(stderr, "%s: not a %zu-byte page flash log, appending in place\n",
+                path, config.page_size);
+        close(fd);
+        flash.fd = -1;
+        return 1;
+    }
+
+    // Nap lai page cuoi chua day vao stage de ghi tiep
+    flash.stage_off = (off_t)(end - end % (long long)page_size);
+    flash.stage_len = (size_t)(end - flash.stage_off);
+    if (flash.stage_len > 0 &&
+        pread(fd, flash.stage, flash.stage_len, flash.stage_off) != (ssize_t)flash.stage_len) {
+        perror("pread log page");
+        flash_close();
+        flash.path[0] = '\0';
+        return -1;
+    }
+    return 0;
+}
+
+// Them mot record vao stage, flush khi day page hoac qua flush_sec
+static int flash_append(const char *record, size_t len)
+{
+    while (len > 0) {
+        size_t room = config.page_size - flash.stage_len;
+        size_t n = len < room ? len : room;
+
+        memcpy(flash.stage + flash.stage_len, record, n);
+        flash.stage_len += n;
+        flash.dirty = 1;
+        record += n;
+        len -= n;
+
+        if (flash.stage_len == config.page_size && flash_flush() != 0) {
+            return -1;
+        }
+    }
+
+    if (flash.dirty && log_clock - flash.last_flush >= (time_t)config.flush_sec) {
+        return flash_flush();
+    }
     return 0;
 }
 
+/*********************************
+ * CRASH RECOVERY
+ *********************************/
+
+// Log CSV thuong: offset ngay sau '\n' cuoi cung trong buf (-1 neu khong co)
+static ssize_t plain_scan_back(const char *buf, size_t len)
+{
+    while (len > 0 && buf[len - 1] != '\n') {
+        len--;
+    }
+    return len > 0 ? (ssize_t)len : -1;
+}
+
+/*
+ * Tim record hop le cuoi cung bang cach quet nguoc tu cuoi file, tung chunk
+ * mot, toi da RECOVER_TAIL byte, nen thoi gian khong phu thuoc kich thuoc
+ * file. Phan bi ghi do (torn) phia sau se bi cat bo: truncate voi file
+ * append, ghi lai logical end trong header voi file flash.
+ *
+ * Framed nhung duoi file khong co record framed nao (CSV cua ban cu, hoac
+ * --plain-log truoc do trong ngay): dung luat CSV, chi cat sau '\n' cuoi.
+ * Khong thay ca '\n': giu nguyen file.
+ */
+static int recover_log_file(const char *path, uint32_t *last_seq)
+{
+    struct timespec t0, t1;
+    struct stat st;
+    char buf[RECOVER_CHUNK];
+    size_t page_size = 0;
+    uint32_t seq = 0;
+
+    *last_seq = 0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    int fd = open(path, O_RDWR);
+    if (fd < 0) {
+        return errno == ENOENT ? 0 : -1;
+    }
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    off_t data_start = 0, end = st.st_size;
+    long long header_end = flash_read_header(fd, &page_size);
+    if (header_end >= 0) {
+        // Header co the cu hon data: xem ca page sau logical end
+        off_t limit = (off_t)(header_end - header_end % (long long)page_size + 2 * (long long)page_size);
+        data_start = (off_t)page_size;
+        end = limit < end ? limit : end;
+    }
+
+    long long logical_end = header_end >= 0 ? header_end : (long long)st.st_size;
+    off_t tail_start = end - RECOVER_TAIL > data_start ? end - RECOVER_TAIL : data_start;
+    off_t valid_end = -1, plain_end = -1;
+    while (end > tail_start) {
+        off_t start = end - RECOVER_CHUNK > tail_start ? end - RECOVER_CHUNK : tail_start;
+        ssize_t n = pread(fd, buf, (size_t)(end - start), start);
+        if (n <= 0) {
+            break;
+        }
+
+        ssize_t off = plain_scan_back(buf, (size_t)n);
+        if (plain_end < 0 && off >= 0) {
+            plain_end = start + off;
+        }
+        if (config.framed) {
+            off = record_scan_back(buf, (size_t)n, &seq);
+        }
+        if (off >= 0) {
+            valid_end = start + off;
+            break;
+        }
+        if (start == tail_start) {
+            break;
+        }
+
+        // Dong dau chunk co the bat dau o chunk truoc: lui ve cuoi dong do
+        char *nl = memchr(buf, '\n', (size_t)n);
+        end = nl && nl - buf + 1 < n ? start + (nl - buf) + 1 : start;
+    }
+
+    if (valid_end < 0) {
+        valid_end = plain_end >= 0 ? plain_end : (off_t)logical_end;
+    }
+    long long dropped = logical_end - (long long)valid_end;
+    int ret = 0;
+
+    if (header_end >= 0) {
+        if (valid_end != header_end) {
+            ret = write_header(fd, page_size, (unsigned long long)valid_end);
+            if (ret == 0) {
+                ret = fdatasync(fd);
+            }
+        }
+    } else if (valid_end < st.st_size) {
+        ret = ftruncate(fd, valid_end);
+    }
+    close(fd);
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if (dropped != 0) {
+        printf("Recovered %s: %s %lld bytes after last record (seq %u) in %.2f ms\n",
+               path, dropped > 0 ? "dropped" : "kept", dropped > 0 ? dropped : -dropped, seq,
+               (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6);
+    }
+
+    *last_seq = seq;
+    return ret;
+}
+
+// Chuyen sang file log moi (khoi dong / sang ngay moi): phuc hoi va lay seq
+static void switch_log_file(const char *path)
+{
+    snprintf(seq_path, sizeof(seq_path), "%s", path);
+
+    // Checkpoint con khop voi file (khong ai ghi them / cat bot): khoi quet lai
+    const struct logger_cursor *resume = config.resume;
+    if (resume && strcmp(resume->path, path) == 0 && config.mode == LOGGER_MODE_APPEND) {
+        struct stat st;
+        if (stat(path, &st) == 0 && (uint64_t)st.st_size == resume->offset) {
+            log_seq = resume->seq;
+            return;
+        }
+    }
+
+    if (recover_log_file(path, &log_seq) != 0) {
+        perror("recover log file");
+    }
+}
+
+// Ket qua cua record dang bay (loi chi bao duoc o lan ghi sau / khi close)
+static int ring_reap(void)
+{
+    if (!ring.pending) {
+        return 0;
+    }
+    ring.pending = 0;
+    ioring_wait(IORING_MASK(IORING_SLOT_LOG));
+
+    int res = ioring_result(IORING_SLOT_LOG);
+    if (res != (int)ring.len) {
+        errno = res < 0 ? -res : EIO;
+        perror("write log file");
+        return -1;
+    }
+    stats.device_bytes += res;
+    return 0;
+}
+
+static void ring_close(void)
+{
+    ring_reap();
+    if (ring.fd >= 0) {
+        ioring_set_fd(IORING_SLOT_LOG, -1);
+        close(ring.fd);
+        ring.fd = -1;
+        ring.path[0] = '\0';
+    }
+}
+
+/*
+ * Append mode qua io_uring: queue record, no di cung frame OLED trong
+ * ioring_submit() cua vong lap, khong open/write/close moi mau
+ */
+static int ring_append(const char *path, const char *record, size_t len)
+{
+    ring_reap();
+
+    if (strcmp(ring.path, path) != 0) {
+        ring_close();
+        ring.fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (ring.fd < 0) {
+            perror("open log file");
+            return -1;
+        }
+        if (ioring_set_fd(IORING_SLOT_LOG, ring.fd) != 0) {
+            close(ring.fd);
+            ring.fd = -1;
+            return -1;
+        }
+        snprintf(ring.path, sizeof(ring.path), "%s", path);
+    }
+
+    // O_APPEND: kernel ghi vao cuoi file, offset bo qua
+    memcpy(ioring_buffer(IORING_SLOT_LOG), record, len);
+    if (ioring_write(IORING_SLOT_LOG, len, 0) != 0) {
+        perror("write log file");
+        return -1;
+    }
+    ring.len = len;
+    ring.pending = 1;
+    return 0;
+}
+
+// Append mode: open / write / close moi record
+static int append_record(const char *path, const char *record, size_t len)
+{
+    // Mo file voi O_CREAT | O_APPEND
+    int fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        perror("open log file");
+        return -1;
+    }
+
+    // Ghi vao file
+    ssize_t written = write(fd, record, len);
+    close(fd);
+
+    if (written != (ssize_t)len) {
+        perror("write log file");
+        return -1;
+    }
+    stats.device_bytes += written;
+
+    return 0;
+}
+
+// Ghi mot mau da parse (bo qua deadband)
+static int write_sample(const struct sensor_sample *sample)
+{
+    char sht30[64], bh1750[64], text[128];
+
+    sample_format(sample, sht30, sizeof(sht30), bh1750, sizeof(bh1750));
+    snprintf(text, sizeof(text), "%s-%s", sht30, bh1750);
+    return log_sensor_data_at(text, (time_t)(sample->t_ms / 1000));
+}
+
+/*********************************
+ * PUBLIC API
+ *********************************/
+
+void logger_default_config(struct logger_config *cfg)
+{
+    cfg->log_dir = LOG_DIR;
+    cfg->mode = LOGGER_MODE_APPEND;
+    cfg->page_size = DEFAULT_PAGE_SIZE;
+    cfg->flush_sec = DEFAULT_FLUSH_SEC;
+    cfg->prealloc_bytes = DEFAULT_PREALLOC;
+    cfg->framed = 1;
+    cfg->deadband = NULL;
+    cfg->heartbeat_sec = DEFAULT_HEARTBEAT;
+    cfg->resume = NULL;
+    cfg->sketches = 1;
+}
+
+void logger_get_stats(struct logger_stats *out)
+{
+    *out = stats;
+}
+
+void logger_get_cursor(struct logger_cursor *out)
+{
+    struct stat st;
+
+    memset(out, 0, sizeof(*out));
+    out->retention_day = retention_day;
+    if (seq_path[0] == '\0') {
+        return;
+    }
+    snprintf(out->path, sizeof(out->path), "%s", seq_path);
+    out->seq = log_seq;
+
+    if (flash.fd >= 0 && strcmp(flash.path, seq_path) == 0) {
+        out->offset = (uint64_t)flash.stage_off + flash.stage_len;
+        return;
+    }
+    ring_reap();
+    if (stat(seq_path, &st) == 0) {
+        out->offset = (uint64_t)st.st_size;
+    }
+}
+
+int logger_is_log_file(const struct dirent *entry)
+{
+    return strncmp(entry->d_name, "sensor_data_", 12) == 0;
+}
+
+void logger_data_range(const char *data, size_t size, const char **start, const char **end)
+{
+    size_t page_size;
+    unsigned long long data_end;
+
+    *start = data;
+    *end = data + size;
+    if (parse_header(data, size, &page_size, &data_end) == 0) {
+        *end = data_end < size ? data + data_end : data + size;
+        *start = page_size < (size_t)(*end - data) ? data + page_size : *end;
+    }
+}
+
+void logger_close(void)
+{
+    if (held_pending) {
+        held_pending = 0;
+        write_sample(&held);
+    }
+    ring_close();
+    flash_close();
+    free(flash.stage);
+    flash.stage = NULL;
+    if (config.sketches) {
+        sketch_writer_flush(&sketch);
+    }
+}
+
 // Khoi tao logger
 int logger_init(void)
 {
+    struct logger_config cfg;
+
+    logger_default_config(&cfg);
+    return logger_init_with(&cfg);
+}
+
+int logger_init_with(const struct logger_config *cfg)
+{
+    config = *cfg;
+    log_clock = time(NULL);
+
     printf("=== Initializing Logger ===\n");
+
+    if (config.mode == LOGGER_MODE_FLASH) {
+        if (config.page_size < 512 || (config.page_size & (config.page_size - 1)) != 0) {
+            fprintf(stderr, "Log page size must be a power of two >= 512\n");
+            return -1;
+        }
+        if (posix_memalign((void **)&flash.stage, config.page_size, config.page_size) != 0) {
+            fprintf(stderr, "Failed to allocate log page buffer\n");
+            return -1;
+        }
+    }
     
     // Tao thu muc log
     if (create_log_directory() != 0) {
         return -1;
     }
     
-    // Xoa log cu hon 7 ngay
-    cleanup_old_logs(MAX_LOG_AGE_DAYS);
+    // Xoa log cu hon 7 ngay (checkpoint: da chay hom nay thi thoi)
+    if (config.resume && config.resume->retention_day == day_start(log_clock)) {
+        retention_day = (time_t)config.resume->retention_day;
+    } else {
+        cleanup_old_logs(MAX_LOG_AGE_DAYS);
+    }
     
     // Hien thi ten file log hien tai
     char current_log[256];
-    get_daily_log_filename(current_log, sizeof(current_log));
+    get_daily_log_filename(current_log, sizeof(current_log), log_clock);
     printf("Current log file: %s\n", current_log);
+    switch_log_file(current_log);
+    config.resume = NULL;       // chi dung luc khoi dong
+    if (config.mode == LOGGER_MODE_FLASH) {
+        printf("Log mode: flash (page %zu bytes, flush every %u s, prealloc %zu bytes)\n",
+               config.page_size, config.flush_sec, config.prealloc_bytes);
+    }
+    if (config.deadband) {
+        deadband_init(&deadband, config.deadband, config.heartbeat_sec);
+        held_pending = 0;
+        printf("Log deadband: on (heartbeat %u s)\n", config.heartbeat_sec);
+    }
+    if (config.sketches) {
+        sketch_writer_init(&sketch, config.log_dir);
+        printf("Log sketches: on (p0..p100 +-%.1f %%)\n", SKETCH_ALPHA * 100);
+    }
     printf("Log retention: %d days\n\n", MAX_LOG_AGE_DAYS);
     
     return 0;
@@ -150,40 +800,97 @@ int logger_init(void)
 // Ghi log du lieu sensor - Nhan raw string "xxx-yyy-zzz"
 int log_sensor_data(const char *sensor_data)
 {
-    // Lay ten file log theo ngay hien tai
+    return log_sensor_data_at(sensor_data, time(NULL));
+}
+
+int log_sensor_sample(const struct sensor_sample *sample)
+{
+    stats.samples++;
+
+    // Sketch thay moi mau, ke ca mau deadband khong ghi
+    if (config.sketches) {
+        sketch_writer_add(&sketch, sample);
+    }
+
+    if (config.deadband) {
+        char log_filename[256];
+
+        // Moi file ngay bat dau bang mot record day du
+        get_daily_log_filename(log_filename, sizeof(log_filename), (time_t)(sample->t_ms / 1000));
+        if (strcmp(seq_path, log_filename) != 0) {
+            deadband.have_last = 0;
+        }
+        if (!deadband_check(&deadband, sample)) {
+            held = *sample;
+            held_pending = 1;
+            stats.deadband_skipped++;
+            return 0;
+        }
+        held_pending = 0;
+    }
+
+    return write_sample(sample);
+}
+
+int log_sensor_data_at(const char *sensor_data, time_t when)
+{
+    log_clock = when;
+
+    // Lay ten file log theo ngay cua mau
     char log_filename[256];
-    get_daily_log_filename(log_filename, sizeof(log_filename));
-    
-    // Mo file voi O_CREAT | O_APPEND
-    int fd = open(log_filename, O_WRONLY | O_CREAT | O_APPEND, 0644);
-    if (fd < 0) {
-        perror("open log file");
-        return -1;
+    get_daily_log_filename(log_filename, sizeof(log_filename), when);
+
+    if (strcmp(seq_path, log_filename) != 0) {
+        if (config.mode == LOGGER_MODE_FLASH) {
+            flash_close();
+        }
+        // Sang ngay moi: chay lai retention (chuong trinh chay lien tuc nhieu ngay)
+        if (seq_path[0] != '\0') {
+            cleanup_logs_before(when, MAX_LOG_AGE_DAYS);
+        }
+        switch_log_file(log_filename);
+    }
+
+    int use_flash = 0;
+    if (config.mode == LOGGER_MODE_FLASH) {
+        // Sang ngay moi: dong file cu, mo file moi
+        if (strcmp(flash.path, log_filename) != 0) {
+            flash_close();
+            flash_open(log_filename);
+        }
+        use_flash = flash.fd >= 0;
     }
 
     char timestamp[64];
-    get_timestamp(timestamp, sizeof(timestamp));
+    get_timestamp(timestamp, sizeof(timestamp), when);
 
-    // Format: timestamp,sensor_data
-    // Vi du: "2025-11-23 14:30:00,Temp:25.5 Hum:60.2-Lux:1250"
-    char log_buffer[512];
-    int len = snprintf(log_buffer, sizeof(log_buffer), "%s,%s\n", 
-                      timestamp, sensor_data);
+    // Format: timestamp,sensor_data[,seq,len,crc]
+    // Vi du: "2025-11-23 14:30:00,25.5-60.2-1250.0,42,36,1c2d3e4f"
+    char log_buffer[RECORD_MAX_LEN];
+    int len;
+    if (config.framed) {
+        len = record_format(log_buffer, sizeof(log_buffer), timestamp, sensor_data, log_seq + 1);
+    } else {
+        len = snprintf(log_buffer, sizeof(log_buffer), "%s,%s\n", timestamp, sensor_data);
+    }
 
-    if (len >= (int)sizeof(log_buffer)) {
+    if (len < 0 || len >= (int)sizeof(log_buffer)) {
         fprintf(stderr, "log_buffer overflow\n");
-        close(fd);
         return -1;
     }
+    log_seq++;
 
-    // Ghi vao file
-    ssize_t written = write(fd, log_buffer, len);
-    close(fd);
+    stats.record_bytes += len;
 
-    if (written != len) {
-        perror("write log file");
-        return -1;
+    int ret;
+    PROF_BEGIN(PROF_WRITE, write);
+    if (use_flash) {
+        ret = flash_append(log_buffer, len);
+    } else if (ioring_active()) {
+        ret = ring_append(log_filename, log_buffer, len);
+    } else {
+        ret = append_record(log_filename, log_buffer, len);
     }
-
-    return 0;
+    PROF_END(PROF_WRITE, write);
+    return ret;
 }
\ No newline at end of file
@@ -0,0 +1,219 @@
+#include "prof.h"
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#define PROF_NODES  64
+#define PROF_DEPTH  8
+
+static const char *const stage_names[PROF_STAGES] = {
+    [PROF_CYCLE]     = "cycle",
+    [PROF_DISPLAY]   = "display",
+    [PROF_READ]      = "read",
+    [PROF_FORMAT]    = "format",
+    [PROF_OLED]      = "oled",
+    [PROF_LOG]       = "log",
+    [PROF_FILENAME]  = "filename",
+    [PROF_TIMESTAMP] = "timestamp",
+    [PROF_WRITE]     = "write",
+    [PROF_SUBMIT]    = "submit",
+    [PROF_CAPTURE]   = "capture",
+    [PROF_HISTORY]   = "history",
+    [PROF_ALERT]     = "alert",
+    [PROF_UPLINK]    = "uplink",
+    [PROF_CONSOLE]   = "console",
+    [PROF_CHECKPOINT] = "checkpoint",
+    [PROF_SLEEP]     = "sleep",
+};
+
+int prof_enabled;
+
+// Mot nut cua cay stage: cung stage duoi parent khac la nut khac
+static struct {
+    int parent;                 // -1 = goc
+    enum prof_stage stage;
+    uint64_t calls;
+    uint64_t wall_ns;           // gom ca stage con
+    uint64_t cpu_ns;
+} nodes[PROF_NODES];
+static int node_count;
+
+static struct {
+    int node;
+    uint64_t wall0, cpu0;
+} stack[PROF_DEPTH];
+static int depth;
+static unsigned int overflow;   // begin khong vao duoc stack (qua sau / het nut)
+
+static uint64_t started_ns;
+
+/*********************************
+ * HELPERS
+ *********************************/
+
+static uint64_t clock_ns(clockid_t clk)
+{
+    struct timespec ts;
+    clock_gettime(clk, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int find_node(int parent, enum prof_stage stage)
+{
+    for (int i = 0; i < node_count; i++) {
+        if (nodes[i].parent == parent && nodes[i].stage == stage) {
+            return i;
+        }
+    }
+    if (node_count == PROF_NODES) {
+        return -1;
+    }
+    nodes[node_count].parent = parent;
+    nodes[node_count].stage = stage;
+    return node_count++;
+}
+
+// Thoi gian rieng cua nut = tong - cac nut con
+static uint64_t self_ns(int node, int cpu)
+{
+    uint64_t total = cpu ? nodes[node].cpu_ns : nodes[node].wall_ns;
+    uint64_t children = 0;
+
+    for (int i = node + 1; i < node_count; i++) {
+        if (nodes[i].parent == node) {
+            children += cpu ? nodes[i].cpu_ns : nodes[i].wall_ns;
+        }
+    }
+    return children < total ? total - children : 0;
+}
+
+// "cycle;log;write"
+static size_t node_path(int node, char *buf, size_t size)
+{
+    size_t len = 0;
+
+    if (nodes[node].parent >= 0) {
+        len = node_path(nodes[node].parent, buf, size);
+        if (len + 1 < size) {
+            buf[len++] = ';';
+            buf[len] = '\0';
+        }
+    }
+    int n = snprintf(buf + len, size - len, "%s", stage_names[nodes[node].stage]);
+    len += n > 0 ? (size_t)n : 0;
+    return len < size ? len : size - 1;
+}
+
+// Nut goc: % cua ca lan chay; nut con: % cua nut goc cua no
+static void print_tree(FILE *out, int parent, int level, uint64_t base_ns)
+{
+    for (int i = 0; i < node_count; i++) {
+        if (nodes[i].parent != parent) {
+            continue;
+        }
+
+        char name[40];
+        uint64_t calls = nodes[i].calls ? nodes[i].calls : 1;
+
+        snprintf(name, sizeof(name), "%*s%s", level * 2, "", stage_names[nodes[i].stage]);
+        fprintf(out, "  %-18s %10llu %11.3f %12.2f %11.3f %10.2f %6.1f%%\n", name,
+                (unsigned long long)nodes[i].calls, nodes[i].wall_ns / 1e6,
+                nodes[i].wall_ns / 1e3 / calls, nodes[i].cpu_ns / 1e6,
+                nodes[i].cpu_ns / 1e3 / calls,
+                base_ns ? 100.0 * nodes[i].wall_ns / base_ns : 0.0);
+        print_tree(out, i, level + 1, parent < 0 ? nodes[i].wall_ns : base_ns);
+    }
+}
+
+/*********************************
+ * PUBLIC API
+ *********************************/
+
+void prof_enable(void)
+{
+    started_ns = clock_ns(CLOCK_MONOTONIC);
+    prof_enabled = 1;
+}
+
+void prof_begin(enum prof_stage stage)
+{
+    int node = depth < PROF_DEPTH ? find_node(depth ? stack[depth - 1].node : -1, stage) : -1;
+
+    if (node < 0) {
+        overflow++;
+        return;
+    }
+    stack[depth].node = node;
+    stack[depth].wall0 = clock_ns(CLOCK_MONOTONIC);
+    stack[depth].cpu0 = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+    depth++;
+}
+
+void prof_end(enum prof_stage stage)
+{
+    uint64_t cpu = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+    uint64_t wall = clock_ns(CLOCK_MONOTONIC);
+
+    if (overflow > 0) {
+        overflow--;
+        return;
+    }
+
+    // Bo cac stage con khong co PROF_END (vd. return som) de giu stack dung
+    int d = depth;
+    while (d > 0 && nodes[stack[d - 1].node].stage != stage) {
+        d--;
+    }
+    if (d == 0) {
+        return;
+    }
+    depth = d - 1;
+
+    int node = stack[depth].node;
+    nodes[node].calls++;
+    nodes[node].wall_ns += wall - stack[depth].wall0;
+    nodes[node].cpu_ns += cpu - stack[depth].cpu0;
+}
+
+int prof_parse_output(const char *name, enum prof_output *out)
+{
+    static const char *const names[] = { "summary", "folded", "folded-cpu" };
+
+    for (unsigned int i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcmp(name, names[i]) == 0) {
+            *out = (enum prof_output)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void prof_report(FILE *out, enum prof_output format)
+{
+    if (format != PROF_OUT_SUMMARY) {
+        // Folded stacks: mot dong moi nut, gia tri = thoi gian rieng (us)
+        for (int i = 0; i < node_count; i++) {
+            uint64_t us = self_ns(i, format == PROF_OUT_FOLDED_CPU) / 1000;
+            char path[PROF_DEPTH * 12];
+
+            if (us > 0) {
+                node_path(i, path, sizeof(path));
+                fprintf(out, "%s %llu\n", path, (unsigned long long)us);
+            }
+        }
+        return;
+    }
+
+    uint64_t elapsed = clock_ns(CLOCK_MONOTONIC) - started_ns;
+    uint64_t total = 0;
+    for (int i = 0; i < node_count; i++) {
+        if (nodes[i].parent < 0) {
+            total += nodes[i].wall_ns;
+        }
+    }
+
+    fprintf(out, "\nProfile: %.3f s run, %.3f s in stages\n", elapsed / 1e9, total / 1e9);
+    fprintf(out, "  %-18s %10s %11s %12s %11s %10s %7s\n", "stage", "calls", "wall ms",
+            "wall us", "cpu ms", "cpu us", "share");
+    print_tree(out, -1, 0, elapsed);
+}
@@ -0,0 +1,149 @@
+#include "record.h"
+#include "crc32c.h"
+#include <stdio.h>
+#include <string.h>
+
+#define CRC_FIELD_LEN 9     // 8 hex digits + '\n'
+
+int record_format(char *out, size_t size, const char *timestamp,
+                  const char *data, uint32_t seq)
+{
+    int head = snprintf(out, size, "%s,%s,%u,", timestamp, data, seq);
+    if (head < 0 || (size_t)head >= size) {
+        return -1;
+    }
+
+    int len = head + snprintf(out + head, size - head, "%d,", head);
+    if ((size_t)len + CRC_FIELD_LEN >= size) {
+        return -1;
+    }
+
+    uint32_t crc = crc32c(0, out, len);
+    len += snprintf(out + len, size - len, "%08x\n", crc);
+    return len;
+}
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+/*
+ * Parse the "<len>,<crc>\n" tail of a line ending at end (one past '\n').
+ * Returns the record's start offset relative to end (negative), or 0 if
+ * the tail is malformed.
+ */
+static ssize_t parse_tail(const char *buf, size_t end, uint32_t *crc, size_t *crc_start)
+{
+    uint32_t value = 0;
+    size_t pos, len = 0, scale = 1;
+
+    if (end < CRC_FIELD_LEN + 2 || buf[end - 1] != '\n') {
+        return 0;
+    }
+
+    pos = end - CRC_FIELD_LEN;
+    for (int i = 0; i < 8; i++) {
+        int h = hex_value(buf[pos + i]);
+        if (h < 0) {
+            return 0;
+        }
+        value = value << 4 | (uint32_t)h;
+    }
+    if (buf[--pos] != ',') {
+        return 0;
+    }
+    *crc_start = pos + 1;
+
+    // <len> digits, read right to left
+    while (pos > 0 && buf[pos - 1] >= '0' && buf[pos - 1] <= '9' && scale <= 1000) {
+        len += (size_t)(buf[--pos] - '0') * scale;
+        scale *= 10;
+    }
+    if (scale == 1 || len > pos || len > RECORD_MAX_LEN) {
+        return 0;
+    }
+
+    *crc = value;
+    return -(ssize_t)(end - (pos - len));
+}
+
+int record_parse(const char *line, size_t len, struct record_view *view)
+{
+    uint32_t crc;
+    size_t crc_start;
+    ssize_t back = parse_tail(line, len, &crc, &crc_start);
+
+    // The record must span exactly the whole line
+    if (back == 0 || (size_t)-back != len) {
+        return -1;
+    }
+    if (crc32c(0, line, crc_start) != crc) {
+        return -1;
+    }
+
+    // "<timestamp>,<data>,<seq>,": timestamp has no comma, seq is last
+    const char *comma = memchr(line, ',', len);
+    const char *head_end = line + crc_start;
+    const char *p = head_end - 1;               // ',' after <len>
+    while (p > line && p[-1] != ',') p--;       // start of <len>
+    const char *seq_end = p - 1;                // ',' after <seq>
+    const char *q = seq_end;
+    while (q > line && q[-1] != ',') q--;       // start of <seq>
+    if (!comma || comma >= q - 1) {
+        return -1;
+    }
+
+    if (view) {
+        unsigned long seq = 0;
+        for (const char *d = q; d < seq_end; d++) {
+            if (*d < '0' || *d > '9') return -1;
+            seq = seq * 10 + (unsigned long)(*d - '0');
+        }
+        view->timestamp = line;
+        view->timestamp_len = (size_t)(comma - line);
+        view->data = comma + 1;
+        view->data_len = (size_t)(q - 1 - (comma + 1));
+        view->seq = (uint32_t)seq;
+    }
+    return 0;
+}
+
+ssize_t record_scan_back(const char *buf, size_t len, uint32_t *seq)
+{
+    size_t end = len;
+
+    // Ignore a torn record (no trailing '\n') at the very end
+    while (end > 0 && buf[end - 1] != '\n') {
+        end--;
+    }
+
+    while (end > 0) {
+        uint32_t crc;
+        size_t crc_start;
+        ssize_t back = parse_tail(buf, end, &crc, &crc_start);
+        struct record_view view;
+
+        if (back != 0) {
+            size_t start = end + back;
+
+            // Jump by <len>; the record must start a line
+            if ((start == 0 || buf[start - 1] == '\n' || buf[start - 1] == '\0') &&
+                record_parse(buf + start, end - start, &view) == 0) {
+                if (seq) {
+                    *seq = view.seq;
+                }
+                return (ssize_t)end;
+            }
+        }
+
+        // Not a valid record: step back to the previous line end
+        end--;
+        while (end > 0 && buf[end - 1] != '\n') {
+            end--;
+        }
+    }
+    return -1;
+}
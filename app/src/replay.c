@@ -0,0 +1,600 @@
+#include "replay.h"
+#include "display_data.h"
+#include "logger.h"
+#include "record.h"
+#include "alert.h"
+#include "filter.h"
+#include "uplink.h"
+#include "history.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define CAPTURE_HEAD_LEN 10     // uint64_t unix_ms + uint16_t len
+#define REPLAY_BATCH     4096    // so mau parse truoc khi loc va day qua pipeline
+
+enum replay_stage {
+    STAGE_PARSE, STAGE_FILTER, STAGE_DISPLAY, STAGE_ALERT, STAGE_UPLINK, STAGE_HISTORY, STAGE_LOG,
+    STAGE_COUNT
+};
+
+static const char *const stage_names[STAGE_COUNT] = {
+    "parse", "filter", "display", "alert", "uplink", "history", "log"
+};
+
+// Trang thai mot lan replay
+static struct {
+    const struct replay_config *cfg;
+    volatile sig_atomic_t *running;
+    int oled;
+    uint64_t stage_ns[STAGE_COUNT];
+    uint64_t samples;
+    uint64_t skipped;           // dong hong / CRC sai / sai format
+    uint64_t log_errors;
+    uint64_t alerts;            // so alert event (raise + clear)
+    uint64_t filled;            // mau tao lai tu gia tri giu (--replay-fill)
+    uint64_t bytes;             // so byte input da doc
+    unsigned int files;
+    int64_t first_ms, last_ms;  // thoi gian cua mau dau / cuoi
+    uint64_t start_ns;          // CLOCK_MONOTONIC luc replay mau dau
+    char hour_key[13];          // "YYYY-MM-DD HH" da mktime()
+    time_t hour_base;
+    struct filter filters[SAMPLE_CHANNELS];
+    struct sensor_sample prev;  // mau truoc (--replay-fill)
+    int have_prev;
+} rp;
+
+// Mau da parse, dang SoA de loc ca batch mot luc
+static struct {
+    int64_t t_ms[REPLAY_BATCH];
+    int32_t value[SAMPLE_CHANNELS][REPLAY_BATCH];
+    uint32_t valid[REPLAY_BATCH];
+    unsigned int count;
+} batch;
+
+static FILE *capture;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int parse_digits(const char *s, int count)
+{
+    int value = 0;
+    for (int i = 0; i < count; i++) {
+        if (s[i] < '0' || s[i] > '9') {
+            return -1;
+        }
+        value = value * 10 + s[i] - '0';
+    }
+    return value;
+}
+
+// "YYYY-MM-DD HH:MM:SS" (gio dia phuong) -> unix time; mktime() moi gio mot lan
+static int parse_timestamp(const char *s, size_t len, time_t *out)
+{
+    if (len != 19 || s[4] != '-' || s[7] != '-' || s[10] != ' ' || s[13] != ':' || s[16] != ':') {
+        return -1;
+    }
+
+    int min = parse_digits(s + 14, 2);
+    int sec = parse_digits(s + 17, 2);
+    if (min < 0 || sec < 0) {
+        return -1;
+    }
+
+    if (memcmp(rp.hour_key, s, sizeof(rp.hour_key)) != 0) {
+        struct tm tm = {0};
+        tm.tm_year = parse_digits(s, 4) - 1900;
+        tm.tm_mon = parse_digits(s + 5, 2) - 1;
+        tm.tm_mday = parse_digits(s + 8, 2);
+        tm.tm_hour = parse_digits(s + 11, 2);
+        tm.tm_isdst = -1;
+        if (tm.tm_year < 0 || tm.tm_mon < 0 || tm.tm_mday < 0 || tm.tm_hour < 0) {
+            return -1;
+        }
+        rp.hour_base = mktime(&tm);
+        memcpy(rp.hour_key, s, sizeof(rp.hour_key));
+    }
+
+    *out = rp.hour_base + min * 60 + sec;
+    return 0;
+}
+
+// Cho den thoi diem cua mau theo toc do replay
+static void pace(int64_t unix_ms)
+{
+    if (unix_ms <= rp.first_ms) {
+        return;
+    }
+
+    uint64_t due = rp.start_ns + (uint64_t)((unix_ms - rp.first_ms) * 1e6 / rp.cfg->speed);
+    struct timespec ts = { .tv_sec = due / 1000000000ULL, .tv_nsec = due % 1000000000ULL };
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR && *rp.running) {
+    }
+}
+
+// Loc tung channel cua batch; mau "ERROR" cua channel do duoc bo qua
+static void filter_batch_channels(void)
+{
+    static int64_t t_ms[REPLAY_BATCH];
+    static int32_t values[REPLAY_BATCH];
+
+    uint32_t all_valid = ~0u;
+
+    for (unsigned int i = 0; i < batch.count; i++) {
+        all_valid &= batch.valid[i];
+    }
+
+    for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+        unsigned int n = 0;
+
+        if (all_valid & (1u << c)) {
+            filter_batch(&rp.filters[c], batch.value[c], batch.t_ms, batch.value[c], batch.count);
+            continue;
+        }
+
+        for (unsigned int i = 0; i < batch.count; i++) {
+            if (batch.valid[i] & (1u << c)) {
+                t_ms[n] = batch.t_ms[i];
+                values[n++] = batch.value[c][i];
+            }
+        }
+        filter_batch(&rp.filters[c], values, t_ms, values, n);
+        n = 0;
+        for (unsigned int i = 0; i < batch.count; i++) {
+            if (batch.valid[i] & (1u << c)) {
+                batch.value[c][i] = values[n++];
+            }
+        }
+    }
+}
+
+/*
+ * Dua batch qua pipeline: filter -> display -> alert -> uplink -> history -> log
+ * (retention chay trong logger khi sang ngay moi; uplink_push / history_push
+ * bo qua neu chua start).
+ */
+static void replay_flush(void)
+{
+    uint64_t t1 = now_ns();
+
+    if (rp.cfg->filters) {
+        filter_batch_channels();
+    }
+    rp.stage_ns[STAGE_FILTER] += now_ns() - t1;
+
+    for (unsigned int i = 0; i < batch.count && *rp.running; i++) {
+        struct sensor_sample sample = { .t_ms = batch.t_ms[i], .valid = batch.valid[i] };
+        char sht30[64], bh1750[64];
+
+        for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+            sample.value[c] = batch.value[c][i];
+        }
+
+        t1 = now_ns();
+        if (rp.samples == 0) {
+            rp.first_ms = sample.t_ms;
+            rp.start_ns = t1;
+        } else if (rp.cfg->speed > 0) {
+            pace(sample.t_ms);
+            t1 = now_ns();
+        }
+
+        sample_format(&sample, sht30, sizeof(sht30), bh1750, sizeof(bh1750));
+        const char *text = display_compose(sht30, bh1750);
+        if (rp.oled && write_oled(text) != 0) {
+            rp.oled = 0;
+        }
+        uint64_t t2 = now_ns();
+        rp.stage_ns[STAGE_DISPLAY] += t2 - t1;
+
+        if (alert_rule_count() > 0) {
+            rp.alerts += alert_eval(&sample);
+        }
+        uint64_t t3 = now_ns();
+        rp.stage_ns[STAGE_ALERT] += t3 - t2;
+
+        uplink_push(&sample);
+        t2 = t3;
+        t3 = now_ns();
+        rp.stage_ns[STAGE_UPLINK] += t3 - t2;
+
+        history_push(&sample);
+        t2 = t3;
+        t3 = now_ns();
+        rp.stage_ns[STAGE_HISTORY] += t3 - t2;
+
+        if (log_sensor_sample(&sample) != 0) {
+            rp.log_errors++;
+        }
+        rp.stage_ns[STAGE_LOG] += now_ns() - t3;
+
+        rp.samples++;
+        rp.last_ms = sample.t_ms;
+    }
+    batch.count = 0;
+}
+
+static void batch_add(const struct sensor_sample *sample)
+{
+    unsigned int i = batch.count++;
+
+    batch.t_ms[i] = sample->t_ms;
+    batch.valid[i] = sample->valid;
+    for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+        batch.value[c][i] = sample->value[c];
+    }
+    if (batch.count == REPLAY_BATCH) {
+        replay_flush();
+    }
+}
+
+/*
+ * Log ghi theo deadband chi co record khi gia tri doi: lap lai mau truoc
+ * moi fill_sec cho den mau nay (ham bac thang). Khoang trong dai hon
+ * fill_max_sec la mat du lieu, khong lap.
+ */
+static void fill_gap(int64_t until_ms)
+{
+    int64_t step = (int64_t)rp.cfg->fill_sec * 1000;
+    struct sensor_sample held = rp.prev;
+
+    if (until_ms - rp.prev.t_ms > (int64_t)rp.cfg->fill_max_sec * 1000) {
+        return;
+    }
+    for (held.t_ms += step; held.t_ms < until_ms - step / 2 && *rp.running; held.t_ms += step) {
+        batch_add(&held);
+        rp.filled++;
+    }
+}
+
+// Parse text "t.t-h.h-l.l" cua mot mau vao batch; t0 la luc bat dau parse
+static void replay_sample(int64_t unix_ms, const char *data, size_t len, uint64_t t0)
+{
+    char text[RECORD_MAX_LEN];
+    struct sensor_sample sample;
+
+    if (len >= sizeof(text)) {
+        rp.skipped++;
+        return;
+    }
+    memcpy(text, data, len);
+    text[len] = '\0';
+
+    if (sample_parse(text, unix_ms, &sample) != 0) {
+        rp.skipped++;
+        return;
+    }
+
+    rp.stage_ns[STAGE_PARSE] += now_ns() - t0;
+
+    if (rp.cfg->fill_sec > 0 && rp.have_prev) {
+        fill_gap(sample.t_ms);
+    }
+    rp.prev = sample;
+    rp.have_prev = 1;
+    batch_add(&sample);
+}
+
+// Log dang text: "<timestamp>,<data>\n" hoac record co seq,len,crc
+static void replay_text(const char *p, const char *end)
+{
+    while (p < end && *rp.running) {
+        uint64_t t0 = now_ns();
+        const char *nl = memchr(p, '\n', end - p);
+        if (!nl) {
+            rp.skipped++;       // dong cuoi bi ghi do
+            break;
+        }
+
+        const char *line = p;
+        size_t len = nl - line + 1;
+        p = nl + 1;
+        rp.bytes += len;
+
+        const char *comma = memchr(line, ',', len);
+        if (!comma) {
+            if (len > 1) {
+                rp.skipped++;
+            }
+            continue;
+        }
+
+        const char *ts = line;
+        size_t ts_len = comma - line;
+        const char *data = comma + 1;
+        size_t data_len = nl - data;
+        if (data_len > 0 && data[data_len - 1] == '\r') {
+            data_len--;
+        }
+
+        if (memchr(data, ',', data_len)) {
+            struct record_view view;
+            if (record_parse(line, len, &view) != 0) {
+                rp.skipped++;
+                continue;
+            }
+            ts = view.timestamp;
+            ts_len = view.timestamp_len;
+            data = view.data;
+            data_len = view.data_len;
+        }
+
+        time_t when;
+        if (parse_timestamp(ts, ts_len, &when) != 0) {
+            rp.skipped++;
+            continue;
+        }
+        replay_sample((int64_t)when * 1000, data, data_len, t0);
+    }
+}
+
+// Binary capture (xem replay.h)
+static void replay_capture(const unsigned char *p, const unsigned char *end)
+{
+    p += strlen(REPLAY_CAPTURE_MAGIC);
+
+    while (end - p >= CAPTURE_HEAD_LEN && *rp.running) {
+        uint64_t t0 = now_ns();
+        uint64_t unix_ms = 0;
+        for (int i = 7; i >= 0; i--) {
+            unix_ms = unix_ms << 8 | p[i];
+        }
+        size_t len = p[8] | (size_t)p[9] << 8;
+        if ((size_t)(end - p - CAPTURE_HEAD_LEN) < len) {
+            break;
+        }
+
+        rp.bytes += CAPTURE_HEAD_LEN + len;
+        replay_sample((int64_t)unix_ms, (const char *)p + CAPTURE_HEAD_LEN, len, t0);
+        p += CAPTURE_HEAD_LEN + len;
+    }
+
+    if (p != end && *rp.running) {
+        rp.skipped++;           // mau cuoi bi ghi do
+    }
+}
+
+static int replay_file(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        rp.files++;
+        return 0;
+    }
+
+    size_t size = st.st_size;
+    const char *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "mmap %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    madvise((void *)map, size, MADV_SEQUENTIAL);
+
+    size_t magic_len = strlen(REPLAY_CAPTURE_MAGIC);
+    if (size >= magic_len && memcmp(map, REPLAY_CAPTURE_MAGIC, magic_len) == 0) {
+        replay_capture((const unsigned char *)map, (const unsigned char *)map + size);
+    } else {
+        // File LOGGER_MODE_FLASH: chi doc [page, end)
+        const char *start, *end;
+
+        logger_data_range(map, size, &start, &end);
+        replay_text(start, end);
+    }
+    replay_flush();
+
+    munmap((void *)map, size);
+    rp.files++;
+    return 0;
+}
+
+// File, hoac thu muc chua sensor_data_*.log (theo thu tu ngay)
+static int replay_path(const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        fprintf(stderr, "stat %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        return replay_file(path);
+    }
+
+    struct dirent **list;
+    int count = scandir(path, &list, logger_is_log_file, alphasort);
+    if (count < 0) {
+        fprintf(stderr, "scandir %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    int ret = 0;
+    for (int i = 0; i < count; i++) {
+        char file[PATH_MAX];
+        snprintf(file, sizeof(file), "%s/%s", path, list[i]->d_name);
+        if (*rp.running && replay_file(file) != 0) {
+            ret = -1;
+        }
+        free(list[i]);
+    }
+    free(list);
+    return ret;
+}
+
+// Input nam trong thu muc log output se bi ghi de trong luc dang doc
+static int is_output_dir(const char *log_dir, const char *path)
+{
+    char input[PATH_MAX], output[PATH_MAX];
+    struct stat st;
+
+    if (!realpath(log_dir, output) || !realpath(path, input)) {
+        return 0;
+    }
+    if (stat(input, &st) == 0 && !S_ISDIR(st.st_mode)) {
+        char *slash = strrchr(input, '/');
+        if (slash) {
+            slash[slash == input] = '\0';
+        }
+    }
+    return strcmp(input, output) == 0;
+}
+
+static void replay_report(uint64_t wall_ns, const struct logger_stats *before,
+                          const struct logger_stats *after)
+{
+    double wall = wall_ns / 1e9;
+    uint64_t retention_ns = after->retention_ns - before->retention_ns;
+    uint64_t samples = rp.samples;
+
+    printf("\n=== Replay ===\n");
+    printf("Samples: %llu from %u file(s), %llu skipped, %llu log error(s), %llu alert event(s)\n",
+           (unsigned long long)rp.samples, rp.files, (unsigned long long)rp.skipped,
+           (unsigned long long)rp.log_errors, (unsigned long long)rp.alerts);
+    if (samples == 0) {
+        return;
+    }
+    if (rp.filled > 0) {
+        printf("Filled: %llu held sample(s) rebuilt from the step-function log\n",
+               (unsigned long long)rp.filled);
+    }
+    printf("Wall time: %.3f s, %.0f samples/s, %.2f MiB/s input\n",
+           wall, rp.samples / wall, rp.bytes / wall / (1024 * 1024));
+    if (rp.samples > 1) {
+        double span = (rp.last_ms - rp.first_ms) / 1e3;
+        printf("Data span: %.2f days (x%.0f real time)\n", span / 86400, span / wall);
+    }
+
+    printf("%-10s %12s %12s\n", "stage", "total ms", "ns/sample");
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        uint64_t ns = rp.stage_ns[i];
+        if (i == STAGE_LOG) {
+            ns -= retention_ns < ns ? retention_ns : ns;
+        }
+        printf("%-10s %12.3f %12.0f\n", stage_names[i], ns / 1e6, (double)ns / samples);
+    }
+    printf("%-10s %12.3f %12.0f  (%llu run(s))\n", "retention", retention_ns / 1e6,
+           (double)retention_ns / samples,
+           (unsigned long long)(after->retention_runs - before->retention_runs));
+    if (rp.cfg->filters) {
+        printf("Rejected by rate limit:");
+        for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+            printf(" %s %llu", sample_channel_names[c], (unsigned long long)rp.filters[c].rejected);
+        }
+        printf("\n");
+    }
+}
+
+int replay_check_inputs(const struct replay_config *cfg, char *const inputs[], int count)
+{
+    for (int i = 0; i < count; i++) {
+        if (is_output_dir(cfg->log_dir, inputs[i])) {
+            fprintf(stderr, "Replay input %s is in the output log dir %s\n",
+                    inputs[i], cfg->log_dir);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int replay_run(const struct replay_config *cfg, char *const inputs[], int count,
+               volatile sig_atomic_t *running)
+{
+    struct logger_stats before, after;
+    int failed = 0;
+
+    memset(&rp, 0, sizeof(rp));
+    rp.cfg = cfg;
+    rp.running = running;
+    rp.oled = cfg->oled;
+    batch.count = 0;
+    for (int c = 0; c < SAMPLE_CHANNELS && cfg->filters; c++) {
+        filter_init(&rp.filters[c], &cfg->filters[c]);
+    }
+
+    logger_get_stats(&before);
+    uint64_t start = now_ns();
+
+    for (int i = 0; i < count && *running; i++) {
+        if (replay_path(inputs[i]) != 0) {
+            failed++;
+        }
+    }
+
+    uint64_t wall_ns = now_ns() - start;
+    logger_get_stats(&after);
+    replay_report(wall_ns, &before, &after);
+
+    return failed == count ? -1 : 0;
+}
+
+/*********************************
+ * BINARY CAPTURE
+ *********************************/
+
+int capture_open(const char *path)
+{
+    capture = fopen(path, "ab");
+    if (!capture) {
+        perror("open capture file");
+        return -1;
+    }
+
+    fseek(capture, 0, SEEK_END);
+    if (ftell(capture) == 0) {
+        fputs(REPLAY_CAPTURE_MAGIC, capture);
+    }
+    return 0;
+}
+
+int capture_write(int64_t unix_ms, const char *data)
+{
+    unsigned char head[CAPTURE_HEAD_LEN];
+    size_t len = strlen(data);
+
+    if (!capture) {
+        return -1;
+    }
+    if (len > 0xffff) {
+        len = 0xffff;
+    }
+
+    for (int i = 0; i < 8; i++) {
+        head[i] = (uint64_t)unix_ms >> (8 * i);
+    }
+    head[8] = len;
+    head[9] = len >> 8;
+
+    if (fwrite(head, 1, sizeof(head), capture) != sizeof(head) ||
+        fwrite(data, 1, len, capture) != len) {
+        return -1;
+    }
+    return fflush(capture);
+}
+
+void capture_close(void)
+{
+    if (capture) {
+        fclose(capture);
+        capture = NULL;
+    }
+}
@@ -0,0 +1,326 @@
+#define _GNU_SOURCE     // pthread_setaffinity_np(), CPU_SET
+#include "rt.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+
+#define HOG_BYTES       (4 * 1024 * 1024)
+#define LATENCY_OVER_US 100
+
+/*********************************
+ * HELPERS
+ *********************************/
+
+static int online_cpus(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+// Cham moi trang cua RT_STACK_PREFAULT byte stack de sau nay khong page fault
+static void __attribute__((noinline)) prefault_stack(void)
+{
+    volatile char stack[RT_STACK_PREFAULT];
+    long page = sysconf(_SC_PAGESIZE);
+
+    for (size_t i = 0; i < sizeof(stack); i += page > 0 ? (size_t)page : 4096) {
+        stack[i] = 0;
+    }
+}
+
+static int64_t ts_ns(const struct timespec *ts)
+{
+    return (int64_t)ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
+/*********************************
+ * LATENCY TEST
+ *********************************/
+
+struct latency_run {
+    const struct rt_config *rt;     // NULL = SCHED_OTHER
+    size_t cycles;
+    int32_t *late_us;
+    int ret;
+};
+
+static atomic_int hogs_stop;
+
+// Tai gia: quet bo nho (cache / bus) va syscall lien tuc o muc uu tien thuong
+static void *hog_main(void *arg)
+{
+    char *buf = malloc(HOG_BYTES);
+    unsigned int round = 0;
+
+    (void)arg;
+    if (!buf) {
+        return NULL;
+    }
+    while (!atomic_load_explicit(&hogs_stop, memory_order_relaxed)) {
+        memset(buf, (int)round++, HOG_BYTES);
+        getppid();
+    }
+    free(buf);
+    return NULL;
+}
+
+static void *latency_main(void *arg)
+{
+    struct latency_run *run = arg;
+    struct timespec next, now;
+
+    if (run->rt && rt_enter(run->rt) != 0) {
+        run->ret = -1;
+        return NULL;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (size_t i = 0; i < run->cycles; i++) {
+        next.tv_nsec += RT_LATENCY_PERIOD_US * 1000;
+        if (next.tv_nsec >= 1000000000) {
+            next.tv_nsec -= 1000000000;
+            next.tv_sec++;
+        }
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR) {
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        run->late_us[i] = (int32_t)((ts_ns(&now) - ts_ns(&next)) / 1000);
+    }
+    return NULL;
+}
+
+static int cmp_int32(const void *a, const void *b)
+{
+    int32_t x = *(const int32_t *)a, y = *(const int32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void report(FILE *out, const char *name, int32_t *late_us, size_t n)
+{
+    int64_t sum = 0;
+    size_t over = 0;
+
+    qsort(late_us, n, sizeof(*late_us), cmp_int32);
+    for (size_t i = 0; i < n; i++) {
+        sum += late_us[i];
+        over += late_us[i] > LATENCY_OVER_US;
+    }
+    fprintf(out, "%-22s %zu wakeups  min %d  avg %.1f  p99 %d  p99.9 %d  max %d us  "
+                 "(%zu over %d us)\n", name, n, late_us[0], (double)sum / n,
+            late_us[n * 99 / 100], late_us[n * 999 / 1000], late_us[n - 1], over,
+            LATENCY_OVER_US);
+}
+
+// Mot pha: hog tren moi CPU + thread do
+static int latency_phase(const struct rt_config *rt, size_t cycles, int32_t *late_us)
+{
+    int hogs = online_cpus();
+    pthread_t tid[hogs], meter;
+    int started = 0;
+    struct latency_run run = { .rt = rt, .cycles = cycles, .late_us = late_us };
+
+    atomic_store(&hogs_stop, 0);
+    for (; started < hogs; started++) {
+        if (pthread_create(&tid[started], NULL, hog_main, NULL) != 0) {
+            break;
+        }
+    }
+
+    int err = pthread_create(&meter, NULL, latency_main, &run);
+    if (err == 0) {
+        pthread_join(meter, NULL);
+    } else {
+        fprintf(stderr, "pthread_create: %s\n", strerror(err));
+        run.ret = -1;
+    }
+
+    atomic_store(&hogs_stop, 1);
+    for (int i = 0; i < started; i++) {
+        pthread_join(tid[i], NULL);
+    }
+    return run.ret;
+}
+
+/*********************************
+ * PUBLIC API
+ *********************************/
+
+void rt_default_config(struct rt_config *cfg)
+{
+    cfg->priority = RT_PRIORITY_DEFAULT;
+    cfg->cpu = online_cpus() - 1;
+}
+
+int rt_parse(const char *arg, struct rt_config *cfg)
+{
+    char *end;
+    long prio = strtol(arg, &end, 10);
+
+    if (end == arg || prio < sched_get_priority_min(SCHED_FIFO) ||
+        prio > sched_get_priority_max(SCHED_FIFO)) {
+        return -1;
+    }
+    cfg->priority = (int)prio;
+    if (*end == '\0') {
+        return 0;
+    }
+    if (*end != ',') {
+        return -1;
+    }
+
+    const char *p = end + 1;
+    long cpu = strtol(p, &end, 10);
+    if (end == p || *end != '\0' || cpu < 0 || cpu >= CPU_SETSIZE ||
+        cpu >= sysconf(_SC_NPROCESSORS_CONF)) {
+        return -1;
+    }
+    cfg->cpu = (int)cpu;
+    return 0;
+}
+
+int rt_enter(const struct rt_config *cfg)
+{
+    struct sched_param sp = { .sched_priority = cfg->priority };
+    int err;
+
+#ifdef M_TRIM_THRESHOLD
+    // Heap khong tra trang cho kernel, malloc lon khong mmap vung moi
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+#endif
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        perror("mlockall");
+        return -1;
+    }
+    prefault_stack();
+
+    if (cfg->cpu >= 0) {
+        cpu_set_t set;
+
+        CPU_ZERO(&set);
+        CPU_SET(cfg->cpu, &set);
+        err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (err != 0) {
+            fprintf(stderr, "Failed to pin to CPU %d: %s\n", cfg->cpu, strerror(err));
+            return -1;
+        }
+    }
+
+    err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp);
+    if (err != 0) {
+        fprintf(stderr, "Failed to set SCHED_FIFO %d: %s\n", cfg->priority, strerror(err));
+        return -1;
+    }
+    return 0;
+}
+
+int rt_queue_init(struct rt_queue *q, size_t item_size)
+{
+    memset(q, 0, sizeof(*q));
+    q->efd = -1;
+    q->item_size = item_size;
+    q->slots = calloc(RT_QUEUE_SLOTS, item_size);
+    if (!q->slots) {
+        perror("calloc");
+        return -1;
+    }
+    q->efd = eventfd(0, EFD_CLOEXEC);
+    if (q->efd < 0) {
+        perror("eventfd");
+        free(q->slots);
+        q->slots = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+int rt_queue_push(struct rt_queue *q, const void *item)
+{
+    uint64_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+
+    if (head - tail >= RT_QUEUE_SLOTS) {
+        q->dropped++;
+        return -1;
+    }
+    memcpy(q->slots + (head % RT_QUEUE_SLOTS) * q->item_size, item, q->item_size);
+    atomic_store_explicit(&q->head, head + 1, memory_order_release);
+    eventfd_write(q->efd, 1);
+    return 0;
+}
+
+int rt_queue_pop(struct rt_queue *q, void *item)
+{
+    uint64_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    eventfd_t ignored;
+
+    for (;;) {
+        int closed = atomic_load_explicit(&q->closed, memory_order_acquire);
+        uint64_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+
+        if (head != tail) {
+            memcpy(item, q->slots + (tail % RT_QUEUE_SLOTS) * q->item_size, q->item_size);
+            atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+            return 1;
+        }
+        if (closed) {
+            return 0;
+        }
+        // Counter cua eventfd giu lai push xay ra giua luc kiem tra va luc ngu
+        if (eventfd_read(q->efd, &ignored) != 0 && errno != EINTR) {
+            perror("eventfd_read");
+            return 0;
+        }
+    }
+}
+
+void rt_queue_close(struct rt_queue *q)
+{
+    atomic_store_explicit(&q->closed, 1, memory_order_release);
+    eventfd_write(q->efd, 1);
+}
+
+void rt_queue_free(struct rt_queue *q)
+{
+    if (q->efd >= 0) {
+        close(q->efd);
+    }
+    free(q->slots);
+    q->slots = NULL;
+}
+
+int rt_latency_test(const struct rt_config *cfg, unsigned int seconds, FILE *out)
+{
+    size_t cycles = (size_t)seconds * 1000000 / RT_LATENCY_PERIOD_US;
+    int32_t *late_us = malloc(cycles * sizeof(*late_us));
+    char name[64];
+    int ret = 0;
+
+    if (!late_us || cycles == 0) {
+        free(late_us);
+        return -1;
+    }
+
+    fprintf(out, "Wakeup latency, %u us period, %u s per run, %d CPU hog(s):\n",
+            RT_LATENCY_PERIOD_US, seconds, online_cpus());
+    if (latency_phase(NULL, cycles, late_us) == 0) {
+        report(out, "SCHED_OTHER", late_us, cycles);
+    }
+
+    // Pha RT: mlockall o day cung khoa luon mang ket qua
+    if (latency_phase(cfg, cycles, late_us) == 0) {
+        snprintf(name, sizeof(name), "SCHED_FIFO %d, CPU %d", cfg->priority, cfg->cpu);
+        report(out, name, late_us, cycles);
+    } else {
+        ret = -1;
+    }
+    free(late_us);
+    return ret;
+}
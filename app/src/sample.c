@@ -0,0 +1,98 @@
+#include "sample.h"
+#include <stdio.h>
+#include <string.h>
+
+const char *const sample_channel_names[SAMPLE_CHANNELS] = { "temp", "hum", "lux" };
+
+// "-12.345" -> -12345; chi lay 3 chu so thap phan
+static const char *parse_milli(const char *p, int32_t *out)
+{
+    int negative = *p == '-';
+    int32_t value = 0, scale = 1000;
+
+    if (negative) {
+        p++;
+    }
+    if (*p < '0' || *p > '9') {
+        return NULL;
+    }
+    while (*p >= '0' && *p <= '9') {
+        value = value * 10 + (*p++ - '0');
+    }
+    value *= 1000;
+    if (*p == '.') {
+        p++;
+        while (*p >= '0' && *p <= '9') {
+            scale /= 10;
+            value += (*p++ - '0') * scale;
+        }
+    }
+
+    *out = negative ? -value : value;
+    return p;
+}
+
+int sample_parse(const char *text, int64_t t_ms, struct sensor_sample *out)
+{
+    const char *p = text;
+
+    out->t_ms = t_ms;
+    out->valid = 0;
+
+    // SHT30: "t.t-h.h" hoac "ERROR"
+    if (strncmp(p, "ERROR", 5) == 0) {
+        p += 5;
+    } else {
+        p = parse_milli(p, &out->value[SAMPLE_TEMP]);
+        if (!p || *p++ != '-' || !(p = parse_milli(p, &out->value[SAMPLE_HUM]))) {
+            return -1;
+        }
+        out->valid |= 1u << SAMPLE_TEMP | 1u << SAMPLE_HUM;
+    }
+    if (*p++ != '-') {
+        return -1;
+    }
+
+    // BH1750: "l.l" hoac "ERROR"
+    if (strncmp(p, "ERROR", 5) == 0) {
+        p += 5;
+    } else {
+        if (!(p = parse_milli(p, &out->value[SAMPLE_LUX]))) {
+            return -1;
+        }
+        out->valid |= 1u << SAMPLE_LUX;
+    }
+
+    return *p == '\0' || *p == '\n' ? 0 : -1;
+}
+
+// milli-unit -> "x.y", lam tron 0.1
+static int format_tenths(char *out, size_t size, int32_t milli)
+{
+    int32_t tenths = (milli + (milli < 0 ? -50 : 50)) / 100;
+    int32_t mag = tenths < 0 ? -tenths : tenths;
+
+    return snprintf(out, size, "%s%d.%d", tenths < 0 ? "-" : "", mag / 10, mag % 10);
+}
+
+void sample_format(const struct sensor_sample *s, char *sht30, size_t sht30_size,
+                   char *bh1750, size_t bh1750_size)
+{
+    uint32_t sht30_bits = 1u << SAMPLE_TEMP | 1u << SAMPLE_HUM;
+
+    if ((s->valid & sht30_bits) == sht30_bits) {
+        int len = format_tenths(sht30, sht30_size, s->value[SAMPLE_TEMP]);
+        if (len > 0 && (size_t)len + 1 < sht30_size) {
+            sht30[len] = '-';
+            format_tenths(sht30 + len + 1, sht30_size - len - 1, s->value[SAMPLE_HUM]);
+        }
+    } else {
+        snprintf(sht30, sht30_size, "ERROR");
+    }
+
+    if (s->valid & (1u << SAMPLE_LUX)) {
+        format_tenths(bh1750, bh1750_size, s->value[SAMPLE_LUX]);
+    } else {
+        snprintf(bh1750, bh1750_size, "ERROR");
+    }
+}
@@ -0,0 +1,613 @@
+#include "sketch.h"
+#include "crc32c.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+
+#define SKETCH_MAGIC    "SKT1"
+
+static double gamma_base;       // (1 + a) / (1 - a)
+static double ln_gamma;
+
+/*********************************
+ * HELPERS
+ *********************************/
+
+static void init_mapping(void)
+{
+    if (ln_gamma == 0) {
+        gamma_base = (1 + SKETCH_ALPHA) / (1 - SKETCH_ALPHA);
+        ln_gamma = log(gamma_base);
+    }
+}
+
+// Bin cua |v| >= 1: ceil(log_gamma(|v|))
+static int bin_index(uint32_t mag)
+{
+    int i = (int)ceil(log((double)mag) / ln_gamma);
+    return i < SKETCH_BINS ? i : SKETCH_BINS - 1;
+}
+
+// Diem giua (theo sai so tuong doi) cua bin i
+static double bin_value(int i)
+{
+    return 2 * pow(gamma_base, i) / (gamma_base + 1);
+}
+
+static int32_t clamp_value(const struct sketch *s, double v)
+{
+    int32_t r = (int32_t)(v < 0 ? v - 0.5 : v + 0.5);
+    return r < s->min ? s->min : r > s->max ? s->max : r;
+}
+
+static void add_bins(struct sketch *s, int store, int lo, const uint32_t *bins, int n)
+{
+    for (int k = 0; k < n; k++) {
+        s->bins[store][lo + k] += bins[k];
+    }
+    if (n > 0) {
+        s->lo[store] = lo < s->lo[store] ? lo : s->lo[store];
+        s->hi[store] = lo + n - 1 > s->hi[store] ? lo + n - 1 : s->hi[store];
+    }
+}
+
+static void add_summary(struct sketch *s, uint64_t count, uint64_t zero, int32_t min, int32_t max)
+{
+    if (count == 0) {
+        return;
+    }
+    s->min = s->count == 0 || min < s->min ? min : s->min;
+    s->max = s->count == 0 || max > s->max ? max : s->max;
+    s->count += count;
+    s->zero += zero;
+}
+
+static void month_path(char *buf, size_t size, const char *dir, int year, int mon)
+{
+    snprintf(buf, size, "%s/sketch_%04d-%02d.skt", dir, year, mon);
+}
+
+static void year_path(char *buf, size_t size, const char *dir, int year)
+{
+    snprintf(buf, size, "%s/sketch_%04d.skt", dir, year);
+}
+
+// So ngay tu 1970-01-01 cua ngay (gio dia phuong) chua t
+static long day_number(time_t t)
+{
+    struct tm tm;
+    localtime_r(&t, &tm);
+
+    long y = tm.tm_year + 1900 - (tm.tm_mon < 2);
+    long era = (y >= 0 ? y : y - 399) / 400;
+    long yoe = y - era * 400;
+    long mp = (tm.tm_mon + 10) % 12;    // thang 3 = 0
+    long doy = (153 * mp + 2) / 5 + tm.tm_mday - 1;
+    return era * 146097 + yoe * 365 + yoe / 4 - yoe / 100 + doy - 719468;
+}
+
+// 00:00 cua ngay chua t, va cua ngay sau do
+static time_t day_bounds(time_t t, time_t *next)
+{
+    struct tm tm;
+    localtime_r(&t, &tm);
+    tm.tm_hour = tm.tm_min = tm.tm_sec = 0;
+    tm.tm_isdst = -1;
+    time_t start = mktime(&tm);
+    tm.tm_mday++;
+    tm.tm_isdst = -1;
+    *next = mktime(&tm);
+    return start;
+}
+
+/*
+ * Record cho mot sketch vao buf (header + bin); tra ve so byte, 0 neu
+ * sketch rong
+ */
+static size_t encode(const struct sketch *s, enum sketch_kind kind, int channel, int64_t start,
+                     char *buf)
+{
+    struct sketch_record rec;
+    int n[2];
+
+    if (s->count == 0) {
+        return 0;
+    }
+    for (int st = 0; st < 2; st++) {
+        n[st] = s->hi[st] >= s->lo[st] ? s->hi[st] - s->lo[st] + 1 : 0;
+    }
+
+    memset(&rec, 0, sizeof(rec));
+    memcpy(rec.magic, SKETCH_MAGIC, sizeof(rec.magic));
+    rec.kind = (uint8_t)kind;
+    rec.channel = (uint8_t)channel;
+    rec.start = start;
+    rec.count = s->count;
+    rec.zero = s->zero;
+    rec.min = s->min;
+    rec.max = s->max;
+    rec.pos_lo = (int16_t)(n[0] ? s->lo[0] : 0);
+    rec.pos_n = (uint16_t)n[0];
+    rec.neg_lo = (int16_t)(n[1] ? s->lo[1] : 0);
+    rec.neg_n = (uint16_t)n[1];
+
+    char *p = buf + sizeof(rec);
+    memcpy(p, &s->bins[0][rec.pos_lo], n[0] * sizeof(uint32_t));
+    memcpy(p + n[0] * sizeof(uint32_t), &s->bins[1][rec.neg_lo], n[1] * sizeof(uint32_t));
+    size_t len = sizeof(rec) + (n[0] + n[1]) * sizeof(uint32_t);
+
+    rec.crc = crc32c(crc32c(0, &rec, sizeof(rec)), p, len - sizeof(rec));
+    memcpy(buf, &rec, sizeof(rec));
+    return len;
+}
+
+static void merge_record(struct sketch *s, const struct sketch_record *rec, const uint32_t *bins)
+{
+    add_summary(s, rec->count, rec->zero, rec->min, rec->max);
+    add_bins(s, 0, rec->pos_lo, bins, rec->pos_n);
+    add_bins(s, 1, rec->neg_lo, bins + rec->pos_n, rec->neg_n);
+}
+
+typedef void (*record_fn)(const struct sketch_record *rec, const uint32_t *bins, void *arg);
+
+// Doc tung record cua file; dung o record hong dau tien. File chua co: 0
+static int read_records(const char *path, record_fn fn, void *arg)
+{
+    static uint32_t bins[2 * SKETCH_BINS];
+    struct sketch_record rec;
+
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        if (errno == ENOENT) {
+            return 0;
+        }
+        perror(path);
+        return -1;
+    }
+
+    while (fread(&rec, sizeof(rec), 1, f) == 1) {
+        size_t n = (size_t)rec.pos_n + rec.neg_n;
+        uint32_t crc = rec.crc;
+
+        if (memcmp(rec.magic, SKETCH_MAGIC, sizeof(rec.magic)) != 0 || rec.kind > SKETCH_DAY ||
+            rec.channel >= SAMPLE_CHANNELS || rec.pos_lo < 0 || rec.neg_lo < 0 ||
+            rec.pos_lo + rec.pos_n > SKETCH_BINS || rec.neg_lo + rec.neg_n > SKETCH_BINS ||
+            fread(bins, sizeof(uint32_t), n, f) != n) {
+            break;
+        }
+        rec.crc = 0;
+        if (crc32c(crc32c(0, &rec, sizeof(rec)), bins, n * sizeof(uint32_t)) != crc) {
+            break;
+        }
+        rec.crc = crc;
+        fn(&rec, bins, arg);
+    }
+    fclose(f);
+    return 0;
+}
+
+static int append_file(const char *path, const char *buf, size_t len)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+
+    ssize_t n = write(fd, buf, len);
+    close(fd);
+    if (n != (ssize_t)len) {
+        perror(path);
+        return -1;
+    }
+    return 0;
+}
+
+/*********************************
+ * DAY ROLLUP / COMPACTION
+ *********************************/
+
+struct rollup {
+    int64_t from, to;
+    int found;                          // da co sketch ngay trong file nam
+    struct sketch day[SAMPLE_CHANNELS];
+};
+
+static void find_day(const struct sketch_record *rec, const uint32_t *bins, void *arg)
+{
+    struct rollup *r = arg;
+    (void)bins;
+    if (rec->kind == SKETCH_DAY && rec->start == r->from) {
+        r->found = 1;
+    }
+}
+
+static void collect_day(const struct sketch_record *rec, const uint32_t *bins, void *arg)
+{
+    struct rollup *r = arg;
+    if (rec->kind == SKETCH_HOUR && rec->start >= r->from && rec->start < r->to) {
+        merge_record(&r->day[rec->channel], rec, bins);
+    }
+}
+
+// Cong cac sketch gio cua ngay [from, to) thanh sketch ngay (mot lan moi ngay)
+static int rollup_day(const char *dir, time_t from, time_t to)
+{
+    char month[PATH_MAX], year[PATH_MAX];
+    char buf[sizeof(struct sketch_record) + 2 * SKETCH_BINS * sizeof(uint32_t)];
+    struct tm tm;
+    int ret = 0;
+
+    localtime_r(&from, &tm);
+    month_path(month, sizeof(month), dir, tm.tm_year + 1900, tm.tm_mon + 1);
+    year_path(year, sizeof(year), dir, tm.tm_year + 1900);
+
+    struct rollup *r = calloc(1, sizeof(*r));
+    if (!r) {
+        return -1;
+    }
+    r->from = from;
+    r->to = to;
+    read_records(year, find_day, r);
+    if (!r->found) {
+        for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+            sketch_init(&r->day[c]);
+        }
+        read_records(month, collect_day, r);
+        for (int c = 0; c < SAMPLE_CHANNELS && ret == 0; c++) {
+            size_t len = encode(&r->day[c], SKETCH_DAY, c, from, buf);
+            if (len > 0) {
+                ret = append_file(year, buf, len);
+            }
+        }
+    }
+    free(r);
+    return ret;
+}
+
+struct compact {
+    FILE *out;
+    int64_t start;
+    int kind;
+    int have;
+    int error;
+    struct sketch acc[SAMPLE_CHANNELS];
+    char buf[sizeof(struct sketch_record) + 2 * SKETCH_BINS * sizeof(uint32_t)];
+};
+
+static void compact_emit(struct compact *cp)
+{
+    for (int c = 0; c < SAMPLE_CHANNELS && cp->have; c++) {
+        size_t len = encode(&cp->acc[c], cp->kind, c, cp->start, cp->buf);
+        if (len > 0 && fwrite(cp->buf, 1, len, cp->out) != len) {
+            cp->error = 1;
+        }
+        sketch_reset(&cp->acc[c]);
+    }
+    cp->have = 0;
+}
+
+// Delta cua cung bucket lien nhau (ca 3 channel) -> mot record moi channel
+static void compact_record(const struct sketch_record *rec, const uint32_t *bins, void *arg)
+{
+    struct compact *cp = arg;
+
+    if (cp->have && (rec->start != cp->start || rec->kind != cp->kind)) {
+        compact_emit(cp);
+    }
+    cp->start = rec->start;
+    cp->kind = rec->kind;
+    cp->have = 1;
+    merge_record(&cp->acc[rec->channel], rec, bins);
+}
+
+// Gop delta trong file thang: tmp + rename, reader luon thay file nguyen ven
+static int compact_month(const char *path)
+{
+    char tmp[PATH_MAX + 8];
+    int ret = -1;
+
+    struct compact *cp = calloc(1, sizeof(*cp));
+    if (!cp) {
+        return -1;
+    }
+    for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+        sketch_init(&cp->acc[c]);
+    }
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    cp->out = fopen(tmp, "wb");
+    if (!cp->out) {
+        perror(tmp);
+        free(cp);
+        return -1;
+    }
+    read_records(path, compact_record, cp);
+    compact_emit(cp);
+
+    if (fflush(cp->out) != 0 || fsync(fileno(cp->out)) != 0 || cp->error) {
+        perror(tmp);
+    } else if (rename(tmp, path) != 0) {
+        perror(path);
+    } else {
+        ret = 0;
+    }
+    fclose(cp->out);
+    if (ret != 0) {
+        unlink(tmp);
+    }
+    free(cp);
+    return ret;
+}
+
+// Ngay [from, to) da xong: sketch ngay + gop file thang cua no
+static void day_over(const char *dir, time_t from, time_t to)
+{
+    char month[PATH_MAX];
+    struct tm tm;
+
+    localtime_r(&from, &tm);
+    month_path(month, sizeof(month), dir, tm.tm_year + 1900, tm.tm_mon + 1);
+    if (access(month, F_OK) != 0) {
+        return;
+    }
+    rollup_day(dir, from, to);
+    compact_month(month);
+}
+
+/*********************************
+ * QUERY
+ *********************************/
+
+struct query {
+    int64_t from, to;
+    long first_day;
+    long days;
+    uint8_t *covered;           // ngay da lay tu sketch ngay
+    struct sketch *out;
+};
+
+static void query_day(const struct sketch_record *rec, const uint32_t *bins, void *arg)
+{
+    struct query *q = arg;
+    time_t next;
+
+    if (rec->kind != SKETCH_DAY || rec->start < q->from) {
+        return;
+    }
+    day_bounds((time_t)rec->start, &next);
+    if (next > q->to) {
+        return;
+    }
+    merge_record(&q->out[rec->channel], rec, bins);
+    q->covered[day_number((time_t)rec->start) - q->first_day] = 1;
+}
+
+static void query_hour(const struct sketch_record *rec, const uint32_t *bins, void *arg)
+{
+    struct query *q = arg;
+
+    if (rec->kind != SKETCH_HOUR || rec->start < q->from || rec->start >= q->to ||
+        q->covered[day_number((time_t)rec->start) - q->first_day]) {
+        return;
+    }
+    merge_record(&q->out[rec->channel], rec, bins);
+}
+
+/*********************************
+ * PUBLIC API
+ *********************************/
+
+void sketch_init(struct sketch *s)
+{
+    init_mapping();
+    memset(s, 0, sizeof(*s));
+    for (int st = 0; st < 2; st++) {
+        s->lo[st] = SKETCH_BINS;
+        s->hi[st] = -1;
+    }
+}
+
+void sketch_reset(struct sketch *s)
+{
+    s->count = 0;
+    s->zero = 0;
+    s->min = s->max = 0;
+    for (int st = 0; st < 2; st++) {
+        // Chi xoa doan da dung
+        if (s->hi[st] >= s->lo[st]) {
+            memset(&s->bins[st][s->lo[st]], 0, (s->hi[st] - s->lo[st] + 1) * sizeof(uint32_t));
+        }
+        s->lo[st] = SKETCH_BINS;
+        s->hi[st] = -1;
+    }
+}
+
+void sketch_add(struct sketch *s, int32_t value)
+{
+    add_summary(s, 1, value == 0, value, value);
+    if (value != 0) {
+        int store = value < 0;
+        uint32_t mag = value < 0 ? (uint32_t)(-(int64_t)value) : (uint32_t)value;
+        uint32_t one = 1;
+
+        add_bins(s, store, bin_index(mag), &one, 1);
+    }
+}
+
+void sketch_merge(struct sketch *dst, const struct sketch *src)
+{
+    add_summary(dst, src->count, src->zero, src->min, src->max);
+    for (int st = 0; st < 2; st++) {
+        if (src->hi[st] >= src->lo[st]) {
+            add_bins(dst, st, src->lo[st], &src->bins[st][src->lo[st]],
+                     src->hi[st] - src->lo[st] + 1);
+        }
+    }
+}
+
+int32_t sketch_quantile(const struct sketch *s, double q)
+{
+    if (q <= 0) {
+        return s->min;
+    }
+    if (q >= 1) {
+        return s->max;
+    }
+
+    double rank = q * (double)(s->count - 1);
+    uint64_t seen = 0;
+
+    // Thu tu tang dan: am (|v| lon truoc), 0, duong
+    for (int i = s->hi[1]; i >= s->lo[1] && i >= 0; i--) {
+        seen += s->bins[1][i];
+        if (seen > rank) {
+            return clamp_value(s, -bin_value(i));
+        }
+    }
+    seen += s->zero;
+    if (seen > rank) {
+        return clamp_value(s, 0);
+    }
+    for (int i = s->lo[0]; i <= s->hi[0]; i++) {
+        seen += s->bins[0][i];
+        if (seen > rank) {
+            return clamp_value(s, bin_value(i));
+        }
+    }
+    return s->max;
+}
+
+int sketch_query(const char *dir, time_t from, time_t to, struct sketch out[SAMPLE_CHANNELS])
+{
+    struct query q = { .from = from, .to = to, .out = out };
+    char path[PATH_MAX];
+    struct tm a, b;
+
+    for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+        sketch_init(&out[c]);
+    }
+    if (to <= from) {
+        return 0;
+    }
+
+    q.first_day = day_number(from);
+    q.days = day_number(to - 1) - q.first_day + 1;
+    q.covered = calloc(q.days, 1);
+    if (!q.covered) {
+        return -1;
+    }
+
+    time_t last = to - 1;
+    localtime_r(&from, &a);
+    localtime_r(&last, &b);
+
+    // Ngay tron trong khoang: sketch ngay tu file nam
+    for (int y = a.tm_year + 1900; y <= b.tm_year + 1900; y++) {
+        year_path(path, sizeof(path), dir, y);
+        read_records(path, query_day, &q);
+    }
+
+    // Phan con lai (dau / cuoi khoang, ngay chua gop): sketch gio tu file thang
+    int y = a.tm_year + 1900, m = a.tm_mon + 1;
+    long day = q.first_day;
+    while (y < b.tm_year + 1900 || (y == b.tm_year + 1900 && m <= b.tm_mon + 1)) {
+        struct tm next = { .tm_year = (m == 12 ? y + 1 : y) - 1900, .tm_mon = m % 12,
+                           .tm_mday = 1, .tm_hour = 12, .tm_isdst = -1 };
+        long month_end = day_number(mktime(&next));
+        int need = 0;
+
+        for (; day < month_end && day < q.first_day + q.days; day++) {
+            need |= !q.covered[day - q.first_day];
+        }
+        if (need) {
+            month_path(path, sizeof(path), dir, y, m);
+            read_records(path, query_hour, &q);
+        }
+        y += m == 12;
+        m = m % 12 + 1;
+    }
+
+    free(q.covered);
+    return 0;
+}
+
+void sketch_writer_init(struct sketch_writer *w, const char *dir)
+{
+    memset(w, 0, sizeof(*w));
+    snprintf(w->dir, sizeof(w->dir), "%s", dir);
+    for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+        sketch_init(&w->cur[c]);
+    }
+}
+
+int sketch_writer_flush(struct sketch_writer *w)
+{
+    static char buf[SAMPLE_CHANNELS * (sizeof(struct sketch_record) + 2 * SKETCH_BINS * sizeof(uint32_t))];
+    char path[PATH_MAX];
+    size_t len = 0;
+    struct tm tm;
+    time_t start = (time_t)w->hour_start;
+
+    for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+        len += encode(&w->cur[c], SKETCH_HOUR, c, w->hour_start, buf + len);
+        sketch_reset(&w->cur[c]);
+    }
+    if (len == 0) {
+        return 0;
+    }
+
+    // Mot write cho ca 3 channel
+    localtime_r(&start, &tm);
+    month_path(path, sizeof(path), w->dir, tm.tm_year + 1900, tm.tm_mon + 1);
+    return append_file(path, buf, len);
+}
+
+int sketch_writer_add(struct sketch_writer *w, const struct sensor_sample *sample)
+{
+    time_t t = (time_t)(sample->t_ms / 1000);
+    int ret = 0;
+
+    if (t < w->hour_start || t >= w->hour_end) {
+        ret = sketch_writer_flush(w);
+
+        time_t day_end;
+        time_t day_start = day_bounds(t, &day_end);
+        if (w->day_end == 0) {
+            // Khoi dong: hom qua co the chua duoc gop (daemon tat qua nua dem)
+            time_t prev_end;
+            time_t prev_start = day_bounds(day_start - 1, &prev_end);
+            day_over(w->dir, prev_start, prev_end);
+        } else if (day_start > w->day_start) {
+            day_over(w->dir, (time_t)w->day_start, (time_t)w->day_end);
+        }
+        // Thoi gian lui (NTP, replay, file cu): chi flush, ngay moi nhat van mo
+        if (day_start > w->day_start) {
+            w->day_start = day_start;
+            w->day_end = day_end;
+        }
+
+        struct tm tm;
+        localtime_r(&t, &tm);
+        w->hour_start = t - tm.tm_min * 60 - tm.tm_sec;
+        w->hour_end = w->hour_start + 3600;
+        w->flushed = t;
+    }
+
+    for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+        if (sample->valid & (1u << c)) {
+            sketch_add(&w->cur[c], sample->value[c]);
+        }
+    }
+
+    if (t - w->flushed >= SKETCH_FLUSH_SEC) {
+        w->flushed = t;
+        ret = sketch_writer_flush(w);
+    }
+    return ret;
+}
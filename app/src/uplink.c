@@ -0,0 +1,755 @@
+#include "uplink.h"
+#include "batch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#define UPLINK_QUEUE_DIR    "/var/lib/sensor_monitor/uplink"
+#define UPLINK_WINDOW       8           // so batch gui chua ack toi da
+#define UPLINK_IO_TIMEOUT   5           // giay: connect / send
+#define UPLINK_ACK_TIMEOUT  30          // giay
+#define UPLINK_BACKOFF_MAX  60          // giay
+#define MQTT_KEEPALIVE      60          // giay
+#define UPLINK_STACK        (256 * 1024)    // --rt khoa ca stack (mlockall): khong lay 8 MiB
+
+// Mot batch trong queue tren disk
+struct queued {
+    uint64_t seq;
+    uint32_t size;
+    int sent;                   // da gui it nhat mot lan (MQTT: gui lai voi DUP)
+};
+
+static struct uplink_config config;
+
+// Batch dang gom (chi thread goi uplink_push dung)
+static struct sensor_sample pending[BATCH_MAX_SAMPLES];
+static unsigned int npending;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_t thread;
+    int running;
+    int stopping;
+    int connected;
+    int wake_fd;                // eventfd: co batch moi / dung
+
+    struct queued *q;           // theo seq tang dan
+    unsigned int count, cap;
+    unsigned int inflight;      // q[0, inflight) da gui, cho ack
+    int sending;                // q[inflight] dang duoc gui (ngoai lock), khong duoc xoa
+    uint64_t bytes;             // tong kich thuoc file trong queue
+    uint64_t next_seq;
+
+    struct uplink_stats stats;
+} up = { .lock = PTHREAD_MUTEX_INITIALIZER, .wake_fd = -1 };
+
+/*********************************
+ * DISK QUEUE
+ *********************************/
+
+static void queue_path(char *buf, size_t size, uint64_t seq, const char *ext)
+{
+    snprintf(buf, size, "%s/%020llu.%s", config.queue_dir, (unsigned long long)seq, ext);
+}
+
+static int queue_cmp(const void *a, const void *b)
+{
+    const struct queued *x = a, *y = b;
+    return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+static int queue_append(uint64_t seq, uint32_t size)
+{
+    if (up.count == up.cap) {
+        unsigned int cap = up.cap ? 2 * up.cap : 64;
+        struct queued *q = realloc(up.q, cap * sizeof(*q));
+        if (!q) {
+            return -1;
+        }
+        up.q = q;
+        up.cap = cap;
+    }
+    up.q[up.count].seq = seq;
+    up.q[up.count].size = size;
+    up.q[up.count].sent = 0;
+    up.count++;
+    up.bytes += size;
+    return 0;
+}
+
+// Xoa q[index] khoi queue va disk (goi khi dang giu lock)
+static void queue_remove(unsigned int index)
+{
+    char path[512];
+
+    queue_path(path, sizeof(path), up.q[index].seq, "batch");
+    unlink(path);
+    up.bytes -= up.q[index].size;
+    memmove(&up.q[index], &up.q[index + 1], (up.count - index - 1) * sizeof(*up.q));
+    up.count--;
+}
+
+// Nap lai cac batch con lai tu lan chay truoc
+static int queue_load(void)
+{
+    DIR *dir = opendir(config.queue_dir);
+    if (!dir) {
+        fprintf(stderr, "opendir %s: %s\n", config.queue_dir, strerror(errno));
+        return -1;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        unsigned long long seq;
+        char ext[8], path[512];
+        struct stat st;
+
+        if (sscanf(entry->d_name, "%20llu.%7s", &seq, ext) != 2) {
+            continue;
+        }
+        queue_path(path, sizeof(path), seq, ext);
+        if (strcmp(ext, "batch") != 0) {
+            unlink(path);       // .tmp do crash giua luc ghi
+            continue;
+        }
+        if (stat(path, &st) == 0 && queue_append(seq, (uint32_t)st.st_size) != 0) {
+            closedir(dir);
+            return -1;
+        }
+    }
+    closedir(dir);
+
+    qsort(up.q, up.count, sizeof(*up.q), queue_cmp);
+    up.next_seq = up.count ? up.q[up.count - 1].seq + 1 : 1;
+    return 0;
+}
+
+// Ghi batch ra file tam roi rename, de crash khong de lai batch do dang
+static int queue_write(uint64_t seq, const uint8_t *payload, size_t len)
+{
+    char tmp[512], path[512];
+
+    queue_path(tmp, sizeof(tmp), seq, "tmp");
+    queue_path(path, sizeof(path), seq, "batch");
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("open uplink batch");
+        return -1;
+    }
+    if (write(fd, payload, len) != (ssize_t)len || fdatasync(fd) != 0) {
+        perror("write uplink batch");
+        close(fd);
+        unlink(tmp);
+        return -1;
+    }
+    close(fd);
+
+    if (rename(tmp, path) != 0) {
+        perror("rename uplink batch");
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+static int flush_batch(void)
+{
+    static uint8_t payload[BATCH_ENCODED_MAX(BATCH_MAX_SAMPLES)];
+    int ret = 0;
+
+    if (npending == 0) {
+        return 0;
+    }
+
+    size_t len = batch_encode(pending, npending, payload);
+    npending = 0;
+
+    // Chi producer cap seq va append nen queue van theo thu tu seq
+    pthread_mutex_lock(&up.lock);
+    uint64_t seq = up.next_seq++;
+    pthread_mutex_unlock(&up.lock);
+
+    int written = queue_write(seq, payload, len) == 0;
+
+    pthread_mutex_lock(&up.lock);
+    if (written && queue_append(seq, (uint32_t)len) == 0) {
+        up.stats.batches++;
+        up.stats.payload_bytes += len;
+
+        // Giu queue duoi queue_max: bo batch cu nhat chua gui (tru batch dang gui)
+        unsigned int oldest = up.inflight + (up.sending ? 1 : 0);
+        while (up.bytes > config.queue_max && up.count > oldest + 1) {
+            queue_remove(oldest);
+            up.stats.dropped++;
+        }
+    } else {
+        ret = -1;
+    }
+    pthread_mutex_unlock(&up.lock);
+
+    eventfd_write(up.wake_fd, 1);
+    return ret;
+}
+
+/*********************************
+ * TRANSPORT
+ *********************************/
+
+static int send_all(int fd, const void *buf, size_t len)
+{
+    const uint8_t *p = buf;
+
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int recv_all(int fd, void *buf, size_t len)
+{
+    uint8_t *p = buf;
+
+    while (len > 0) {
+        ssize_t n = recv(fd, p, len, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// MQTT remaining length (varint 7 bit, toi da 4 byte)
+static uint8_t *mqtt_put_len(uint8_t *p, size_t len)
+{
+    do {
+        uint8_t b = len % 128;
+        len /= 128;
+        *p++ = len ? b | 0x80 : b;
+    } while (len);
+    return p;
+}
+
+static uint8_t *mqtt_put_str(uint8_t *p, const char *s)
+{
+    size_t len = strlen(s);
+    batch_put_be(p, len, 2);
+    memcpy(p + 2, s, len);
+    return p + 2 + len;
+}
+
+static int mqtt_connect(int fd)
+{
+    uint8_t pkt[256], body[200], *b = body, *p = pkt;
+    char client_id[96];
+
+    snprintf(client_id, sizeof(client_id), "env-monitor-%s", config.node);
+
+    static const uint8_t head[] = { 0, 4, 'M', 'Q', 'T', 'T', 4, 0x02 };  // v3.1.1, clean session
+    memcpy(b, head, sizeof(head));
+    b += sizeof(head);
+    batch_put_be(b, MQTT_KEEPALIVE, 2);
+    b += 2;
+    b = mqtt_put_str(b, client_id);
+
+    *p++ = 0x10;
+    p = mqtt_put_len(p, b - body);
+    memcpy(p, body, b - body);
+    p += b - body;
+
+    uint8_t connack[4];
+    if (send_all(fd, pkt, p - pkt) != 0 || recv_all(fd, connack, sizeof(connack)) != 0 ||
+        connack[0] != 0x20 || connack[3] != 0) {
+        fprintf(stderr, "uplink: MQTT connect refused\n");
+        return -1;
+    }
+    return 0;
+}
+
+// Collector TCP: cho biet ten node truoc batch dau tien
+static int send_hello(int fd)
+{
+    uint8_t frame[BATCH_HEAD_LEN + BATCH_NODE_MAX];
+    size_t len = strlen(config.node);
+
+    batch_put_head(frame, BATCH_SEQ_HELLO, (uint32_t)len);
+    memcpy(frame + BATCH_HEAD_LEN, config.node, len);
+    return send_all(fd, frame, BATCH_HEAD_LEN + len);
+}
+
+static int open_link(void)
+{
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM }, *res, *ai;
+    struct timeval tv = { .tv_sec = UPLINK_IO_TIMEOUT };
+    int fd = -1;
+
+    if (getaddrinfo(config.host, config.port, &hints, &res) != 0) {
+        return -1;
+    }
+
+    for (ai = res; ai && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        // SO_SNDTIMEO cung gioi han thoi gian connect()
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+
+    if (fd >= 0 && (config.proto == UPLINK_MQTT ? mqtt_connect(fd) : send_hello(fd)) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+// Gui batch seq (doc tu queue) thanh mot frame; dup: da gui truoc khi mat ket noi
+static int send_batch(int fd, uint64_t seq, uint32_t size, int dup)
+{
+    char path[512];
+    uint8_t *frame = malloc(BATCH_HEAD_LEN + size + 160);
+    int ret = -1;
+
+    if (!frame) {
+        return -1;
+    }
+
+    // Cho header MQTT PUBLISH o truoc frame
+    uint8_t *body = frame + 160;
+    batch_put_head(body, seq, size);
+
+    queue_path(path, sizeof(path), seq, "batch");
+    int in = open(path, O_RDONLY);
+    if (in < 0 || read(in, body + BATCH_HEAD_LEN, size) != (ssize_t)size) {
+        // File mat/hong: coi nhu da gui de khong ket queue
+        if (in >= 0) {
+            close(in);
+        }
+        free(frame);
+        return 1;
+    }
+    close(in);
+
+    uint8_t *start = body;
+    size_t len = BATCH_HEAD_LEN + size;
+    if (config.proto == UPLINK_MQTT) {
+        uint8_t head[160], *p = head;
+        size_t topic_len = strlen(config.topic);
+
+        *p++ = dup ? 0x3A : 0x32;   // PUBLISH, QoS 1 (+ DUP khi gui lai)
+        p = mqtt_put_len(p, 2 + topic_len + 2 + len);
+        p = mqtt_put_str(p, config.topic);
+        batch_put_be(p, seq % 0xFFFF + 1, 2);   // packet id khac 0
+        p += 2;
+
+        start = body - (p - head);
+        memcpy(start, head, p - head);
+        len += p - head;
+    }
+
+    ret = send_all(fd, start, len);
+    free(frame);
+    return ret;
+}
+
+// Doc mot goi tu collector: 0 = ack cua q[0], 1 = PINGRESP, -1 = loi / ack sai
+static int read_ack(int fd, int inflight, uint64_t expect)
+{
+    uint8_t buf[8];
+
+    if (config.proto == UPLINK_TCP) {
+        if (!inflight || recv_all(fd, buf, 8) != 0) {
+            return -1;
+        }
+        return batch_get_be(buf, 8) == expect ? 0 : -1;
+    }
+
+    if (recv_all(fd, buf, 2) != 0) {
+        return -1;
+    }
+    if (buf[0] == 0xD0 && buf[1] == 0) {
+        return 1;
+    }
+    if (!inflight || buf[0] != 0x40 || buf[1] != 2 || recv_all(fd, buf, 2) != 0) {
+        return -1;
+    }
+    return batch_get_be(buf, 2) == expect % 0xFFFF + 1 ? 0 : -1;
+}
+
+/*********************************
+ * SENDER THREAD
+ *********************************/
+
+static void drain_wake(void)
+{
+    eventfd_t v;
+    eventfd_read(up.wake_fd, &v);
+}
+
+// Cho toi da timeout_ms hoac toi khi bi danh thuc
+static void idle_wait(int timeout_ms)
+{
+    struct pollfd pfd = { .fd = up.wake_fd, .events = POLLIN };
+    if (poll(&pfd, 1, timeout_ms) > 0) {
+        drain_wake();
+    }
+}
+
+// Backoff: batch moi khong rut ngan thoi gian cho, chi uplink_stop() thi thoi
+static void backoff_wait(int timeout_ms)
+{
+    struct timespec now, deadline;
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_nsec -= 1000000000;
+        deadline.tv_sec++;
+    }
+
+    for (;;) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long left = (deadline.tv_sec - now.tv_sec) * 1000 +
+                    (deadline.tv_nsec - now.tv_nsec) / 1000000;
+        if (left <= 0) {
+            return;
+        }
+        idle_wait((int)left);
+
+        pthread_mutex_lock(&up.lock);
+        int stopping = up.stopping;
+        pthread_mutex_unlock(&up.lock);
+        if (stopping) {
+            return;
+        }
+    }
+}
+
+static void *sender_main(void *arg)
+{
+    int fd = -1, backoff = 1;
+    time_t last_ack = 0, last_tx = 0;
+
+    (void)arg;
+
+    for (;;) {
+        pthread_mutex_lock(&up.lock);
+        int stopping = up.stopping;
+        unsigned int queued = up.count;
+        pthread_mutex_unlock(&up.lock);
+
+        if (stopping) {
+            break;
+        }
+
+        if (fd < 0) {
+            if (queued == 0) {
+                idle_wait(-1);
+                continue;
+            }
+            fd = open_link();
+            if (fd < 0) {
+                // Link down: batch nam tren disk, thu lai voi backoff tang dan
+                backoff_wait(backoff * 1000);
+                backoff = backoff * 2 > UPLINK_BACKOFF_MAX ? UPLINK_BACKOFF_MAX : backoff * 2;
+                continue;
+            }
+            backoff = 1;
+            last_ack = last_tx = time(NULL);
+            pthread_mutex_lock(&up.lock);
+            up.connected = 1;
+            up.inflight = 0;
+            up.stats.connects++;
+            pthread_mutex_unlock(&up.lock);
+        }
+
+        // Gui cho du cua so
+        int failed = 0;
+        for (;;) {
+            pthread_mutex_lock(&up.lock);
+            int more = up.inflight < UPLINK_WINDOW && up.inflight < up.count;
+            struct queued next = more ? up.q[up.inflight] : (struct queued){ 0 };
+            up.sending = more;
+            pthread_mutex_unlock(&up.lock);
+            if (!more) {
+                break;
+            }
+
+            int ret = send_batch(fd, next.seq, next.size, next.sent);
+            pthread_mutex_lock(&up.lock);
+            up.sending = 0;
+            int same = up.inflight < up.count && up.q[up.inflight].seq == next.seq;
+            if (ret > 0) {
+                // batch khong doc duoc: bo qua
+                if (same) {
+                    queue_remove(up.inflight);
+                }
+            } else if (ret == 0 && same) {
+                up.q[up.inflight].sent = 1;
+                up.inflight++;
+                up.stats.sent++;
+            }
+            pthread_mutex_unlock(&up.lock);
+            if (ret < 0) {
+                failed = 1;
+                break;
+            }
+            last_tx = time(NULL);
+        }
+
+        // Cho ack hoac batch moi
+        if (!failed) {
+            struct pollfd pfd[2] = {
+                { .fd = fd, .events = POLLIN },
+                { .fd = up.wake_fd, .events = POLLIN },
+            };
+            pthread_mutex_lock(&up.lock);
+            unsigned int inflight = up.inflight;
+            pthread_mutex_unlock(&up.lock);
+
+            int n = poll(pfd, 2, 1000);
+            if (pfd[1].revents & POLLIN) {
+                drain_wake();
+            }
+            if (n > 0 && (pfd[0].revents & (POLLIN | POLLHUP | POLLERR))) {
+                pthread_mutex_lock(&up.lock);
+                uint64_t expect = up.inflight ? up.q[0].seq : 0;
+                pthread_mutex_unlock(&up.lock);
+
+                int ret = read_ack(fd, inflight, expect);
+                if (ret < 0) {
+                    failed = 1;
+                } else if (ret == 0) {
+                    pthread_mutex_lock(&up.lock);
+                    queue_remove(0);
+                    up.inflight--;
+                    up.stats.acked++;
+                    pthread_mutex_unlock(&up.lock);
+                    last_ack = time(NULL);
+                }
+            } else if (inflight > 0 && time(NULL) - last_ack > UPLINK_ACK_TIMEOUT) {
+                fprintf(stderr, "uplink: ack timeout\n");
+                failed = 1;
+            } else if (config.proto == UPLINK_MQTT && time(NULL) - last_tx > MQTT_KEEPALIVE / 2) {
+                static const uint8_t pingreq[] = { 0xC0, 0 };
+                failed = send_all(fd, pingreq, sizeof(pingreq)) != 0;
+                last_tx = time(NULL);
+            }
+        }
+
+        if (failed) {
+            // Gui lai tu batch cu nhat chua ack sau khi ket noi lai
+            close(fd);
+            fd = -1;
+            pthread_mutex_lock(&up.lock);
+            up.connected = 0;
+            up.inflight = 0;
+            pthread_mutex_unlock(&up.lock);
+        }
+    }
+
+    if (fd >= 0) {
+        if (config.proto == UPLINK_MQTT) {
+            static const uint8_t disconnect[] = { 0xE0, 0 };
+            send_all(fd, disconnect, sizeof(disconnect));
+        }
+        close(fd);
+    }
+    return NULL;
+}
+
+/*********************************
+ * PUBLIC API
+ *********************************/
+
+void uplink_default_config(struct uplink_config *cfg)
+{
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->queue_dir = UPLINK_QUEUE_DIR;
+    cfg->batch_count = 60;
+    cfg->batch_sec = 300;
+    cfg->queue_max = 16 * 1024 * 1024;
+    if (gethostname(cfg->node, sizeof(cfg->node) - 1) != 0 || cfg->node[0] == '\0') {
+        snprintf(cfg->node, sizeof(cfg->node), "board");
+    }
+}
+
+int uplink_parse_url(const char *url, struct uplink_config *cfg)
+{
+    const char *rest;
+
+    if (strncmp(url, "tcp://", 6) == 0) {
+        cfg->proto = UPLINK_TCP;
+        rest = url + 6;
+    } else if (strncmp(url, "mqtt://", 7) == 0) {
+        cfg->proto = UPLINK_MQTT;
+        rest = url + 7;
+        snprintf(cfg->topic, sizeof(cfg->topic), "sensor_monitor/batch");
+    } else {
+        return -1;
+    }
+
+    const char *slash = strchr(rest, '/');
+    const char *colon = strrchr(rest, ':');
+    size_t host_len = (colon && (!slash || colon < slash) ? colon : slash ? slash : rest + strlen(rest)) - rest;
+
+    if (host_len == 0 || host_len >= sizeof(cfg->host)) {
+        return -1;
+    }
+    memcpy(cfg->host, rest, host_len);
+    cfg->host[host_len] = '\0';
+
+    if (colon && (!slash || colon < slash)) {
+        size_t port_len = (slash ? slash : colon + strlen(colon)) - colon - 1;
+        if (port_len == 0 || port_len >= sizeof(cfg->port)) {
+            return -1;
+        }
+        memcpy(cfg->port, colon + 1, port_len);
+        cfg->port[port_len] = '\0';
+    } else {
+        snprintf(cfg->port, sizeof(cfg->port), cfg->proto == UPLINK_MQTT ? "1883" : "7878");
+    }
+
+    if (slash && slash[1] != '\0') {
+        if (cfg->proto != UPLINK_MQTT) {
+            return -1;
+        }
+        snprintf(cfg->topic, sizeof(cfg->topic), "%s", slash + 1);
+    }
+    return 0;
+}
+
+int uplink_start(const struct uplink_config *cfg)
+{
+    config = *cfg;
+    if (config.batch_count == 0 || config.batch_count > BATCH_MAX_SAMPLES) {
+        config.batch_count = BATCH_MAX_SAMPLES;
+    }
+
+    if (mkdir(config.queue_dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "mkdir %s: %s\n", config.queue_dir, strerror(errno));
+        return -1;
+    }
+    if (queue_load() != 0) {
+        return -1;
+    }
+
+    unsigned int queued = up.count;
+
+    up.wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (up.wake_fd < 0) {
+        perror("eventfd");
+        return -1;
+    }
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, UPLINK_STACK);
+    int err = pthread_create(&up.thread, &attr, sender_main, NULL);
+    pthread_attr_destroy(&attr);
+    if (err != 0) {
+        fprintf(stderr, "uplink: failed to start sender thread\n");
+        close(up.wake_fd);
+        up.wake_fd = -1;
+        return -1;
+    }
+    up.running = 1;
+
+    printf("Uplink: %s://%s:%s%s%s, batch %u samples / %u s, queue %s (%u pending)\n",
+           config.proto == UPLINK_MQTT ? "mqtt" : "tcp", config.host, config.port,
+           config.proto == UPLINK_MQTT ? "/" : "", config.proto == UPLINK_MQTT ? config.topic : "",
+           config.batch_count, config.batch_sec, config.queue_dir, queued);
+    return 0;
+}
+
+int uplink_push(const struct sensor_sample *sample)
+{
+    if (!up.running) {
+        return -1;
+    }
+
+    // Batch theo thoi gian cua mau (replay van cat batch dung nhu luc chay that)
+    if (npending > 0 && sample->t_ms - pending[0].t_ms >= (int64_t)config.batch_sec * 1000) {
+        flush_batch();
+    }
+
+    pending[npending++] = *sample;
+    pthread_mutex_lock(&up.lock);
+    up.stats.samples++;
+    pthread_mutex_unlock(&up.lock);
+
+    if (npending >= config.batch_count) {
+        return flush_batch();
+    }
+    return 0;
+}
+
+void uplink_stop(void)
+{
+    if (!up.running) {
+        return;
+    }
+
+    flush_batch();
+
+    // Link dang len: cho queue gui het mot chut truoc khi dung
+    for (int i = 0; i < UPLINK_IO_TIMEOUT * 100; i++) {
+        pthread_mutex_lock(&up.lock);
+        int busy = up.connected && up.count > 0;
+        pthread_mutex_unlock(&up.lock);
+        if (!busy) {
+            break;
+        }
+        usleep(10000);
+    }
+
+    pthread_mutex_lock(&up.lock);
+    up.stopping = 1;
+    pthread_mutex_unlock(&up.lock);
+    eventfd_write(up.wake_fd, 1);
+    pthread_join(up.thread, NULL);
+
+    close(up.wake_fd);
+    up.wake_fd = -1;
+    up.running = 0;
+    free(up.q);
+    up.q = NULL;
+    up.count = up.cap = 0;
+}
+
+void uplink_get_stats(struct uplink_stats *stats)
+{
+    pthread_mutex_lock(&up.lock);
+    *stats = up.stats;
+    pthread_mutex_unlock(&up.lock);
+}
@@ -0,0 +1,1102 @@
+#define _GNU_SOURCE // accept4(), recvmmsg(), sendmmsg()
+#include "batch.h"
+#include "record.h"
+#include "sample.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/*
+ * Collector for many env_monitor_app nodes (--uplink tcp://...).
+ *
+ * Every worker thread owns an epoll set with its own SO_REUSEPORT TCP
+ * listener and UDP socket, so the kernel spreads connections and datagrams
+ * over the workers and nothing is shared on the receive path. Batches are
+ * decoded with the uplink codec (batch.h) and appended as framed records
+ * (record.h) to DIR/<node>/sensor_data_YYYY-MM-DD.log, the same files the
+ * logger writes, so --replay works on them. Records are buffered per node
+ * and written once per epoll round; acks go out after that write.
+ *
+ * The node table (open addressing, CAS insert, never shrinks) and each
+ * node's latest sample / last-hour statistics (seqlock) are read without
+ * locks by the status socket. Writers of one node serialize on its mutex,
+ * which is uncontended unless the node talks to two workers at once.
+ *
+ * UDP: one datagram = hello frame + batch frame, acked to the sender.
+ */
+
+#define COLLECTOR_PORT      "7878"
+#define COLLECTOR_DATA_DIR  "/var/lib/sensor_monitor/nodes"
+#define MAX_EVENTS          64
+#define UDP_BATCH           32
+#define UDP_MAX             65536
+#define NODE_BUF_SIZE       (16 * 1024)
+#define STATS_MINUTES       60
+#define TOUCHED_MAX         256
+#define ACKS_MAX            64
+#define CONN_BUF_MIN        (16 * 1024)
+#define FRAME_MAX           (BATCH_HEAD_LEN + BATCH_ENCODED_MAX(BATCH_MAX_SAMPLES))
+
+/*********************************
+ * NODE TABLE
+ *********************************/
+
+struct minute_stats {
+    int64_t minute;                 // t_ms / 60000
+    uint32_t count[SAMPLE_CHANNELS];
+    int32_t min[SAMPLE_CHANNELS];
+    int32_t max[SAMPLE_CHANNELS];
+    int64_t sum[SAMPLE_CHANNELS];
+};
+
+struct node {
+    char name[BATCH_NODE_MAX];
+
+    // Phia ghi: giu lock
+    pthread_mutex_t lock;
+    int fd;
+    char date[11];                  // ngay cua file dang mo
+    uint32_t seq;                   // seq record cuoi trong file
+    int64_t last_ms;                // mau cu hon / trung (gui lai) bi bo
+    size_t len;
+    char *buf;
+
+    // Phia doc khong lock: seqlock, chi ghi khi giu lock
+    _Atomic uint32_t version;
+    uint64_t samples;
+    struct sensor_sample latest;
+    struct minute_stats ring[STATS_MINUTES];
+};
+
+static struct {
+    _Atomic(struct node *) *slots;
+    size_t mask;
+    _Atomic unsigned int count;
+    unsigned int max;
+} table;
+
+static const char *data_dir = COLLECTOR_DATA_DIR;
+
+static uint32_t name_hash(const char *s)
+{
+    uint32_t h = 2166136261u;   // FNV-1a
+    while (*s) {
+        h = (h ^ (uint8_t)*s++) * 16777619u;
+    }
+    return h;
+}
+
+static int table_init(unsigned int max)
+{
+    size_t size = 64;
+    while (size < 2 * (size_t)max) {
+        size *= 2;
+    }
+    table.slots = calloc(size, sizeof(*table.slots));
+    if (!table.slots) {
+        return -1;
+    }
+    table.mask = size - 1;
+    table.max = max;
+    return 0;
+}
+
+static struct node *node_new(const char *name)
+{
+    struct node *n = calloc(1, sizeof(*n));
+    char path[512];
+
+    if (!n || !(n->buf = malloc(NODE_BUF_SIZE))) {
+        free(n);
+        return NULL;
+    }
+    snprintf(n->name, sizeof(n->name), "%s", name);
+    pthread_mutex_init(&n->lock, NULL);
+    n->fd = -1;
+    n->last_ms = INT64_MIN;
+
+    snprintf(path, sizeof(path), "%s/%s", data_dir, name);
+    if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "mkdir %s: %s\n", path, strerror(errno));
+    }
+    return n;
+}
+
+static void node_free(struct node *n)
+{
+    pthread_mutex_destroy(&n->lock);
+    free(n->buf);
+    free(n);
+}
+
+// Tim node theo ten, them neu chua co; NULL neu bang day
+static struct node *node_get(const char *name)
+{
+    struct node *fresh = NULL;
+
+    for (size_t i = name_hash(name) & table.mask;; i = (i + 1) & table.mask) {
+        struct node *n = atomic_load_explicit(&table.slots[i], memory_order_acquire);
+
+        while (!n) {
+            if (!fresh) {
+                if (atomic_fetch_add(&table.count, 1) >= table.max) {
+                    atomic_fetch_sub(&table.count, 1);
+                    return NULL;
+                }
+                if (!(fresh = node_new(name))) {
+                    atomic_fetch_sub(&table.count, 1);
+                    return NULL;
+                }
+            }
+            if (atomic_compare_exchange_strong(&table.slots[i], &n, fresh)) {
+                return fresh;
+            }
+            // Thread khac vua chiem slot: n la node cua no, so ten ben duoi
+        }
+        if (strcmp(n->name, name) == 0) {
+            if (fresh) {
+                node_free(fresh);
+                atomic_fetch_sub(&table.count, 1);
+            }
+            return n;
+        }
+    }
+}
+
+// Ky tu an toan cho ten thu muc; ten rong / bat dau bang '.' bi doi
+static void sanitize_name(const uint8_t *in, size_t len, char *out)
+{
+    if (len > BATCH_NODE_MAX - 1) {
+        len = BATCH_NODE_MAX - 1;
+    }
+    for (size_t i = 0; i < len; i++) {
+        char c = (char)in[i];
+        int ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                 (c >= '0' && c <= '9') || c == '-' || c == '_' || c == '.';
+        out[i] = ok ? c : '_';
+    }
+    out[len] = '\0';
+    if (len == 0) {
+        snprintf(out, BATCH_NODE_MAX, "unnamed");
+    } else if (out[0] == '.') {
+        out[0] = '_';
+    }
+}
+
+/*********************************
+ * NODE FILES
+ *********************************/
+
+// "YYYY-MM-DD HH:" cho gio dang xet; localtime_r chi goi mot lan / gio
+struct clock_cache {
+    int64_t hour_start, hour_end;
+    char prefix[16];
+};
+
+static void format_time(struct clock_cache *cc, int64_t sec, char ts[20], char date[11])
+{
+    if (sec < cc->hour_start || sec >= cc->hour_end) {
+        time_t t = (time_t)sec;
+        struct tm tm;
+
+        localtime_r(&t, &tm);
+        strftime(cc->prefix, sizeof(cc->prefix), "%Y-%m-%d %H:", &tm);
+        cc->hour_start = sec - tm.tm_min * 60 - tm.tm_sec;
+        cc->hour_end = cc->hour_start + 3600;
+    }
+
+    int rem = (int)(sec - cc->hour_start);
+    memcpy(ts, cc->prefix, 14);
+    ts[14] = (char)('0' + rem / 600);
+    ts[15] = (char)('0' + rem / 60 % 10);
+    ts[16] = ':';
+    ts[17] = (char)('0' + rem % 60 / 10);
+    ts[18] = (char)('0' + rem % 10);
+    ts[19] = '\0';
+    memcpy(date, ts, 10);
+    date[10] = '\0';
+}
+
+// Ghi buffer cua node (goi khi giu lock); tra ve so byte da ghi
+static size_t node_flush(struct node *n)
+{
+    size_t done = 0;
+
+    while (n->fd >= 0 && done < n->len) {
+        ssize_t w = write(n->fd, n->buf + done, n->len - done);
+        if (w < 0 && errno == EINTR) {
+            continue;
+        }
+        if (w <= 0) {
+            fprintf(stderr, "write %s/%s: %s\n", n->name, n->date, strerror(errno));
+            break;
+        }
+        done += w;
+    }
+    n->len = 0;
+    return done;
+}
+
+// Thoi diem cuoi giay cua record ket thuc tai tail[0, end)
+static int64_t record_end_ms(const char *tail, size_t end)
+{
+    struct record_view view;
+    struct tm tm = { .tm_isdst = -1 };
+    char ts[20];
+    size_t start = end - 1;
+
+    while (start > 0 && tail[start - 1] != '\n') {
+        start--;
+    }
+    if (record_parse(tail + start, end - start, &view) != 0 || view.timestamp_len != 19) {
+        return INT64_MIN;
+    }
+    memcpy(ts, view.timestamp, 19);
+    ts[19] = '\0';
+    if (!strptime(ts, "%Y-%m-%d %H:%M:%S", &tm)) {
+        return INT64_MIN;
+    }
+    return ((int64_t)mktime(&tm) + 1) * 1000 - 1;
+}
+
+/*
+ * Mo file cua ngay date, tiep tuc seq tu record cuoi (nhu logger khi mo lai)
+ * va khong ghi lai mau cu hon record do (batch gui lai sau khi restart).
+ */
+static void node_open(struct node *n, const char *date)
+{
+    char path[512], tail[4096];
+    struct stat st;
+
+    if (n->fd >= 0) {
+        close(n->fd);
+    }
+    memcpy(n->date, date, sizeof(n->date));
+    n->seq = 0;
+
+    snprintf(path, sizeof(path), "%s/%s/sensor_data_%s.log", data_dir, n->name, date);
+    n->fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (n->fd < 0) {
+        fprintf(stderr, "open %s: %s\n", path, strerror(errno));
+        return;
+    }
+
+    if (fstat(n->fd, &st) == 0 && st.st_size > 0) {
+        int rfd = open(path, O_RDONLY | O_CLOEXEC);
+        off_t off = st.st_size > (off_t)sizeof(tail) ? st.st_size - (off_t)sizeof(tail) : 0;
+        ssize_t got = rfd >= 0 ? pread(rfd, tail, st.st_size - off, off) : -1;
+        uint32_t seq;
+
+        ssize_t end = got > 0 ? record_scan_back(tail, got, &seq) : -1;
+        if (end > 0) {
+            int64_t last_ms = record_end_ms(tail, end);
+            n->seq = seq;
+            if (last_ms > n->last_ms) {
+                n->last_ms = last_ms;
+            }
+        }
+        if (rfd >= 0) {
+            close(rfd);
+        }
+    }
+}
+
+static void stats_add(struct node *n, const struct sensor_sample *s)
+{
+    int64_t minute = s->t_ms / 60000;
+    struct minute_stats *m = &n->ring[minute % STATS_MINUTES];
+
+    if (m->minute != minute) {
+        memset(m, 0, sizeof(*m));
+        m->minute = minute;
+    }
+    for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+        if (!(s->valid & (1u << c))) {
+            continue;
+        }
+        int32_t v = s->value[c];
+        if (m->count[c] == 0 || v < m->min[c]) {
+            m->min[c] = v;
+        }
+        if (m->count[c] == 0 || v > m->max[c]) {
+            m->max[c] = v;
+        }
+        m->count[c]++;
+        m->sum[c] += v;
+    }
+}
+
+/*
+ * Ghi mau vao buffer record cua node va cap nhat bang latest/stats.
+ * Tra ve so mau moi (mau khong moi hon mau cuoi bi bo: batch gui lai).
+ */
+static unsigned int node_ingest(struct node *n, struct clock_cache *cc,
+                                const struct sensor_sample *s, unsigned int count,
+                                uint64_t *written)
+{
+    uint64_t keep[BATCH_MAX_SAMPLES / 64] = { 0 };
+    unsigned int fresh = 0;
+
+    pthread_mutex_lock(&n->lock);
+
+    for (unsigned int i = 0; i < count; i++) {
+        char ts[20], date[11], sht30[32], bh1750[32], text[64];
+
+        if (s[i].t_ms <= n->last_ms) {
+            continue;
+        }
+        format_time(cc, s[i].t_ms / 1000, ts, date);
+        if (n->fd < 0 || strcmp(date, n->date) != 0) {
+            *written += node_flush(n);
+            node_open(n, date);
+            if (s[i].t_ms <= n->last_ms) {
+                continue;
+            }
+        }
+        n->last_ms = s[i].t_ms;
+
+        if (n->len + RECORD_MAX_LEN > NODE_BUF_SIZE) {
+            *written += node_flush(n);
+        }
+
+        sample_format(&s[i], sht30, sizeof(sht30), bh1750, sizeof(bh1750));
+        snprintf(text, sizeof(text), "%s-%s", sht30, bh1750);
+        int len = record_format(n->buf + n->len, NODE_BUF_SIZE - n->len, ts, text, n->seq + 1);
+        if (len > 0) {
+            n->len += len;
+            n->seq++;
+        }
+        keep[i / 64] |= 1ull << (i % 64);
+        fresh++;
+    }
+
+    // Seqlock chi bao phan bang, khong bao write(): reader khong phai cho I/O
+    if (fresh > 0) {
+        uint32_t v = atomic_load_explicit(&n->version, memory_order_relaxed);
+        atomic_store_explicit(&n->version, v + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+
+        for (unsigned int i = 0; i < count; i++) {
+            if (keep[i / 64] & (1ull << (i % 64))) {
+                n->latest = s[i];
+                n->samples++;
+                stats_add(n, &s[i]);
+            }
+        }
+
+        atomic_store_explicit(&n->version, v + 2, memory_order_release);
+    }
+
+    pthread_mutex_unlock(&n->lock);
+    return fresh;
+}
+
+/*
+ * Chup latest + stats 60 phut cua node khong lock: doc lai neu writer chen
+ * vao giua (version le hoac doi).
+ */
+static void node_snapshot(struct node *n, uint64_t *samples, struct sensor_sample *latest,
+                          struct minute_stats ring[STATS_MINUTES])
+{
+    for (;;) {
+        uint32_t v = atomic_load_explicit(&n->version, memory_order_acquire);
+        if (v & 1) {
+            sched_yield();
+            continue;
+        }
+        *samples = n->samples;
+        *latest = n->latest;
+        memcpy(ring, n->ring, sizeof(n->ring));
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&n->version, memory_order_relaxed) == v) {
+            return;
+        }
+    }
+}
+
+/*********************************
+ * WORKERS
+ *********************************/
+
+enum conn_kind { CONN_LISTEN, CONN_UDP, CONN_TCP };
+
+struct conn {
+    enum conn_kind kind;
+    int fd;
+    int dead;
+    struct node *node;
+    char peer[INET6_ADDRSTRLEN];
+    uint8_t *buf;
+    size_t len, cap;
+    uint8_t acks[8 * ACKS_MAX];
+    unsigned int nacks;
+};
+
+struct worker_stats {
+    _Atomic uint64_t samples;
+    _Atomic uint64_t batches;
+    _Atomic uint64_t duplicates;    // mau bi bo vi da co
+    _Atomic uint64_t bad_frames;
+    _Atomic uint64_t bytes;         // byte record da ghi
+    _Atomic uint64_t conns;         // dang mo
+};
+
+struct worker {
+    int id;
+    pthread_t thread;
+    int epfd;
+    struct conn listener, udp;
+    struct clock_cache clock;
+    struct sensor_sample samples[BATCH_MAX_SAMPLES];
+    struct node *touched[TOUCHED_MAX];
+    unsigned int ntouched;
+    struct conn *round[MAX_EVENTS];
+    unsigned int nround;
+
+    // UDP: datagram va ack cua lan recvmmsg hien tai
+    uint8_t (*dgram)[UDP_MAX];
+    struct sockaddr_storage addr[UDP_BATCH];
+    uint8_t ack_buf[UDP_BATCH][8];
+    struct mmsghdr ack_msg[UDP_BATCH];
+    struct iovec ack_iov[UDP_BATCH];
+    unsigned int nudp_acks;
+
+    struct worker_stats stats;
+} __attribute__((aligned(64)));
+
+static volatile sig_atomic_t keep_running = 1;
+
+static void stat_add(_Atomic uint64_t *counter, uint64_t v)
+{
+    // Moi counter chi co mot thread ghi
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + v,
+                          memory_order_relaxed);
+}
+
+// Ghi cac node co du lieu moi trong vong epoll nay (truoc khi ack)
+static void flush_touched(struct worker *w)
+{
+    uint64_t written = 0;
+
+    for (unsigned int i = 0; i < w->ntouched; i++) {
+        struct node *n = w->touched[i];
+        pthread_mutex_lock(&n->lock);
+        written += node_flush(n);
+        pthread_mutex_unlock(&n->lock);
+    }
+    w->ntouched = 0;
+    stat_add(&w->stats.bytes, written);
+}
+
+static void touch(struct worker *w, struct node *n)
+{
+    // Batch lien tiep thuong cung node: chi so voi node cuoi
+    if (w->ntouched > 0 && w->touched[w->ntouched - 1] == n) {
+        return;
+    }
+    if (w->ntouched == TOUCHED_MAX) {
+        flush_touched(w);
+    }
+    w->touched[w->ntouched++] = n;
+}
+
+// Decode + ghi mot batch; -1 neu payload hong
+static int ingest_batch(struct worker *w, struct node *n, const uint8_t *payload, uint32_t len)
+{
+    uint64_t written = 0;
+    int count = batch_decode(payload, len, w->samples, BATCH_MAX_SAMPLES);
+
+    if (count < 0) {
+        stat_add(&w->stats.bad_frames, 1);
+        return -1;
+    }
+    unsigned int fresh = node_ingest(n, &w->clock, w->samples, (unsigned int)count, &written);
+    touch(w, n);
+
+    stat_add(&w->stats.samples, fresh);
+    stat_add(&w->stats.duplicates, (unsigned int)count - fresh);
+    stat_add(&w->stats.batches, 1);
+    stat_add(&w->stats.bytes, written);
+    return 0;
+}
+
+static void conn_close(struct worker *w, struct conn *c)
+{
+    epoll_ctl(w->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    free(c->buf);
+    free(c);
+    stat_add(&w->stats.conns, (uint64_t)-1);
+}
+
+static void conn_send_acks(struct conn *c)
+{
+    size_t len = c->nacks * 8;
+
+    // Ack nho, cua so uplink toi da 8 batch: gui khong het = ket noi hong,
+    // uplink se ket noi lai va gui lai
+    if (len > 0 && send(c->fd, c->acks, len, MSG_NOSIGNAL | MSG_DONTWAIT) != (ssize_t)len) {
+        c->dead = 1;
+    }
+    c->nacks = 0;
+}
+
+static void accept_conns(struct worker *w)
+{
+    for (int i = 0; i < MAX_EVENTS; i++) {
+        struct sockaddr_storage addr;
+        socklen_t alen = sizeof(addr);
+        int fd = accept4(w->listener.fd, (struct sockaddr *)&addr, &alen,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                perror("accept4");
+            }
+            return;
+        }
+
+        struct conn *c = calloc(1, sizeof(*c));
+        if (!c) {
+            close(fd);
+            continue;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        c->kind = CONN_TCP;
+        c->fd = fd;
+        if (addr.ss_family == AF_INET6) {
+            inet_ntop(AF_INET6, &((struct sockaddr_in6 *)&addr)->sin6_addr, c->peer, sizeof(c->peer));
+        } else {
+            inet_ntop(AF_INET, &((struct sockaddr_in *)&addr)->sin_addr, c->peer, sizeof(c->peer));
+        }
+
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP, .data.ptr = c };
+        if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            close(fd);
+            free(c);
+            continue;
+        }
+        stat_add(&w->stats.conns, 1);
+    }
+}
+
+// Xu ly cac frame day du trong c->buf
+static void conn_parse(struct worker *w, struct conn *c)
+{
+    size_t off = 0;
+
+    while (!c->dead && c->len - off >= BATCH_HEAD_LEN) {
+        uint64_t seq;
+        uint32_t len;
+
+        if (batch_get_head(c->buf + off, &seq, &len) != 0 ||
+            BATCH_HEAD_LEN + (size_t)len > FRAME_MAX) {
+            stat_add(&w->stats.bad_frames, 1);
+            c->dead = 1;
+            break;
+        }
+        if (c->len - off < BATCH_HEAD_LEN + (size_t)len) {
+            break;
+        }
+
+        const uint8_t *payload = c->buf + off + BATCH_HEAD_LEN;
+        if (seq == BATCH_SEQ_HELLO) {
+            char name[BATCH_NODE_MAX];
+            sanitize_name(payload, len, name);
+            c->node = node_get(name);
+        } else {
+            // Uplink cu khong gui hello: dung dia chi IP lam ten node
+            if (!c->node) {
+                char name[BATCH_NODE_MAX];
+                sanitize_name((const uint8_t *)c->peer, strlen(c->peer), name);
+                c->node = node_get(name);
+            }
+            if (!c->node || ingest_batch(w, c->node, payload, len) != 0) {
+                c->dead = 1;
+                break;
+            }
+            if (c->nacks == ACKS_MAX) {
+                flush_touched(w);
+                conn_send_acks(c);
+            }
+            batch_put_be(c->acks + 8 * c->nacks++, seq, 8);
+        }
+        if (!c->node) {
+            fprintf(stderr, "collector: node table full, dropping %s\n", c->peer);
+            c->dead = 1;
+        }
+        off += BATCH_HEAD_LEN + len;
+    }
+
+    memmove(c->buf, c->buf + off, c->len - off);
+    c->len -= off;
+}
+
+static void conn_read(struct worker *w, struct conn *c)
+{
+    // Du cho ca frame dang do (toi da FRAME_MAX)
+    size_t need = CONN_BUF_MIN;
+    if (c->len >= BATCH_HEAD_LEN) {
+        uint64_t seq;
+        uint32_t len;
+        if (batch_get_head(c->buf, &seq, &len) == 0 && BATCH_HEAD_LEN + (size_t)len <= FRAME_MAX &&
+            BATCH_HEAD_LEN + (size_t)len > need) {
+            need = BATCH_HEAD_LEN + len;
+        }
+    }
+    if (c->cap < need) {
+        uint8_t *buf = realloc(c->buf, need);
+        if (!buf) {
+            c->dead = 1;
+            return;
+        }
+        c->buf = buf;
+        c->cap = need;
+    }
+
+    ssize_t n = recv(c->fd, c->buf + c->len, c->cap - c->len, 0);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+        c->dead = 1;
+        return;
+    }
+    if (n > 0) {
+        c->len += n;
+        conn_parse(w, c);
+    }
+}
+
+// Moi datagram: hello + mot hay nhieu batch
+static void udp_read(struct worker *w)
+{
+    struct mmsghdr msgs[UDP_BATCH];
+    struct iovec iov[UDP_BATCH];
+
+    for (int i = 0; i < UDP_BATCH; i++) {
+        iov[i] = (struct iovec){ .iov_base = w->dgram[i], .iov_len = UDP_MAX };
+        msgs[i] = (struct mmsghdr){ .msg_hdr = {
+            .msg_name = &w->addr[i], .msg_namelen = sizeof(w->addr[i]),
+            .msg_iov = &iov[i], .msg_iovlen = 1 } };
+    }
+
+    int got = recvmmsg(w->udp.fd, msgs, UDP_BATCH, MSG_DONTWAIT, NULL);
+    for (int i = 0; i < got; i++) {
+        const uint8_t *p = w->dgram[i];
+        size_t left = msgs[i].msg_len;
+        struct node *node = NULL;
+
+        while (left >= BATCH_HEAD_LEN) {
+            uint64_t seq;
+            uint32_t len;
+            if (batch_get_head(p, &seq, &len) != 0 || len > left - BATCH_HEAD_LEN) {
+                stat_add(&w->stats.bad_frames, 1);
+                break;
+            }
+            if (seq == BATCH_SEQ_HELLO) {
+                char name[BATCH_NODE_MAX];
+                sanitize_name(p + BATCH_HEAD_LEN, len, name);
+                node = node_get(name);
+            } else if (node && ingest_batch(w, node, p + BATCH_HEAD_LEN, len) == 0 &&
+                       w->nudp_acks < UDP_BATCH) {
+                unsigned int a = w->nudp_acks++;
+                batch_put_be(w->ack_buf[a], seq, 8);
+                w->ack_iov[a] = (struct iovec){ .iov_base = w->ack_buf[a], .iov_len = 8 };
+                w->ack_msg[a] = (struct mmsghdr){ .msg_hdr = {
+                    .msg_name = &w->addr[i], .msg_namelen = msgs[i].msg_hdr.msg_namelen,
+                    .msg_iov = &w->ack_iov[a], .msg_iovlen = 1 } };
+            }
+            p += BATCH_HEAD_LEN + len;
+            left -= BATCH_HEAD_LEN + len;
+        }
+    }
+}
+
+static void *worker_main(void *arg)
+{
+    struct worker *w = arg;
+    struct epoll_event events[MAX_EVENTS];
+
+    while (keep_running) {
+        int n = epoll_wait(w->epfd, events, MAX_EVENTS, 200);
+
+        w->nround = 0;
+        for (int i = 0; i < n; i++) {
+            struct conn *c = events[i].data.ptr;
+
+            if (c->kind == CONN_LISTEN) {
+                accept_conns(w);
+            } else if (c->kind == CONN_UDP) {
+                udp_read(w);
+            } else {
+                if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                    conn_read(w, c);
+                }
+                w->round[w->nround++] = c;
+            }
+        }
+
+        // Ghi file mot lan cho ca vong, roi moi ack
+        flush_touched(w);
+        for (unsigned int i = 0; i < w->nround; i++) {
+            struct conn *c = w->round[i];
+            if (!c->dead) {
+                conn_send_acks(c);
+            }
+            if (c->dead) {
+                conn_close(w, c);
+            }
+        }
+        if (w->nudp_acks > 0) {
+            sendmmsg(w->udp.fd, w->ack_msg, w->nudp_acks, MSG_DONTWAIT);
+            w->nudp_acks = 0;
+        }
+    }
+    return NULL;
+}
+
+static int bind_socket(const struct addrinfo *ai, int type)
+{
+    int one = 1;
+    int fd = socket(ai->ai_family, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+    if (bind(fd, ai->ai_addr, ai->ai_addrlen) != 0 ||
+        (type == SOCK_STREAM && listen(fd, SOMAXCONN) != 0)) {
+        perror("bind/listen");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int worker_init(struct worker *w, int id, const struct addrinfo *ai)
+{
+    struct epoll_event ev = { .events = EPOLLIN };
+
+    w->id = id;
+    w->dgram = malloc((size_t)UDP_BATCH * UDP_MAX);
+    w->epfd = epoll_create1(EPOLL_CLOEXEC);
+    w->listener = (struct conn){ .kind = CONN_LISTEN, .fd = bind_socket(ai, SOCK_STREAM) };
+    w->udp = (struct conn){ .kind = CONN_UDP, .fd = bind_socket(ai, SOCK_DGRAM) };
+    if (!w->dgram || w->epfd < 0 || w->listener.fd < 0 || w->udp.fd < 0) {
+        return -1;
+    }
+
+    ev.data.ptr = &w->listener;
+    epoll_ctl(w->epfd, EPOLL_CTL_ADD, w->listener.fd, &ev);
+    ev.data.ptr = &w->udp;
+    epoll_ctl(w->epfd, EPOLL_CTL_ADD, w->udp.fd, &ev);
+    return 0;
+}
+
+/*********************************
+ * STATUS / REPORT
+ *********************************/
+
+// Mot dong / node: latest va min/avg/max 60 phut gan nhat moi channel
+static void dump_status(int fd)
+{
+    struct minute_stats ring[STATS_MINUTES];
+    struct sensor_sample latest;
+    uint64_t samples;
+
+    dprintf(fd, "# node samples last_ms");
+    for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+        dprintf(fd, " %s(now,min,avg,max)", sample_channel_names[c]);
+    }
+    dprintf(fd, "\n");
+
+    for (size_t i = 0; i <= table.mask; i++) {
+        struct node *n = atomic_load_explicit(&table.slots[i], memory_order_acquire);
+        if (!n) {
+            continue;
+        }
+        node_snapshot(n, &samples, &latest, ring);
+
+        dprintf(fd, "%s %llu %lld", n->name, (unsigned long long)samples, (long long)latest.t_ms);
+        int64_t now_min = latest.t_ms / 60000;
+        for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+            uint64_t count = 0;
+            int64_t sum = 0;
+            int32_t lo = 0, hi = 0;
+
+            for (int m = 0; m < STATS_MINUTES; m++) {
+                if (ring[m].minute <= now_min - STATS_MINUTES || ring[m].count[c] == 0) {
+                    continue;
+                }
+                if (count == 0 || ring[m].min[c] < lo) {
+                    lo = ring[m].min[c];
+                }
+                if (count == 0 || ring[m].max[c] > hi) {
+                    hi = ring[m].max[c];
+                }
+                count += ring[m].count[c];
+                sum += ring[m].sum[c];
+            }
+            if (!(latest.valid & (1u << c)) || count == 0) {
+                dprintf(fd, " -");
+                continue;
+            }
+            dprintf(fd, " %.1f,%.1f,%.1f,%.1f", latest.value[c] / 1000.0, lo / 1000.0,
+                    (double)sum / count / 1000.0, hi / 1000.0);
+        }
+        dprintf(fd, "\n");
+    }
+}
+
+static int status_listen(const char *path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Status socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    unlink(path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 8) != 0) {
+        perror("status socket");
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+static void sum_stats(struct worker *workers, int count, uint64_t out[6])
+{
+    memset(out, 0, 6 * sizeof(*out));
+    for (int i = 0; i < count; i++) {
+        struct worker_stats *st = &workers[i].stats;
+        out[0] += atomic_load_explicit(&st->samples, memory_order_relaxed);
+        out[1] += atomic_load_explicit(&st->batches, memory_order_relaxed);
+        out[2] += atomic_load_explicit(&st->bytes, memory_order_relaxed);
+        out[3] += atomic_load_explicit(&st->duplicates, memory_order_relaxed);
+        out[4] += atomic_load_explicit(&st->bad_frames, memory_order_relaxed);
+        out[5] += atomic_load_explicit(&st->conns, memory_order_relaxed);
+    }
+}
+
+/*********************************
+ * MAIN
+ *********************************/
+
+static void signal_handler(int sig)
+{
+    (void)sig;
+    keep_running = 0;
+}
+
+static void print_usage(const char *prog)
+{
+    printf("Usage: %s [options]\n"
+           "  -l, --listen HOST:PORT   TCP + UDP address (default 0.0.0.0:" COLLECTOR_PORT ")\n"
+           "  -d, --data-dir DIR       per-node logs (default " COLLECTOR_DATA_DIR ")\n"
+           "  -w, --workers N          worker threads (default: online CPUs)\n"
+           "  -n, --max-nodes N        node table size (default 4096)\n"
+           "  -s, --status PATH        Unix socket: latest + last hour stats per node\n"
+           "  -i, --report SEC         print throughput every SEC seconds (default 10, 0 = off)\n"
+           "  -h, --help               show this help\n",
+           prog);
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct option long_opts[] = {
+        { "listen",    required_argument, NULL, 'l' },
+        { "data-dir",  required_argument, NULL, 'd' },
+        { "workers",   required_argument, NULL, 'w' },
+        { "max-nodes", required_argument, NULL, 'n' },
+        { "status",    required_argument, NULL, 's' },
+        { "report",    required_argument, NULL, 'i' },
+        { "help",      no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    char host[128] = "0.0.0.0", port[16] = COLLECTOR_PORT;
+    int nworkers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned int max_nodes = 4096;
+    const char *status_path = NULL;
+    int report_sec = 10;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "l:d:w:n:s:i:h", long_opts, NULL)) != -1) {
+        switch (opt) {
+        case 'l': {
+            const char *colon = strrchr(optarg, ':');
+            if (!colon || colon == optarg || (size_t)(colon - optarg) >= sizeof(host)) {
+                fprintf(stderr, "Invalid listen address: %s\n", optarg);
+                return 1;
+            }
+            snprintf(host, sizeof(host), "%.*s", (int)(colon - optarg), optarg);
+            snprintf(port, sizeof(port), "%s", colon + 1);
+            break;
+        }
+        case 'd':
+            data_dir = optarg;
+            break;
+        case 'w':
+            nworkers = atoi(optarg);
+            break;
+        case 'n':
+            max_nodes = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            status_path = optarg;
+            break;
+        case 'i':
+            report_sec = atoi(optarg);
+            break;
+        case 'h':
+            print_usage(argv[0]);
+            return 0;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (nworkers < 1 || max_nodes < 1) {
+        fprintf(stderr, "Invalid --workers / --max-nodes\n");
+        return 1;
+    }
+
+    // Moi node giu mot file mo, moi ket noi mot socket
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    if (mkdir(data_dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "mkdir %s: %s\n", data_dir, strerror(errno));
+        return 1;
+    }
+    if (table_init(max_nodes) != 0) {
+        perror("calloc");
+        return 1;
+    }
+
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_flags = AI_PASSIVE }, *ai;
+    if (getaddrinfo(host, port, &hints, &ai) != 0) {
+        fprintf(stderr, "Cannot resolve %s:%s\n", host, port);
+        return 1;
+    }
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+    signal(SIGPIPE, SIG_IGN);
+
+    struct worker *workers = aligned_alloc(64, sizeof(*workers) * nworkers);
+    if (!workers) {
+        perror("aligned_alloc");
+        return 1;
+    }
+    memset(workers, 0, sizeof(*workers) * nworkers);
+    for (int i = 0; i < nworkers; i++) {
+        if (worker_init(&workers[i], i, ai) != 0) {
+            fprintf(stderr, "Failed to set up worker %d\n", i);
+            return 1;
+        }
+    }
+    freeaddrinfo(ai);
+
+    int status_fd = status_path ? status_listen(status_path) : -1;
+    if (status_path && status_fd < 0) {
+        return 1;
+    }
+
+    for (int i = 0; i < nworkers; i++) {
+        if (pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]) != 0) {
+            fprintf(stderr, "Failed to start worker %d\n", i);
+            return 1;
+        }
+    }
+    printf("Collector on %s:%s (tcp+udp), %d worker(s), data in %s\n", host, port, nworkers, data_dir);
+
+    struct timespec t0, t_last;
+    uint64_t last[6];
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    t_last = t0;
+    sum_stats(workers, nworkers, last);
+
+    while (keep_running) {
+        struct pollfd pfd = { .fd = status_fd, .events = POLLIN };
+        if (poll(&pfd, status_fd >= 0 ? 1 : 0, 1000) > 0) {
+            int fd = accept4(status_fd, NULL, NULL, SOCK_CLOEXEC);
+            if (fd >= 0) {
+                dump_status(fd);
+                close(fd);
+            }
+        }
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double dt = (now.tv_sec - t_last.tv_sec) + (now.tv_nsec - t_last.tv_nsec) / 1e9;
+        if (report_sec > 0 && dt >= report_sec) {
+            uint64_t cur[6];
+            sum_stats(workers, nworkers, cur);
+            printf("Collector: %u nodes, %llu conns, %.0f samples/s, %.0f batches/s, %.2f MiB/s written\n",
+                   atomic_load(&table.count), (unsigned long long)cur[5],
+                   (cur[0] - last[0]) / dt, (cur[1] - last[1]) / dt,
+                   (cur[2] - last[2]) / dt / (1024 * 1024));
+            fflush(stdout);
+            memcpy(last, cur, sizeof(last));
+            t_last = now;
+        }
+    }
+
+    for (int i = 0; i < nworkers; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    for (size_t i = 0; i <= table.mask; i++) {
+        struct node *n = atomic_load(&table.slots[i]);
+        if (n) {
+            node_flush(n);
+            if (n->fd >= 0) {
+                close(n->fd);
+            }
+        }
+    }
+    if (status_fd >= 0) {
+        close(status_fd);
+        unlink(status_path);
+    }
+
+    uint64_t total[6];
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    sum_stats(workers, nworkers, total);
+    double wall = (end.tv_sec - t0.tv_sec) + (end.tv_nsec - t0.tv_nsec) / 1e9;
+    printf("Collector: %u nodes, %llu samples in %llu batches (%.0f samples/s), "
+           "%llu bytes written, %llu duplicate(s), %llu bad frame(s)\n",
+           atomic_load(&table.count), (unsigned long long)total[0], (unsigned long long)total[1],
+           total[0] / wall, (unsigned long long)total[2], (unsigned long long)total[3],
+           (unsigned long long)total[4]);
+    return 0;
+}
@@ -0,0 +1,140 @@
+#include "display_data.h"
+#include "ioring.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/resource.h>
+
+/*
+ * Per-cycle I/O cost of the monitor loop: blocking open/read/close per
+ * sensor, OLED and log record vs the io_uring path (--io-uring). Runs the
+ * real display_data() + log_sensor_sample() back to back, without the
+ * sample period, against /dev/sht30_sensor, /dev/bh1750_sensor and
+ * /dev/oled_ssd1306 (plain files will do on a dev host, but only the real
+ * drivers show the reads overlapping).
+ */
+
+#define BLOCKING_SYSCALLS   12      // 2 x open/read/close, 2 x open/write/close
+
+struct result {
+    double us;                  // moi chu ky
+    double csw;                 // context switch moi chu ky
+    double enters;              // io_uring_enter moi chu ky
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static long context_switches(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_nvcsw + ru.ru_nivcsw;
+}
+
+static void run(unsigned int cycles, struct result *out)
+{
+    struct ioring_stats before, after;
+    long csw = context_switches();
+
+    ioring_get_stats(&before);
+    uint64_t t0 = now_ns();
+    for (unsigned int i = 0; i < cycles; i++) {
+        display_data();
+        const struct sensor_sample *sample = display_sample();
+        if (sample) {
+            log_sensor_sample(sample);
+        }
+        if (ioring_active()) {
+            ioring_submit(0);
+        }
+    }
+    if (ioring_active()) {
+        ioring_wait(~0u);
+    }
+    uint64_t ns = now_ns() - t0;
+    ioring_get_stats(&after);
+
+    out->us = ns / 1e3 / cycles;
+    out->csw = (double)(context_switches() - csw) / cycles;
+    out->enters = (double)(after.enters - before.enters) / cycles;
+}
+
+static void print_usage(const char *prog)
+{
+    printf("Usage: %s [options]\n"
+           "  -n, --cycles N           cycles per mode (default 10000)\n"
+           "  -d, --log-dir DIR        scratch log directory (default /tmp/env_iobench)\n"
+           "  -h, --help               show this help\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct option long_opts[] = {
+        { "cycles",  required_argument, NULL, 'n' },
+        { "log-dir", required_argument, NULL, 'd' },
+        { "help",    no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    struct logger_config log_cfg;
+    unsigned int cycles = 10000;
+    int c;
+
+    logger_default_config(&log_cfg);
+    log_cfg.log_dir = "/tmp/env_iobench";
+
+    while ((c = getopt_long(argc, argv, "n:d:h", long_opts, NULL)) != -1) {
+        switch (c) {
+        case 'n': cycles = strtoul(optarg, NULL, 0); break;
+        case 'd': log_cfg.log_dir = optarg; break;
+        case 'h':
+            print_usage(argv[0]);
+            return 0;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (cycles == 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if (logger_init_with(&log_cfg) != 0) {
+        return 1;
+    }
+
+    struct result blocking, ring;
+    run(cycles / 10 + 1, &blocking);            // lam nong page cache / driver
+    run(cycles, &blocking);
+
+    if (ioring_start() != 0) {
+        fprintf(stderr, "io_uring not available\n");
+        logger_close();
+        return 1;
+    }
+    run(cycles / 10 + 1, &ring);
+    run(cycles, &ring);
+
+    logger_close();
+    ioring_stop();
+
+    struct ioring_stats st;
+    ioring_get_stats(&st);
+
+    printf("%-9s %10s %14s %14s\n", "mode", "us/cycle", "syscalls/cycle", "ctxsw/cycle");
+    printf("%-9s %10.2f %14d %14.2f\n", "blocking", blocking.us, BLOCKING_SYSCALLS,
+           blocking.csw);
+    printf("%-9s %10.2f %14.2f %14.2f\n", "io_uring", ring.us, ring.enters, ring.csw);
+    if (st.errors > 0) {
+        printf("io_uring: %llu I/O error(s)\n", (unsigned long long)st.errors);
+    }
+    return 0;
+}
@@ -0,0 +1,881 @@
+#define _GNU_SOURCE
+#include "batch.h"
+#include "logger.h"
+#include "sample.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+/*
+ * Synthetic fleet for sizing the collector and the logger.
+ *
+ * Every virtual node produces SHT30/BH1750-like samples: a diurnal
+ * temperature curve with humidity moving the other way, daylight lux,
+ * sensor noise, and dropouts that read "ERROR" like display_data() does.
+ * Sample time advances by --interval per sample; --rate sets how many
+ * samples per second each node emits in real time (0 = as fast as the
+ * target takes them), so days of data can be pushed in seconds.
+ *
+ * Targets:
+ *   tcp://host:port   one connection per node, hello + batches, like
+ *                     --uplink; latency = batch sent -> ack
+ *   udp://host:port   hello + batch per datagram; unacked after
+ *                     --timeout counts as lost
+ *   log:DIR, flash:DIR  the logger itself (append / flash mode), one
+ *                     node on one thread, since the logger keeps a single
+ *                     day file per DIR; latency = one log_sensor_data_at()
+ *                     call
+ */
+
+#define LOADGEN_WINDOW      8           // batch chua ack toi da / node (nhu uplink)
+#define HIST_SUB            16
+#define HIST_BUCKETS        (64 * HIST_SUB)
+#define DRAIN_SEC           5
+
+enum target_kind { TARGET_TCP, TARGET_UDP, TARGET_LOG };
+
+static struct {
+    enum target_kind kind;
+    char host[128];
+    char port[16];
+    struct logger_config log;
+    unsigned int nodes;
+    unsigned int threads;
+    unsigned int interval_ms;
+    double rate;
+    unsigned int batch;
+    double duration;
+    uint64_t count;
+    double error_rate;
+    unsigned int dropout_len;
+    const char *prefix;
+    uint64_t seed;
+    int64_t start_ms;
+    double timeout;
+} opt = {
+    .kind = TARGET_TCP, .host = "127.0.0.1", .port = "7878",
+    .nodes = 100, .interval_ms = 5000, .rate = -1, .batch = 60, .duration = 10,
+    .error_rate = 0.001, .dropout_len = 12, .prefix = "vnode", .seed = 1, .timeout = 1,
+};
+
+static volatile sig_atomic_t keep_running = 1;
+static long tz_offset;                  // giay, cho duong cong theo gio dia phuong
+
+/*********************************
+ * LATENCY HISTOGRAM
+ *********************************/
+
+// Log-linear: 16 bucket moi luy thua 2 (sai so < 6.25%)
+struct hist {
+    uint64_t count[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t max;
+};
+
+static unsigned int hist_index(uint64_t v)
+{
+    if (v < HIST_SUB) {
+        return (unsigned int)v;
+    }
+    int msb = 63 - __builtin_clzll(v);
+    return (msb - 3) * HIST_SUB + ((v >> (msb - 4)) & (HIST_SUB - 1));
+}
+
+static uint64_t hist_value(unsigned int index)
+{
+    if (index < HIST_SUB) {
+        return index;
+    }
+    int msb = index / HIST_SUB + 3;
+    return (uint64_t)(HIST_SUB + index % HIST_SUB) << (msb - 4);
+}
+
+static void hist_add(struct hist *h, uint64_t v)
+{
+    h->count[hist_index(v)]++;
+    h->total++;
+    if (v > h->max) {
+        h->max = v;
+    }
+}
+
+static void hist_merge(struct hist *dst, const struct hist *src)
+{
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        dst->count[i] += src->count[i];
+    }
+    dst->total += src->total;
+    if (src->max > dst->max) {
+        dst->max = src->max;
+    }
+}
+
+static uint64_t hist_percentile(const struct hist *h, double p)
+{
+    uint64_t rank = (uint64_t)(p / 100 * h->total), seen = 0;
+
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->count[i];
+        if (seen > rank) {
+            return hist_value(i);
+        }
+    }
+    return h->max;
+}
+
+/*********************************
+ * SIGNAL MODEL
+ *********************************/
+
+static uint64_t rng_next(uint64_t *s)
+{
+    *s ^= *s >> 12;     // xorshift64*
+    *s ^= *s << 25;
+    *s ^= *s >> 27;
+    return *s * 2685821657736338717ull;
+}
+
+static double rng_uniform(uint64_t *s)
+{
+    return (rng_next(s) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Xap xi N(0, 1) bang tong 4 bien deu
+static double rng_gauss(uint64_t *s)
+{
+    return (rng_uniform(s) + rng_uniform(s) + rng_uniform(s) + rng_uniform(s) - 2.0) * 1.7320508;
+}
+
+// sin(2*pi*phase), xap xi Bhaskara (khong can libm)
+static double wave(double phase)
+{
+    const double pi = 3.14159265358979;
+    double x;
+    int neg;
+
+    phase -= (double)(int64_t)phase;
+    if (phase < 0) {
+        phase += 1;
+    }
+    neg = phase >= 0.5;
+    x = (neg ? phase - 0.5 : phase) * 2 * pi;
+    double y = 16 * x * (pi - x) / (5 * pi * pi - 4 * x * (pi - x));
+    return neg ? -y : y;
+}
+
+struct vnode {
+    char name[BATCH_NODE_MAX];
+    uint64_t rng;
+    double temp_base, temp_amp;         // °C
+    double hum_base, hum_amp;           // %RH
+    double lux_peak;                    // lx giua trua
+    unsigned int sht30_down, bh1750_down;   // so mau con lai cua dropout
+    int64_t t_ms;                       // thoi diem mau tiep theo
+    uint64_t produced;
+    double phase;                       // lech pha [0, 1) de cac node khong gui cung luc
+
+    struct sensor_sample *batch;
+    unsigned int nbatch;
+
+    // TCP / UDP
+    int fd;
+    uint32_t index;                     // trong thread, nam trong seq UDP
+    uint32_t next_seq;
+    uint8_t ack[8];
+    unsigned int ack_len;
+    unsigned int inflight;
+    uint64_t sent_seq[LOADGEN_WINDOW];
+    uint64_t sent_ns[LOADGEN_WINDOW];
+};
+
+static void vnode_init(struct vnode *n, unsigned int id)
+{
+    snprintf(n->name, sizeof(n->name), "%s-%05u", opt.prefix, id);
+    n->rng = (opt.seed + id) * 0x9E3779B97F4A7C15ull | 1;
+    n->temp_base = 18 + 10 * rng_uniform(&n->rng);
+    n->temp_amp = 2 + 4 * rng_uniform(&n->rng);
+    n->hum_base = 40 + 30 * rng_uniform(&n->rng);
+    n->hum_amp = 5 + 10 * rng_uniform(&n->rng);
+    n->lux_peak = 200 + 20000 * rng_uniform(&n->rng) * rng_uniform(&n->rng);
+    n->t_ms = opt.start_ms;
+    n->phase = (double)id / opt.nodes;
+    n->fd = -1;
+}
+
+static int node_done(const struct vnode *n)
+{
+    return opt.count > 0 && n->produced >= opt.count;
+}
+
+static int node_up(const struct vnode *n)
+{
+    return opt.kind == TARGET_UDP || n->fd >= 0;
+}
+
+// So mau node phai co sau elapsed giay
+static uint64_t node_due(const struct vnode *n, double elapsed)
+{
+    return opt.rate > 0 ? (uint64_t)(elapsed * opt.rate + n->phase) : UINT64_MAX;
+}
+
+static void vnode_sample(struct vnode *n, struct sensor_sample *s, uint64_t *errors)
+{
+    double day = (double)((n->t_ms / 1000 + tz_offset) % 86400) / 86400;
+    double curve = wave(day - 0.375);   // dinh luc 15:00
+    double temp = n->temp_base + n->temp_amp * curve + 0.05 * rng_gauss(&n->rng);
+    double hum = n->hum_base - n->hum_amp * curve + 0.3 * rng_gauss(&n->rng);
+    double lux = 0;
+
+    if (day > 0.25 && day < 0.75) {     // 06:00 - 18:00
+        lux = n->lux_peak * wave(day - 0.25) * (1 + 0.1 * rng_gauss(&n->rng));
+    }
+    hum = hum < 0 ? 0 : hum > 100 ? 100 : hum;
+    lux = lux < 0 ? 0 : lux;
+
+    // Dropout: sensor bao loi trong 1..dropout_len mau
+    if (rng_uniform(&n->rng) < opt.error_rate) {
+        unsigned int len = 1 + (unsigned int)(rng_uniform(&n->rng) * opt.dropout_len);
+        if (rng_uniform(&n->rng) < 0.5) {
+            n->sht30_down = len;
+        } else {
+            n->bh1750_down = len;
+        }
+    }
+
+    s->t_ms = n->t_ms;
+    s->valid = 0;
+    s->value[SAMPLE_TEMP] = (int32_t)(temp * 1000);
+    s->value[SAMPLE_HUM] = (int32_t)(hum * 1000);
+    s->value[SAMPLE_LUX] = (int32_t)(lux * 1000);
+    if (n->sht30_down > 0) {
+        n->sht30_down--;
+        s->value[SAMPLE_TEMP] = s->value[SAMPLE_HUM] = 0;
+        (*errors)++;
+    } else {
+        s->valid |= 1u << SAMPLE_TEMP | 1u << SAMPLE_HUM;
+    }
+    if (n->bh1750_down > 0) {
+        n->bh1750_down--;
+        s->value[SAMPLE_LUX] = 0;
+        (*errors)++;
+    } else {
+        s->valid |= 1u << SAMPLE_LUX;
+    }
+
+    n->t_ms += opt.interval_ms;
+    n->produced++;
+}
+
+/*********************************
+ * GENERATOR THREADS
+ *********************************/
+
+struct gen_thread {
+    pthread_t thread;
+    struct vnode *nodes;
+    unsigned int count;
+    int epfd;
+    int udp_fd;
+    uint8_t *frame;
+
+    struct hist lat;
+    uint64_t samples;
+    uint64_t batches;
+    uint64_t acked;
+    uint64_t lost;
+    uint64_t stalls;            // node muon gui nhung cua so day
+    uint64_t payload_bytes;
+    uint64_t sensor_errors;
+    uint64_t net_errors;
+} __attribute__((aligned(64)));
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int connect_target(int type)
+{
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = type }, *res, *ai;
+    int fd = -1;
+
+    if (getaddrinfo(opt.host, opt.port, &hints, &res) != 0) {
+        return -1;
+    }
+    for (ai = res; ai && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+static int send_all(int fd, const uint8_t *p, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static void node_fail(struct gen_thread *g, struct vnode *n)
+{
+    if (n->fd >= 0 && opt.kind == TARGET_TCP) {
+        epoll_ctl(g->epfd, EPOLL_CTL_DEL, n->fd, NULL);
+        close(n->fd);
+    }
+    n->fd = -1;
+    n->inflight = 0;
+    g->net_errors++;
+}
+
+// Gui batch dang gom cua node (hello truoc moi datagram UDP)
+static void send_batch(struct gen_thread *g, struct vnode *n)
+{
+    uint8_t *p = g->frame;
+    size_t name_len = strlen(n->name);
+    uint64_t seq = (uint64_t)n->index << 32 | ++n->next_seq;
+
+    if (opt.kind == TARGET_UDP) {
+        batch_put_head(p, BATCH_SEQ_HELLO, (uint32_t)name_len);
+        memcpy(p + BATCH_HEAD_LEN, n->name, name_len);
+        p += BATCH_HEAD_LEN + name_len;
+    }
+    size_t len = batch_encode(n->batch, n->nbatch, p + BATCH_HEAD_LEN);
+    batch_put_head(p, seq, (uint32_t)len);
+    p += BATCH_HEAD_LEN + len;
+
+    n->sent_seq[n->inflight] = seq;
+    n->sent_ns[n->inflight] = now_ns();
+    n->inflight++;
+    g->batches++;
+    g->payload_bytes += len;
+    n->nbatch = 0;
+
+    if (opt.kind == TARGET_UDP) {
+        if (send(g->udp_fd, g->frame, p - g->frame, MSG_NOSIGNAL) < 0) {
+            n->inflight--;
+            g->lost++;
+        }
+    } else if (send_all(n->fd, g->frame, p - g->frame) != 0) {
+        node_fail(g, n);
+    }
+}
+
+static void ack_batch(struct gen_thread *g, struct vnode *n, uint64_t seq)
+{
+    for (unsigned int i = 0; i < n->inflight; i++) {
+        if (n->sent_seq[i] == seq) {
+            hist_add(&g->lat, now_ns() - n->sent_ns[i]);
+            memmove(&n->sent_seq[i], &n->sent_seq[i + 1], (n->inflight - i - 1) * sizeof(uint64_t));
+            memmove(&n->sent_ns[i], &n->sent_ns[i + 1], (n->inflight - i - 1) * sizeof(uint64_t));
+            n->inflight--;
+            g->acked++;
+            return;
+        }
+    }
+}
+
+static void read_acks(struct gen_thread *g, int timeout_ms)
+{
+    struct epoll_event events[64];
+    int count = epoll_wait(g->epfd, events, 64, timeout_ms);
+
+    for (int i = 0; i < count; i++) {
+        if (opt.kind == TARGET_UDP) {
+            uint8_t buf[8];
+            while (recv(g->udp_fd, buf, sizeof(buf), MSG_DONTWAIT) == 8) {
+                uint64_t seq = batch_get_be(buf, 8);
+                if ((seq >> 32) < g->count) {
+                    ack_batch(g, &g->nodes[seq >> 32], seq);
+                }
+            }
+            continue;
+        }
+
+        struct vnode *n = events[i].data.ptr;
+        for (;;) {
+            ssize_t got = recv(n->fd, n->ack + n->ack_len, 8 - n->ack_len, MSG_DONTWAIT);
+            if (got == 0 || (got < 0 && errno != EAGAIN && errno != EINTR)) {
+                node_fail(g, n);
+                break;
+            }
+            if (got < 0) {
+                break;
+            }
+            n->ack_len += got;
+            if (n->ack_len == 8) {
+                ack_batch(g, n, batch_get_be(n->ack, 8));
+                n->ack_len = 0;
+            }
+        }
+    }
+}
+
+// UDP: batch qua --timeout khong co ack la mat
+static void expire_udp(struct gen_thread *g, uint64_t now)
+{
+    uint64_t limit = (uint64_t)(opt.timeout * 1e9);
+
+    for (unsigned int i = 0; i < g->count; i++) {
+        struct vnode *n = &g->nodes[i];
+        while (n->inflight > 0 && now - n->sent_ns[0] > limit) {
+            memmove(&n->sent_seq[0], &n->sent_seq[1], (n->inflight - 1) * sizeof(uint64_t));
+            memmove(&n->sent_ns[0], &n->sent_ns[1], (n->inflight - 1) * sizeof(uint64_t));
+            n->inflight--;
+            g->lost++;
+        }
+    }
+}
+
+static int gen_setup(struct gen_thread *g)
+{
+    struct epoll_event ev = { .events = EPOLLIN };
+
+    g->frame = malloc(2 * BATCH_HEAD_LEN + BATCH_NODE_MAX + BATCH_ENCODED_MAX(opt.batch));
+    g->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (!g->frame || g->epfd < 0) {
+        return -1;
+    }
+
+    if (opt.kind == TARGET_UDP) {
+        g->udp_fd = connect_target(SOCK_DGRAM);
+        ev.data.ptr = NULL;
+        return g->udp_fd < 0 ? -1 : epoll_ctl(g->epfd, EPOLL_CTL_ADD, g->udp_fd, &ev);
+    }
+
+    for (unsigned int i = 0; i < g->count; i++) {
+        struct vnode *n = &g->nodes[i];
+        uint8_t hello[BATCH_HEAD_LEN + BATCH_NODE_MAX];
+        size_t len = strlen(n->name);
+        int one = 1;
+
+        n->fd = connect_target(SOCK_STREAM);
+        if (n->fd < 0) {
+            fprintf(stderr, "%s: connect %s:%s: %s\n", n->name, opt.host, opt.port, strerror(errno));
+            return -1;
+        }
+        setsockopt(n->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        batch_put_head(hello, BATCH_SEQ_HELLO, (uint32_t)len);
+        memcpy(hello + BATCH_HEAD_LEN, n->name, len);
+        ev.data.ptr = n;
+        if (send_all(n->fd, hello, BATCH_HEAD_LEN + len) != 0 ||
+            epoll_ctl(g->epfd, EPOLL_CTL_ADD, n->fd, &ev) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void *gen_main(void *arg)
+{
+    struct gen_thread *g = arg;
+    uint64_t start = now_ns();
+    uint64_t end = start + (uint64_t)(opt.duration * 1e9);
+
+    while (keep_running) {
+        uint64_t now = now_ns();
+        int waiting = 0, active = 0;
+
+        if (now >= end) {
+            break;
+        }
+        double elapsed = (now - start) / 1e9;
+
+        for (unsigned int i = 0; i < g->count; i++) {
+            struct vnode *n = &g->nodes[i];
+            uint64_t due = node_due(n, elapsed);
+            unsigned int burst = 0;
+
+            if (!node_up(n)) {
+                continue;
+            }
+            // Toi da mot batch / node / vong de cac node deu nhau
+            while (n->produced < due && !node_done(n) && burst++ < opt.batch) {
+                if (n->inflight == LOADGEN_WINDOW) {
+                    g->stalls++;
+                    waiting = 1;
+                    break;
+                }
+                vnode_sample(n, &n->batch[n->nbatch++], &g->sensor_errors);
+                g->samples++;
+                if (n->nbatch == opt.batch || node_done(n)) {
+                    send_batch(g, n);
+                }
+            }
+            active |= !node_done(n);
+        }
+        if (!active) {
+            break;
+        }
+
+        read_acks(g, opt.rate > 0 || waiting ? 1 : 0);
+        if (opt.kind == TARGET_UDP) {
+            expire_udp(g, now_ns());
+        }
+    }
+
+    // Gui not batch do dang va cho ack con lai
+    for (unsigned int i = 0; i < g->count; i++) {
+        struct vnode *n = &g->nodes[i];
+        if (n->nbatch > 0 && node_up(n)) {
+            while (n->inflight == LOADGEN_WINDOW && node_up(n)) {
+                read_acks(g, 10);
+                if (opt.kind == TARGET_UDP) {
+                    expire_udp(g, now_ns());
+                }
+            }
+            if (node_up(n)) {
+                send_batch(g, n);
+            }
+        }
+    }
+    uint64_t drain_end = now_ns() + DRAIN_SEC * 1000000000ull;
+    for (;;) {
+        unsigned int inflight = 0;
+        for (unsigned int i = 0; i < g->count; i++) {
+            inflight += g->nodes[i].inflight;
+        }
+        if (inflight == 0 || now_ns() > drain_end) {
+            g->lost += inflight;
+            break;
+        }
+        read_acks(g, 10);
+        if (opt.kind == TARGET_UDP) {
+            expire_udp(g, now_ns());
+        }
+    }
+    return NULL;
+}
+
+// Logger chi co mot instance: mot thread, latency = mot lan ghi
+static void log_main(struct gen_thread *g)
+{
+    uint64_t start = now_ns();
+    uint64_t end = start + (uint64_t)(opt.duration * 1e9);
+
+    while (keep_running && now_ns() < end) {
+        double elapsed = (now_ns() - start) / 1e9;
+        int active = 0;
+
+        for (unsigned int i = 0; i < g->count; i++) {
+            struct vnode *n = &g->nodes[i];
+            if (n->produced < node_due(n, elapsed) && !node_done(n)) {
+                struct sensor_sample s;
+                char sht30[32], bh1750[32], text[64];
+
+                vnode_sample(n, &s, &g->sensor_errors);
+                sample_format(&s, sht30, sizeof(sht30), bh1750, sizeof(bh1750));
+                snprintf(text, sizeof(text), "%s-%s", sht30, bh1750);
+
+                uint64_t t0 = now_ns();
+                if (log_sensor_data_at(text, (time_t)(s.t_ms / 1000)) != 0) {
+                    g->net_errors++;
+                }
+                hist_add(&g->lat, now_ns() - t0);
+                g->samples++;
+                g->acked++;
+            }
+            active |= !node_done(n);
+        }
+        if (!active) {
+            break;
+        }
+        if (opt.rate > 0) {
+            usleep(1000);
+        }
+    }
+}
+
+/*********************************
+ * MAIN
+ *********************************/
+
+static void signal_handler(int sig)
+{
+    (void)sig;
+    keep_running = 0;
+}
+
+static int parse_target(const char *url)
+{
+    const char *rest = NULL;
+
+    if (strncmp(url, "tcp://", 6) == 0) {
+        opt.kind = TARGET_TCP;
+        rest = url + 6;
+    } else if (strncmp(url, "udp://", 6) == 0) {
+        opt.kind = TARGET_UDP;
+        rest = url + 6;
+    } else if (strncmp(url, "log:", 4) == 0 && url[4]) {
+        opt.kind = TARGET_LOG;
+        opt.log.log_dir = url + 4;
+        return 0;
+    } else if (strncmp(url, "flash:", 6) == 0 && url[6]) {
+        opt.kind = TARGET_LOG;
+        opt.log.mode = LOGGER_MODE_FLASH;
+        opt.log.log_dir = url + 6;
+        return 0;
+    } else {
+        return -1;
+    }
+
+    const char *colon = strrchr(rest, ':');
+    if (!colon || colon == rest || (size_t)(colon - rest) >= sizeof(opt.host) ||
+        strlen(colon + 1) >= sizeof(opt.port)) {
+        return -1;
+    }
+    snprintf(opt.host, sizeof(opt.host), "%.*s", (int)(colon - rest), rest);
+    snprintf(opt.port, sizeof(opt.port), "%s", colon + 1);
+    return 0;
+}
+
+static void print_usage(const char *prog)
+{
+    printf("Usage: %s [options]\n"
+           "  -T, --target URL         tcp://host:port, udp://host:port, log:DIR or flash:DIR\n"
+           "                           (default tcp://127.0.0.1:7878)\n"
+           "  -n, --nodes N            virtual nodes (default 100; log targets take only 1)\n"
+           "  -w, --threads N          generator threads (default: online CPUs; 1 for log targets)\n"
+           "  -i, --interval MS        sample time step (default 5000)\n"
+           "  -r, --rate HZ            samples/s per node in real time\n"
+           "                           (default 1000/interval, 0 = as fast as possible)\n"
+           "  -b, --batch N            samples per batch (default 60)\n"
+           "  -d, --duration SEC       run time (default 10)\n"
+           "  -c, --count N            stop each node after N samples\n"
+           "  -e, --error-rate P       chance per sample that a sensor drops out (default 0.001)\n"
+           "  -E, --dropout-len N      longest dropout in samples (default 12)\n"
+           "  -p, --prefix NAME        node name prefix (default vnode)\n"
+           "  -s, --seed N             signal model seed (default 1)\n"
+           "  -S, --start UNIX_SEC     time of the first sample (default now)\n"
+           "  -t, --timeout SEC        UDP batch counted lost after SEC (default 1)\n"
+           "  -h, --help               show this help\n",
+           prog);
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct option long_opts[] = {
+        { "target",      required_argument, NULL, 'T' },
+        { "nodes",       required_argument, NULL, 'n' },
+        { "threads",     required_argument, NULL, 'w' },
+        { "interval",    required_argument, NULL, 'i' },
+        { "rate",        required_argument, NULL, 'r' },
+        { "batch",       required_argument, NULL, 'b' },
+        { "duration",    required_argument, NULL, 'd' },
+        { "count",       required_argument, NULL, 'c' },
+        { "error-rate",  required_argument, NULL, 'e' },
+        { "dropout-len", required_argument, NULL, 'E' },
+        { "prefix",      required_argument, NULL, 'p' },
+        { "seed",        required_argument, NULL, 's' },
+        { "start",       required_argument, NULL, 'S' },
+        { "timeout",     required_argument, NULL, 't' },
+        { "help",        no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    int nodes_set = 0;
+    int c;
+
+    logger_default_config(&opt.log);
+    opt.threads = (unsigned int)sysconf(_SC_NPROCESSORS_ONLN);
+    opt.start_ms = (int64_t)time(NULL) * 1000;
+
+    while ((c = getopt_long(argc, argv, "T:n:w:i:r:b:d:c:e:E:p:s:S:t:h", long_opts, NULL)) != -1) {
+        switch (c) {
+        case 'T':
+            if (parse_target(optarg) != 0) {
+                fprintf(stderr, "Invalid target: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'n': opt.nodes = strtoul(optarg, NULL, 0); nodes_set = 1; break;
+        case 'w': opt.threads = strtoul(optarg, NULL, 0); break;
+        case 'i': opt.interval_ms = strtoul(optarg, NULL, 0); break;
+        case 'r': opt.rate = atof(optarg); break;
+        case 'b': opt.batch = strtoul(optarg, NULL, 0); break;
+        case 'd': opt.duration = atof(optarg); break;
+        case 'c': opt.count = strtoull(optarg, NULL, 0); break;
+        case 'e': opt.error_rate = atof(optarg); break;
+        case 'E': opt.dropout_len = strtoul(optarg, NULL, 0); break;
+        case 'p': opt.prefix = optarg; break;
+        case 's': opt.seed = strtoull(optarg, NULL, 0); break;
+        case 'S': opt.start_ms = (int64_t)strtoll(optarg, NULL, 0) * 1000; break;
+        case 't': opt.timeout = atof(optarg); break;
+        case 'h':
+            print_usage(argv[0]);
+            return 0;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (opt.nodes == 0 || opt.interval_ms == 0 || opt.batch == 0 || opt.batch > BATCH_MAX_SAMPLES ||
+        opt.duration <= 0 || opt.dropout_len == 0) {
+        fprintf(stderr, "Invalid --nodes / --interval / --batch / --duration / --dropout-len\n");
+        return 1;
+    }
+    // Logger chi co mot file ngay / DIR: nhieu node se ghi chen vao nhau
+    if (opt.kind == TARGET_LOG && !nodes_set) {
+        opt.nodes = 1;
+    } else if (opt.kind == TARGET_LOG && opt.nodes > 1) {
+        fprintf(stderr, "log: and flash: targets take a single node (-n 1)\n");
+        return 1;
+    }
+    if (opt.rate < 0) {
+        opt.rate = 1000.0 / opt.interval_ms;
+    }
+    if (opt.kind == TARGET_LOG || opt.threads == 0) {
+        opt.threads = 1;
+    }
+    if (opt.threads > opt.nodes) {
+        opt.threads = opt.nodes;
+    }
+
+    // Moi node TCP mot socket
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    tz_offset = tm.tm_gmtoff;
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+    signal(SIGPIPE, SIG_IGN);
+
+    struct vnode *nodes = calloc(opt.nodes, sizeof(*nodes));
+    struct gen_thread *gens = aligned_alloc(64, sizeof(*gens) * opt.threads);
+    if (!nodes || !gens) {
+        perror("calloc");
+        return 1;
+    }
+    memset(gens, 0, sizeof(*gens) * opt.threads);
+
+    for (unsigned int i = 0; i < opt.nodes; i++) {
+        vnode_init(&nodes[i], i);
+        if (opt.kind != TARGET_LOG && !(nodes[i].batch = malloc(opt.batch * sizeof(struct sensor_sample)))) {
+            perror("malloc");
+            return 1;
+        }
+    }
+
+    // Chia node lien tiep cho cac thread
+    for (unsigned int t = 0, first = 0; t < opt.threads; t++) {
+        unsigned int count = opt.nodes / opt.threads + (t < opt.nodes % opt.threads);
+        gens[t].nodes = &nodes[first];
+        gens[t].count = count;
+        gens[t].udp_fd = -1;
+        for (unsigned int i = 0; i < count; i++) {
+            nodes[first + i].index = i;
+        }
+        first += count;
+    }
+
+    if (opt.kind == TARGET_LOG) {
+        printf("Load: %u nodes -> logger %s (%s mode)\n", opt.nodes, opt.log.log_dir,
+               opt.log.mode == LOGGER_MODE_FLASH ? "flash" : "append");
+        if (logger_init_with(&opt.log) != 0) {
+            return 1;
+        }
+    } else {
+        printf("Load: %u nodes -> %s://%s:%s, %u thread(s), batch %u\n", opt.nodes,
+               opt.kind == TARGET_UDP ? "udp" : "tcp", opt.host, opt.port, opt.threads, opt.batch);
+        for (unsigned int t = 0; t < opt.threads; t++) {
+            if (gen_setup(&gens[t]) != 0) {
+                fprintf(stderr, "Failed to connect to %s:%s\n", opt.host, opt.port);
+                return 1;
+            }
+        }
+    }
+    if (opt.rate > 0) {
+        printf("Target rate: %.0f samples/s (%.3g per node)\n", opt.rate * opt.nodes, opt.rate);
+    } else {
+        printf("Target rate: as fast as possible\n");
+    }
+    fflush(stdout);
+
+    uint64_t t0 = now_ns();
+    if (opt.kind == TARGET_LOG) {
+        log_main(&gens[0]);
+        logger_close();
+    } else {
+        for (unsigned int t = 0; t < opt.threads; t++) {
+            pthread_create(&gens[t].thread, NULL, gen_main, &gens[t]);
+        }
+        for (unsigned int t = 0; t < opt.threads; t++) {
+            pthread_join(gens[t].thread, NULL);
+        }
+    }
+    double wall = (now_ns() - t0) / 1e9;
+
+    static struct hist lat;
+    uint64_t samples = 0, batches = 0, acked = 0, lost = 0, stalls = 0, bytes = 0;
+    uint64_t sensor_errors = 0, net_errors = 0;
+    for (unsigned int t = 0; t < opt.threads; t++) {
+        hist_merge(&lat, &gens[t].lat);
+        samples += gens[t].samples;
+        batches += gens[t].batches;
+        acked += gens[t].acked;
+        lost += gens[t].lost;
+        stalls += gens[t].stalls;
+        bytes += gens[t].payload_bytes;
+        sensor_errors += gens[t].sensor_errors;
+        net_errors += gens[t].net_errors;
+    }
+
+    printf("\n=== Load ===\n");
+    printf("Samples: %llu in %.3f s = %.0f samples/s (%.2f days of data per node)\n",
+           (unsigned long long)samples, wall, samples / wall,
+           (double)samples / opt.nodes * opt.interval_ms / 86400000.0);
+    printf("Sensor errors: %llu reading(s)\n", (unsigned long long)sensor_errors);
+    if (opt.kind == TARGET_LOG) {
+        struct logger_stats st;
+        logger_get_stats(&st);
+        printf("Logged %llu bytes, wrote %llu bytes (write amplification %.2f), %llu error(s)\n",
+               (unsigned long long)st.record_bytes, (unsigned long long)st.device_bytes,
+               st.record_bytes ? (double)st.device_bytes / st.record_bytes : 0.0,
+               (unsigned long long)net_errors);
+    } else {
+        printf("Batches: %llu sent, %llu acked (%.0f batches/s), %llu lost, %llu stall(s), %llu error(s)\n",
+               (unsigned long long)batches, (unsigned long long)acked, acked / wall,
+               (unsigned long long)lost, (unsigned long long)stalls, (unsigned long long)net_errors);
+        printf("Payload: %.2f MiB (%.2f bytes/sample, %.2f MiB/s)\n", bytes / (1024.0 * 1024.0),
+               samples ? (double)bytes / samples : 0.0, bytes / wall / (1024 * 1024));
+    }
+    if (lat.total > 0) {
+        printf("Latency (%s): p50 %.1f us, p90 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us\n",
+               opt.kind == TARGET_LOG ? "log call" : "send -> ack",
+               hist_percentile(&lat, 50) / 1e3, hist_percentile(&lat, 90) / 1e3,
+               hist_percentile(&lat, 99) / 1e3, hist_percentile(&lat, 99.9) / 1e3, lat.max / 1e3);
+    }
+    return lost > 0 || net_errors > 0 ? 2 : 0;
+}
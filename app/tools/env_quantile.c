@@ -0,0 +1,329 @@
+#define _GNU_SOURCE     // strptime()
+#include "bulk.h"
+#include "sketch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <getopt.h>
+#include <time.h>
+
+/*
+ * Percentiles over long ranges from the quantile sketches the logger keeps
+ * next to its logs (sketch.h), without reading the logs:
+ *
+ *   env_quantile -d DIR -f 2025-01-01 -t 2026-01-01 -b month
+ *
+ * prints p5 / p50 / p95 (or -q ...) per channel for every hour, day, month
+ * or the whole range. Every value is within SKETCH_ALPHA relative error of
+ * a real sample. --rebuild creates the sketches of a DIR from existing logs
+ * (e.g. logs written before sketches existed, or an env_collectord node).
+ */
+
+#define MAX_QUANTILES   16
+
+enum bucket {
+    BUCKET_HOUR,
+    BUCKET_DAY,
+    BUCKET_MONTH,
+    BUCKET_ALL
+};
+
+static void print_usage(const char *prog)
+{
+    printf("Usage: %s -d DIR [options]\n"
+           "       %s -d DIR --rebuild LOG|DIR...\n"
+           "  -d, --dir DIR            directory with sketch_*.skt (the log directory)\n"
+           "  -f, --from TIME          start, YYYY-MM-DD[ HH[:MM]] or @unix (default TO - 24 h)\n"
+           "  -t, --to TIME            end, exclusive (default now)\n"
+           "  -b, --bucket B           hour | day | month | all (default all)\n"
+           "  -q, --quantiles LIST     percentiles, e.g. 1,50,99.9 (default 5,50,95)\n"
+           "      --rebuild            build the sketches of DIR from the given logs\n"
+           "  -h, --help               show this help\n", prog, prog);
+}
+
+static int parse_time(const char *s, time_t *out)
+{
+    static const char *const formats[] = { "%Y-%m-%d %H:%M", "%Y-%m-%d %H", "%Y-%m-%d" };
+    struct tm tm;
+
+    if (s[0] == '@') {
+        char *end;
+        *out = (time_t)strtoll(s + 1, &end, 10);
+        return *end == '\0' ? 0 : -1;
+    }
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+        memset(&tm, 0, sizeof(tm));
+        const char *end = strptime(s, formats[i], &tm);
+        if (end && *end == '\0') {
+            tm.tm_isdst = -1;
+            *out = mktime(&tm);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int parse_bucket(const char *s, enum bucket *out)
+{
+    static const char *const names[] = { "hour", "day", "month", "all" };
+
+    for (int i = 0; i <= BUCKET_ALL; i++) {
+        if (strcmp(s, names[i]) == 0) {
+            *out = (enum bucket)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int parse_quantiles(const char *s, double *q)
+{
+    int n = 0;
+    char *end;
+
+    while (*s && n < MAX_QUANTILES) {
+        q[n] = strtod(s, &end);
+        if (end == s || q[n] < 0 || q[n] > 100 || (*end != ',' && *end != '\0')) {
+            return -1;
+        }
+        n++;
+        s = *end == ',' ? end + 1 : end;
+    }
+    return *s == '\0' ? n : -1;
+}
+
+// Dau bucket chua t, va dau bucket sau
+static time_t bucket_bounds(time_t t, enum bucket b, time_t *next)
+{
+    struct tm tm;
+
+    localtime_r(&t, &tm);
+    tm.tm_min = tm.tm_sec = 0;
+    if (b != BUCKET_HOUR) {
+        tm.tm_hour = 0;
+    }
+    if (b == BUCKET_MONTH) {
+        tm.tm_mday = 1;
+    }
+    tm.tm_isdst = -1;
+    time_t start = mktime(&tm);
+
+    if (b == BUCKET_HOUR) {
+        *next = start + 3600;
+    } else {
+        if (b == BUCKET_DAY) {
+            tm.tm_mday++;
+        } else {
+            tm.tm_mon++;
+        }
+        tm.tm_isdst = -1;
+        *next = mktime(&tm);
+    }
+    return start;
+}
+
+static void print_bucket(time_t from, enum bucket b, const struct sketch s[SAMPLE_CHANNELS],
+                         const double *q, int nq)
+{
+    static const char *const formats[] = { "%Y-%m-%d %H:00", "%Y-%m-%d", "%Y-%m", "%Y-%m-%d %H:%M" };
+    char label[32];
+    struct tm tm;
+
+    localtime_r(&from, &tm);
+    strftime(label, sizeof(label), formats[b], &tm);
+    printf("%-16s", label);
+    for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+        if (s[c].count == 0) {
+            printf("  %-4s %*s", sample_channel_names[c], nq * 9 - 1, "-");
+            continue;
+        }
+        printf("  %-4s", sample_channel_names[c]);
+        for (int i = 0; i < nq; i++) {
+            printf(" %8.1f", sketch_quantile(&s[c], q[i] / 100) / 1000.0);
+        }
+    }
+    printf("  n=%llu\n", (unsigned long long)s[0].count);
+}
+
+static int query(const char *dir, time_t from, time_t to, enum bucket b, const double *q, int nq)
+{
+    struct sketch *s = malloc(SAMPLE_CHANNELS * sizeof(*s));
+    struct timespec t0, t1;
+    unsigned int buckets = 0;
+    int ret = 0;
+
+    if (!s) {
+        perror("malloc");
+        return -1;
+    }
+
+    printf("%-16s", "bucket");
+    for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+        printf("  %-4s", sample_channel_names[c]);
+        for (int i = 0; i < nq; i++) {
+            char name[16];
+            snprintf(name, sizeof(name), "p%g", q[i]);
+            printf(" %8s", name);
+        }
+    }
+    printf("\n");
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    time_t start = from;
+    while (start < to && ret == 0) {
+        time_t next = to;
+        if (b != BUCKET_ALL) {
+            bucket_bounds(start, b, &next);
+            next = next < to ? next : to;
+        }
+        ret = sketch_query(dir, start, next, s);
+        if (ret == 0) {
+            print_bucket(start, b, s, q, nq);
+        }
+        buckets++;
+        start = next;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    fprintf(stderr, "%u bucket(s) in %.2f ms\n", buckets,
+            (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6);
+    free(s);
+    return ret;
+}
+
+static int has_sketches(const char *dir)
+{
+    DIR *d = opendir(dir);
+    struct dirent *entry;
+    int found = 0;
+
+    if (!d) {
+        return 0;
+    }
+    while (!found && (entry = readdir(d)) != NULL) {
+        found = strncmp(entry->d_name, "sketch_", 7) == 0;
+    }
+    closedir(d);
+    return found;
+}
+
+// Sketch tu log cu: cung duong ghi nhu logger, theo thu tu file
+static int rebuild(const char *dir, char *const paths[], int count)
+{
+    struct bulk_config cfg;
+    struct bulk_columns cols;
+    struct bulk_stats st;
+    int ret = 0;
+
+    // Record chi duoc cong them: chay lai se dem mau hai lan
+    if (has_sketches(dir)) {
+        fprintf(stderr, "%s already has sketches, remove sketch_*.skt first\n", dir);
+        return -1;
+    }
+
+    bulk_default_config(&cfg);
+    if (bulk_load(&cfg, paths, count, &cols, &st) != 0) {
+        return -1;
+    }
+
+    struct sketch_writer *w = malloc(sizeof(*w));
+    if (!w) {
+        perror("malloc");
+        bulk_free(&cols);
+        return -1;
+    }
+    sketch_writer_init(w, dir);
+    for (size_t i = 0; i < cols.count && ret == 0; i++) {
+        struct sensor_sample sample = { .t_ms = cols.t_ms[i], .valid = cols.valid[i] };
+        for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+            sample.value[c] = cols.value[c][i];
+        }
+        ret = sketch_writer_add(w, &sample);
+    }
+    if (ret == 0) {
+        ret = sketch_writer_flush(w);
+    }
+
+    printf("Rebuilt sketches of %zu samples from %llu file(s) into %s\n", cols.count,
+           (unsigned long long)st.files, dir);
+    free(w);
+    bulk_free(&cols);
+    return ret;
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct option long_opts[] = {
+        { "dir",       required_argument, NULL, 'd' },
+        { "from",      required_argument, NULL, 'f' },
+        { "to",        required_argument, NULL, 't' },
+        { "bucket",    required_argument, NULL, 'b' },
+        { "quantiles", required_argument, NULL, 'q' },
+        { "rebuild",   no_argument,       NULL, 'R' },
+        { "help",      no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    const char *dir = NULL;
+    const char *from_arg = NULL;
+    time_t to = time(NULL);
+    enum bucket b = BUCKET_ALL;
+    double q[MAX_QUANTILES] = { 5, 50, 95 };
+    int nq = 3;
+    int do_rebuild = 0;
+    int c;
+
+    while ((c = getopt_long(argc, argv, "d:f:t:b:q:h", long_opts, NULL)) != -1) {
+        switch (c) {
+        case 'd':
+            dir = optarg;
+            break;
+        case 'f':
+            from_arg = optarg;
+            break;
+        case 't':
+            if (parse_time(optarg, &to) != 0) {
+                fprintf(stderr, "Invalid time: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'b':
+            if (parse_bucket(optarg, &b) != 0) {
+                fprintf(stderr, "Invalid bucket: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'q':
+            nq = parse_quantiles(optarg, q);
+            if (nq <= 0) {
+                fprintf(stderr, "Invalid quantiles: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'R':
+            do_rebuild = 1;
+            break;
+        case 'h':
+            print_usage(argv[0]);
+            return 0;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!dir || (do_rebuild && optind >= argc) || (!do_rebuild && optind < argc)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if (do_rebuild) {
+        return rebuild(dir, argv + optind, argc - optind) == 0 ? 0 : 1;
+    }
+
+    time_t from = to - 24 * 3600;
+    if (from_arg && parse_time(from_arg, &from) != 0) {
+        fprintf(stderr, "Invalid time: %s\n", from_arg);
+        return 1;
+    }
+    return query(dir, from, to, b, q, nq) == 0 ? 0 : 1;
+}
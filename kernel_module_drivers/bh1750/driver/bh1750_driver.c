@@ -5,32 +5,173 @@
 #include <linux/miscdevice.h>
 #include <linux/fs.h>
 #include <linux/uaccess.h>
+#include <linux/hrtimer.h>
+#include <linux/mutex.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
+#include <linux/jiffies.h>
+#include <linux/ktime.h>
+
+#include "sensor_hub.h"
 
 #define DEVICE_NAME   "bh1750_sensor"
 #define DRIVER_NAME   "bh1750_i2c"
 #define MAX_BUF_SIZE  64
 
+/* BH1750 instruction set (datasheet, "Instruction Set Architecture") */
+#define BH1750_POWER_ON       0x01
+#define BH1750_ONE_TIME_H     0x20    // 1 lx resolution, 120 ms typ.
+#define BH1750_ONE_TIME_H2    0x21    // 0.5 lx resolution, 120 ms typ.
+#define BH1750_ONE_TIME_L     0x23    // 4 lx resolution, 16 ms typ.
+#define BH1750_MTREG_HI       0x40    // 01000_MT[7:5]
+#define BH1750_MTREG_LO       0x60    // 011_MT[4:0]
+
+#define BH1750_MTREG_MIN      31
+#define BH1750_MTREG_DEFAULT  69
+#define BH1750_MTREG_MAX      254
+#define BH1750_RAW_SATURATED  0xFFF0
+
+/*
+ * Auto policy thresholds (lux * 10). Each pair has a gap so that a light
+ * level sitting on a boundary does not make the mode flap between reads.
+ */
+#define BH1750_DARK_ENTER     100       // < 10 lx: H2 + max MTreg
+#define BH1750_DARK_LEAVE     200       // > 20 lx
+#define BH1750_BRIGHT_ENTER   300000    // > 30000 lx: H + min MTreg
+#define BH1750_BRIGHT_LEAVE   200000    // < 20000 lx
+
 /* Global I2C client */
 static struct i2c_client *bh1750_client;
 
+/* =========================================================================
+ *  Measurement Modes & Policy
+ * ========================================================================= */
+
+struct bh1750_mode {
+    const char *name;
+    u8  cmd;        // one-time measurement command
+    u8  mtreg;      // measurement time register
+    u8  div;        // H2 counts twice per lux
+    u16 typ_ms;     // typical conversion time at default MTreg
+};
+
+enum bh1750_mode_id {
+    BH1750_MODE_FAST,       // L-res, default MTreg
+    BH1750_MODE_NORMAL,     // H-res, default MTreg (legacy behaviour)
+    BH1750_MODE_DARK,       // H2-res, max MTreg: best resolution in low light
+    BH1750_MODE_BRIGHT,     // H-res, min MTreg: no saturation in direct sun
+};
+
+static const struct bh1750_mode bh1750_modes[] = {
+    [BH1750_MODE_FAST]   = { "fast",   BH1750_ONE_TIME_L,  BH1750_MTREG_DEFAULT, 1, 16  },
+    [BH1750_MODE_NORMAL] = { "normal", BH1750_ONE_TIME_H,  BH1750_MTREG_DEFAULT, 1, 120 },
+    [BH1750_MODE_DARK]   = { "dark",   BH1750_ONE_TIME_H2, BH1750_MTREG_MAX,     2, 120 },
+    [BH1750_MODE_BRIGHT] = { "bright", BH1750_ONE_TIME_H,  BH1750_MTREG_MIN,     1, 120 },
+};
+
+enum bh1750_policy {
+    BH1750_POLICY_AUTO,     // pick normal/dark/bright from the last reading
+    BH1750_POLICY_FAST,     // always L-res: lowest latency
+    BH1750_POLICY_NORMAL,   // always H-res with default MTreg
+};
+
+static const char * const bh1750_policy_names[] = {
+    [BH1750_POLICY_AUTO]   = "auto",
+    [BH1750_POLICY_FAST]   = "fast",
+    [BH1750_POLICY_NORMAL] = "normal",
+};
+
+static int bh1750_policy = BH1750_POLICY_AUTO;
+static int bh1750_cur_mode = BH1750_MODE_NORMAL;
+static u8  bh1750_cur_mtreg;    // 0 = not written since probe
+
+/* Conversion time scales linearly with MTreg */
+static unsigned int bh1750_conv_ms(const struct bh1750_mode *m)
+{
+    return DIV_ROUND_UP(m->typ_ms * m->mtreg, BH1750_MTREG_DEFAULT);
+}
+
+/* Mode to use for the next measurement, given the policy and last reading */
+static int bh1750_select_mode(int policy, int cur_mode, int last_lux10)
+{
+    switch (policy) {
+    case BH1750_POLICY_FAST:
+        return BH1750_MODE_FAST;
+    case BH1750_POLICY_NORMAL:
+        return BH1750_MODE_NORMAL;
+    }
+
+    if (last_lux10 < 0)
+        return cur_mode == BH1750_MODE_FAST ? BH1750_MODE_NORMAL : cur_mode;
+
+    switch (cur_mode) {
+    case BH1750_MODE_DARK:
+        return last_lux10 > BH1750_DARK_LEAVE ? BH1750_MODE_NORMAL : cur_mode;
+    case BH1750_MODE_BRIGHT:
+        return last_lux10 < BH1750_BRIGHT_LEAVE ? BH1750_MODE_NORMAL : cur_mode;
+    default:
+        if (last_lux10 < BH1750_DARK_ENTER)
+            return BH1750_MODE_DARK;
+        if (last_lux10 > BH1750_BRIGHT_ENTER)
+            return BH1750_MODE_BRIGHT;
+        return BH1750_MODE_NORMAL;
+    }
+}
+
 /* =========================================================================
  *  Low-Level BH1750 Read Function
  * ========================================================================= */
-static int bh1750_read_lux(struct i2c_client *client)
+
+/* Program MTreg; only touches the bus when the value actually changes */
+static int bh1750_set_mtreg(struct i2c_client *client, u8 mtreg)
+{
+    u8 cmds[3] = {
+        BH1750_POWER_ON,
+        BH1750_MTREG_HI | (mtreg >> 5),
+        BH1750_MTREG_LO | (mtreg & 0x1F),
+    };
+    int i, ret;
+
+    if (mtreg == bh1750_cur_mtreg)
+        return 0;
+
+    for (i = 0; i < ARRAY_SIZE(cmds); i++) {
+        ret = i2c_master_send(client, &cmds[i], 1);
+        if (ret < 0) {
+            dev_err(&client->dev, "Failed to set MTreg %u\n", mtreg);
+            bh1750_cur_mtreg = 0;
+            return ret;
+        }
+    }
+
+    bh1750_cur_mtreg = mtreg;
+    return 0;
+}
+
+/* Start a conversion in the given mode */
+static int bh1750_start(struct i2c_client *client, const struct bh1750_mode *m)
 {
     int ret;
-    u8 cmd = 0x20;      // One-time H-Resolution mode
-    u8 buf[2];
-    int raw;
+
+    ret = bh1750_set_mtreg(client, m->mtreg);
+    if (ret < 0)
+        return ret;
 
     /* Send measurement command */
-    ret = i2c_master_send(client, &cmd, 1);
+    ret = i2c_master_send(client, &m->cmd, 1);
     if (ret < 0) {
         dev_err(&client->dev, "Failed to send measurement command\n");
         return ret;
     }
 
-    msleep(120); // Wait for conversion
+    return 0;
+}
+
+/* Fetch a finished conversion; returns the raw 16-bit count */
+static int bh1750_fetch_raw(struct i2c_client *client)
+{
+    int ret;
+    u8 buf[2];
 
     /* Read 2 bytes */
     ret = i2c_master_recv(client, buf, 2);
@@ -39,11 +180,388 @@ static int bh1750_read_lux(struct i2c_client *client)
         return -EIO;
     }
 
-    raw = (buf[0] << 8) | buf[1];
+    return (buf[0] << 8) | buf[1];
+}
+
+/*
+ * Convert a raw count to lux * 10 for the given mode.
+ * Datasheet: lux = raw / 1.2 * (69 / MTreg), halved again in H2 mode.
+ */
+static int bh1750_raw_to_lux10(int raw, const struct bh1750_mode *m)
+{
+    return raw * 100 * BH1750_MTREG_DEFAULT / (12 * m->mtreg * m->div);
+}
+
+/* =========================================================================
+ *  Measurement State Machine
+ * ========================================================================= */
+
+/*
+ * Readers never touch the bus themselves. The first reader kicks a
+ * conversion; the work item programs the mode and sends the command, an
+ * hrtimer brings it back once the conversion time has passed and the work
+ * item fetches the result. Readers that arrive while a conversion is in
+ * flight wait for that same result, and a result younger than ttl_ms is
+ * served from the cache without touching the bus.
+ */
+enum bh1750_state {
+    BH1750_IDLE,
+    BH1750_START,       // conversion requested, command not sent yet
+    BH1750_CONVERTING,  // command sent, waiting for the result
+};
+
+static unsigned int bh1750_ttl_ms;  // serve cached results younger than this
+
+/* Boot timing, reported in the log and in sysfs */
+static ktime_t bh1750_probe_start;
+static unsigned int bh1750_probe_us;
+static unsigned int bh1750_first_read_us;   // probe start -> first result
+
+static struct {
+    struct mutex lock;          // protects the fields below and the bus
+    wait_queue_head_t wq;
+    struct work_struct work;
+    struct hrtimer timer;
+    enum bh1750_state state;
+    bool stopping;
+    int policy;                 // policy of the conversion in flight
+    int mode;                   // mode of the conversion in flight
+    unsigned long seq;          // completed conversions
+    int lux10;                  // last result (lux * 10) or negative errno
+    unsigned long stamp;        // jiffies of the last good result
+} bh1750 = {
+    .lock     = __MUTEX_INITIALIZER(bh1750.lock),
+    .wq       = __WAIT_QUEUE_HEAD_INITIALIZER(bh1750.wq),
+    .stopping = true,           // until probe
+};
+
+/* Publish a result (or error) and wake every waiting reader */
+static void bh1750_complete(int lux10)
+{
+    if (!bh1750.seq) {
+        WRITE_ONCE(bh1750_first_read_us,
+                   ktime_us_delta(ktime_get(), bh1750_probe_start));
+        if (lux10 >= 0)
+            pr_info("BH1750 first read: %d.%d lux (%u us after probe)\n",
+                    lux10 / 10, lux10 % 10, bh1750_first_read_us);
+        else
+            pr_warn("BH1750: initial read failed: %d\n", lux10);
+    }
+
+    bh1750.lux10 = lux10;
+    if (lux10 >= 0)
+        bh1750.stamp = jiffies;
+
+    bh1750.state = BH1750_IDLE;
+    WRITE_ONCE(bh1750.seq, bh1750.seq + 1);
+    wake_up_all(&bh1750.wq);
+}
+
+/* Program the mode, send the command and arm the conversion timer */
+static void bh1750_kick(struct i2c_client *client, int mode)
+{
+    const struct bh1750_mode *m = &bh1750_modes[mode];
+    int ret;
+
+    ret = bh1750_start(client, m);
+    if (ret < 0) {
+        bh1750_complete(ret);
+        return;
+    }
+
+    bh1750.mode = mode;
+    bh1750.state = BH1750_CONVERTING;
+    hrtimer_start(&bh1750.timer, ms_to_ktime(bh1750_conv_ms(m)),
+                  HRTIMER_MODE_REL);
+}
+
+/* Work item: advance the state machine by one step */
+static void bh1750_work_fn(struct work_struct *work)
+{
+    struct i2c_client *client = bh1750_client;
+    int raw, lux10;
+
+    mutex_lock(&bh1750.lock);
+    if (bh1750.stopping)
+        goto out;
+
+    switch (bh1750.state) {
+    case BH1750_START:
+        bh1750.policy = READ_ONCE(bh1750_policy);
+        bh1750_kick(client, bh1750_select_mode(bh1750.policy,
+                                               bh1750_cur_mode, -1));
+        break;
+
+    case BH1750_CONVERTING:
+        raw = bh1750_fetch_raw(client);
+        if (raw < 0) {
+            bh1750_complete(raw);
+            break;
+        }
+
+        /* A saturated count is meaningless: step down MTreg and redo it now */
+        if (bh1750.policy == BH1750_POLICY_AUTO &&
+            raw >= BH1750_RAW_SATURATED && bh1750.mode != BH1750_MODE_BRIGHT) {
+            bh1750_kick(client, BH1750_MODE_BRIGHT);
+            break;
+        }
+
+        lux10 = bh1750_raw_to_lux10(raw, &bh1750_modes[bh1750.mode]);
+        WRITE_ONCE(bh1750_cur_mode,
+                   bh1750_select_mode(bh1750.policy, bh1750.mode, lux10));
+        bh1750_complete(lux10);
+        break;
+
+    default:
+        break;
+    }
+out:
+    mutex_unlock(&bh1750.lock);
+}
+
+static enum hrtimer_restart bh1750_timer_fn(struct hrtimer *timer)
+{
+    schedule_work(&bh1750.work);
+    return HRTIMER_NORESTART;
+}
+
+/* Start a conversion unless one is already in flight (lock held) */
+static void bh1750_request(void)
+{
+    if (bh1750.state == BH1750_IDLE) {
+        bh1750.state = BH1750_START;
+        schedule_work(&bh1750.work);
+    }
+}
+
+/* Get lux * 10: cached if fresh, else join or start a conversion */
+static int bh1750_read_lux(void)
+{
+    unsigned long target;
+    int ret;
+
+    mutex_lock(&bh1750.lock);
+    if (bh1750.seq && bh1750.lux10 >= 0 &&
+        time_before(jiffies, bh1750.stamp +
+                             msecs_to_jiffies(READ_ONCE(bh1750_ttl_ms))))
+        goto copy;
+
+    bh1750_request();
+    target = bh1750.seq + 1;
+    mutex_unlock(&bh1750.lock);
+
+    ret = wait_event_interruptible(bh1750.wq,
+                                   (long)(READ_ONCE(bh1750.seq) - target) >= 0 ||
+                                   READ_ONCE(bh1750.stopping));
+    if (ret)
+        return ret;
+
+    mutex_lock(&bh1750.lock);
+    if (bh1750.stopping) {
+        mutex_unlock(&bh1750.lock);
+        return -ENODEV;
+    }
+copy:
+    ret = bh1750.lux10;
+    mutex_unlock(&bh1750.lock);
+
+    return ret;
+}
+
+/* Set up the state machine (called before the first read) */
+static void bh1750_sm_init(void)
+{
+    INIT_WORK(&bh1750.work, bh1750_work_fn);
+    hrtimer_init(&bh1750.timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+    bh1750.timer.function = bh1750_timer_fn;
+
+    mutex_lock(&bh1750.lock);
+    bh1750.state = BH1750_IDLE;
+    bh1750.stopping = false;
+    // A rebind starts over: no cached result, next one is the first read
+    WRITE_ONCE(bh1750.seq, 0);
+    bh1750.stamp = 0;
+    mutex_unlock(&bh1750.lock);
+}
+
+/* Stop the state machine and release any waiting readers */
+static void bh1750_sm_stop(void)
+{
+    mutex_lock(&bh1750.lock);
+    bh1750.stopping = true;
+    mutex_unlock(&bh1750.lock);
+    wake_up_all(&bh1750.wq);
+
+    /* The work item no longer re-arms the timer once stopping is set */
+    hrtimer_cancel(&bh1750.timer);
+    cancel_work_sync(&bh1750.work);
+}
+
+/* =========================================================================
+ *  Sensor Hub Interface (see sensor_hub.h)
+ * ========================================================================= */
+
+/* Wait for idle, lock the bus and send the command */
+int bh1750_hub_start(unsigned int *conv_us)
+{
+    int ret;
+
+    for (;;) {
+        ret = wait_event_interruptible(bh1750.wq,
+                                       READ_ONCE(bh1750.state) == BH1750_IDLE ||
+                                       READ_ONCE(bh1750.stopping));
+        if (ret)
+            return ret;
+
+        mutex_lock(&bh1750.lock);
+        if (bh1750.stopping) {
+            mutex_unlock(&bh1750.lock);
+            return -ENODEV;
+        }
+        if (bh1750.state == BH1750_IDLE)
+            break;
+        mutex_unlock(&bh1750.lock);
+    }
+
+    bh1750.policy = READ_ONCE(bh1750_policy);
+    bh1750.mode = bh1750_select_mode(bh1750.policy, bh1750_cur_mode, -1);
+    ret = bh1750_start(bh1750_client, &bh1750_modes[bh1750.mode]);
+    if (ret < 0) {
+        bh1750_complete(ret);
+        mutex_unlock(&bh1750.lock);
+        return ret;
+    }
+
+    bh1750.state = BH1750_CONVERTING;
+    *conv_us = bh1750_conv_ms(&bh1750_modes[bh1750.mode]) * 1000;
+    return 0;
+}
+EXPORT_SYMBOL_GPL(bh1750_hub_start);
+
+/*
+ * Fetch the result, publish it and unlock the bus. A saturated count is
+ * not redone here (that would stall the whole hub cycle); the policy
+ * still steps to the bright mode for the next conversion.
+ */
+int bh1750_hub_finish(int *lux10)
+{
+    int raw, ret;
+
+    raw = bh1750_fetch_raw(bh1750_client);
+    if (raw < 0) {
+        bh1750_complete(raw);
+    } else {
+        int mode = bh1750.mode;
+        int val = bh1750_raw_to_lux10(raw, &bh1750_modes[mode]);
+
+        if (bh1750.policy == BH1750_POLICY_AUTO && raw >= BH1750_RAW_SATURATED)
+            WRITE_ONCE(bh1750_cur_mode, BH1750_MODE_BRIGHT);
+        else
+            WRITE_ONCE(bh1750_cur_mode,
+                       bh1750_select_mode(bh1750.policy, mode, val));
+        bh1750_complete(val);
+    }
+
+    ret = bh1750.lux10;
+    mutex_unlock(&bh1750.lock);
+
+    if (ret < 0)
+        return ret;
+    *lux10 = ret;
+    return 0;
+}
+EXPORT_SYMBOL_GPL(bh1750_hub_finish);
+
+/* =========================================================================
+ *  Sysfs Attributes (/sys/bus/i2c/devices/<bus>-0023/)
+ * ========================================================================= */
+
+static ssize_t policy_show(struct device *dev,
+                           struct device_attribute *attr, char *buf)
+{
+    int i, len = 0;
+    int policy = READ_ONCE(bh1750_policy);
+
+    /* e.g. "[auto] fast normal" */
+    for (i = 0; i < ARRAY_SIZE(bh1750_policy_names); i++)
+        len += sysfs_emit_at(buf, len, i == policy ? "[%s] " : "%s ",
+                             bh1750_policy_names[i]);
+    buf[len - 1] = '\n';
+    return len;
+}
+
+static ssize_t policy_store(struct device *dev,
+                            struct device_attribute *attr,
+                            const char *buf, size_t count)
+{
+    int i = sysfs_match_string(bh1750_policy_names, buf);
+
+    if (i < 0)
+        return i;
+
+    WRITE_ONCE(bh1750_policy, i);
+    return count;
+}
+static DEVICE_ATTR_RW(policy);
+
+static ssize_t mode_show(struct device *dev,
+                         struct device_attribute *attr, char *buf)
+{
+    const struct bh1750_mode *m = &bh1750_modes[READ_ONCE(bh1750_cur_mode)];
+
+    return sysfs_emit(buf, "%s mtreg=%u conv_ms=%u\n",
+                      m->name, m->mtreg, bh1750_conv_ms(m));
+}
+static DEVICE_ATTR_RO(mode);
+
+static ssize_t ttl_ms_show(struct device *dev,
+                           struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "%u\n", READ_ONCE(bh1750_ttl_ms));
+}
+
+static ssize_t ttl_ms_store(struct device *dev,
+                            struct device_attribute *attr,
+                            const char *buf, size_t count)
+{
+    unsigned int val;
+    int ret = kstrtouint(buf, 0, &val);
+
+    if (ret)
+        return ret;
+
+    WRITE_ONCE(bh1750_ttl_ms, val);
+    return count;
+}
+static DEVICE_ATTR_RW(ttl_ms);
+
+/* Time spent in probe, and from probe start to the first result (0 = none yet) */
+static ssize_t probe_us_show(struct device *dev,
+                             struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "%u\n", READ_ONCE(bh1750_probe_us));
+}
+static DEVICE_ATTR_RO(probe_us);
 
-    /* Convert to lux (datasheet: lux = raw / 1.2) */
-    return raw * 10 / 12;  // return lux * 10 for one decimal place
+static ssize_t first_read_us_show(struct device *dev,
+                                  struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "%u\n", READ_ONCE(bh1750_first_read_us));
 }
+static DEVICE_ATTR_RO(first_read_us);
+
+static struct attribute *bh1750_attrs[] = {
+    &dev_attr_policy.attr,
+    &dev_attr_mode.attr,
+    &dev_attr_ttl_ms.attr,
+    &dev_attr_probe_us.attr,
+    &dev_attr_first_read_us.attr,
+    NULL,
+};
+
+static const struct attribute_group bh1750_attr_group = {
+    .attrs = bh1750_attrs,
+};
 
 /* =========================================================================
  *  File Operations
@@ -59,7 +577,7 @@ static ssize_t my_misc_read(struct file *file, char __user *buf,
     if (*ppos > 0)
         return 0;
 
-    lux10 = bh1750_read_lux(bh1750_client);
+    lux10 = bh1750_read_lux();
     if (lux10 < 0)
         return lux10;
 
@@ -100,35 +618,54 @@ static struct miscdevice my_misc_dev = {
  *  I2C Driver
  * ========================================================================= */
 
+/*
+ * Probe only registers the device and kicks the first conversion; its
+ * result is logged from the work item (and served to any reader that
+ * arrives while it is in flight), so probe does not wait 120 ms for it.
+ */
 static int my_i2c_probe(struct i2c_client *client,
                         const struct i2c_device_id *id)
 {
-    int lux10;
+    int ret;
 
     pr_info("BH1750: probe start\n");
 
+    bh1750_probe_start = ktime_get();
+    bh1750_first_read_us = 0;
     bh1750_client = client;
+    bh1750_cur_mtreg = 0;
+    bh1750_sm_init();
 
-    lux10 = bh1750_read_lux(client);
-    if (lux10 >= 0)
-        pr_info("BH1750 first read: %d.%d lux\n",
-                lux10 / 10, lux10 % 10);
-    else
-        pr_warn("BH1750: initial read failed\n");
+    ret = sysfs_create_group(&client->dev.kobj, &bh1750_attr_group);
+    if (ret) {
+        dev_err(&client->dev, "Failed to create sysfs group: %d\n", ret);
+        bh1750_sm_stop();
+        return ret;
+    }
 
     /* Register /dev/bh1750_sensor */
     if (misc_register(&my_misc_dev)) {
         dev_err(&client->dev, "Failed to register misc device\n");
+        sysfs_remove_group(&client->dev.kobj, &bh1750_attr_group);
+        bh1750_sm_stop();
         return -EINVAL;
     }
 
-    pr_info("BH1750 driver initialized (/dev/%s)\n", DEVICE_NAME);
+    mutex_lock(&bh1750.lock);
+    bh1750_request();
+    mutex_unlock(&bh1750.lock);
+
+    bh1750_probe_us = ktime_us_delta(ktime_get(), bh1750_probe_start);
+    pr_info("BH1750 driver initialized (/dev/%s), probe took %u us\n",
+            DEVICE_NAME, bh1750_probe_us);
     return 0;
 }
 
 static int my_i2c_remove(struct i2c_client *client)
 {
     misc_deregister(&my_misc_dev);
+    sysfs_remove_group(&client->dev.kobj, &bh1750_attr_group);
+    bh1750_sm_stop();
     pr_info("BH1750 driver removed\n");
     return 0;
 }
@@ -143,6 +680,7 @@ static struct i2c_driver bh1750_driver = {
     .driver = {
         .name           = DRIVER_NAME,
         .of_match_table = my_i2c_of_match,
+        .probe_type     = PROBE_PREFER_ASYNCHRONOUS,
     },
     .probe  = my_i2c_probe,
     .remove = my_i2c_remove,
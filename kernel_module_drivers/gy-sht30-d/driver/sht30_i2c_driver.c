@@ -5,11 +5,21 @@
 #include <linux/miscdevice.h>
 #include <linux/fs.h>
 #include <linux/uaccess.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/mutex.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
+#include <linux/jiffies.h>
+
+#include "sensor_hub.h"
 
 #define DEVICE_NAME   	"sht30_sensor"  // Name of the device node (/dev/sht30_sensor)
 #define DRIVER_NAME 	"sht30_i2c"
 #define MAX_BUF_SIZE    64
 
+#define SHT30_POLL_US	500		// retry period while the sensor NACKs a read
+
 // =========================================================================
 // == Low-Level Hardware Interface 
 // =========================================================================
@@ -35,29 +45,62 @@ static u8 sht30_crc8(const u8 *data, size_t len)
 /*--- Global clientr ---*/ 
 static struct i2c_client *sht30_client;
 
-/*--- Helper: read and convert in one function ---*/ 
-static int sht30_read_measurement(struct i2c_client *client, int *temp_milli, int *hum_milli)
+// =========================================================================
+// == Measurement Modes
+// =========================================================================
+
+/*
+ * Single-shot commands (datasheet table 9). Conversion times are the
+ * datasheet typical/max values; with clock stretching the sensor holds SCL
+ * until the result is ready, so no host-side wait is needed at all.
+ */
+struct sht30_mode {
+	u8 cmd_lsb_stretch;		// MSB 0x2C
+	u8 cmd_lsb_nostretch;	// MSB 0x24
+	u16 typ_us;
+	u16 max_us;
+};
+
+static const struct sht30_mode sht30_modes[] = {
+	{ 0x10, 0x16,  2500,  4000 },	// low
+	{ 0x0D, 0x0B,  4500,  6000 },	// medium
+	{ 0x06, 0x00, 12500, 15000 },	// high
+};
+
+static const char * const sht30_mode_names[] = { "low", "medium", "high" };
+
+static int sht30_repeatability = ARRAY_SIZE(sht30_modes) - 1;	// high (legacy)
+static bool sht30_clock_stretch;
+static unsigned int sht30_last_latency_us;
+
+static unsigned int sht30_ttl_ms;	// serve cached results younger than this
+
+/*--- Boot timing, reported in the log and in sysfs ---*/
+static ktime_t sht30_probe_start;
+static unsigned int sht30_probe_us;
+static unsigned int sht30_first_read_us;	// probe start -> first result
+
+/*--- Helper: send the single-shot command for a mode ---*/
+static int sht30_send_command(struct i2c_client *client, const struct sht30_mode *m, bool stretch)
 {
+	u8 cmd[2];
 	int ret;
-	u8 cmd[2] = { 0x24, 0x00 };
-	u8 buf[6];
-	u16 raw_temp, raw_hum;
 
-	// Send command
+	cmd[0] = stretch ? 0x2C : 0x24;
+	cmd[1] = stretch ? m->cmd_lsb_stretch : m->cmd_lsb_nostretch;
+
 	ret = i2c_master_send(client, cmd, 2);
 	if (ret < 0) {
 		dev_err(&client->dev, "i2c_master_send failed: %d\n", ret);
 		return -EIO;
 	}
+	return 0;
+}
 
-	msleep(20);	// wait
-
-	// Read 6 bytes
-	ret = i2c_master_recv(client, buf, sizeof(buf));
-	if (ret != sizeof(buf)) {
-		dev_err(&client->dev, "i2c_master_recv failed: %d\n", ret);
-		return -EIO;
-	}
+/*--- Helper: check CRC and convert a 6-byte result ---*/
+static int sht30_parse(struct i2c_client *client, const u8 *buf, int *temp_milli, int *hum_milli)
+{
+	u16 raw_temp, raw_hum;
 
 	// CRC check
 	if (buf[2] != sht30_crc8(buf, 2) || buf[5] != sht30_crc8(buf + 3, 2)) {
@@ -77,6 +120,372 @@ static int sht30_read_measurement(struct i2c_client *client, int *temp_milli, in
 }
 
 
+// =========================================================================
+// == Measurement State Machine
+// =========================================================================
+
+/*
+ * Readers never touch the bus themselves. The first reader kicks a
+ * conversion; the work item sends the command, an hrtimer brings it back
+ * when the result is due and the work item fetches it (polling while the
+ * sensor NACKs). Readers that arrive while a conversion is in flight wait
+ * for that same result, and a result younger than ttl_ms is served from
+ * the cache without touching the bus.
+ */
+enum sht30_state {
+	SHT30_IDLE,
+	SHT30_START,		// conversion requested, command not sent yet
+	SHT30_CONVERTING,	// command sent, waiting for the result
+};
+
+static struct {
+	struct mutex lock;		// protects the fields below and the bus
+	wait_queue_head_t wq;
+	struct work_struct work;
+	struct hrtimer timer;
+	enum sht30_state state;
+	bool stopping;
+	const struct sht30_mode *mode;	// mode of the conversion in flight
+	ktime_t start;
+	unsigned int waited_us;
+	unsigned long seq;		// completed conversions
+	int err;			// status of the last conversion
+	int temp_milli, hum_milli;
+	unsigned long stamp;		// jiffies of the last good result
+} sht30 = {
+	.lock     = __MUTEX_INITIALIZER(sht30.lock),
+	.wq       = __WAIT_QUEUE_HEAD_INITIALIZER(sht30.wq),
+	.stopping = true,		// until probe
+};
+
+/*--- Publish a result (or error) and wake every waiting reader ---*/
+static void sht30_complete(int err, const u8 *buf)
+{
+	if (!err)
+		err = sht30_parse(sht30_client, buf, &sht30.temp_milli, &sht30.hum_milli);
+	if (!err) {
+		sht30.stamp = jiffies;
+		WRITE_ONCE(sht30_last_latency_us, ktime_us_delta(ktime_get(), sht30.start));
+	}
+
+	if (!sht30.seq) {
+		WRITE_ONCE(sht30_first_read_us, ktime_us_delta(ktime_get(), sht30_probe_start));
+		if (!err)
+			pr_info("SHT30: Temp=%d.%dC, Hum=%d.%d%% (%u us after probe)\n", sht30.temp_milli / 1000, abs(sht30.temp_milli % 1000) / 100, sht30.hum_milli / 1000, (sht30.hum_milli % 1000) / 100, sht30_first_read_us);
+		else
+			pr_warn("SHT30: Initial read failed: %d\n", err);
+	}
+
+	sht30.err = err;
+	sht30.state = SHT30_IDLE;
+	WRITE_ONCE(sht30.seq, sht30.seq + 1);
+	wake_up_all(&sht30.wq);
+}
+
+/*--- Work item: advance the state machine by one step ---*/
+static void sht30_work_fn(struct work_struct *work)
+{
+	struct i2c_client *client = sht30_client;
+	bool stretch;
+	u8 buf[6];
+	int ret;
+
+	mutex_lock(&sht30.lock);
+	if (sht30.stopping)
+		goto out;
+
+	switch (sht30.state) {
+	case SHT30_START:
+		sht30.mode = &sht30_modes[READ_ONCE(sht30_repeatability)];
+		stretch = READ_ONCE(sht30_clock_stretch);
+
+		ret = sht30_send_command(client, sht30.mode, stretch);
+		if (ret < 0) {
+			sht30_complete(ret, NULL);
+			break;
+		}
+		sht30.start = ktime_get();
+
+		if (stretch) {
+			// The sensor holds SCL until the result is ready
+			ret = i2c_master_recv(client, buf, sizeof(buf));
+			if (ret != sizeof(buf))
+				dev_err(&client->dev, "i2c_master_recv failed: %d\n", ret);
+			sht30_complete(ret == sizeof(buf) ? 0 : -EIO, buf);
+			break;
+		}
+
+		// Come back after the typical time, then poll until the maximum
+		sht30.state = SHT30_CONVERTING;
+		sht30.waited_us = sht30.mode->typ_us;
+		hrtimer_start(&sht30.timer, us_to_ktime(sht30.waited_us), HRTIMER_MODE_REL);
+		break;
+
+	case SHT30_CONVERTING:
+		ret = i2c_master_recv(client, buf, sizeof(buf));
+		if (ret != sizeof(buf) && sht30.waited_us < sht30.mode->max_us + SHT30_POLL_US) {
+			sht30.waited_us += SHT30_POLL_US;
+			hrtimer_start(&sht30.timer, us_to_ktime(SHT30_POLL_US), HRTIMER_MODE_REL);
+			break;
+		}
+		if (ret != sizeof(buf))
+			dev_err(&client->dev, "i2c_master_recv failed: %d\n", ret);
+		sht30_complete(ret == sizeof(buf) ? 0 : -EIO, buf);
+		break;
+
+	default:
+		break;
+	}
+out:
+	mutex_unlock(&sht30.lock);
+}
+
+static enum hrtimer_restart sht30_timer_fn(struct hrtimer *timer)
+{
+	schedule_work(&sht30.work);
+	return HRTIMER_NORESTART;
+}
+
+/*--- Start a conversion unless one is already in flight (lock held) ---*/
+static void sht30_request(void)
+{
+	if (sht30.state == SHT30_IDLE) {
+		sht30.state = SHT30_START;
+		schedule_work(&sht30.work);
+	}
+}
+
+/*--- Get a measurement: cached if fresh, else join or start a conversion ---*/
+static int sht30_read_measurement(int *temp_milli, int *hum_milli)
+{
+	unsigned long target;
+	int ret;
+
+	mutex_lock(&sht30.lock);
+	if (sht30.seq && !sht30.err &&
+	    time_before(jiffies, sht30.stamp + msecs_to_jiffies(READ_ONCE(sht30_ttl_ms))))
+		goto copy;
+
+	sht30_request();
+	target = sht30.seq + 1;
+	mutex_unlock(&sht30.lock);
+
+	ret = wait_event_interruptible(sht30.wq,
+				       (long)(READ_ONCE(sht30.seq) - target) >= 0 ||
+				       READ_ONCE(sht30.stopping));
+	if (ret)
+		return ret;
+
+	mutex_lock(&sht30.lock);
+	if (sht30.stopping) {
+		mutex_unlock(&sht30.lock);
+		return -ENODEV;
+	}
+copy:
+	ret = sht30.err;
+	*temp_milli = sht30.temp_milli;
+	*hum_milli = sht30.hum_milli;
+	mutex_unlock(&sht30.lock);
+
+	return ret;
+}
+
+/*--- Set up the state machine (called before the first read) ---*/
+static void sht30_sm_init(void)
+{
+	INIT_WORK(&sht30.work, sht30_work_fn);
+	hrtimer_init(&sht30.timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	sht30.timer.function = sht30_timer_fn;
+
+	mutex_lock(&sht30.lock);
+	sht30.state = SHT30_IDLE;
+	sht30.stopping = false;
+	// A rebind starts over: no cached result, next one is the first read
+	WRITE_ONCE(sht30.seq, 0);
+	sht30.stamp = 0;
+	mutex_unlock(&sht30.lock);
+}
+
+/*--- Stop the state machine and release any waiting readers ---*/
+static void sht30_sm_stop(void)
+{
+	mutex_lock(&sht30.lock);
+	sht30.stopping = true;
+	mutex_unlock(&sht30.lock);
+	wake_up_all(&sht30.wq);
+
+	// The work item no longer re-arms the timer once stopping is set
+	hrtimer_cancel(&sht30.timer);
+	cancel_work_sync(&sht30.work);
+}
+
+// =========================================================================
+// == Sensor Hub Interface (see sensor_hub.h)
+// =========================================================================
+
+/*--- Wait for idle, lock the bus and send the command ---*/
+int sht30_hub_start(unsigned int *conv_us)
+{
+	int ret;
+
+	for (;;) {
+		ret = wait_event_interruptible(sht30.wq,
+					       READ_ONCE(sht30.state) == SHT30_IDLE ||
+					       READ_ONCE(sht30.stopping));
+		if (ret)
+			return ret;
+
+		mutex_lock(&sht30.lock);
+		if (sht30.stopping) {
+			mutex_unlock(&sht30.lock);
+			return -ENODEV;
+		}
+		if (sht30.state == SHT30_IDLE)
+			break;
+		mutex_unlock(&sht30.lock);
+	}
+
+	// Never stretch here: it would hold the bus the other sensors need
+	sht30.mode = &sht30_modes[READ_ONCE(sht30_repeatability)];
+	ret = sht30_send_command(sht30_client, sht30.mode, false);
+	if (ret < 0) {
+		sht30_complete(ret, NULL);
+		mutex_unlock(&sht30.lock);
+		return ret;
+	}
+
+	sht30.start = ktime_get();
+	sht30.state = SHT30_CONVERTING;
+	*conv_us = sht30.mode->max_us;
+	return 0;
+}
+EXPORT_SYMBOL_GPL(sht30_hub_start);
+
+/*--- Fetch the result, publish it and unlock the bus ---*/
+int sht30_hub_finish(int *temp_milli, int *hum_milli)
+{
+	u8 buf[6];
+	int ret;
+
+	ret = i2c_master_recv(sht30_client, buf, sizeof(buf));
+	if (ret != sizeof(buf))
+		dev_err(&sht30_client->dev, "i2c_master_recv failed: %d\n", ret);
+	sht30_complete(ret == sizeof(buf) ? 0 : -EIO, buf);
+
+	ret = sht30.err;
+	*temp_milli = sht30.temp_milli;
+	*hum_milli = sht30.hum_milli;
+	mutex_unlock(&sht30.lock);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(sht30_hub_finish);
+
+
+// =========================================================================
+// == Sysfs Attributes (/sys/bus/i2c/devices/<bus>-0044/)
+// =========================================================================
+
+/*--- repeatability: low | medium | high ---*/
+static ssize_t repeatability_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	int i, len = 0;
+	int cur = READ_ONCE(sht30_repeatability);
+
+	for (i = 0; i < ARRAY_SIZE(sht30_mode_names); i++)
+		len += sysfs_emit_at(buf, len, i == cur ? "[%s] " : "%s ", sht30_mode_names[i]);
+	buf[len - 1] = '\n';
+	return len;
+}
+
+static ssize_t repeatability_store(struct device *dev, struct device_attribute *attr,
+				   const char *buf, size_t count)
+{
+	int i = sysfs_match_string(sht30_mode_names, buf);
+
+	if (i < 0)
+		return i;
+
+	WRITE_ONCE(sht30_repeatability, i);
+	return count;
+}
+static DEVICE_ATTR_RW(repeatability);
+
+/*--- clock_stretch: 0 = poll for the result, 1 = sensor holds SCL ---*/
+static ssize_t clock_stretch_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	return sysfs_emit(buf, "%d\n", READ_ONCE(sht30_clock_stretch));
+}
+
+static ssize_t clock_stretch_store(struct device *dev, struct device_attribute *attr,
+				   const char *buf, size_t count)
+{
+	bool val;
+	int ret = kstrtobool(buf, &val);
+
+	if (ret)
+		return ret;
+
+	WRITE_ONCE(sht30_clock_stretch, val);
+	return count;
+}
+static DEVICE_ATTR_RW(clock_stretch);
+
+/*--- latency_us: command-to-result time of the last measurement ---*/
+static ssize_t latency_us_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	return sysfs_emit(buf, "%u\n", READ_ONCE(sht30_last_latency_us));
+}
+static DEVICE_ATTR_RO(latency_us);
+
+/*--- ttl_ms: serve results younger than this without a new conversion ---*/
+static ssize_t ttl_ms_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	return sysfs_emit(buf, "%u\n", READ_ONCE(sht30_ttl_ms));
+}
+
+static ssize_t ttl_ms_store(struct device *dev, struct device_attribute *attr,
+			    const char *buf, size_t count)
+{
+	unsigned int val;
+	int ret = kstrtouint(buf, 0, &val);
+
+	if (ret)
+		return ret;
+
+	WRITE_ONCE(sht30_ttl_ms, val);
+	return count;
+}
+static DEVICE_ATTR_RW(ttl_ms);
+
+/*--- probe_us / first_read_us: time in probe, probe start -> first result ---*/
+static ssize_t probe_us_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	return sysfs_emit(buf, "%u\n", READ_ONCE(sht30_probe_us));
+}
+static DEVICE_ATTR_RO(probe_us);
+
+static ssize_t first_read_us_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	return sysfs_emit(buf, "%u\n", READ_ONCE(sht30_first_read_us));
+}
+static DEVICE_ATTR_RO(first_read_us);
+
+static struct attribute *sht30_attrs[] = {
+	&dev_attr_repeatability.attr,
+	&dev_attr_clock_stretch.attr,
+	&dev_attr_latency_us.attr,
+	&dev_attr_ttl_ms.attr,
+	&dev_attr_probe_us.attr,
+	&dev_attr_first_read_us.attr,
+	NULL,
+};
+
+static const struct attribute_group sht30_attr_group = {
+	.attrs = sht30_attrs,
+};
+
+
 // =========================================================================
 // == File_operations
 // =========================================================================
@@ -104,7 +513,7 @@ static ssize_t my_misc_read(struct file *file, char __user *buf, size_t count, l
 		return 0;
 
 	// Get data
-	ret = sht30_read_measurement(sht30_client, &temp_milli, &hum_milli);
+	ret = sht30_read_measurement(&temp_milli, &hum_milli);
 	if (ret < 0)
 		return ret;
 
@@ -143,30 +552,45 @@ static struct miscdevice my_misc_dev = {
 // == Linux I2C Driver Implementation
 // =========================================================================
 
-/* --- Probe Function --- */
+/*
+ * --- Probe Function ---
+ * Only registers the device and kicks the first measurement; the result
+ * is logged from the work item, so probe does not wait up to 15 ms for it.
+ */
 static int my_i2c_probe(struct i2c_client *client, const struct i2c_device_id *id)
 {
-	int temp_milli, hum_milli, ret;
+	int ret;
 
 	pr_info("SHT30: Probe start\n");
 
+	sht30_probe_start = ktime_get();
+	sht30_first_read_us = 0;
 	sht30_client = client;
+	sht30_sm_init();
 
-	ret = sht30_read_measurement(sht30_client, &temp_milli, &hum_milli);
-	if (ret == 0) {
-		pr_info("SHT30: Temp=%d.%dC, Hum=%d.%d%%\n", temp_milli / 1000, abs(temp_milli % 1000) / 100, hum_milli / 1000, (hum_milli % 1000) / 100);
-	} else {
-		pr_warn("SHT30: Initial read failed\n");
+	ret = sysfs_create_group(&client->dev.kobj, &sht30_attr_group);
+	if (ret) {
+		dev_err(&client->dev, "Failed to create sysfs group: %d\n", ret);
+		sht30_sm_stop();
+		return ret;
 	}
 
 	// Register MISC device
 	ret = misc_register(&my_misc_dev);
 	if (ret) {
 		dev_err(&client->dev, "Failed to register misc device: %d\n", ret);
+		sysfs_remove_group(&client->dev.kobj, &sht30_attr_group);
+		sht30_sm_stop();
 		return ret;
 	}
 
-	pr_info("SHT30 driver initialized: /dev/%s\n", DEVICE_NAME);
+	// First measurement, joined by any reader that comes before it is done
+	mutex_lock(&sht30.lock);
+	sht30_request();
+	mutex_unlock(&sht30.lock);
+
+	sht30_probe_us = ktime_us_delta(ktime_get(), sht30_probe_start);
+	pr_info("SHT30 driver initialized: /dev/%s, probe took %u us\n", DEVICE_NAME, sht30_probe_us);
 	return 0;
 }
 
@@ -175,6 +599,8 @@ static int my_i2c_remove(struct i2c_client *client)
 {
 	// Unregister MISC device
 	misc_deregister(&my_misc_dev);
+	sysfs_remove_group(&client->dev.kobj, &sht30_attr_group);
+	sht30_sm_stop();
 
 	pr_info("SHT30 driver removed\n");
 	return 0;
@@ -192,6 +618,7 @@ static struct i2c_driver sht30_driver = {
 	.driver = {
 		.name           = DRIVER_NAME,
 		.of_match_table = my_i2c_of_match,
+		.probe_type     = PROBE_PREFER_ASYNCHRONOUS,
 	},
 	.probe  = my_i2c_probe,
 	.remove = my_i2c_remove,
@@ -3,17 +3,28 @@
 #include <linux/gpio.h>
 #include <linux/of_gpio.h>
 #include <linux/delay.h>
+#include <linux/ktime.h>
 #include <linux/fs.h>
 #include <linux/miscdevice.h>
 #include <linux/printk.h>
 #include <linux/uaccess.h> 
 #include <linux/string.h>  
 #include <linux/random.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
 
 #define DEVICE_NAME     "oled_ssd1306"   // Name of the device node (/dev/oled_ssd1306)
 #define DRIVER_NAME     "ssd1306_spi"
 #define MAX_BUF_SIZE    128
 
+#define SSD1306_WIDTH   128
+#define SSD1306_PAGES   8
+
+// ioctl: block until everything written so far is on the panel (same as fsync)
+#define SSD1306_IOC_WAIT    _IO('O', 1)
+
 // Font 8x8
 static const u8 font_8x8[][8] = {
     {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Space (32)
@@ -134,20 +145,60 @@ static void ssd1306_send_command(u8 cmd)
     spi_write(ssd1306_spi, &cmd, 1);
 }
 
-// Send a data byte to SSD1306
-static void ssd1306_send_data(u8 data) 
+// Power-up command sequence, sent as a single transfer with DC low
+static const u8 ssd1306_init_cmds[] = {
+    0xAE,                   // Display OFF
+    0xD5, 0x80,             // Set display clock
+    0xA8, 0x3F,             // Set multiplex ratio: 64 lines
+    0xD3, 0x00,             // Set display offset
+    0x40,                   // Set start line
+    0x8D, 0x14,             // Charge pump: enable
+    0x20, 0x00,             // Memory mode: horizontal addressing
+    0xA1,                   // Segment remap
+    0xC8,                   // COM scan direction
+    0xDA, 0x12,             // COM pins config
+    0x81, 0xCF,             // Set contrast
+    0xD9, 0xF1,             // Set precharge
+    0xDB, 0x40,             // Set VCOMH
+    0xA4,                   // Resume to RAM
+    0xA6,                   // Normal display
+    0xAF,                   // Display ON
+};
+
+/*
+ * Rendering goes to a RAM copy of the panel (same page/column layout as the
+ * controller's GDDRAM) and the whole frame is then sent in one transfer.
+ * Kept in kmalloc'd memory because SPI controllers may DMA from it.
+ */
+struct ssd1306_frame {
+    u8 init[sizeof(ssd1306_init_cmds)];
+    u8 window[6];                           // column/page address commands
+    u8 fb[SSD1306_PAGES][SSD1306_WIDTH];
+};
+
+static struct ssd1306_frame *frame;
+
+static const u8 ssd1306_window_cmds[6] = {
+    0x21, 0x00, SSD1306_WIDTH - 1,          // Column address 0..127
+    0x22, 0x00, SSD1306_PAGES - 1,          // Page address 0..7
+};
+
+// Send the frame buffer synchronously (panel init/remove only)
+static void ssd1306_flush_sync(void)
 {
-    gpio_set_value(dc_gpio, 1);         
-    spi_write(ssd1306_spi, &data, 1);
+    gpio_set_value(dc_gpio, 0);
+    spi_write(ssd1306_spi, frame->window, sizeof(frame->window));
+    gpio_set_value(dc_gpio, 1);
+    spi_write(ssd1306_spi, frame->fb, sizeof(frame->fb));
 }
 
-// Hardware reset
+// Hardware reset: RES# low for >= 3 us, then give the controller time to settle
 static void ssd1306_reset(void)
 {
     gpio_set_value(reset_gpio, 0);     
-    msleep(10);
+    usleep_range(10, 20);
     gpio_set_value(reset_gpio, 1);   
-    msleep(10);
+    usleep_range(1000, 1500);
 }
 
 
@@ -160,31 +211,9 @@ static void ssd1306_init_display(void)
 {
     ssd1306_reset();
 
-    ssd1306_send_command(0xAE);         // Display OFF
-    ssd1306_send_command(0xD5);         // Set display clock
-    ssd1306_send_command(0x80);
-    ssd1306_send_command(0xA8);         // Set multiplex ratio
-    ssd1306_send_command(0x3F);         // 64 lines
-    ssd1306_send_command(0xD3);         // Set display offset
-    ssd1306_send_command(0x00);
-    ssd1306_send_command(0x40);         // Set start line
-    ssd1306_send_command(0x8D);         // Charge pump
-    ssd1306_send_command(0x14);         // Enable charge pump
-    ssd1306_send_command(0x20);         // Memory mode
-    ssd1306_send_command(0x00);         // Horizontal addressing
-    ssd1306_send_command(0xA1);         // Segment remap
-    ssd1306_send_command(0xC8);         // COM scan direction
-    ssd1306_send_command(0xDA);         // COM pins config
-    ssd1306_send_command(0x12);
-    ssd1306_send_command(0x81);         // Set contrast
-    ssd1306_send_command(0xCF);
-    ssd1306_send_command(0xD9);         // Set precharge
-    ssd1306_send_command(0xF1);
-    ssd1306_send_command(0xDB);         // Set VCOMH
-    ssd1306_send_command(0x40);
-    ssd1306_send_command(0xA4);         // Resume to RAM
-    ssd1306_send_command(0xA6);         // Normal display
-    ssd1306_send_command(0xAF);         // Display ON
+    memcpy(frame->init, ssd1306_init_cmds, sizeof(frame->init));
+    gpio_set_value(dc_gpio, 0);
+    spi_write(ssd1306_spi, frame->init, sizeof(frame->init));
 }
 
 // Fill screen (white) - Test
@@ -206,17 +235,7 @@ static void ssd1306_init_display(void)
 // Clear screen (black)
 static void ssd1306_clear_display(void)
 {
-    int page, col;
-    
-    for (page = 0; page < 8; page++) {
-        ssd1306_send_command(0xB0 + page);  
-        ssd1306_send_command(0x00);         
-        ssd1306_send_command(0x10);         
-        
-        for (col = 0; col < 128; col++) {
-            ssd1306_send_data(0x00);        
-        }
-    }
+    memset(frame->fb, 0x00, sizeof(frame->fb));
 }
 
 
@@ -224,36 +243,30 @@ static void ssd1306_clear_display(void)
 // == Graphics Primitives
 // =========================================================================
 
+// Draw an 8x8 glyph at the position (x, y) - x: column (0-127), y: row (0-7)
+static void ssd1306_draw_glyph(int x, int y, const u8 *glyph)
+{
+    int i;
+
+    for (i = 0; i < 8 && x + i < SSD1306_WIDTH; i++) {
+        frame->fb[y][x + i] = glyph[i];
+    }
+}
+
 // Draw a character at the position (x, y) - x: column (0-127), y: row (0-7)
 static void ssd1306_draw_char(int x, int y, char ch)
 {
-    int i;
-    
     if (ch < 32 || ch > 126) {
         ch = 32;  
     }
     
-    ssd1306_send_command(0xB0 + y);             
-    ssd1306_send_command(0x00 | (x & 0x0F));    
-    ssd1306_send_command(0x10 | (x >> 4));      
-    
-    for (i = 0; i < 8; i++) {
-        ssd1306_send_data(font_8x8[ch - 32][i]);
-    }
+    ssd1306_draw_glyph(x, y, font_8x8[ch - 32]);
 }
 
 // Draw an 8x8 icon at the position (x, y) - x: column (0-127), y: row (0-7)
 static void ssd1306_draw_icon(int x, int y, const u8 *icon)
 {
-    int i;
-    
-    ssd1306_send_command(0xB0 + y);            
-    ssd1306_send_command(0x00 | (x & 0x0F));    
-    ssd1306_send_command(0x10 | (x >> 4));      
-    
-    for (i = 0; i < 8; i++) {
-        ssd1306_send_data(icon[i]);
-    }
+    ssd1306_draw_glyph(x, y, icon);
 }
 
 // Display string at position (x, y) - x: column (0-127), y: row (0-7)
@@ -286,6 +299,37 @@ static void ssd1306_update_data(char *temp, char *humi, char *lux)
     ssd1306_display_string(70, 6, lux_buf);
 }
 
+// Render a "temp-humi-lux[-age]" string into the frame buffer
+static void ssd1306_render_data(char *kbuf)
+{
+    char *p, *temp, *humi, *lux, *age;
+
+    // Split string
+    p = kbuf;
+    temp = strsep(&p, "-");
+    humi = strsep(&p, "-");
+    lux = strsep(&p, "-");
+    age = strsep(&p, "-");
+
+    ssd1306_clear_display();        
+
+    ssd1306_draw_icon(1, 2, icon_thermometer);      
+    ssd1306_display_string(16, 2, "Temp :");
+    
+    ssd1306_draw_icon(1, 4, icon_water_drop);       
+    ssd1306_display_string(16, 4, "Humid:");
+    
+    ssd1306_draw_icon(1, 6, icon_sun);              
+    ssd1306_display_string(16, 6, "Light:");
+      
+    ssd1306_update_data(temp ? temp : "", humi ? humi : "", lux ? lux : "");
+
+    // Age of the last good values shown while a sensor is down, top right
+    if (age && *age && strlen(age) <= 16) {
+        ssd1306_display_string(128 - 8 * strlen(age), 0, age);
+    }
+}
+
 static void ssd1306_display_startup(void) 
 {
     ssd1306_display_string(37, 2, "~Ohayo~");
@@ -331,6 +375,194 @@ static void ssd1306_display_startup(void)
 // }
 
 
+// =========================================================================
+// == Deferred Frame Updates
+// =========================================================================
+
+/*
+ * write() only copies the new text into a pending slot and kicks the work
+ * item. The work item renders the latest pending text and sends it with
+ * spi_async(): the address window first (DC low), then, from that
+ * message's completion, the frame data (DC high). A write that lands
+ * while a frame is being rendered or sent simply replaces the pending
+ * text, so stale frames are never drawn. fsync()/SSD1306_IOC_WAIT block
+ * until everything written so far has reached the panel.
+ *
+ * Panel bring-up (reset, init sequence, splash) also runs from a work
+ * item, so probe returns as soon as the device node exists. Frames
+ * written before the panel is ready stay pending until init_work is done;
+ * if one is already there, the splash is skipped and that frame is shown
+ * first.
+ */
+static struct {
+    spinlock_t lock;                    // protects the fields below
+    wait_queue_head_t wq;
+    struct work_struct work;
+    struct work_struct init_work;
+    char pending[MAX_BUF_SIZE];
+    unsigned long pending_seq;          // last frame written by userspace
+    unsigned long flush_seq;            // frame being sent
+    unsigned long shown_seq;            // last frame on the panel
+    bool ready;                         // panel initialized
+    bool flushing;
+    bool stopping;
+    struct spi_transfer window_xfer, data_xfer;
+    struct spi_message window_msg, data_msg;
+
+    // Boot timing, reported in the log and in sysfs
+    ktime_t probe_start;
+    unsigned int probe_us;              // time spent in probe
+    unsigned int init_us;               // panel reset + init + first flush
+    unsigned int first_frame_us;        // probe start -> first userspace frame shown
+} oled;
+
+static void ssd1306_data_complete(void *context)
+{
+    unsigned long flags;
+    bool more;
+
+    if (oled.data_msg.status)
+        pr_warn_ratelimited("SSD1306: frame transfer failed: %d\n", oled.data_msg.status);
+
+    if (!oled.first_frame_us)
+        WRITE_ONCE(oled.first_frame_us, ktime_us_delta(ktime_get(), oled.probe_start));
+
+    spin_lock_irqsave(&oled.lock, flags);
+    oled.shown_seq = oled.flush_seq;
+    oled.flushing = false;
+    more = oled.pending_seq != oled.shown_seq && !oled.stopping;
+    spin_unlock_irqrestore(&oled.lock, flags);
+
+    wake_up_all(&oled.wq);
+    if (more)
+        schedule_work(&oled.work);
+}
+
+static void ssd1306_window_complete(void *context)
+{
+    int ret = oled.window_msg.status;
+
+    if (!ret) {
+        gpio_set_value(dc_gpio, 1);
+        ret = spi_async(ssd1306_spi, &oled.data_msg);
+    }
+    if (ret) {
+        oled.data_msg.status = ret;
+        ssd1306_data_complete(context);
+    }
+}
+
+// Render the latest pending text and start sending it
+static void ssd1306_render_work(struct work_struct *work)
+{
+    char text[MAX_BUF_SIZE];
+    unsigned long flags;
+    int ret;
+
+    spin_lock_irqsave(&oled.lock, flags);
+    if (!oled.ready || oled.flushing || oled.stopping ||
+        oled.pending_seq == oled.shown_seq) {
+        spin_unlock_irqrestore(&oled.lock, flags);
+        return;
+    }
+    memcpy(text, oled.pending, sizeof(text));
+    oled.flush_seq = oled.pending_seq;
+    oled.flushing = true;
+    spin_unlock_irqrestore(&oled.lock, flags);
+
+    // The frame buffer is only touched here while flushing is set
+    ssd1306_render_data(text);
+
+    gpio_set_value(dc_gpio, 0);
+    ret = spi_async(ssd1306_spi, &oled.window_msg);
+    if (ret) {
+        oled.data_msg.status = ret;
+        ssd1306_data_complete(NULL);
+    }
+}
+
+// Bring the panel up and show the splash (unless a frame is already pending)
+static void ssd1306_init_work(struct work_struct *work)
+{
+    ktime_t start = ktime_get();
+    unsigned long flags;
+    bool pending, stopping;
+
+    ssd1306_init_display();
+
+    spin_lock_irqsave(&oled.lock, flags);
+    pending = oled.pending_seq != oled.shown_seq;
+    spin_unlock_irqrestore(&oled.lock, flags);
+
+    ssd1306_clear_display();
+    if (!pending)
+        ssd1306_display_startup();
+    ssd1306_flush_sync();
+
+    WRITE_ONCE(oled.init_us, ktime_us_delta(ktime_get(), start));
+
+    spin_lock_irqsave(&oled.lock, flags);
+    oled.ready = true;
+    stopping = oled.stopping;
+    pending = oled.pending_seq != oled.shown_seq;
+    spin_unlock_irqrestore(&oled.lock, flags);
+
+    dev_info(&ssd1306_spi->dev, "panel ready: init %u us, %lld us after probe\n",
+             oled.init_us, ktime_us_delta(ktime_get(), oled.probe_start));
+
+    if (pending && !stopping)
+        schedule_work(&oled.work);
+}
+
+static void ssd1306_async_init(void)
+{
+    spin_lock_init(&oled.lock);
+    init_waitqueue_head(&oled.wq);
+    INIT_WORK(&oled.work, ssd1306_render_work);
+    INIT_WORK(&oled.init_work, ssd1306_init_work);
+    oled.pending_seq = oled.flush_seq = oled.shown_seq = 0;
+    oled.ready = false;
+    oled.flushing = false;
+    oled.stopping = false;
+
+    memcpy(frame->window, ssd1306_window_cmds, sizeof(frame->window));
+    oled.window_xfer.tx_buf = frame->window;
+    oled.window_xfer.len = sizeof(frame->window);
+    spi_message_init_with_transfers(&oled.window_msg, &oled.window_xfer, 1);
+    oled.window_msg.complete = ssd1306_window_complete;
+
+    oled.data_xfer.tx_buf = frame->fb;
+    oled.data_xfer.len = sizeof(frame->fb);
+    spi_message_init_with_transfers(&oled.data_msg, &oled.data_xfer, 1);
+    oled.data_msg.complete = ssd1306_data_complete;
+}
+
+// Stop accepting frames and wait for the one in flight to finish
+static void ssd1306_async_stop(void)
+{
+    unsigned long flags;
+
+    spin_lock_irqsave(&oled.lock, flags);
+    oled.stopping = true;
+    spin_unlock_irqrestore(&oled.lock, flags);
+
+    cancel_work_sync(&oled.init_work);
+    cancel_work_sync(&oled.work);
+    wait_event(oled.wq, !READ_ONCE(oled.flushing));
+    wake_up_all(&oled.wq);
+}
+
+// Block until every frame written so far is on the panel
+static int ssd1306_wait_shown(void)
+{
+    unsigned long target = READ_ONCE(oled.pending_seq);
+
+    return wait_event_interruptible(oled.wq,
+                                    (long)(READ_ONCE(oled.shown_seq) - target) >= 0 ||
+                                    READ_ONCE(oled.stopping));
+}
+
+
 // =========================================================================
 // == File_operations 
 // =========================================================================
@@ -357,7 +589,11 @@ static ssize_t my_misc_read(struct file *file, char __user *buf, size_t count, l
 static ssize_t my_misc_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos)
 {
     char kbuf[MAX_BUF_SIZE];
-    char *p, *temp, *humi, *lux;
+    unsigned long flags;
+
+    if (count == 0) {
+        return 0;
+    }
 
     // Limit buffer size
     if (count > MAX_BUF_SIZE - 1) {
@@ -377,37 +613,41 @@ static ssize_t my_misc_write(struct file *file, const char __user *buf, size_t c
         kbuf[count - 1] = '\0';
     }
 
-    // Split string
-    p = kbuf;
-    temp = strsep(&p, "-");
-    humi = strsep(&p, "-");
-    lux = strsep(&p, "-");
-
-    ssd1306_clear_display();        
+    // Replace whatever is pending; the work item draws only the latest
+    spin_lock_irqsave(&oled.lock, flags);
+    memcpy(oled.pending, kbuf, sizeof(kbuf));
+    oled.pending_seq++;
+    spin_unlock_irqrestore(&oled.lock, flags);
 
-    ssd1306_draw_icon(1, 2, icon_thermometer);      
-    ssd1306_display_string(16, 2, "Temp :");
-    
-    ssd1306_draw_icon(1, 4, icon_water_drop);       
-    ssd1306_display_string(16, 4, "Humid:");
-    
-    ssd1306_draw_icon(1, 6, icon_sun);              
-    ssd1306_display_string(16, 6, "Light:");
-      
-    // ssd1306_update_temperature(25.6);  
-    // ssd1306_update_humidity(68.3);    
-    // ssd1306_update_light(1234);     
-    ssd1306_update_data(temp, humi, lux);
+    schedule_work(&oled.work);
 
     return count; 
 }
 
+/*--- fsync(): wait until the last written frame is on the panel ---*/
+static int my_misc_fsync(struct file *file, loff_t start, loff_t end, int datasync)
+{
+    return ssd1306_wait_shown();
+}
+
+static long my_misc_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+    switch (cmd) {
+    case SSD1306_IOC_WAIT:
+        return ssd1306_wait_shown();
+    default:
+        return -ENOTTY;
+    }
+}
+
 static const struct file_operations my_fops = {
-    .owner   = THIS_MODULE,
-    .open    = my_misc_open,
-    .release = my_misc_release,
-    .read    = my_misc_read,
-    .write   = my_misc_write,
+    .owner          = THIS_MODULE,
+    .open           = my_misc_open,
+    .release        = my_misc_release,
+    .read           = my_misc_read,
+    .write          = my_misc_write,
+    .fsync          = my_misc_fsync,
+    .unlocked_ioctl = my_misc_ioctl,
 };
 
 static struct miscdevice my_misc_dev = {
@@ -417,17 +657,58 @@ static struct miscdevice my_misc_dev = {
 };
 
 
+// =========================================================================
+// == Sysfs Attributes
+// =========================================================================
+
+// Boot timing in microseconds (0 = not reached yet)
+static ssize_t probe_us_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "%u\n", READ_ONCE(oled.probe_us));
+}
+static DEVICE_ATTR_RO(probe_us);
+
+static ssize_t init_us_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "%u\n", READ_ONCE(oled.init_us));
+}
+static DEVICE_ATTR_RO(init_us);
+
+static ssize_t first_frame_us_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "%u\n", READ_ONCE(oled.first_frame_us));
+}
+static DEVICE_ATTR_RO(first_frame_us);
+
+static struct attribute *ssd1306_attrs[] = {
+    &dev_attr_probe_us.attr,
+    &dev_attr_init_us.attr,
+    &dev_attr_first_frame_us.attr,
+    NULL,
+};
+
+static const struct attribute_group ssd1306_attr_group = {
+    .attrs = ssd1306_attrs,
+};
+
+
 // =========================================================================
 // == Linux SPI Driver Implementation
 // =========================================================================
 
-/* --- Probe Function --- */
+/*
+ * --- Probe Function ---
+ * Sets up GPIOs and buffers and registers the device; the panel itself is
+ * brought up by init_work.
+ */
 static int my_spi_probe(struct spi_device *spi)
 {
     int ret;
     
     pr_info("SSD1306: Probe start\n");
     
+    oled.probe_start = ktime_get();
+    oled.probe_us = oled.init_us = oled.first_frame_us = 0;
     ssd1306_spi = spi;
     
     // Get GPIO from device tree
@@ -460,43 +741,58 @@ static int my_spi_probe(struct spi_device *spi)
     gpio_direction_output(reset_gpio, 1);
     
     pr_info("SSD1306: DC GPIO=%d, RESET GPIO=%d\n", dc_gpio, reset_gpio);
-    
-    ssd1306_init_display();
-    ssd1306_clear_display();
 
-    // ssd1306_draw_icon(1, 2, icon_thermometer);      
-    // ssd1306_display_string(16, 2, "Temp :");
-    
-    // ssd1306_draw_icon(1, 4, icon_water_drop);       
-    // ssd1306_display_string(16, 4, "Humid:");
-    
-    // ssd1306_draw_icon(1, 6, icon_sun);              
-    // ssd1306_display_string(16, 6, "Light:");
-    ssd1306_display_startup();
+    frame = devm_kzalloc(&spi->dev, sizeof(*frame), GFP_KERNEL);
+    if (!frame) {
+        gpio_free(reset_gpio);
+        gpio_free(dc_gpio);
+        return -ENOMEM;
+    }
+    ssd1306_async_init();
+
+    ret = sysfs_create_group(&spi->dev.kobj, &ssd1306_attr_group);
+    if (ret) {
+        dev_err(&spi->dev, "Failed to create sysfs group: %d\n", ret);
+        gpio_free(reset_gpio);
+        gpio_free(dc_gpio);
+        return ret;
+    }
     
     // Register MISC device
     ret = misc_register(&my_misc_dev);
     if (ret) {
         pr_err("my_misc_driver: Không thể đăng ký misc device. Lỗi: %d\n", ret);
+        sysfs_remove_group(&spi->dev.kobj, &ssd1306_attr_group);
+        gpio_free(reset_gpio);
+        gpio_free(dc_gpio);
         return ret;
     }
+
+    // Panel reset, init sequence and splash
+    schedule_work(&oled.init_work);
     
-    pr_info("SSD1306 driver initialized\n");
+    oled.probe_us = ktime_us_delta(ktime_get(), oled.probe_start);
+    pr_info("SSD1306 driver initialized, probe took %u us\n", oled.probe_us);
     return 0;
 }
 
 /* --- Remove Function --- */
 static int my_spi_remove(struct spi_device *spi)
 {
-    ssd1306_clear_display();
-    ssd1306_send_command(0xAE);
+    // Unregister MISC device
+    misc_deregister(&my_misc_dev);
+    sysfs_remove_group(&spi->dev.kobj, &ssd1306_attr_group);
+    ssd1306_async_stop();
+
+    if (oled.ready) {
+        ssd1306_clear_display();
+        ssd1306_flush_sync();
+        ssd1306_send_command(0xAE);
+    }
     
     // Free GPIOs
     gpio_free(reset_gpio);
     gpio_free(dc_gpio);
-
-    // Unregister MISC device
-    misc_deregister(&my_misc_dev);
     
     pr_info("SSD1306 driver removed\n");
     return 0;
@@ -514,6 +810,7 @@ static struct spi_driver my_spi_driver = {
     .driver = {
         .name           = DRIVER_NAME,
         .of_match_table = my_spi_of_match,
+        .probe_type     = PROBE_PREFER_ASYNCHRONOUS,
     },
     .probe  = my_spi_probe,
     .remove = my_spi_remove,
@@ -0,0 +1,189 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/miscdevice.h>
+#include <linux/fs.h>
+#include <linux/uaccess.h>
+#include <linux/mutex.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/sched.h>
+
+#include "sensor_hub.h"
+
+#define DEVICE_NAME     "sensor_hub"    // Name of the device node (/dev/sensor_hub)
+#define MAX_BUF_SIZE    96
+
+/*
+ * The SHT30 and BH1750 share one I2C bus. Instead of each driver running
+ * its own command/sleep/fetch cycle back to back, the hub starts both
+ * conversions immediately one after the other, sleeps once for the longest
+ * conversion time and then fetches both results. A combined sample costs
+ * roughly max(conversion times) and a single wakeup.
+ *
+ * read() returns one record: "<unix_ms>,<temp>-<hum>-<lux>", where a failed
+ * sensor reads "ERROR" in place of its fields (same layout as the app's
+ * display buffer). The timestamp is taken when the conversions start.
+ */
+
+// =========================================================================
+// == Combined Sample
+// =========================================================================
+
+static struct {
+    struct mutex lock;          // one hub cycle at a time
+    unsigned long seq;          // completed cycles
+    s64 stamp_ms;
+    int sht30_err, bh1750_err;
+    int temp_milli, hum_milli, lux10;
+} hub = {
+    .lock = __MUTEX_INITIALIZER(hub.lock),
+};
+
+/* Run one pipelined cycle over both sensors (hub.lock held) */
+static void sensor_hub_cycle(void)
+{
+    unsigned int conv_us = 0, us;
+    bool bh1750_started, sht30_started;
+    ktime_t due;
+
+    hub.stamp_ms = ktime_to_ms(ktime_get_real());
+
+    /* Longest conversion first, so the second command overlaps it */
+    hub.bh1750_err = bh1750_hub_start(&us);
+    bh1750_started = !hub.bh1750_err;
+    if (bh1750_started)
+        conv_us = max(conv_us, us);
+
+    hub.sht30_err = sht30_hub_start(&us);
+    sht30_started = !hub.sht30_err;
+    if (sht30_started)
+        conv_us = max(conv_us, us);
+
+    /* Exactly one wakeup, when the slowest result is due */
+    if (conv_us) {
+        due = us_to_ktime(conv_us);
+        __set_current_state(TASK_UNINTERRUPTIBLE);
+        schedule_hrtimeout_range(&due, 500 * NSEC_PER_USEC, HRTIMER_MODE_REL);
+    }
+
+    if (bh1750_started)
+        hub.bh1750_err = bh1750_hub_finish(&hub.lux10);
+    if (sht30_started)
+        hub.sht30_err = sht30_hub_finish(&hub.temp_milli, &hub.hum_milli);
+
+    hub.seq++;
+}
+
+/* Format the last sample as one record (hub.lock held) */
+static size_t sensor_hub_format(char *kbuf, size_t size)
+{
+    char sht30[32], bh1750[32];
+
+    if (hub.sht30_err)
+        snprintf(sht30, sizeof(sht30), "ERROR");
+    else
+        snprintf(sht30, sizeof(sht30), "%d.%d-%d.%d",
+                 hub.temp_milli / 1000, abs(hub.temp_milli % 1000) / 100,
+                 hub.hum_milli / 1000, (hub.hum_milli % 1000) / 100);
+
+    if (hub.bh1750_err)
+        snprintf(bh1750, sizeof(bh1750), "ERROR");
+    else
+        snprintf(bh1750, sizeof(bh1750), "%d.%d", hub.lux10 / 10, hub.lux10 % 10);
+
+    return scnprintf(kbuf, size, "%lld,%s-%s", (long long)hub.stamp_ms, sht30, bh1750);
+}
+
+
+// =========================================================================
+// == File_operations
+// =========================================================================
+
+static ssize_t my_misc_read(struct file *file, char __user *buf, size_t count, loff_t *ppos)
+{
+    char kbuf[MAX_BUF_SIZE];
+    unsigned long seq = READ_ONCE(hub.seq);
+    size_t len;
+
+    if (*ppos > 0)
+        return 0;
+
+    if (mutex_lock_interruptible(&hub.lock))
+        return -ERESTARTSYS;
+
+    // A cycle finished while we waited for the lock: share its result
+    if (hub.seq == seq)
+        sensor_hub_cycle();
+
+    if (hub.sht30_err && hub.bh1750_err) {
+        int err = hub.sht30_err;
+
+        mutex_unlock(&hub.lock);
+        return err;
+    }
+
+    len = sensor_hub_format(kbuf, sizeof(kbuf));
+    mutex_unlock(&hub.lock);
+
+    len = min(len, count);
+    if (copy_to_user(buf, kbuf, len))
+        return -EFAULT;
+
+    *ppos += len;
+    return len;
+}
+
+static int my_misc_open(struct inode *inode, struct file *file)
+{
+    return 0;
+}
+
+static int my_misc_release(struct inode *inode, struct file *file)
+{
+    return 0;
+}
+
+static const struct file_operations my_fops = {
+    .owner   = THIS_MODULE,
+    .open    = my_misc_open,
+    .release = my_misc_release,
+    .read    = my_misc_read,
+};
+
+static struct miscdevice my_misc_dev = {
+    .minor = MISC_DYNAMIC_MINOR,
+    .name  = DEVICE_NAME,
+    .fops  = &my_fops,
+};
+
+
+// =========================================================================
+// == Module Init / Exit
+// =========================================================================
+
+static int __init sensor_hub_init(void)
+{
+    int ret;
+
+    ret = misc_register(&my_misc_dev);
+    if (ret) {
+        pr_err("sensor_hub: Failed to register misc device: %d\n", ret);
+        return ret;
+    }
+
+    pr_info("sensor_hub initialized: /dev/%s\n", DEVICE_NAME);
+    return 0;
+}
+
+static void __exit sensor_hub_exit(void)
+{
+    misc_deregister(&my_misc_dev);
+    pr_info("sensor_hub removed\n");
+}
+
+module_init(sensor_hub_init);
+module_exit(sensor_hub_exit);
+
+MODULE_AUTHOR("Seikai <haidoan2098@gmail.com>");
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Pipelined SHT30 + BH1750 sampling over a shared I2C bus");
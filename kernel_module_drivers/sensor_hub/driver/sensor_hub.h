@@ -0,0 +1,21 @@
+#ifndef SENSOR_HUB_H
+#define SENSOR_HUB_H
+
+/*
+ * Interface exported by the sensor drivers to sensor_hub.
+ *
+ * *_hub_start() waits until the driver's state machine is idle, takes its
+ * bus lock and sends the measurement command; it returns the time after
+ * which the result is guaranteed to be ready. *_hub_finish() fetches the
+ * result, publishes it to the driver's own cache and drops the lock. The
+ * two calls must be made from the same task, and every successful start
+ * must be paired with a finish.
+ */
+
+int sht30_hub_start(unsigned int *conv_us);
+int sht30_hub_finish(int *temp_milli, int *hum_milli);
+
+int bh1750_hub_start(unsigned int *conv_us);
+int bh1750_hub_finish(int *lux10);
+
+#endif // SENSOR_HUB_H